@@ -0,0 +1,99 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "blowfish_cfb64.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Blowfish-CFB64 of the game servers: the sessions are either processed one
+// after the other, or in batches where the blocks of LANES sessions are
+// interleaved. The key schedules of a burst of logins are measured the same
+// way.
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024, 4096 };
+static const size_t SESSIONS = 1024;
+
+int
+benchBlowfish(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 64 * 1024 * 1024;
+
+    std::vector<Blowfish_CFB64> ciphers(SESSIONS);
+    std::vector<Blowfish_CFB64*> pointers(SESSIONS);
+    std::vector<uint8_t> keys(SESSIONS * 16);
+    std::vector<const uint8_t*> keyPointers(SESSIONS);
+    std::vector<size_t> keyLens(SESSIONS, 16);
+
+    fillRandom(keys.data(), keys.size(), 1);
+    for (size_t i = 0; i < SESSIONS; ++i)
+    {
+        pointers[i] = &ciphers[i];
+        keyPointers[i] = &keys[i * 16];
+    }
+
+    printf("operation,packet_size,mode,sessions,seconds,ns_per_op,mb_per_s\n");
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        Stopwatch sw;
+        if (mode == 0)
+        {
+            for (size_t i = 0; i < SESSIONS; ++i)
+                ciphers[i].setKey(keyPointers[i], keyLens[i]);
+        }
+        else
+            Blowfish_CFB64::setKeys(pointers.data(), keyPointers.data(), keyLens.data(), SESSIONS);
+        double elapsed = sw.elapsed();
+
+        printf("set_key,16,%s,%u,%.4f,%.1f,\n",
+               mode == 0 ? "serial" : "batched", (unsigned)SESSIONS, elapsed,
+               elapsed * 1e9 / (double)SESSIONS);
+    }
+
+    for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+    {
+        size_t size = PACKET_SIZES[j];
+        size_t rounds = totalBytes / (size * SESSIONS) + 1;
+
+        std::vector<uint8_t> bufs(size * SESSIONS);
+        fillRandom(bufs.data(), bufs.size(), 2);
+
+        std::vector<BlowfishJob> jobs(SESSIONS);
+        for (size_t i = 0; i < SESSIONS; ++i)
+        {
+            jobs[i].cipher = &ciphers[i];
+            jobs[i].buf = &bufs[i * size];
+            jobs[i].len = size;
+        }
+
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            Stopwatch sw;
+            for (size_t n = 0; n < rounds; ++n)
+            {
+                if (mode == 0)
+                {
+                    for (size_t i = 0; i < SESSIONS; ++i)
+                        ciphers[i].encrypt(jobs[i].buf, jobs[i].len);
+                }
+                else
+                    Blowfish_CFB64::encrypt(jobs.data(), jobs.size());
+            }
+            double elapsed = sw.elapsed();
+
+            size_t packets = rounds * SESSIONS;
+            printf("encrypt,%u,%s,%u,%.4f,%.1f,%.1f\n",
+                   (unsigned)size, mode == 0 ? "serial" : "batched", (unsigned)SESSIONS, elapsed,
+                   elapsed * 1e9 / (double)packets,
+                   (double)(packets * size) / elapsed / (1024.0 * 1024.0));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_std.h"
+#include "tqcipher_sse2.h"
+#include "tqcipher_avx2.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The same packet sent to many sessions (e.g. a message to all the players
+// of a map): either each session encrypts its own copy, or the packet is
+// broadcasted. Both must produce the same octets.
+
+static const size_t PACKET_SIZES[] = { 64, 256, 1024 };
+static const size_t FAN_OUTS[] = { 10, 30, 100, 300, 1000 };
+
+typedef void (*Broadcast)(const uint8_t*, size_t, TqBroadcastTarget*, size_t);
+
+static Broadcast
+getBroadcast(const std::string& aImpl)
+{
+    if (aImpl == "std")
+        return &TqCipher_Std::broadcast;
+    else if (aImpl == "sse2")
+        return &TqCipher_SSE2::broadcast;
+    else if (aImpl == "avx2")
+        return &TqCipher_AVX2::broadcast;
+    return nullptr;
+}
+
+int
+benchBroadcast(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+
+    printf("impl,packet_size,fan_out,mode,packets,seconds,ns_per_recipient,mb_per_s\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        Broadcast broadcast = getBroadcast(impls[i]);
+
+        for (size_t k = 0; k < sizeof(FAN_OUTS) / sizeof(FAN_OUTS[0]); ++k)
+        {
+            size_t fanOut = FAN_OUTS[k];
+
+            std::vector<TqCipher_Base*> sessions(fanOut);
+            std::vector<TqBroadcastTarget> targets(fanOut);
+            for (size_t t = 0; t < fanOut; ++t)
+                sessions[t] = createCipher(impls[i]);
+
+            for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+            {
+                size_t size = PACKET_SIZES[j];
+                size_t packets = totalBytes / size / fanOut > 0 ? totalBytes / size / fanOut : 1;
+
+                std::vector<uint8_t> packet(size);
+                std::vector<uint8_t> outs(size * fanOut);
+                fillRandom(packet.data(), packet.size(), 1);
+
+                for (size_t t = 0; t < fanOut; ++t)
+                {
+                    targets[t].cipher = sessions[t];
+                    targets[t].out = &outs[t * size];
+                }
+
+                // check the broadcast against individual encryptions first
+                std::vector<uint8_t> copy(size);
+                broadcast(packet.data(), size, targets.data(), fanOut);
+                for (size_t t = 0; t < fanOut; ++t)
+                {
+                    uint16_t counter = targets[t].counter;
+                    memcpy(copy.data(), packet.data(), size);
+                    TqCipherState state;
+                    sessions[t]->saveState(state);
+                    state.enCounter = counter;
+                    sessions[t]->restoreState(state);
+                    sessions[t]->encrypt(copy.data(), size);
+                    if (memcmp(copy.data(), &outs[t * size], size) != 0)
+                    {
+                        fprintf(stderr, "%s: broadcast differs from encrypt\n", impls[i].c_str());
+                        return EXIT_FAILURE;
+                    }
+                }
+
+                for (int mode = 0; mode < 2; ++mode)
+                {
+                    Stopwatch sw;
+                    for (size_t n = 0; n < packets; ++n)
+                    {
+                        if (mode == 0)
+                        {
+                            for (size_t t = 0; t < fanOut; ++t)
+                            {
+                                memcpy(&outs[t * size], packet.data(), size);
+                                sessions[t]->encrypt(&outs[t * size], size);
+                            }
+                        }
+                        else
+                            broadcast(packet.data(), size, targets.data(), fanOut);
+                    }
+                    double elapsed = sw.elapsed();
+
+                    printf("%s,%u,%u,%s,%u,%.4f,%.1f,%.1f\n",
+                           impls[i].c_str(), (unsigned)size, (unsigned)fanOut,
+                           mode == 0 ? "individual" : "broadcast",
+                           (unsigned)packets, elapsed,
+                           elapsed * 1e9 / (double)(packets * fanOut),
+                           (double)(packets * fanOut * size) / elapsed / (1024.0 * 1024.0));
+                }
+            }
+
+            for (size_t t = 0; t < fanOut; ++t)
+                delete sessions[t];
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
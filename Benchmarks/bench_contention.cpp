@@ -0,0 +1,113 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+#include <thread>
+
+// One session, a send thread encrypting and a receive thread decrypting at
+// the same time. Either the whole session is guarded by a mutex, or each
+// thread drives its own cache-line isolated stream.
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024 };
+
+static double
+runLocked(TqCipher_Base* aCipher, size_t aPacketSize, size_t aPackets)
+{
+    std::mutex lock;
+
+    auto worker = [&](bool aEncrypt)
+    {
+        std::vector<uint8_t> buf(aPacketSize);
+        fillRandom(buf.data(), buf.size(), aEncrypt ? 1 : 2);
+
+        for (size_t i = 0; i < aPackets; ++i)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (aEncrypt)
+                aCipher->encrypt(buf.data(), buf.size());
+            else
+                aCipher->decrypt(buf.data(), buf.size());
+        }
+    };
+
+    Stopwatch sw;
+    std::thread sender(worker, true);
+    std::thread receiver(worker, false);
+    sender.join();
+    receiver.join();
+    return sw.elapsed();
+}
+
+static double
+runSplit(TqCipher_Base* aCipher, size_t aPacketSize, size_t aPackets)
+{
+    TqCipherStream* encryptor = aCipher->createEncryptor();
+    TqCipherStream* decryptor = aCipher->createDecryptor();
+
+    auto worker = [&](TqCipherStream* aStream, uint32_t aSeed)
+    {
+        std::vector<uint8_t> buf(aPacketSize);
+        fillRandom(buf.data(), buf.size(), aSeed);
+
+        for (size_t i = 0; i < aPackets; ++i)
+            aStream->process(buf.data(), buf.size());
+    };
+
+    Stopwatch sw;
+    std::thread sender(worker, encryptor, 1);
+    std::thread receiver(worker, decryptor, 2);
+    sender.join();
+    receiver.join();
+    double elapsed = sw.elapsed();
+
+    delete encryptor;
+    delete decryptor;
+    return elapsed;
+}
+
+int
+benchContention(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+
+    printf("impl,packet_size,mode,packets_per_thread,seconds,ns_per_packet,mb_per_s\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipher_Base* cipher = createCipher(impls[i]);
+        cipher->generateAltKey(0x4C7D0F33, 0x2A4D5C67);
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            size_t size = PACKET_SIZES[j];
+            size_t packets = totalBytes / size / 2;
+
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                double elapsed = mode == 0
+                    ? runLocked(cipher, size, packets)
+                    : runSplit(cipher, size, packets);
+
+                printf("%s,%u,%s,%u,%.4f,%.1f,%.1f\n",
+                       impls[i].c_str(), (unsigned)size, mode == 0 ? "mutex" : "split",
+                       (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets,
+                       (double)(2 * packets * size) / elapsed / (1024.0 * 1024.0));
+            }
+        }
+
+        delete cipher;
+    }
+
+    return EXIT_SUCCESS;
+}
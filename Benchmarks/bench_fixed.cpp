@@ -0,0 +1,221 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_fixed.h"
+#include "tqcipher_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The fixed-size messages (heartbeats, movements, actions, ...), encrypted
+// one after the other by a session:
+//  - runtime:       TqCipher_Base::encrypt(aBuf, aLen), the generic kernel;
+//  - fixed:         TqCipher_Base::encrypt<N>, the kernel specialized for the size;
+//  - stream:        TqCipherStream::process(aBuf, aLen);
+//  - stream_fixed:  TqCipherStream::process<N>.
+// The counters run through all the pages, so the packets crossing into the
+// next key2 octet are measured too.
+//
+// Before the timings, the specialized kernels of every size from 1 to 64
+// octets are checked against the runtime path, at every counter where a
+// packet reaches a page boundary, with the base key (encryption) and the
+// alternate key (decryption).
+
+enum Mode { MODE_RUNTIME, MODE_FIXED, MODE_STREAM, MODE_STREAM_FIXED };
+static const char* MODE_NAMES[] = { "runtime", "fixed", "stream", "stream_fixed" };
+
+/** The largest size checked against the runtime path. */
+static const size_t CHECK_MAX_SIZE = 64;
+
+/**
+ * Compare the kernels specialized for N octets to the runtime path, for the
+ * sessions and the streams. The packets start from N octets before each page
+ * boundary up to the boundary itself, so each one ends at, crosses or starts
+ * at the boundary (the key2 octet changes).
+ *
+ * @returns false if an octet differs
+ */
+template <size_t N>
+static bool
+check(const std::string& aImpl)
+{
+    TqCipher_Base* fixed = createCipher(aImpl);
+    TqCipher_Base* runtime = createCipher(aImpl);
+
+    uint8_t plain[N], expected[N], actual[N];
+    fillRandom(plain, N, (uint32_t)N);
+
+    bool ok = true;
+    for (int alt = 0; alt < 2 && ok; ++alt)
+    {
+        if (alt != 0)
+        {
+            fixed->generateAltKey(0x12345678, 1000001);
+            runtime->generateAltKey(0x12345678, 1000001);
+        }
+
+        TqCipherState state;
+        runtime->saveState(state);
+        for (uint32_t page = 0; page < 256 && ok; ++page)
+        {
+            for (uint32_t back = 0; back <= N && ok; ++back)
+            {
+                state.enCounter = state.deCounter = (uint16_t)(page * 256 - back);
+                fixed->restoreState(state);
+                runtime->restoreState(state);
+
+                TqCipherStream* streams[] = {
+                    fixed->createEncryptor(), runtime->createEncryptor(),
+                    fixed->createDecryptor(), runtime->createDecryptor() };
+
+                // encrypt<N> then decrypt<N>, then the fixed streams
+                for (int op = 0; op < 4 && ok; ++op)
+                {
+                    memcpy(expected, plain, N);
+                    memcpy(actual, plain, N);
+                    switch (op)
+                    {
+                        case 0:
+                            runtime->encrypt(expected, N);
+                            fixed->encrypt<N>(actual);
+                            break;
+                        case 1:
+                            runtime->decrypt(expected, N);
+                            fixed->decrypt<N>(actual);
+                            break;
+                        case 2:
+                            streams[1]->process(expected, N);
+                            streams[0]->process<N>(actual);
+                            break;
+                        case 3:
+                            streams[3]->process(expected, N);
+                            streams[2]->process<N>(actual);
+                            break;
+                    }
+
+                    if (memcmp(expected, actual, N) != 0)
+                    {
+                        fprintf(stderr, "The fixed kernel differs (%s, %u octets, counter %u, %s key, op %d)\n",
+                                aImpl.c_str(), (unsigned)N, (unsigned)state.enCounter,
+                                alt != 0 ? "alternate" : "base", op);
+                        ok = false;
+                    }
+                }
+
+                for (size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); ++i)
+                    delete streams[i];
+            }
+        }
+    }
+
+    delete runtime;
+    delete fixed;
+    return ok;
+}
+
+/**
+ * Check the sizes from 1 to N (see check).
+ */
+template <size_t N>
+struct CheckSizes
+{
+    static bool run(const std::string& aImpl)
+    {
+        bool ok = CheckSizes<N - 1>::run(aImpl);
+        return check<N>(aImpl) && ok;
+    }
+};
+
+template <>
+struct CheckSizes<0>
+{
+    static bool run(const std::string&) { return true; }
+};
+
+/**
+ * Encrypt the same message of N octets n times.
+ *
+ * @returns the elapsed time in seconds
+ */
+template <size_t N>
+static double
+run(int aMode, TqCipher_Base* aCipher, TqCipherStream* aStream, uint8_t* aBuf, size_t aPackets)
+{
+    Stopwatch sw;
+    switch (aMode)
+    {
+        case MODE_RUNTIME:
+            for (size_t i = 0; i < aPackets; ++i)
+                aCipher->encrypt(aBuf, N);
+            break;
+        case MODE_FIXED:
+            for (size_t i = 0; i < aPackets; ++i)
+                aCipher->encrypt<N>(aBuf);
+            break;
+        case MODE_STREAM:
+            for (size_t i = 0; i < aPackets; ++i)
+                aStream->process(aBuf, N);
+            break;
+        case MODE_STREAM_FIXED:
+            for (size_t i = 0; i < aPackets; ++i)
+                aStream->process<N>(aBuf);
+            break;
+    }
+    return sw.elapsed();
+}
+
+/**
+ * Measure all the modes for a message of N octets.
+ */
+template <size_t N>
+static void
+measure(const std::string& aImpl, size_t aPackets)
+{
+    for (int mode = MODE_RUNTIME; mode <= MODE_STREAM_FIXED; ++mode)
+    {
+        TqCipher_Base* cipher = createCipher(aImpl);
+        TqCipherStream* stream = cipher->createEncryptor();
+
+        uint8_t buf[N];
+        fillRandom(buf, N, 1);
+
+        double elapsed = run<N>(mode, cipher, stream, buf, aPackets);
+
+        printf("%s,%u,%s,%u,%.4f,%.1f,%.1f\n",
+               aImpl.c_str(), (unsigned)N, MODE_NAMES[mode], (unsigned)aPackets, elapsed,
+               elapsed * 1e9 / (double)aPackets,
+               (double)(aPackets * N) / elapsed / (1024.0 * 1024.0));
+
+        delete stream;
+        delete cipher;
+    }
+}
+
+int
+benchFixed(int argc, char* argv[])
+{
+    size_t packets = argc > 0 ? (size_t)atol(argv[0]) : 16 * 1024 * 1024;
+
+    printf("impl,packet_size,mode,packets,seconds,ns_per_packet,mb_per_s\n");
+
+    bool ok = true;
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        ok &= CheckSizes<CHECK_MAX_SIZE>::run(impls[i]);
+
+        measure<8>(impls[i], packets);
+        measure<12>(impls[i], packets);
+        measure<16>(impls[i], packets);
+        measure<24>(impls[i], packets);
+        measure<28>(impls[i], packets);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
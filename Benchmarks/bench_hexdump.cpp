@@ -0,0 +1,127 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "instructionset.h"
+#include "tqcipher_stream.h"
+#include "tqhexdump.h"
+#include "tqhexdump_avx2.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Packet logs of a decryptor (the dumps are discarded):
+//  - concat:  the dump of the test vectors, concatenating the strings
+//             (the formatting of the current packet logs);
+//  - scalar:  the portable formatter, one octet at a time;
+//  - avx2:    the vectorized formatter, two lines at a time;
+//  - decrypt: the packet decrypted, then dumped by the best formatter;
+//  - fused:   decrypted and dumped in one pass (TqHexDump::formatDecrypted).
+
+static const size_t PACKET_SIZES[] = { 64, 256, 1024, 8192 };
+
+enum Mode { MODE_CONCAT, MODE_SCALAR, MODE_AVX2, MODE_DECRYPT, MODE_FUSED };
+static const char* MODE_NAMES[] = { "concat", "scalar", "avx2", "decrypt", "fused" };
+
+/**
+ * Dump a packet like the test vectors: the hexadecimal string is built,
+ * then cut in lines of 48 characters, each one followed by its text.
+ */
+static std::string
+concatDump(const uint8_t* aBuf, size_t aLen)
+{
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+    std::string hex = "";
+    for (size_t i = 0; i < aLen; ++i)
+        hex = hex + HEX_DIGITS[aBuf[i] >> 4] + HEX_DIGITS[aBuf[i] & 0x0F] + " ";
+
+    std::string out = "";
+    while (hex.length() != 0)
+    {
+        std::string line = hex.substr(0, hex.length() >= 48 ? 48 : hex.length());
+        std::string text = "";
+        for (size_t i = 0; i < line.length(); i += 3)
+        {
+            uint8_t octet = (uint8_t)strtoul(line.substr(i, 2).c_str(), nullptr, 16);
+            text = text + (octet >= 32 && octet <= 126 ? (char)octet : '.');
+        }
+        hex.erase(0, line.length());
+        out = out + line + std::string(60 - line.length(), ' ') + text + "\r\n";
+    }
+    return out;
+}
+
+int
+benchHexDump(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 64 * 1024 * 1024;
+
+    printf("mode,packet_size,packets,seconds,ns_per_packet,mb_per_s\n");
+
+    TqCipher_Base* cipher = createCipher(getSupportedImpls().back());
+    TqCipherStream* decryptor = cipher->createDecryptor();
+    TqHexDump::Lines lines = InstructionSet::AVX2() ? &TqHexDump_AVX2::formatLines : &TqHexDump::formatLines;
+
+    size_t checksum = 0;
+    for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+    {
+        size_t size = PACKET_SIZES[j];
+        std::vector<uint8_t> packet(size);
+        std::vector<char> dump(TqHexDump::getSize(size));
+        fillRandom(packet.data(), packet.size(), 1);
+
+        for (int mode = MODE_CONCAT; mode <= MODE_FUSED; ++mode)
+        {
+            if (mode == MODE_AVX2 && !InstructionSet::AVX2())
+                continue;
+
+            // the concatenations are too slow for the whole total
+            size_t packets = (mode == MODE_CONCAT ? totalBytes / 64 : totalBytes) / size + 1;
+
+            Stopwatch sw;
+            for (size_t n = 0; n < packets; ++n)
+            {
+                switch (mode)
+                {
+                    case MODE_CONCAT:
+                        checksum += concatDump(packet.data(), size).length();
+                        break;
+                    case MODE_SCALAR:
+                        checksum += TqHexDump::format(&TqHexDump::formatLines, packet.data(), size, dump.data(), dump.size());
+                        break;
+                    case MODE_AVX2:
+                        checksum += TqHexDump::format(&TqHexDump_AVX2::formatLines, packet.data(), size, dump.data(), dump.size());
+                        break;
+                    case MODE_DECRYPT:
+                        decryptor->process(packet.data(), size);
+                        checksum += TqHexDump::format(lines, packet.data(), size, dump.data(), dump.size());
+                        break;
+                    case MODE_FUSED:
+                        checksum += TqHexDump::formatDecrypted(lines, *decryptor, decryptor->reserve(size),
+                                                               packet.data(), size, packet.data(),
+                                                               dump.data(), dump.size());
+                        break;
+                }
+                checksum += (uint8_t)dump[n % dump.size()];
+            }
+            double elapsed = sw.elapsed();
+
+            printf("%s,%u,%u,%.4f,%.1f,%.1f\n",
+                   MODE_NAMES[mode], (unsigned)size, (unsigned)packets, elapsed,
+                   elapsed * 1e9 / (double)packets,
+                   (double)(packets * size) / elapsed / (1024.0 * 1024.0));
+        }
+    }
+
+    delete decryptor;
+    delete cipher;
+
+    fprintf(stderr, "checksum: %u\n", (unsigned)checksum);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqnuma.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+// The sessions are created by a thread pinned on a home node and served by
+// a worker pinned on another node, each packet being encrypted and decrypted
+// (with the alternate key of the session):
+//  - remote:  the sessions and the base key read by the worker are on the
+//             home node;
+//  - rebound: the sessions are rebound to the node of the worker, only the
+//             state of the sessions is still on the home node;
+//  - local:   the sessions are created by the worker, on its node.
+// On a single node machine, there is only the pair (0, 0).
+
+enum Mode { MODE_REMOTE, MODE_REBOUND, MODE_LOCAL };
+static const char* MODE_NAMES[] = { "remote", "rebound", "local" };
+
+static void
+createSessions(const std::string& aImpl, std::vector<TqCipher_Base*>& aSessions)
+{
+    for (size_t i = 0; i < aSessions.size(); ++i)
+    {
+        aSessions[i] = createCipher(aImpl);
+        aSessions[i]->generateAltKey((int32_t)i, 0x2A4D5C67);
+    }
+}
+
+static double
+runSessions(const std::string& aImpl, uint32_t aHome, uint32_t aWorker, Mode aMode,
+            size_t aSessions, size_t aPackets, size_t aPacketSize)
+{
+    std::vector<TqCipher_Base*> sessions(aSessions);
+
+    if (aMode != MODE_LOCAL)
+    {
+        std::thread creator([&]()
+        {
+            TqNuma::pinThread(aHome);
+            createSessions(aImpl, sessions);
+        });
+        creator.join();
+    }
+
+    double elapsed = 0.0;
+    std::thread worker([&]()
+    {
+        TqNuma::pinThread(aWorker);
+
+        if (aMode == MODE_LOCAL)
+            createSessions(aImpl, sessions);
+        else if (aMode == MODE_REBOUND)
+        {
+            for (size_t i = 0; i < sessions.size(); ++i)
+                sessions[i]->bindToNode(TqNuma::getCurrentNode());
+        }
+
+        std::vector<uint8_t> buf(aPacketSize);
+        fillRandom(buf.data(), buf.size(), 1);
+
+        Stopwatch sw;
+        for (size_t n = 0; n < aPackets; ++n)
+        {
+            // stride through the sessions, so their state isn't in the cache
+            TqCipher_Base* session = sessions[(n * 7919) % sessions.size()];
+            session->encrypt(buf.data(), buf.size());
+            session->decrypt(buf.data(), buf.size());
+        }
+        elapsed = sw.elapsed();
+    });
+    worker.join();
+
+    for (size_t i = 0; i < sessions.size(); ++i)
+        delete sessions[i];
+
+    return elapsed;
+}
+
+int
+benchNuma(int argc, char* argv[])
+{
+    size_t sessions = argc > 0 ? (size_t)atol(argv[0]) : 4096;
+    size_t packets = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    size_t packetSize = argc > 2 ? (size_t)atol(argv[2]) : 256;
+    if (sessions == 0)
+        sessions = 1;
+
+    std::vector<std::string> impls = getSupportedImpls();
+    const std::string& impl = impls.back(); // the fastest kernel
+
+    uint32_t nodes = TqNuma::getNodeCount();
+    fprintf(stderr, "%u node(s), %s kernel\n", (unsigned)nodes, impl.c_str());
+
+    printf("impl,home_node,worker_node,mode,sessions,packets,seconds,ns_per_packet,mb_per_s\n");
+
+    for (uint32_t home = 0; home < nodes; ++home)
+    {
+        for (uint32_t worker = 0; worker < nodes; ++worker)
+        {
+            for (int mode = MODE_REMOTE; mode <= MODE_LOCAL; ++mode)
+            {
+                double elapsed = runSessions(impl, home, worker, (Mode)mode,
+                                             sessions, packets, packetSize);
+
+                printf("%s,%u,%u,%s,%u,%u,%.4f,%.1f,%.1f\n",
+                       impl.c_str(), (unsigned)home, (unsigned)worker, MODE_NAMES[mode],
+                       (unsigned)sessions, (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets,
+                       (double)(2 * packets * packetSize) / elapsed / (1024.0 * 1024.0));
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_offload.h"
+#include "tqoffload_service.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+// Sessions encrypting their packets in the process, or handing them over to
+// the offload service: copied in and out of a block of the arena, or written
+// directly in the arena (zero-copy). The service of the given name is used
+// if it runs, else one is started in the process.
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024, 4096, 16384 };
+static const char* const MODES[] = { "in-process", "offload-copy", "offload-zero-copy" };
+static const size_t MAX_SAMPLES = 65536;
+
+/**
+ * Encrypt the packets of one session and sample their latency.
+ */
+static void
+encryptThread(TqCipher_Base* aCipher, uint8_t* aBuf, size_t aSize, size_t aPackets,
+              std::vector<double>& aLatencies)
+{
+    size_t step = aPackets > MAX_SAMPLES ? aPackets / MAX_SAMPLES : 1;
+
+    Stopwatch sw;
+    for (size_t n = 0; n < aPackets; ++n)
+    {
+        if (n % step != 0)
+        {
+            aCipher->encrypt(aBuf, aSize);
+            continue;
+        }
+
+        double start = sw.elapsed();
+        aCipher->encrypt(aBuf, aSize);
+        aLatencies.push_back(sw.elapsed() - start);
+    }
+}
+
+int
+benchOffload(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 64 * 1024 * 1024;
+    size_t threads = argc > 1 ? (size_t)atol(argv[1]) : 1;
+    const char* name = argc > 2 ? argv[2] : TqOffloadService::DEFAULT_NAME;
+
+    std::string impl = getSupportedImpls().back();
+    TqCipherStream::Kernel kernel = getKernel(impl);
+
+    TqOffloadService service;
+    TqOffloadClient* client = TqOffloadClient::connect(name);
+    if (client == nullptr)
+    {
+        name = "tqcipher-offload-bench";
+        if (!service.start(name, kernel, 2, -1) || (client = TqOffloadClient::connect(name)) == nullptr)
+        {
+            fprintf(stderr, "Can't start the offload service\n");
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Using an in-process service (%s)\n", impl.c_str());
+    }
+    if (threads == 0 || threads > TqOffloadRegion::BLOCKS)
+        threads = 1;
+
+    printf("impl,packet_size,threads,mode,packets,seconds,mb_per_s,p50_ns,p99_ns\n");
+
+    bool ok = true;
+    for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+    {
+        size_t size = PACKET_SIZES[j];
+        size_t packets = totalBytes / size / threads;
+
+        for (size_t mode = 0; mode < sizeof(MODES) / sizeof(MODES[0]); ++mode)
+        {
+            std::vector<TqCipher_Base*> ciphers(threads);
+            std::vector<uint8_t*> bufs(threads);
+            std::vector<std::vector<double> > latencies(threads);
+
+            for (size_t t = 0; t < threads; ++t)
+            {
+                if (mode == 0)
+                    ciphers[t] = createCipher(impl);
+                else
+                {
+                    ciphers[t] = new TqCipher_Offload(client, kernel);
+                    ciphers[t]->generateKey(BENCH_P, BENCH_G);
+                }
+                bufs[t] = mode == 2 ? client->allocate() : new uint8_t[size];
+                fillRandom(bufs[t], size, (uint32_t)(t + 1));
+            }
+
+            // the offloaded sessions must produce the same octets
+            if (mode != 0)
+            {
+                TqCipher_Base* reference = createCipher(impl);
+                std::vector<uint8_t> expected(bufs[0], bufs[0] + size);
+                std::vector<uint8_t> actual(expected);
+                reference->encrypt(expected.data(), size);
+                TqCipher_Base* check = new TqCipher_Offload(client, kernel);
+                check->generateKey(BENCH_P, BENCH_G);
+                check->encrypt(actual.data(), size);
+                if (expected != actual)
+                {
+                    fprintf(stderr, "The offloaded octets differ (%s, %u)\n", MODES[mode], (unsigned)size);
+                    ok = false;
+                }
+                delete check;
+                delete reference;
+            }
+
+            std::vector<std::thread> workers;
+            Stopwatch sw;
+            for (size_t t = 0; t < threads; ++t)
+            {
+                workers.push_back(std::thread(&encryptThread, ciphers[t], bufs[t], size, packets,
+                                              std::ref(latencies[t])));
+            }
+            for (size_t t = 0; t < threads; ++t)
+                workers[t].join();
+            double elapsed = sw.elapsed();
+
+            std::vector<double> all;
+            for (size_t t = 0; t < threads; ++t)
+            {
+                all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+                if (mode == 2)
+                    client->release(bufs[t]);
+                else
+                    delete[] bufs[t];
+                delete ciphers[t];
+            }
+            std::sort(all.begin(), all.end());
+
+            printf("%s,%u,%u,%s,%u,%.4f,%.1f,%.0f,%.0f\n",
+                   impl.c_str(), (unsigned)size, (unsigned)threads, MODES[mode],
+                   (unsigned)(packets * threads), elapsed,
+                   (double)(packets * threads * size) / elapsed / (1024.0 * 1024.0),
+                   all[all.size() / 2] * 1e9, all[all.size() * 99 / 100] * 1e9);
+            fflush(stdout);
+        }
+    }
+
+    delete client;
+    service.stop();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,68 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqkeycontext.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// The kernels split a buffer at the boundaries of the pages of 256 counters
+// (sharing the same key2 octet): a buffer starting on a page is processed by
+// whole unrolled pages, while any other start has a partial first run, and
+// a partial vector when the start isn't a multiple of the vector width.
+
+static const size_t PACKET_SIZES[] = { 64, 1024, 16384 };
+static const uint16_t OFFSETS[] = { 0, 1, 8, 15, 16, 31, 32, 63, 64, 128, 200, 255 };
+
+int
+benchOffsets(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+
+    printf("impl,packet_size,offset,packets,seconds,ns_per_packet,mb_per_s\n");
+
+    const TqKeyContext* context = TqKeyContext::acquire(BENCH_P, BENCH_G);
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipherStream::Kernel kernel = getKernel(impls[i]);
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            size_t size = PACKET_SIZES[j];
+            size_t packets = totalBytes / size;
+
+            std::vector<uint8_t> buf(size);
+            fillRandom(buf.data(), buf.size(), 1);
+
+            for (size_t k = 0; k < sizeof(OFFSETS) / sizeof(OFFSETS[0]); ++k)
+            {
+                // each packet starts at the same offset in the next page
+                uint16_t counter = OFFSETS[k];
+
+                Stopwatch sw;
+                for (size_t n = 0; n < packets; ++n)
+                {
+                    kernel(context->getKey(), counter, buf.data(), buf.size());
+                    counter = (uint16_t)(counter + 0x100);
+                }
+                double elapsed = sw.elapsed();
+
+                printf("%s,%u,%u,%u,%.4f,%.1f,%.1f\n",
+                       impls[i].c_str(), (unsigned)size, (unsigned)OFFSETS[k],
+                       (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets,
+                       (double)(packets * size) / elapsed / (1024.0 * 1024.0));
+            }
+        }
+    }
+
+    context->release();
+    return EXIT_SUCCESS;
+}
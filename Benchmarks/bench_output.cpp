@@ -0,0 +1,257 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqoutput.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// On each tick, the game logic emits small packets (8 to 64 octets) for the
+// clients of a map, then the packets are sent:
+//  - immediate: each packet is encrypted by its own call, then copied to the
+//               send buffer of the socket;
+//  - coalesced: the packets are appended to the output buffer of the
+//               session, encrypted by one call and handed over at the end
+//               of the tick (or when a segment is full).
+// Before, the octets handed over by the output buffer are checked against
+// one encryption per packet, with a sink taking everything and with a sink
+// only taking a part of them (or nothing) on each call.
+
+static const size_t PACKETS_PER_TICK[] = { 4, 16, 64, 256 };
+static const size_t SESSIONS = 64;
+static const size_t SEND_BUFFER_SIZE = 64 * 1024;
+static const size_t FLUSH_SIZE = 1460; // a TCP segment
+
+enum Mode { MODE_IMMEDIATE, MODE_COALESCED };
+static const char* MODE_NAMES[] = { "immediate", "coalesced" };
+
+/**
+ * Send buffer of the socket of a session (emptied on each tick).
+ */
+struct SendBuffer
+{
+    uint8_t data[SEND_BUFFER_SIZE];
+    size_t length;
+};
+
+static size_t
+sendToSocket(void* aContext, const uint8_t* aBuf, size_t aLen)
+{
+    SendBuffer* socket = (SendBuffer*)aContext;
+    size_t len = aLen < SEND_BUFFER_SIZE - socket->length ? aLen : SEND_BUFFER_SIZE - socket->length;
+    memcpy(socket->data + socket->length, aBuf, len);
+    socket->length += len;
+    return len;
+}
+
+static const size_t CHECK_PACKETS = 4096;
+static const size_t CHECK_MAX_SIZE = 200;
+static const size_t CHECK_CAPACITY = 256;
+static const size_t CHECK_FLUSH_SIZE = 100;
+
+/**
+ * Sink of the check, taking at most a limit of octets per call (and nothing
+ * on every third call), or everything without a limit.
+ */
+struct CheckSink
+{
+    std::vector<uint8_t> received;
+    size_t limit;
+    size_t calls;
+};
+
+static size_t
+sendToCheck(void* aContext, const uint8_t* aBuf, size_t aLen)
+{
+    CheckSink* sink = (CheckSink*)aContext;
+    size_t len = aLen;
+    if (sink->limit != 0)
+    {
+        len = aLen < sink->limit ? aLen : sink->limit;
+        if (++sink->calls % 3 == 0)
+            len = 0;
+    }
+
+    sink->received.insert(sink->received.end(), aBuf, aBuf + len);
+    return len;
+}
+
+/**
+ * Check that the octets handed over to a sink are those of one encryption
+ * per packet, in order.
+ */
+static bool
+checkOutput(const std::string& aImpl, size_t aLimit)
+{
+    TqCipher_Base* cipher = createCipher(aImpl);
+    TqCipher_Base* reference = createCipher(aImpl);
+
+    CheckSink sink;
+    sink.limit = aLimit;
+    sink.calls = 0;
+
+    std::vector<uint8_t> sizes(CHECK_PACKETS);
+    fillRandom(sizes.data(), sizes.size(), 3);
+
+    bool ok = true;
+    std::vector<uint8_t> expected;
+    {
+        TqOutputBuffer output(*cipher, CHECK_CAPACITY, CHECK_FLUSH_SIZE, 0xFFFFFFFF, &sendToCheck, &sink);
+        for (size_t n = 0; n < CHECK_PACKETS && ok; ++n)
+        {
+            uint8_t packet[CHECK_MAX_SIZE];
+            size_t len = 1 + sizes[n] % CHECK_MAX_SIZE;
+            fillRandom(packet, len, (uint32_t)(n + 4));
+
+            // alternately copied and written in place, flushing while the
+            // sink leaves no room
+            bool appended = false;
+            for (size_t tries = 0; !appended && tries < 1000; ++tries)
+            {
+                if (n % 2 == 0)
+                {
+                    appended = output.write(packet, len);
+                }
+                else
+                {
+                    uint8_t* out = output.append(len);
+                    if (out != nullptr)
+                        memcpy(out, packet, len);
+                    appended = out != nullptr;
+                }
+
+                if (!appended)
+                    output.flush();
+            }
+
+            reference->encrypt(packet, len);
+            expected.insert(expected.end(), packet, packet + len);
+
+            // the end of a tick
+            if (n % 16 == 15)
+                output.poll();
+
+            if (!appended)
+            {
+                fprintf(stderr, "The output buffer stays full (%s, limit %u)\n", aImpl.c_str(), (unsigned)aLimit);
+                ok = false;
+            }
+        }
+
+        for (size_t tries = 0; ok && !output.flush() && tries < 1000; ++tries)
+            ;
+        if (output.getPending() != 0 || output.getWaiting() != 0)
+        {
+            fprintf(stderr, "The output buffer isn't drained (%s, limit %u)\n", aImpl.c_str(), (unsigned)aLimit);
+            ok = false;
+        }
+    }
+
+    if (sink.received != expected)
+    {
+        fprintf(stderr, "The coalesced octets differ (%s, limit %u)\n", aImpl.c_str(), (unsigned)aLimit);
+        ok = false;
+    }
+
+    delete reference;
+    delete cipher;
+    return ok;
+}
+
+int
+benchOutput(int argc, char* argv[])
+{
+    size_t totalPackets = argc > 0 ? (size_t)atol(argv[0]) : 16 * 1024 * 1024;
+
+    printf("impl,packets_per_tick,mode,packets,seconds,ns_per_packet,encrypt_calls\n");
+
+    // the sizes of the packets of a tick
+    std::vector<uint8_t> sizes(4096);
+    fillRandom(sizes.data(), sizes.size(), 1);
+    for (size_t i = 0; i < sizes.size(); ++i)
+        sizes[i] = (uint8_t)(8 + sizes[i] % 57);
+
+    uint8_t packet[64];
+    fillRandom(packet, sizeof(packet), 2);
+
+    bool ok = true;
+    std::vector<SendBuffer> sockets(SESSIONS);
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        ok &= checkOutput(impls[i], 0);
+        ok &= checkOutput(impls[i], 37);
+
+        for (size_t j = 0; j < sizeof(PACKETS_PER_TICK) / sizeof(PACKETS_PER_TICK[0]); ++j)
+        {
+            size_t perTick = PACKETS_PER_TICK[j];
+            size_t ticks = totalPackets / perTick / SESSIONS;
+
+            for (int mode = MODE_IMMEDIATE; mode <= MODE_COALESCED; ++mode)
+            {
+                std::vector<TqCipher_Base*> ciphers(SESSIONS);
+                std::vector<TqOutputBuffer*> outputs(SESSIONS);
+                for (size_t s = 0; s < SESSIONS; ++s)
+                {
+                    ciphers[s] = createCipher(impls[i]);
+                    outputs[s] = new TqOutputBuffer(*ciphers[s], 16 * 1024, FLUSH_SIZE, 50, &sendToSocket, &sockets[s]);
+                }
+
+                size_t calls = 0;
+                Stopwatch sw;
+                for (size_t t = 0; t < ticks; ++t)
+                {
+                    for (size_t s = 0; s < SESSIONS; ++s)
+                    {
+                        sockets[s].length = 0;
+                        for (size_t n = 0; n < perTick; ++n)
+                        {
+                            size_t len = sizes[(t * perTick + n) % sizes.size()];
+                            if (mode == MODE_IMMEDIATE)
+                            {
+                                uint8_t buf[64];
+                                memcpy(buf, packet, len);
+                                ciphers[s]->encrypt(buf, len);
+                                sendToSocket(&sockets[s], buf, len);
+                                ++calls;
+                            }
+                            else
+                            {
+                                size_t pending = outputs[s]->getPending();
+                                outputs[s]->write(packet, len);
+                                if (outputs[s]->getPending() < pending + len)
+                                    ++calls; // flushed by the size threshold
+                            }
+                        }
+
+                        if (mode == MODE_COALESCED)
+                        {
+                            outputs[s]->flush();
+                            ++calls;
+                        }
+                    }
+                }
+                double elapsed = sw.elapsed();
+
+                size_t packets = ticks * perTick * SESSIONS;
+                printf("%s,%u,%s,%u,%.4f,%.1f,%u\n",
+                       impls[i].c_str(), (unsigned)perTick, MODE_NAMES[mode], (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets, (unsigned)calls);
+
+                for (size_t s = 0; s < SESSIONS; ++s)
+                {
+                    delete outputs[s];
+                    delete ciphers[s];
+                }
+            }
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
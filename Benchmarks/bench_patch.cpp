@@ -0,0 +1,106 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_std.h"
+#include "tqcipher_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The timestamp (4 octets at offset 4) of the packets waiting in a send
+// queue, already encrypted, is updated before the flush:
+//  - reencrypt: the packet is decrypted at its position, edited, then
+//               encrypted again;
+//  - patch:     the ciphertext of the timestamp is patched with the delta of
+//               the plaintext (TqCipher_Std::patch).
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024 };
+static const size_t QUEUE_SIZE = 256;
+static const size_t FIELD_OFFSET = 4;
+
+enum Mode { MODE_REENCRYPT, MODE_PATCH };
+static const char* MODE_NAMES[] = { "reencrypt", "patch" };
+
+int
+benchPatch(int argc, char* argv[])
+{
+    size_t totalPackets = argc > 0 ? (size_t)atol(argv[0]) : 16 * 1024 * 1024;
+
+    printf("impl,packet_size,mode,packets,seconds,ns_per_packet\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipher_Base* cipher = createCipher(impls[i]);
+        TqCipherStream* encryptor = cipher->createEncryptor();
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            size_t size = PACKET_SIZES[j];
+            size_t rounds = totalPackets / QUEUE_SIZE;
+
+            // the queue of encrypted packets (with a zero timestamp), with their positions
+            std::vector<uint8_t> queue(QUEUE_SIZE * size);
+            std::vector<uint32_t> positions(QUEUE_SIZE);
+            fillRandom(queue.data(), queue.size(), 1);
+            for (size_t n = 0; n < QUEUE_SIZE; ++n)
+            {
+                memset(&queue[n * size + FIELD_OFFSET], 0, sizeof(uint32_t));
+                positions[n] = encryptor->getPosition();
+                encryptor->process(&queue[n * size], size);
+            }
+
+            for (int mode = MODE_REENCRYPT; mode <= MODE_PATCH; ++mode)
+            {
+                uint32_t timestamp = 0;
+
+                Stopwatch sw;
+                for (size_t r = 0; r < rounds; ++r)
+                {
+                    uint32_t next = timestamp + 1;
+                    for (size_t n = 0; n < QUEUE_SIZE; ++n)
+                    {
+                        uint8_t* packet = &queue[n * size];
+                        if (mode == MODE_REENCRYPT)
+                        {
+                            encryptor->processAt(positions[n], packet, size);
+                            memcpy(packet + FIELD_OFFSET, &next, sizeof(next));
+                            encryptor->processAt(positions[n], packet, size);
+                        }
+                        else
+                        {
+                            TqCipher_Std::patch(packet + FIELD_OFFSET,
+                                                (const uint8_t*)&timestamp, (const uint8_t*)&next, sizeof(next));
+                        }
+                    }
+                    timestamp = next;
+                }
+                double elapsed = sw.elapsed();
+
+                size_t packets = rounds * QUEUE_SIZE;
+                printf("%s,%u,%s,%u,%.4f,%.1f\n",
+                       impls[i].c_str(), (unsigned)size, MODE_NAMES[mode], (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets);
+
+                // the next mode starts from a zero timestamp again
+                for (size_t n = 0; n < QUEUE_SIZE; ++n)
+                {
+                    uint32_t zero = 0;
+                    TqCipher_Std::patch(&queue[n * size + FIELD_OFFSET],
+                                        (const uint8_t*)&timestamp, (const uint8_t*)&zero, sizeof(zero));
+                }
+            }
+        }
+
+        delete encryptor;
+        delete cipher;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "perfcounters.h"
+#include "tqkeycontext.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Hardware counters of each kernel, per size class and placement of the
+// packet in the key:
+//  - aligned:   the packet starts at a counter multiple of 256;
+//  - unaligned: the packet starts one octet after (unaligned key loads);
+//  - crossing:  the packet starts 8 octets before the end of a key2 block,
+//               so the vector kernels take their boundary path.
+// The counters are reported per packet; the frequency ratio (cycles over
+// reference cycles) shows the frequency licence of the kernel.
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024, 4096, 65536 };
+
+static const struct
+{
+    const char* name;
+    uint16_t counter;
+} PLACEMENTS[] =
+{
+    { "aligned", 0 },
+    { "unaligned", 1 },
+    { "crossing", 248 },
+};
+
+static void
+printCounter(const PerfCounters& aCounters, PerfCounters::Event aEvent, double aPackets)
+{
+    if (aCounters.isAvailable(aEvent))
+        printf(",%.1f", (double)aCounters.getValue(aEvent) / aPackets);
+    else
+        printf(",");
+}
+
+static void
+printRatio(const PerfCounters& aCounters, PerfCounters::Event aNum, PerfCounters::Event aDen)
+{
+    if (aCounters.isAvailable(aNum) && aCounters.isAvailable(aDen) && aCounters.getValue(aDen) != 0)
+        printf(",%.3f", (double)aCounters.getValue(aNum) / (double)aCounters.getValue(aDen));
+    else
+        printf(",");
+}
+
+int
+benchProfile(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 64 * 1024 * 1024;
+
+    PerfCounters counters;
+    const TqKeyContext* context = TqKeyContext::acquire(BENCH_P, BENCH_G);
+
+    // say why a column is empty (e.g. only the reference cycles on Windows)
+    for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+    {
+        if (!counters.isAvailable((PerfCounters::Event)e))
+            fprintf(stderr, "%s: not available (%s)\n", PerfCounters::getName((PerfCounters::Event)e),
+                    counters.getReason((PerfCounters::Event)e));
+    }
+
+    printf("impl,packet_size,placement,packets,seconds,ns_per_packet");
+    for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+        printf(",%s", PerfCounters::getName((PerfCounters::Event)e));
+    printf(",ipc,freq_ratio,cycles_per_byte\n");
+
+    std::vector<uint8_t> buf(PACKET_SIZES[sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]) - 1]);
+    fillRandom(buf.data(), buf.size(), 1);
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipherStream::Kernel kernel = getKernel(impls[i]);
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            for (size_t k = 0; k < sizeof(PLACEMENTS) / sizeof(PLACEMENTS[0]); ++k)
+            {
+                size_t size = PACKET_SIZES[j];
+                uint16_t counter = PLACEMENTS[k].counter;
+                size_t packets = totalBytes / size > 0 ? totalBytes / size : 1;
+
+                // warm up the caches and the frequency
+                for (size_t n = 0; n < packets / 8 + 1; ++n)
+                    kernel(context->getKey(), counter, buf.data(), size);
+
+                Stopwatch sw;
+                counters.start();
+                for (size_t n = 0; n < packets; ++n)
+                    kernel(context->getKey(), counter, buf.data(), size);
+                counters.stop();
+                double elapsed = sw.elapsed();
+
+                printf("%s,%u,%s,%u,%.4f,%.1f",
+                       impls[i].c_str(), (unsigned)size, PLACEMENTS[k].name,
+                       (unsigned)packets, elapsed, elapsed * 1e9 / (double)packets);
+                for (int e = 0; e < PerfCounters::EVENT_COUNT; ++e)
+                    printCounter(counters, (PerfCounters::Event)e, (double)packets);
+                printRatio(counters, PerfCounters::INSTRUCTIONS, PerfCounters::CYCLES);
+                printRatio(counters, PerfCounters::CYCLES, PerfCounters::REF_CYCLES);
+
+                PerfCounters::Event cycles = counters.isAvailable(PerfCounters::CYCLES)
+                    ? PerfCounters::CYCLES : PerfCounters::REF_CYCLES;
+                printCounter(counters, cycles, (double)(packets * size));
+                printf("\n");
+            }
+        }
+    }
+
+    context->release();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "instructionset.h"
+#include "rc5_32.h"
+#include "rc5_32_avx2.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Password fields of a burst of logins (16 octets each), decrypted with the
+// key of the AccServer:
+//  - serial:  one login after the other, the key expanded for each one
+//             (like the managed decryption of the AccServer);
+//  - cached:  one login after the other, with the shared expanded key;
+//  - batched: the whole burst at once, LANES blocks interleaved;
+//  - avx2:    the whole burst at once, eight blocks per vector.
+
+static const size_t BURST_SIZES[] = { 16, 256, 4096 };
+static const size_t PASSWORD_SIZE = 16;
+
+enum Mode { MODE_SERIAL, MODE_CACHED, MODE_BATCHED, MODE_AVX2 };
+static const char* MODE_NAMES[] = { "serial", "cached", "batched", "avx2" };
+
+int
+benchRC5(int argc, char* argv[])
+{
+    size_t totalLogins = argc > 0 ? (size_t)atol(argv[0]) : 4 * 1024 * 1024;
+
+    printf("mode,burst_size,logins,seconds,ns_per_login,logins_per_s\n");
+
+    const RC5_32& serverKey = RC5_32::getServerKey();
+    int lastMode = InstructionSet::AVX2() ? MODE_AVX2 : MODE_BATCHED;
+
+    for (size_t j = 0; j < sizeof(BURST_SIZES) / sizeof(BURST_SIZES[0]); ++j)
+    {
+        size_t burst = BURST_SIZES[j];
+        size_t bursts = totalLogins / burst + 1;
+
+        std::vector<uint8_t> passwords(burst * PASSWORD_SIZE);
+        fillRandom(passwords.data(), passwords.size(), 1);
+
+        for (int mode = MODE_SERIAL; mode <= lastMode; ++mode)
+        {
+            Stopwatch sw;
+            for (size_t n = 0; n < bursts; ++n)
+            {
+                switch (mode)
+                {
+                    case MODE_SERIAL:
+                        for (size_t i = 0; i < burst; ++i)
+                        {
+                            RC5_32 key;
+                            key.setKey(RC5_32::SERVER_SEED, sizeof(RC5_32::SERVER_SEED));
+                            key.decrypt(&passwords[i * PASSWORD_SIZE], PASSWORD_SIZE);
+                        }
+                        break;
+                    case MODE_CACHED:
+                        for (size_t i = 0; i < burst; ++i)
+                            serverKey.decrypt(&passwords[i * PASSWORD_SIZE], PASSWORD_SIZE);
+                        break;
+                    case MODE_BATCHED:
+                        serverKey.decrypt(passwords.data(), passwords.size());
+                        break;
+                    case MODE_AVX2:
+                        RC5_32_AVX2::decrypt(serverKey, passwords.data(), passwords.size());
+                        break;
+                }
+            }
+            double elapsed = sw.elapsed();
+
+            size_t logins = bursts * burst;
+            printf("%s,%u,%u,%.4f,%.1f,%.0f\n",
+                   MODE_NAMES[mode], (unsigned)burst, (unsigned)logins, elapsed,
+                   elapsed * 1e9 / (double)logins, (double)logins / elapsed);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <mutex>
+#include <thread>
+
+// Many threads sending on the same session (e.g. a broadcast reaching one
+// client from several workers). Either the encryption is serialized by a
+// mutex, or each thread reserves the counters of its packet and encrypts it
+// in parallel with the others.
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024 };
+static const size_t THREAD_COUNTS[] = { 1, 2, 4, 8 };
+
+static double
+runLocked(TqCipherStream* aStream, size_t aThreads, size_t aPacketSize, size_t aPackets)
+{
+    std::mutex lock;
+
+    auto worker = [&](uint32_t aSeed)
+    {
+        std::vector<uint8_t> buf(aPacketSize);
+        fillRandom(buf.data(), buf.size(), aSeed);
+
+        for (size_t i = 0; i < aPackets; ++i)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            aStream->process(buf.data(), buf.size());
+        }
+    };
+
+    Stopwatch sw;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < aThreads; ++i)
+        threads.push_back(std::thread(worker, (uint32_t)i + 1));
+    for (size_t i = 0; i < aThreads; ++i)
+        threads[i].join();
+    return sw.elapsed();
+}
+
+static double
+runReserved(TqCipherStream* aStream, size_t aThreads, size_t aPacketSize, size_t aPackets)
+{
+    auto worker = [&](uint32_t aSeed)
+    {
+        std::vector<uint8_t> buf(aPacketSize);
+        fillRandom(buf.data(), buf.size(), aSeed);
+
+        for (size_t i = 0; i < aPackets; ++i)
+        {
+            uint32_t position = aStream->reserve(buf.size());
+            aStream->processAt(position, buf.data(), buf.size());
+        }
+    };
+
+    Stopwatch sw;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < aThreads; ++i)
+        threads.push_back(std::thread(worker, (uint32_t)i + 1));
+    for (size_t i = 0; i < aThreads; ++i)
+        threads[i].join();
+    return sw.elapsed();
+}
+
+int
+benchReserve(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+
+    printf("impl,packet_size,threads,mode,packets_per_thread,seconds,ns_per_packet,mb_per_s\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipher_Base* cipher = createCipher(impls[i]);
+        TqCipherStream* encryptor = cipher->createEncryptor();
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            for (size_t k = 0; k < sizeof(THREAD_COUNTS) / sizeof(THREAD_COUNTS[0]); ++k)
+            {
+                size_t size = PACKET_SIZES[j];
+                size_t threads = THREAD_COUNTS[k];
+                size_t packets = totalBytes / size / threads;
+
+                for (int mode = 0; mode < 2; ++mode)
+                {
+                    double elapsed = mode == 0
+                        ? runLocked(encryptor, threads, size, packets)
+                        : runReserved(encryptor, threads, size, packets);
+
+                    printf("%s,%u,%u,%s,%u,%.4f,%.1f,%.1f\n",
+                           impls[i].c_str(), (unsigned)size, (unsigned)threads,
+                           mode == 0 ? "mutex" : "reserve",
+                           (unsigned)packets, elapsed,
+                           elapsed * 1e9 / (double)(packets * threads),
+                           (double)(threads * packets * size) / elapsed / (1024.0 * 1024.0));
+                }
+            }
+        }
+
+        delete encryptor;
+        delete cipher;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// A session (with its alternate key) lost its decryption counter: the first
+// octets of a packet (a length in [4, 1024], a type in [1000, 2999]) are
+// searched with both keys, by 1 thread up to one per processor. The
+// candidates are counted with the filter of the header only, then with a
+// predicate checking the rest of the window.
+
+static const size_t WINDOW_SIZE = 16;
+static const uint16_t PACKET_LENGTH = 52;
+static const uint16_t PACKET_TYPE = 1052;
+
+static bool
+checkBody(const uint8_t* aPlain, size_t aLen, void* aContext)
+{
+    // the body of the packet is known (e.g. a zero-filled field)
+    const uint8_t* expected = (const uint8_t*)aContext;
+    return memcmp(aPlain + TqResync::HEADER_SIZE, expected + TqResync::HEADER_SIZE,
+                  aLen - TqResync::HEADER_SIZE) == 0;
+}
+
+/**
+ * Encrypt octets as the client does: the octet whose decryption at the
+ * position is the plaintext (the cipher of the server only decrypts).
+ */
+static void
+encryptAt(const TqCipherStream& aDecryptor, uint32_t aPosition, const uint8_t* aPlain, uint8_t* aOut, size_t aLen)
+{
+    for (size_t i = 0; i < aLen; ++i)
+    {
+        for (int value = 0; value < 256; ++value)
+        {
+            uint8_t octet = (uint8_t)value;
+            aDecryptor.processAt(aPosition + (uint32_t)i, &octet, 1);
+            if (octet == aPlain[i])
+            {
+                aOut[i] = (uint8_t)value;
+                break;
+            }
+        }
+    }
+}
+
+int
+benchResync(int argc, char* argv[])
+{
+    size_t searches = argc > 0 ? (size_t)atol(argv[0]) : 20;
+    if (searches == 0)
+        searches = 1;
+
+    printf("impl,threads,predicate,searches,candidates,ms_per_search\n");
+
+    uint8_t plain[WINDOW_SIZE] = { 0 };
+    memcpy(plain, &PACKET_LENGTH, sizeof(PACKET_LENGTH));
+    memcpy(plain + 2, &PACKET_TYPE, sizeof(PACKET_TYPE));
+
+    std::vector<size_t> threadCounts;
+    size_t processors = std::thread::hardware_concurrency();
+    for (size_t n = 1; n < processors; n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(processors > 0 ? processors : 1);
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipher_Base* cipher = createCipher(impls[i]);
+        cipher->generateAltKey(0x4C7D0F33, 0x2A4D5C67);
+
+        // the window is the packet encrypted by the client at an unknown counter
+        TqCipherStream* decryptor = cipher->createDecryptor();
+        uint8_t window[WINDOW_SIZE];
+        encryptAt(*decryptor, decryptor->getPosition() + 4321, plain, window, sizeof(window));
+
+        TqResyncFilter filter = { 4, 1024, 1000, 2999 };
+        std::vector<TqResyncCandidate> candidates(2 * TqResync::COUNTERS);
+
+        for (size_t t = 0; t < threadCounts.size(); ++t)
+        {
+            for (int predicate = 0; predicate < 2; ++predicate)
+            {
+                size_t found = 0;
+                Stopwatch sw;
+                for (size_t n = 0; n < searches; ++n)
+                {
+                    found = decryptor->findCounters(window, sizeof(window), filter,
+                                                    predicate ? &checkBody : nullptr, plain,
+                                                    candidates.data(), candidates.size(), threadCounts[t]);
+                }
+                double elapsed = sw.elapsed();
+
+                printf("%s,%u,%s,%u,%u,%.3f\n",
+                       impls[i].c_str(), (unsigned)threadCounts[t], predicate ? "yes" : "no",
+                       (unsigned)searches, (unsigned)found, elapsed * 1e3 / (double)searches);
+            }
+        }
+
+        delete decryptor;
+        delete cipher;
+    }
+
+    return EXIT_SUCCESS;
+}
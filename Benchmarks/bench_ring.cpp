@@ -0,0 +1,84 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Packets received in a circular buffer, each one wrapping past its end at
+// an odd offset. A packet is either linearized in a scratch buffer, split in
+// two calls (one per part), or decrypted as one region of the ring.
+
+static const size_t PACKET_SIZES[] = { 64, 256, 1024, 4096 };
+static const size_t RING_SIZE = 64 * 1024;
+
+enum Mode { MODE_COPY, MODE_SPLIT, MODE_RING };
+static const char* MODE_NAMES[] = { "copy", "split", "ring" };
+
+int
+benchRing(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+
+    printf("impl,packet_size,mode,packets,seconds,ns_per_packet,mb_per_s\n");
+
+    std::vector<uint8_t> ring(RING_SIZE);
+    std::vector<uint8_t> scratch(RING_SIZE);
+    fillRandom(ring.data(), ring.size(), 1);
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipher_Base* cipher = createCipher(impls[i]);
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            size_t size = PACKET_SIZES[j];
+            size_t packets = totalBytes / size;
+
+            // the end of the buffer splits the packet at an odd offset
+            TqRingBuffer region = { ring.data(), ring.size(), ring.size() - size / 2 - 3, size };
+            size_t first = region.capacity - region.head;
+
+            for (int mode = MODE_COPY; mode <= MODE_RING; ++mode)
+            {
+                Stopwatch sw;
+                for (size_t n = 0; n < packets; ++n)
+                {
+                    switch (mode)
+                    {
+                        case MODE_COPY:
+                            memcpy(scratch.data(), ring.data() + region.head, first);
+                            memcpy(scratch.data() + first, ring.data(), size - first);
+                            cipher->decrypt(scratch.data(), size);
+                            break;
+                        case MODE_SPLIT:
+                            cipher->decrypt(ring.data() + region.head, first);
+                            cipher->decrypt(ring.data(), size - first);
+                            break;
+                        case MODE_RING:
+                            cipher->decrypt(region);
+                            break;
+                    }
+                }
+                double elapsed = sw.elapsed();
+
+                printf("%s,%u,%s,%u,%.4f,%.1f,%.1f\n",
+                       impls[i].c_str(), (unsigned)size, MODE_NAMES[mode],
+                       (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets,
+                       (double)(packets * size) / elapsed / (1024.0 * 1024.0));
+            }
+        }
+
+        delete cipher;
+    }
+
+    return EXIT_SUCCESS;
+}
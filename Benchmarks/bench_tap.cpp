@@ -0,0 +1,132 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "tqcipher_stream.h"
+#include "tqtap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+
+// Sessions encrypting and decrypting their packets on several threads, with
+// a tap mirroring the plaintext (drained by a reader thread):
+//  - stream:   the kernels called by the streams of the sessions, which
+//              have no hook (the baseline);
+//  - off:      no tap attached;
+//  - paused:   a tap attached with a sampling rate of 0;
+//  - filtered: a tap attached, keeping another session;
+//  - sampled:  a tap attached, keeping one packet in 100;
+//  - all:      a tap attached, keeping every packet (the full ring drops).
+
+static const size_t PACKET_SIZES[] = { 64, 256, 1024 };
+static const size_t TAP_CAPACITY = 4096;
+static const size_t SNAP_LENGTH = 128;
+
+enum Mode { MODE_STREAM, MODE_OFF, MODE_PAUSED, MODE_FILTERED, MODE_SAMPLED, MODE_ALL };
+static const char* MODE_NAMES[] = { "stream", "off", "paused", "filtered", "sampled", "all" };
+
+static double
+run(const std::string& aImpl, int aMode, TqTap* aTap, size_t aThreads, size_t aPacketSize, size_t aPackets)
+{
+    auto worker = [&](uint32_t aSession)
+    {
+        TqCipher_Base* cipher = createCipher(aImpl);
+        TqCipherStream* encryptor = cipher->createEncryptor();
+        TqCipherStream* decryptor = cipher->createDecryptor();
+        cipher->setTap(aTap, aSession);
+
+        std::vector<uint8_t> buf(aPacketSize);
+        fillRandom(buf.data(), buf.size(), aSession + 1);
+
+        for (size_t i = 0; i < aPackets; ++i)
+        {
+            if (aMode == MODE_STREAM)
+            {
+                encryptor->process(buf.data(), buf.size());
+                decryptor->process(buf.data(), buf.size());
+            }
+            else
+            {
+                cipher->encrypt(buf.data(), buf.size());
+                cipher->decrypt(buf.data(), buf.size());
+            }
+        }
+
+        cipher->setTap(nullptr, 0);
+        delete decryptor;
+        delete encryptor;
+        delete cipher;
+    };
+
+    // the reader drains the ring while the sessions run
+    volatile bool running = true;
+    std::thread reader([&]()
+    {
+        TqTapRecord record;
+        std::vector<uint8_t> data(SNAP_LENGTH);
+        while (running)
+        {
+            if (aTap == nullptr || !aTap->read(record, data.data()))
+                std::this_thread::yield();
+        }
+    });
+
+    Stopwatch sw;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < aThreads; ++i)
+        threads.push_back(std::thread(worker, (uint32_t)i));
+    for (size_t i = 0; i < aThreads; ++i)
+        threads[i].join();
+    double elapsed = sw.elapsed();
+
+    running = false;
+    reader.join();
+    return elapsed;
+}
+
+int
+benchTap(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+    size_t threadCount = argc > 1 ? (size_t)atol(argv[1]) : 4;
+
+    printf("impl,packet_size,threads,mode,packets,seconds,ns_per_packet,recorded,dropped\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            size_t size = PACKET_SIZES[j];
+            size_t packets = totalBytes / size / threadCount / 2;
+
+            for (int mode = MODE_STREAM; mode <= MODE_ALL; ++mode)
+            {
+                TqTap* tap = mode <= MODE_OFF ? nullptr : new TqTap(TAP_CAPACITY, SNAP_LENGTH);
+                if (tap != nullptr)
+                {
+                    tap->setSampling(mode == MODE_PAUSED ? 0 : mode == MODE_SAMPLED ? 100 : 1);
+                    tap->setSession(mode == MODE_FILTERED ? (uint32_t)threadCount : TqTap::ANY_SESSION);
+                }
+
+                double elapsed = run(impls[i], mode, tap, threadCount, size, packets);
+
+                // both directions of each packet go through the hook
+                size_t total = 2 * packets * threadCount;
+                printf("%s,%u,%u,%s,%u,%.4f,%.1f,%u,%u\n",
+                       impls[i].c_str(), (unsigned)size, (unsigned)threadCount, MODE_NAMES[mode],
+                       (unsigned)total, elapsed, elapsed * 1e9 / (double)total * (double)threadCount,
+                       tap != nullptr ? tap->getRecorded() : 0, tap != nullptr ? tap->getDropped() : 0);
+
+                delete tap;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// A proxy forwarding the packets of a client to a server: either the packet
+// is decrypted with the client session then encrypted with the server one
+// (two passes), or both are fused in a single pass.
+
+static const size_t PACKET_SIZES[] = { 16, 64, 256, 1024, 4096 };
+
+int
+benchTranscrypt(int argc, char* argv[])
+{
+    size_t totalBytes = argc > 0 ? (size_t)atol(argv[0]) : 256 * 1024 * 1024;
+
+    printf("impl,packet_size,mode,packets,seconds,ns_per_packet,mb_per_s\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        TqCipher_Base* client = createCipher(impls[i]);
+        TqCipher_Base* server = createCipher(impls[i]);
+        client->generateAltKey(0x4C7D0F33, 0x2A4D5C67);
+
+        for (size_t j = 0; j < sizeof(PACKET_SIZES) / sizeof(PACKET_SIZES[0]); ++j)
+        {
+            size_t size = PACKET_SIZES[j];
+            size_t packets = totalBytes / size;
+
+            std::vector<uint8_t> buf(size);
+            fillRandom(buf.data(), buf.size(), 1);
+
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                Stopwatch sw;
+                for (size_t n = 0; n < packets; ++n)
+                {
+                    if (mode == 0)
+                    {
+                        client->decrypt(buf.data(), buf.size());
+                        server->encrypt(buf.data(), buf.size());
+                    }
+                    else
+                        client->transcrypt(*server, buf.data(), buf.data(), buf.size());
+                }
+                double elapsed = sw.elapsed();
+
+                printf("%s,%u,%s,%u,%.4f,%.1f,%.1f\n",
+                       impls[i].c_str(), (unsigned)size, mode == 0 ? "two-pass" : "fused",
+                       (unsigned)packets, elapsed,
+                       elapsed * 1e9 / (double)packets,
+                       (double)(packets * size) / elapsed / (1024.0 * 1024.0));
+            }
+        }
+
+        delete server;
+        delete client;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "workload.h"
+#include "tqkeycontext.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h> // __rdtsc
+#else
+#include <x86intrin.h> // __rdtsc
+#endif
+
+// Replay of a game server trace (synthesized, or loaded from a file) on
+// thousands of sessions, for each kernel and layout of the sessions:
+//  - session:  one cipher per session, with the shared base key;
+//  - split:    an encryptor and a decryptor stream per session;
+//  - private:  one cipher per session, each with its own base key, as
+//              before the key contexts (cache pressure of the keys).
+// The counters of the sessions start at random values, so they wrap.
+
+enum Layout
+{
+    LAYOUT_SESSION,
+    LAYOUT_SPLIT,
+    LAYOUT_PRIVATE,
+    LAYOUT_COUNT
+};
+
+static const char* LAYOUT_NAMES[LAYOUT_COUNT] = { "session", "split", "private" };
+
+/**
+ * Sessions of the replay, in one of the layouts.
+ */
+class Sessions
+{
+public:
+    /* constructor */
+    Sessions(const std::string& aImpl, Layout aLayout, uint32_t aCount)
+        : mLayout(aLayout), mCiphers(aCount), mEncryptors(aCount), mDecryptors(aCount)
+    {
+        uint32_t x = 0x2545F491;
+        for (uint32_t i = 0; i < aCount; ++i)
+        {
+            mCiphers[i] = createCipher(aImpl);
+            if (mLayout == LAYOUT_PRIVATE)
+                mCiphers[i]->generateKey(BENCH_P + i + 1, BENCH_G);
+
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+
+            TqCipherState state;
+            mCiphers[i]->saveState(state);
+            state.enCounter = (uint16_t)x;
+            state.deCounter = (uint16_t)(x >> 16);
+            mCiphers[i]->restoreState(state);
+
+            if (mLayout == LAYOUT_SPLIT)
+            {
+                mEncryptors[i] = mCiphers[i]->createEncryptor();
+                mDecryptors[i] = mCiphers[i]->createDecryptor();
+            }
+        }
+    }
+
+    /* destructor */
+    ~Sessions()
+    {
+        for (size_t i = 0; i < mCiphers.size(); ++i)
+        {
+            delete mEncryptors[i];
+            delete mDecryptors[i];
+            delete mCiphers[i];
+        }
+    }
+
+    /** Replay an event of the trace. */
+    void replay(const TraceEvent& aEvent, uint8_t* aBuf)
+    {
+        uint32_t s = aEvent.session;
+        switch (aEvent.op)
+        {
+            case TraceEvent::OP_ENCRYPT:
+                if (mLayout == LAYOUT_SPLIT)
+                    mEncryptors[s]->process(aBuf, aEvent.size);
+                else
+                    mCiphers[s]->encrypt(aBuf, aEvent.size);
+                break;
+            case TraceEvent::OP_DECRYPT:
+                if (mLayout == LAYOUT_SPLIT)
+                    mDecryptors[s]->process(aBuf, aEvent.size);
+                else
+                    mCiphers[s]->decrypt(aBuf, aEvent.size);
+                break;
+            case TraceEvent::OP_LOGIN:
+                mCiphers[s]->generateAltKey((int32_t)(s * 0x9E3779B9), (int32_t)s);
+                if (mLayout == LAYOUT_SPLIT)
+                {
+                    delete mEncryptors[s];
+                    delete mDecryptors[s];
+                    mEncryptors[s] = mCiphers[s]->createEncryptor();
+                    mDecryptors[s] = mCiphers[s]->createDecryptor();
+                }
+                break;
+        }
+    }
+
+private:
+    Layout mLayout; //!< Layout of the sessions
+    std::vector<TqCipher_Base*> mCiphers; //!< Cipher of each session
+    std::vector<TqCipherStream*> mEncryptors; //!< Encryptor of each session (split layout)
+    std::vector<TqCipherStream*> mDecryptors; //!< Decryptor of each session (split layout)
+};
+
+int
+benchWorkload(int argc, char* argv[])
+{
+    uint32_t sessions = argc > 0 ? (uint32_t)atol(argv[0]) : 4096;
+    size_t events = argc > 1 ? (size_t)atol(argv[1]) : 2000000;
+
+    std::vector<TraceEvent> trace;
+    if (argc > 2 && loadTrace(trace, argv[2]))
+        sessions = getSessionCount(trace);
+    else
+    {
+        generateTrace(trace, sessions, events, 1);
+        if (argc > 2 && !saveTrace(trace, argv[2]))
+            fprintf(stderr, "Can't write the trace to %s\n", argv[2]);
+    }
+
+    std::vector<uint8_t> buf(0x10000);
+    fillRandom(buf.data(), buf.size(), 1);
+    std::vector<uint32_t> latencies(trace.size());
+
+    printf("impl,layout,sessions,packets,bytes,seconds,packets_per_s,mb_per_s,p50_ns,p99_ns\n");
+
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        for (int layout = 0; layout < LAYOUT_COUNT; ++layout)
+        {
+            Sessions table(impls[i], (Layout)layout, sessions);
+
+            size_t packets = 0;
+            uint64_t bytes = 0;
+
+            Stopwatch sw;
+            uint64_t start = __rdtsc();
+            for (size_t n = 0; n < trace.size(); ++n)
+            {
+                uint64_t begin = __rdtsc();
+                table.replay(trace[n], buf.data());
+                latencies[n] = (uint32_t)(__rdtsc() - begin);
+
+                if (trace[n].op != TraceEvent::OP_LOGIN)
+                {
+                    ++packets;
+                    bytes += trace[n].size;
+                }
+            }
+            uint64_t ticks = __rdtsc() - start;
+            double elapsed = sw.elapsed();
+            double ticksPerNs = (double)ticks / (elapsed * 1e9);
+
+            std::sort(latencies.begin(), latencies.end());
+            double p50 = latencies[latencies.size() / 2] / ticksPerNs;
+            double p99 = latencies[latencies.size() * 99 / 100] / ticksPerNs;
+
+            printf("%s,%s,%u,%u,%llu,%.4f,%.0f,%.1f,%.1f,%.1f\n",
+                   impls[i].c_str(), LAYOUT_NAMES[layout], (unsigned)sessions,
+                   (unsigned)packets, (unsigned long long)bytes, elapsed,
+                   (double)packets / elapsed,
+                   (double)bytes / elapsed / (1024.0 * 1024.0),
+                   p50, p99);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
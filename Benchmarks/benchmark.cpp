@@ -0,0 +1,118 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "benchmark.h"
+#include "instructionset.h"
+#include "tqcipher_std.h"
+#include "tqcipher_sse2.h"
+#include "tqcipher_avx2.h"
+#include "tqcipher_gfni.h"
+#include "tqcipher_avx512.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+std::vector<std::string>
+getSupportedImpls()
+{
+    std::vector<std::string> impls;
+    impls.push_back("std");
+    if (InstructionSet::SSE2())
+        impls.push_back("sse2");
+    if (InstructionSet::AVX2())
+        impls.push_back("avx2");
+#if TQ_CIPHER_GFNI
+    if (InstructionSet::AVX2() && InstructionSet::GFNI())
+        impls.push_back("gfni");
+    if (InstructionSet::AVX512F() && InstructionSet::AVX512BW() && InstructionSet::GFNI())
+        impls.push_back("avx512");
+#endif
+    return impls;
+}
+
+TqCipher_Base*
+createCipher(const std::string& aImpl)
+{
+    TqCipher_Base* cipher = nullptr;
+
+    if (aImpl == "std")
+        cipher = new TqCipher_Std();
+    else if (aImpl == "sse2" && InstructionSet::SSE2())
+        cipher = new TqCipher_SSE2();
+    else if (aImpl == "avx2" && InstructionSet::AVX2())
+        cipher = new TqCipher_AVX2();
+#if TQ_CIPHER_GFNI
+    else if (aImpl == "gfni" && InstructionSet::AVX2() && InstructionSet::GFNI())
+        cipher = new TqCipher_GFNI();
+    else if (aImpl == "avx512" && InstructionSet::AVX512F() && InstructionSet::AVX512BW() && InstructionSet::GFNI())
+        cipher = new TqCipher_AVX512();
+#endif
+
+    if (cipher != nullptr)
+        cipher->generateKey(BENCH_P, BENCH_G);
+
+    return cipher;
+}
+
+TqCipherStream::Kernel
+getKernel(const std::string& aImpl)
+{
+    if (aImpl == "std")
+        return &TqCipher_Std::transform;
+    else if (aImpl == "sse2")
+        return &TqCipher_SSE2::transform;
+    else if (aImpl == "avx2")
+        return &TqCipher_AVX2::transform;
+#if TQ_CIPHER_GFNI
+    else if (aImpl == "gfni")
+        return &TqCipher_GFNI::transform;
+    else if (aImpl == "avx512")
+        return &TqCipher_AVX512::transform;
+#endif
+    return nullptr;
+}
+
+void
+fillRandom(uint8_t* aBuf, size_t aLen, uint32_t aSeed)
+{
+    // xorshift32, good enough for payloads
+    uint32_t x = aSeed != 0 ? aSeed : 0x9E3779B9;
+    for (size_t i = 0; i < aLen; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        aBuf[i] = (uint8_t)x;
+    }
+}
+
+double
+getProcessCpuTime()
+{
+    #ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+
+    // in units of 100 nanoseconds
+    return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+    #else
+    struct timespec time;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+        return 0.0;
+
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+    #endif
+}
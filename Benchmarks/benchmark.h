@@ -0,0 +1,119 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include "tqcipher_base.h"
+#include "tqcipher_stream.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+/**
+ * High-resolution stopwatch, based on the performance counter on Windows
+ * (the steady clock of VS2013 only has the resolution of the system clock)
+ * and on the steady clock elsewhere.
+ */
+class Stopwatch
+{
+public:
+    /* constructor */
+    Stopwatch()
+    {
+        #ifdef _WIN32
+        QueryPerformanceFrequency(&mFrequency);
+        #endif
+        start();
+    }
+
+    /** Restart the stopwatch. */
+    void start()
+    {
+        #ifdef _WIN32
+        QueryPerformanceCounter(&mStart);
+        #else
+        mStart = std::chrono::steady_clock::now();
+        #endif
+    }
+
+    /** Get the elapsed time in seconds. */
+    double elapsed() const
+    {
+        #ifdef _WIN32
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return (double)(now.QuadPart - mStart.QuadPart) / (double)mFrequency.QuadPart;
+        #else
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+        #endif
+    }
+
+private:
+#ifdef _WIN32
+    LARGE_INTEGER mFrequency; //!< Frequency of the counter
+    LARGE_INTEGER mStart; //!< Value of the counter when started
+#else
+    std::chrono::steady_clock::time_point mStart; //!< Time when started
+#endif
+};
+
+/**
+ * Get the names of the implementations supported by the processor
+ * ("std", "sse2", "avx2", ...).
+ */
+std::vector<std::string> getSupportedImpls();
+
+/**
+ * Create a cipher of the named implementation, with the base key of the
+ * original P & G constants.
+ *
+ * @param[in] aImpl  the name of the implementation
+ *
+ * @returns the cipher, or nullptr if the implementation is unknown or not
+ *          supported by the processor
+ */
+TqCipher_Base* createCipher(const std::string& aImpl);
+
+/**
+ * Get the kernel of the named implementation.
+ *
+ * @param[in] aImpl  the name of the implementation
+ *
+ * @returns the kernel, or nullptr if the implementation is unknown
+ */
+TqCipherStream::Kernel getKernel(const std::string& aImpl);
+
+/**
+ * Fill a buffer with pseudo-random octets.
+ *
+ * @param[out] aBuf   the buffer to fill
+ * @param[in]  aLen   the number of octets
+ * @param[in]  aSeed  the seed of the generator
+ */
+void fillRandom(uint8_t* aBuf, size_t aLen, uint32_t aSeed);
+
+/**
+ * Get the CPU time (user and kernel) consumed by the process.
+ *
+ * @returns the CPU time in seconds
+ */
+double getProcessCpuTime();
+
+/** The P constant of the original key. */
+static const uint32_t BENCH_P = 0x13FA0F9D;
+/** The G constant of the original key. */
+static const uint32_t BENCH_G = 0x6D5C7962;
+
+#endif // _BENCHMARK_H_
@@ -0,0 +1,322 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "gateway.h"
+#include "benchmark.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <set>
+
+typedef GatewayProtocol Proto;
+
+struct Gateway::Worker
+{
+    Poller poller; //!< Poller of the connections
+    std::mutex lock; //!< Lock of the accepted sockets
+    std::vector<Socket> accepted; //!< Sockets accepted but not yet served
+    std::thread thread; //!< Thread of the worker
+    std::set<Connection*> connections; //!< Connections served by the worker
+    uint32_t random; //!< Generator of the tokens
+};
+
+struct Gateway::Connection
+{
+    Socket socket; //!< Socket of the connection
+    TqCipher_Base* cipher; //!< Cipher of the connection
+    std::vector<uint8_t> in; //!< Decrypted octets not yet handled
+    std::vector<uint8_t> out; //!< Encrypted octets not yet sent
+    bool logged; //!< Whether the handshake is completed
+    bool writing; //!< Whether the socket is polled for writing
+};
+
+Gateway :: Gateway()
+    : mListener(INVALID_SOCKET), mPort(0), mRunning(false),
+      mConnections(0), mPackets(0), mBytes(0)
+{
+
+}
+
+Gateway :: ~Gateway()
+{
+    stop();
+}
+
+bool
+Gateway :: start(const std::string& aImpl, uint16_t aPort, size_t aThreads)
+{
+    mImpl = aImpl;
+    mListener = netListen(aPort, &mPort);
+    if (mListener == INVALID_SOCKET)
+        return false;
+
+    mRunning = true;
+    for (size_t i = 0; i < aThreads; ++i)
+    {
+        Worker* worker = new Worker();
+        worker->random = 0x9E3779B9 + (uint32_t)i;
+        worker->thread = std::thread(&Gateway::workerLoop, this, worker);
+        mWorkers.push_back(worker);
+    }
+    mAcceptor = std::thread(&Gateway::acceptLoop, this);
+    return true;
+}
+
+void
+Gateway :: stop()
+{
+    if (!mRunning)
+        return;
+
+    mRunning = false;
+    mAcceptor.join();
+    for (size_t i = 0; i < mWorkers.size(); ++i)
+    {
+        mWorkers[i]->thread.join();
+        delete mWorkers[i];
+    }
+    mWorkers.clear();
+
+    netClose(mListener);
+    mListener = INVALID_SOCKET;
+}
+
+void
+Gateway :: acceptLoop()
+{
+    Poller poller;
+    poller.add(mListener, nullptr, Poller::READABLE);
+
+    size_t next = 0;
+    Poller::Event events[1];
+    while (mRunning)
+    {
+        if (poller.wait(events, 1, 10) == 0)
+            continue;
+
+        Socket socket;
+        while ((socket = netAccept(mListener)) != INVALID_SOCKET)
+        {
+            Worker* worker = mWorkers[next++ % mWorkers.size()];
+            std::lock_guard<std::mutex> guard(worker->lock);
+            worker->accepted.push_back(socket);
+        }
+    }
+
+    poller.remove(mListener);
+}
+
+void
+Gateway :: workerLoop(Worker* aWorker)
+{
+    Poller::Event events[256];
+
+    while (mRunning)
+    {
+        std::vector<Socket> accepted;
+        {
+            std::lock_guard<std::mutex> guard(aWorker->lock);
+            accepted.swap(aWorker->accepted);
+        }
+
+        for (size_t i = 0; i < accepted.size(); ++i)
+        {
+            Connection* connection = new Connection();
+            connection->socket = accepted[i];
+            connection->cipher = createCipher(mImpl);
+            connection->logged = false;
+            connection->writing = false;
+            aWorker->connections.insert(connection);
+            aWorker->poller.add(connection->socket, connection, Poller::READABLE);
+        }
+
+        int count = aWorker->poller.wait(events, 256, 10);
+        for (int i = 0; i < count; ++i)
+        {
+            Connection* connection = (Connection*)events[i].data;
+            bool alive = (events[i].events & Poller::FAILED) == 0;
+
+            if (alive && (events[i].events & Poller::READABLE) != 0)
+                alive = onReadable(aWorker, connection);
+            if (alive && (events[i].events & Poller::WRITABLE) != 0)
+                alive = flush(aWorker, connection);
+
+            if (!alive)
+                close(aWorker, connection);
+        }
+    }
+
+    while (!aWorker->connections.empty())
+        close(aWorker, *aWorker->connections.begin());
+
+    std::vector<Socket> accepted;
+    {
+        std::lock_guard<std::mutex> guard(aWorker->lock);
+        accepted.swap(aWorker->accepted);
+    }
+    for (size_t i = 0; i < accepted.size(); ++i)
+        netClose(accepted[i]);
+}
+
+bool
+Gateway :: onReadable(Worker* aWorker, Connection* aConnection)
+{
+    uint8_t buf[16384];
+    int received = netRecv(aConnection->socket, buf, sizeof(buf));
+    if (received < 0)
+        return false;
+    if (received == 0)
+        return true;
+
+    // the cipher is a stream cipher: the octets are decrypted as they come
+    mBytes += (uint64_t)received;
+    aConnection->cipher->decrypt(buf, (size_t)received);
+    aConnection->in.insert(aConnection->in.end(), buf, buf + received);
+
+    size_t offset = 0;
+    while (aConnection->in.size() - offset >= Proto::HEADER_SIZE)
+    {
+        uint8_t* msg = &aConnection->in[offset];
+        size_t len = Proto::read16(msg);
+        uint16_t type = Proto::read16(msg + 2);
+
+        if (len < Proto::HEADER_SIZE || len > Proto::MAX_SIZE)
+            return false;
+        if (aConnection->in.size() - offset < len)
+            break;
+
+        if (!aConnection->logged)
+        {
+            if (type != Proto::MSG_ACCOUNT || len != Proto::ACCOUNT_SIZE)
+                return false;
+
+            uint32_t& x = aWorker->random;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+
+            uint32_t uid = (uint32_t)(uintptr_t)aConnection;
+            uint32_t token = x;
+
+            uint8_t reply[Proto::CONNECT_SIZE];
+            Proto::write16(reply, (uint16_t)Proto::CONNECT_SIZE);
+            Proto::write16(reply + 2, Proto::MSG_CONNECT);
+            Proto::write32(reply + 4, uid);
+            Proto::write32(reply + 8, token);
+
+            aConnection->cipher->encrypt(reply, sizeof(reply));
+            aConnection->out.insert(aConnection->out.end(), reply, reply + sizeof(reply));
+
+            // the following messages use the alternate key
+            aConnection->cipher->generateAltKey((int32_t)token, (int32_t)uid);
+            aConnection->logged = true;
+            ++mConnections;
+        }
+        else
+        {
+            if (type != Proto::MSG_ECHO)
+                return false;
+
+            size_t pos = aConnection->out.size();
+            aConnection->out.insert(aConnection->out.end(), msg, msg + len);
+            aConnection->cipher->encrypt(&aConnection->out[pos], len);
+            ++mPackets;
+        }
+
+        offset += len;
+    }
+    aConnection->in.erase(aConnection->in.begin(), aConnection->in.begin() + offset);
+
+    return flush(aWorker, aConnection);
+}
+
+bool
+Gateway :: flush(Worker* aWorker, Connection* aConnection)
+{
+    if (!aConnection->out.empty())
+    {
+        int sent = netSend(aConnection->socket, aConnection->out.data(), aConnection->out.size());
+        if (sent < 0)
+            return false;
+
+        mBytes += (uint64_t)sent;
+        aConnection->out.erase(aConnection->out.begin(), aConnection->out.begin() + sent);
+    }
+
+    // only poll for writing while there are pending octets
+    bool writing = !aConnection->out.empty();
+    if (writing != aConnection->writing)
+    {
+        aConnection->writing = writing;
+        aWorker->poller.modify(aConnection->socket, aConnection,
+                               Poller::READABLE | (writing ? Poller::WRITABLE : 0));
+    }
+    return true;
+}
+
+void
+Gateway :: close(Worker* aWorker, Connection* aConnection)
+{
+    aWorker->connections.erase(aConnection);
+    aWorker->poller.remove(aConnection->socket);
+    netClose(aConnection->socket);
+    delete aConnection->cipher;
+    delete aConnection;
+}
+
+int
+benchGateway(int argc, char* argv[])
+{
+    uint16_t port = argc > 0 ? (uint16_t)atoi(argv[0]) : 9958;
+    size_t threads = argc > 1 ? (size_t)atoi(argv[1]) : 4;
+    std::string impl = argc > 2 ? argv[2] : getSupportedImpls().back();
+    int seconds = argc > 3 ? atoi(argv[3]) : 60;
+
+    if (!netStartup())
+        return EXIT_FAILURE;
+
+    TqCipher_Base* probe = createCipher(impl);
+    delete probe;
+
+    Gateway gateway;
+    if (probe == nullptr || !gateway.start(impl, port, threads))
+    {
+        fprintf(stderr, "Can't start the gateway (%s) on port %u\n", impl.c_str(), (unsigned)port);
+        netCleanup();
+        return EXIT_FAILURE;
+    }
+
+    printf("seconds,connections,packets,mb_per_s,cpu_ns_per_byte\n");
+
+    Stopwatch sw;
+    double cpu = getProcessCpuTime();
+    uint64_t bytes = 0;
+    for (int i = 0; i < seconds; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        double elapsed = sw.elapsed();
+        double used = getProcessCpuTime() - cpu;
+        uint64_t total = gateway.getBytes();
+        sw.start();
+        cpu += used;
+
+        printf("%d,%llu,%llu,%.1f,%.1f\n", i + 1,
+               (unsigned long long)gateway.getConnections(),
+               (unsigned long long)gateway.getPackets(),
+               (double)(total - bytes) / elapsed / (1024.0 * 1024.0),
+               total != bytes ? used * 1e9 / (double)(total - bytes) : 0.0);
+        fflush(stdout);
+        bytes = total;
+    }
+
+    gateway.stop();
+    netCleanup();
+    return EXIT_SUCCESS;
+}
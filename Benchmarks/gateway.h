@@ -0,0 +1,135 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _GATEWAY_H_
+#define _GATEWAY_H_
+
+#include "netio.h"
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Messages of the reference protocol. Each message starts with its length
+ * and its type (16-bit little-endian integers), and is encrypted as a whole.
+ *
+ * The handshake follows the AccServer: the client sends its account with
+ * the base key, the gateway answers with the UID and a token, then both
+ * sides switch to the alternate key of (token, UID). The gateway echoes all
+ * the following messages.
+ */
+struct GatewayProtocol
+{
+    /** The size of the header of a message (length and type). */
+    static const size_t HEADER_SIZE = 4;
+    /** The maximum size of a message. */
+    static const size_t MAX_SIZE = 8192;
+
+    /** Account of the client (base key): account, password, server. */
+    static const uint16_t MSG_ACCOUNT = 1051;
+    /** Answer of the gateway (base key): UID and token. */
+    static const uint16_t MSG_CONNECT = 1055;
+    /** Message echoed by the gateway (alternate key). */
+    static const uint16_t MSG_ECHO = 2001;
+
+    /** The size of MSG_ACCOUNT. */
+    static const size_t ACCOUNT_SIZE = HEADER_SIZE + 3 * 16;
+    /** The size of MSG_CONNECT. */
+    static const size_t CONNECT_SIZE = HEADER_SIZE + 2 * sizeof(uint32_t);
+
+    /** Read a 16-bit integer. */
+    static uint16_t read16(const uint8_t* aBuf) { return (uint16_t)(aBuf[0] | aBuf[1] << 8); }
+    /** Read a 32-bit integer. */
+    static uint32_t read32(const uint8_t* aBuf) { return (uint32_t)read16(aBuf) | (uint32_t)read16(aBuf + 2) << 16; }
+    /** Write a 16-bit integer. */
+    static void write16(uint8_t* aBuf, uint16_t aValue) { aBuf[0] = (uint8_t)aValue; aBuf[1] = (uint8_t)(aValue >> 8); }
+    /** Write a 32-bit integer. */
+    static void write32(uint8_t* aBuf, uint32_t aValue) { write16(aBuf, (uint16_t)aValue); write16(aBuf + 2, (uint16_t)(aValue >> 16)); }
+};
+
+/**
+ * Reference gateway: accepts the connections on the loopback interface,
+ * performs the handshake with a cipher per connection and echoes the
+ * messages. The connections are spread over worker threads, each with its
+ * own poller.
+ */
+class Gateway
+{
+public:
+    /* constructor */
+    Gateway();
+
+    /* destructor */
+    ~Gateway();
+
+    /**
+     * Start the gateway.
+     *
+     * @param[in] aImpl     the implementation of the cipher
+     * @param[in] aPort     the port, or zero for an ephemeral port
+     * @param[in] aThreads  the number of worker threads
+     *
+     * @returns false if the gateway can't listen
+     */
+    bool start(const std::string& aImpl, uint16_t aPort, size_t aThreads);
+
+    /** Stop the gateway and close all the connections. */
+    void stop();
+
+    /** Get the port the gateway listens on. */
+    uint16_t getPort() const { return mPort; }
+
+    /** Get the number of completed handshakes. */
+    uint64_t getConnections() const { return mConnections; }
+
+    /** Get the number of echoed messages. */
+    uint64_t getPackets() const { return mPackets; }
+
+    /** Get the number of octets received and sent. */
+    uint64_t getBytes() const { return mBytes; }
+
+private:
+    struct Worker;
+    struct Connection;
+
+    /** Accept the connections and hand them to the workers. */
+    void acceptLoop();
+
+    /** Serve the connections of a worker. */
+    void workerLoop(Worker* aWorker);
+
+    /** Handle the received octets of a connection. */
+    bool onReadable(Worker* aWorker, Connection* aConnection);
+
+    /** Send the pending octets of a connection. */
+    bool flush(Worker* aWorker, Connection* aConnection);
+
+    /** Close a connection. */
+    void close(Worker* aWorker, Connection* aConnection);
+
+private:
+    // not copyable
+    Gateway(const Gateway&);
+    Gateway& operator=(const Gateway&);
+
+private:
+    std::string mImpl; //!< Implementation of the cipher
+    Socket mListener; //!< Listening socket
+    uint16_t mPort; //!< Port of the listener
+    std::atomic<bool> mRunning; //!< Whether the threads must keep running
+    std::thread mAcceptor; //!< Acceptor thread
+    std::vector<Worker*> mWorkers; //!< Worker threads
+
+    std::atomic<uint64_t> mConnections; //!< Completed handshakes
+    std::atomic<uint64_t> mPackets; //!< Echoed messages
+    std::atomic<uint64_t> mBytes; //!< Octets received and sent
+};
+
+#endif // _GATEWAY_H_
@@ -0,0 +1,388 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "gateway.h"
+#include "benchmark.h"
+#include "tqkeycontext.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Load generator of the reference gateway: many client connections, each
+// performing the handshake then echoing a number of messages one at a time.
+// Each thread has its own poller and limits its pending connections, so the
+// backlog of the gateway isn't overflowed.
+
+typedef GatewayProtocol Proto;
+
+static const size_t MAX_PENDING_CONNECTS = 64;
+
+/**
+ * Parameters and results of a load.
+ */
+struct LoadStats
+{
+    std::atomic<uint64_t> connections; //!< Completed handshakes
+    std::atomic<uint64_t> packets; //!< Echoed messages
+    std::atomic<uint64_t> bytes; //!< Octets sent and received
+    std::atomic<uint64_t> errors; //!< Failed connections or corrupted echoes
+
+    LoadStats() : connections(0), packets(0), bytes(0), errors(0) { }
+};
+
+/**
+ * Client side of the cipher: the inverse of the server transforms, with the
+ * keys of the library. The server decrypts with the alternate key after the
+ * login, while it always encrypts with the base key.
+ */
+class ClientCipher
+{
+public:
+    /* constructor */
+    ClientCipher()
+        : mContext(TqKeyContext::acquire(BENCH_P, BENCH_G)),
+          mUsingAltKey(false), mEnCounter(0), mDeCounter(0)
+    {
+
+    }
+
+    /* destructor */
+    ~ClientCipher() { mContext->release(); }
+
+    /** Switch to the alternate key of the login; the server restarts its encryption. */
+    void login(uint32_t aToken, uint32_t aUID)
+    {
+        mContext->expandAltKey(mAltKey, ((aToken + aUID) ^ 0x4321) ^ aToken);
+        mUsingAltKey = true;
+        mDeCounter = 0;
+    }
+
+    /** Encrypt octets for the server: swap(p ^ k) ^ 0xAB. */
+    void encrypt(uint8_t* aBuf, size_t aLen)
+    {
+        mEnCounter = process(mUsingAltKey ? mAltKey : mContext->getKey(), mEnCounter, aBuf, aLen);
+    }
+
+    /** Decrypt octets of the server: swap(c ^ k) ^ 0xAB. */
+    void decrypt(uint8_t* aBuf, size_t aLen)
+    {
+        mDeCounter = process(mContext->getKey(), mDeCounter, aBuf, aLen);
+    }
+
+private:
+    static uint16_t process(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf, size_t aLen)
+    {
+        const uint8_t* key1 = aKey;
+        const uint8_t* key2 = key1 + TqKeyContext::HALF_SIZE;
+        for (size_t i = 0; i < aLen; ++i)
+        {
+            uint8_t b = (uint8_t)(aBuf[i] ^ key1[(uint8_t)aCounter] ^ key2[(uint8_t)(aCounter >> 8)]);
+            aBuf[i] = (uint8_t)((b << 4 | b >> 4) ^ 0xAB);
+            ++aCounter;
+        }
+        return aCounter;
+    }
+
+private:
+    const TqKeyContext* mContext; //!< Base key
+    uint8_t mAltKey[TqKeyContext::SIZE]; //!< Alternate key
+    bool mUsingAltKey; //!< Whether the alternate key is used for the encryption
+    uint16_t mEnCounter; //!< Encryption counter
+    uint16_t mDeCounter; //!< Decryption counter
+};
+
+/**
+ * Client connection of the load generator.
+ */
+struct Client
+{
+    enum State { CONNECTING, LOGGING, ECHOING };
+
+    Socket socket; //!< Socket of the connection
+    State state; //!< State of the connection
+    ClientCipher cipher; //!< Cipher of the client
+    std::vector<uint8_t> in; //!< Decrypted octets not yet handled
+    uint32_t sent; //!< Number of echoes requested
+};
+
+static void
+fillEcho(uint8_t* aMsg, size_t aLen, uint32_t aSeq)
+{
+    Proto::write16(aMsg, (uint16_t)aLen);
+    Proto::write16(aMsg + 2, Proto::MSG_ECHO);
+    for (size_t i = Proto::HEADER_SIZE; i < aLen; ++i)
+        aMsg[i] = (uint8_t)(aSeq * 31 + i);
+}
+
+static bool
+sendMessage(Client* aClient, uint8_t* aMsg, size_t aLen, LoadStats& aStats)
+{
+    aClient->cipher.encrypt(aMsg, aLen);
+
+    // the messages are small and the peer is local: the socket never stays full long
+    size_t offset = 0;
+    while (offset < aLen)
+    {
+        int sent = netSend(aClient->socket, aMsg + offset, aLen - offset);
+        if (sent < 0)
+            return false;
+        if (sent == 0)
+            std::this_thread::yield();
+        offset += (size_t)sent;
+    }
+
+    aStats.bytes += aLen;
+    return true;
+}
+
+static void
+closeClient(Poller& aPoller, Client* aClient)
+{
+    aPoller.remove(aClient->socket);
+    netClose(aClient->socket);
+    delete aClient;
+}
+
+/**
+ * Handle the received octets of a client.
+ *
+ * @returns false if the client is done or failed
+ */
+static bool
+onReadable(Client* aClient, size_t aPackets, size_t aPacketSize, LoadStats& aStats)
+{
+    uint8_t buf[16384];
+    int received = netRecv(aClient->socket, buf, sizeof(buf));
+    if (received < 0)
+    {
+        ++aStats.errors;
+        return false;
+    }
+
+    aStats.bytes += (uint64_t)received;
+    aClient->cipher.decrypt(buf, (size_t)received);
+    aClient->in.insert(aClient->in.end(), buf, buf + received);
+
+    size_t offset = 0;
+    while (aClient->in.size() - offset >= Proto::HEADER_SIZE)
+    {
+        const uint8_t* msg = &aClient->in[offset];
+        size_t len = Proto::read16(msg);
+        if (len < Proto::HEADER_SIZE || aClient->in.size() - offset < len)
+            break;
+
+        if (aClient->state == Client::LOGGING)
+        {
+            if (Proto::read16(msg + 2) != Proto::MSG_CONNECT || len != Proto::CONNECT_SIZE)
+            {
+                ++aStats.errors;
+                return false;
+            }
+
+            aClient->cipher.login(Proto::read32(msg + 8), Proto::read32(msg + 4));
+
+            aClient->state = Client::ECHOING;
+            ++aStats.connections;
+
+            // the rest of the buffer was decrypted with the previous key
+            if (aClient->in.size() - offset != len)
+            {
+                ++aStats.errors;
+                return false;
+            }
+        }
+        else
+        {
+            std::vector<uint8_t> expected(len);
+            fillEcho(expected.data(), len, aClient->sent - 1);
+            if (memcmp(msg, expected.data(), len) != 0)
+            {
+                ++aStats.errors;
+                return false;
+            }
+            ++aStats.packets;
+        }
+
+        offset += len;
+        if (aClient->state == Client::ECHOING)
+        {
+            if (aClient->sent == aPackets)
+                return false;
+
+            std::vector<uint8_t> echo(aPacketSize);
+            fillEcho(echo.data(), echo.size(), aClient->sent++);
+            if (!sendMessage(aClient, echo.data(), echo.size(), aStats))
+            {
+                ++aStats.errors;
+                return false;
+            }
+        }
+    }
+    aClient->in.erase(aClient->in.begin(), aClient->in.begin() + offset);
+    return true;
+}
+
+static void
+loadThread(const char* aHost, uint16_t aPort,
+           size_t aConnections, size_t aPackets, size_t aPacketSize, LoadStats& aStats)
+{
+    Poller poller;
+    Poller::Event events[256];
+    size_t opened = 0, pending = 0, active = 0;
+
+    while (opened < aConnections || active > 0)
+    {
+        while (opened < aConnections && pending < MAX_PENDING_CONNECTS)
+        {
+            ++opened;
+            Socket socket = netConnect(aHost, aPort);
+            if (socket == INVALID_SOCKET)
+            {
+                ++aStats.errors;
+                continue;
+            }
+
+            Client* client = new Client();
+            client->socket = socket;
+            client->state = Client::CONNECTING;
+            client->sent = 0;
+            poller.add(socket, client, Poller::WRITABLE);
+            ++pending;
+            ++active;
+        }
+
+        int count = poller.wait(events, 256, 100);
+        for (int i = 0; i < count; ++i)
+        {
+            Client* client = (Client*)events[i].data;
+            bool alive = (events[i].events & Poller::FAILED) == 0;
+            if (!alive)
+                ++aStats.errors;
+
+            if (alive && client->state == Client::CONNECTING && (events[i].events & Poller::WRITABLE) != 0)
+            {
+                --pending;
+                client->state = Client::LOGGING;
+                poller.modify(client->socket, client, Poller::READABLE);
+
+                uint8_t account[Proto::ACCOUNT_SIZE];
+                memset(account, 0, sizeof(account));
+                Proto::write16(account, (uint16_t)Proto::ACCOUNT_SIZE);
+                Proto::write16(account + 2, Proto::MSG_ACCOUNT);
+                memcpy(account + 4, "loadgen", 7);
+                alive = sendMessage(client, account, sizeof(account), aStats);
+                if (!alive)
+                    ++aStats.errors;
+            }
+            else if (alive && (events[i].events & Poller::READABLE) != 0)
+                alive = onReadable(client, aPackets, aPacketSize, aStats);
+
+            if (!alive)
+            {
+                if (client->state == Client::CONNECTING)
+                    --pending;
+                closeClient(poller, client);
+                --active;
+            }
+        }
+    }
+}
+
+/**
+ * Run a load against a gateway and print its CSV line.
+ *
+ * @param[in] aImpl  the implementation used by the gateway (for the report)
+ */
+static bool
+runLoad(const std::string& aImpl, const char* aHost, uint16_t aPort, size_t aConnections,
+        size_t aPackets, size_t aPacketSize, size_t aThreads)
+{
+    LoadStats stats;
+    std::vector<std::thread> threads;
+
+    Stopwatch sw;
+    double cpu = getProcessCpuTime();
+    for (size_t i = 0; i < aThreads; ++i)
+    {
+        size_t share = aConnections / aThreads + (i < aConnections % aThreads ? 1 : 0);
+        threads.push_back(std::thread(&loadThread, aHost, aPort, share,
+                                      aPackets, aPacketSize, std::ref(stats)));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+    double elapsed = sw.elapsed();
+    cpu = getProcessCpuTime() - cpu;
+
+    printf("%s,%u,%u,%u,%u,%.3f,%.0f,%.0f,%.1f,%.1f,%llu\n",
+           aImpl.c_str(), (unsigned)aConnections, (unsigned)aPackets, (unsigned)aPacketSize,
+           (unsigned)aThreads, elapsed,
+           (double)stats.connections / elapsed,
+           (double)stats.packets / elapsed,
+           (double)stats.bytes / elapsed / (1024.0 * 1024.0),
+           stats.bytes != 0 ? cpu * 1e9 / (double)stats.bytes : 0.0,
+           (unsigned long long)stats.errors);
+    fflush(stdout);
+    return stats.errors == 0;
+}
+
+static const char* LOAD_HEADER =
+    "impl,connections,packets_per_connection,packet_size,threads,seconds,"
+    "connections_per_s,packets_per_s,mb_per_s,cpu_ns_per_byte,errors\n";
+
+int
+benchLoadGen(int argc, char* argv[])
+{
+    uint16_t port = argc > 0 ? (uint16_t)atoi(argv[0]) : 9958;
+    size_t connections = argc > 1 ? (size_t)atol(argv[1]) : 10000;
+    size_t packets = argc > 2 ? (size_t)atol(argv[2]) : 100;
+    size_t packetSize = argc > 3 ? (size_t)atol(argv[3]) : 64;
+    size_t threads = argc > 4 ? (size_t)atol(argv[4]) : 4;
+
+    if (packetSize < Proto::HEADER_SIZE || packetSize > Proto::MAX_SIZE || threads == 0 || !netStartup())
+        return EXIT_FAILURE;
+
+    printf("%s", LOAD_HEADER);
+    bool ok = runLoad("remote", "127.0.0.1", port, connections, packets, packetSize, threads);
+
+    netCleanup();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int
+benchEndToEnd(int argc, char* argv[])
+{
+    size_t connections = argc > 0 ? (size_t)atol(argv[0]) : 10000;
+    size_t packets = argc > 1 ? (size_t)atol(argv[1]) : 100;
+    size_t packetSize = argc > 2 ? (size_t)atol(argv[2]) : 64;
+    size_t threads = argc > 3 ? (size_t)atol(argv[3]) : 4;
+
+    if (packetSize < Proto::HEADER_SIZE || packetSize > Proto::MAX_SIZE || threads == 0 || !netStartup())
+        return EXIT_FAILURE;
+
+    // the CPU per octet covers both the gateway and the clients
+    printf("%s", LOAD_HEADER);
+
+    bool ok = true;
+    std::vector<std::string> impls = getSupportedImpls();
+    for (size_t i = 0; i < impls.size(); ++i)
+    {
+        Gateway gateway;
+        if (!gateway.start(impls[i], 0, threads))
+        {
+            fprintf(stderr, "Can't start the gateway\n");
+            ok = false;
+            break;
+        }
+
+        ok = runLoad(impls[i], "127.0.0.1", gateway.getPort(), connections, packets, packetSize, threads) && ok;
+        gateway.stop();
+    }
+
+    netCleanup();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,84 @@
+﻿/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int benchContention(int argc, char* argv[]);
+int benchReserve(int argc, char* argv[]);
+int benchProfile(int argc, char* argv[]);
+int benchTranscrypt(int argc, char* argv[]);
+int benchBroadcast(int argc, char* argv[]);
+int benchWorkload(int argc, char* argv[]);
+int benchGateway(int argc, char* argv[]);
+int benchLoadGen(int argc, char* argv[]);
+int benchEndToEnd(int argc, char* argv[]);
+int benchBlowfish(int argc, char* argv[]);
+int benchOffload(int argc, char* argv[]);
+int benchOffsets(int argc, char* argv[]);
+int benchNuma(int argc, char* argv[]);
+int benchRing(int argc, char* argv[]);
+int benchRC5(int argc, char* argv[]);
+int benchResync(int argc, char* argv[]);
+int benchHexDump(int argc, char* argv[]);
+int benchTap(int argc, char* argv[]);
+int benchFixed(int argc, char* argv[]);
+int benchPatch(int argc, char* argv[]);
+int benchOutput(int argc, char* argv[]);
+
+static const struct
+{
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+    const char* usage;
+} BENCHMARKS[] =
+{
+    { "contention", &benchContention, "[total_bytes]  mutex-guarded session vs. split encryptor/decryptor" },
+    { "reserve", &benchReserve, "[total_bytes]  many writers on one session: mutex vs. counter reservation" },
+    { "profile", &benchProfile, "[total_bytes]  hardware counters of each kernel per size class (CSV)" },
+    { "transcrypt", &benchTranscrypt, "[total_bytes]  proxy forwarding: decrypt + encrypt vs. fused transcrypt" },
+    { "broadcast", &benchBroadcast, "[total_bytes]  one packet for 10 to 1000 sessions: individual vs. broadcast" },
+    { "workload", &benchWorkload, "[sessions] [events] [trace_file]  replay of a game server trace (loaded, or saved)" },
+    { "gateway", &benchGateway, "[port] [threads] [impl] [seconds]  reference gateway (handshake and echo)" },
+    { "loadgen", &benchLoadGen, "[port] [connections] [packets] [packet_size] [threads]  clients of the gateway" },
+    { "e2e", &benchEndToEnd, "[connections] [packets] [packet_size] [threads]  in-process gateway and clients, per kernel" },
+    { "blowfish", &benchBlowfish, "[total_bytes]  Blowfish-CFB64 sessions: one after the other vs. interleaved" },
+    { "offload", &benchOffload, "[total_bytes] [threads] [name]  in-process sessions vs. shared-memory offload service" },
+    { "offsets", &benchOffsets, "[total_bytes]  throughput of each kernel by start offset in a page of 256 counters" },
+    { "numa", &benchNuma, "[sessions] [packets] [packet_size]  sessions served from another NUMA node: remote vs. replicated key" },
+    { "ring", &benchRing, "[total_bytes]  packets wrapping in a circular buffer: copy vs. two calls vs. ring region" },
+    { "rc5", &benchRC5, "[total_logins]  RC5 password decryption of login bursts: serial vs. cached key vs. batched" },
+    { "resync", &benchResync, "[searches]  search of the decryption counter of a desynchronized session, per thread count" },
+    { "hexdump", &benchHexDump, "[total_bytes]  packet logs: concatenated strings vs. scalar vs. AVX2 dump vs. fused decrypt and dump" },
+    { "tap", &benchTap, "[total_bytes] [threads]  sessions with a packet tap: none vs. paused vs. filtered vs. sampled vs. all" },
+    { "fixed", &benchFixed, "[packets]  fixed-size messages (8 to 28 bytes): runtime-length vs. size-specialized kernels" },
+    { "patch", &benchPatch, "[packets]  timestamp of queued encrypted packets: decrypt, edit and encrypt vs. patch" },
+    { "output", &benchOutput, "[packets]  small packets of a tick: encrypted one by one vs. coalesced output buffer" },
+};
+
+int
+main(int argc, char* argv[])
+{
+    const size_t count = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+    if (argc >= 2)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (strcmp(argv[1], BENCHMARKS[i].name) == 0)
+                return BENCHMARKS[i].run(argc - 2, argv + 2);
+        }
+    }
+
+    fprintf(stderr, "Usage: %s <benchmark> [args...]\n\n", argc > 0 ? argv[0] : "Benchmarks");
+    for (size_t i = 0; i < count; ++i)
+        fprintf(stderr, "  %-12s %s\n", BENCHMARKS[i].name, BENCHMARKS[i].usage);
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,334 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "netio.h"
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+static bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+static bool inProgress() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+#else
+static bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+static bool inProgress() { return errno == EINPROGRESS; }
+#endif
+
+static void
+setOptions(Socket aSocket)
+{
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ioctlsocket(aSocket, FIONBIO, &nonBlocking);
+#else
+    fcntl(aSocket, F_SETFL, fcntl(aSocket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    // the packets are small and latency-bound
+    int noDelay = 1;
+    setsockopt(aSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+}
+
+bool
+netStartup()
+{
+#if defined(_WIN32)
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    // thousands of connections don't fit in the default soft limit (often 1024)
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return true;
+#endif
+}
+
+void
+netCleanup()
+{
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+Socket
+netListen(uint16_t aPort, uint16_t* aBoundPort)
+{
+    Socket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(aPort);
+
+    socklen_t len = sizeof(addr);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listener, SOMAXCONN) != 0 ||
+        getsockname(listener, (struct sockaddr*)&addr, &len) != 0)
+    {
+        netClose(listener);
+        return INVALID_SOCKET;
+    }
+
+    setOptions(listener);
+    if (aBoundPort != nullptr)
+        *aBoundPort = ntohs(addr.sin_port);
+    return listener;
+}
+
+Socket
+netAccept(Socket aListener)
+{
+    Socket socket = accept(aListener, nullptr, nullptr);
+    if (socket != INVALID_SOCKET)
+        setOptions(socket);
+    return socket;
+}
+
+Socket
+netConnect(const char* aHost, uint16_t aPort)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(aPort);
+    if (inet_pton(AF_INET, aHost, &addr.sin_addr) != 1)
+        return INVALID_SOCKET;
+
+    Socket socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (socket == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    setOptions(socket);
+    if (connect(socket, (struct sockaddr*)&addr, sizeof(addr)) != 0 && !inProgress())
+    {
+        netClose(socket);
+        return INVALID_SOCKET;
+    }
+    return socket;
+}
+
+int
+netSend(Socket aSocket, const uint8_t* aBuf, size_t aLen)
+{
+#if defined(_WIN32)
+    int sent = send(aSocket, (const char*)aBuf, (int)aLen, 0);
+#else
+    int sent = (int)send(aSocket, aBuf, aLen, MSG_NOSIGNAL);
+#endif
+    if (sent < 0)
+        return wouldBlock() ? 0 : -1;
+    return sent;
+}
+
+int
+netRecv(Socket aSocket, uint8_t* aBuf, size_t aLen)
+{
+#if defined(_WIN32)
+    int received = recv(aSocket, (char*)aBuf, (int)aLen, 0);
+#else
+    int received = (int)recv(aSocket, aBuf, aLen, 0);
+#endif
+    if (received < 0)
+        return wouldBlock() ? 0 : -1;
+    if (received == 0)
+        return -1; // closed by the peer
+    return received;
+}
+
+void
+netClose(Socket aSocket)
+{
+#if defined(_WIN32)
+    closesocket(aSocket);
+#else
+    close(aSocket);
+#endif
+}
+
+#if defined(_WIN32)
+
+static short
+toPollEvents(int aEvents)
+{
+    return (short)(((aEvents & Poller::READABLE) != 0 ? POLLRDNORM : 0) |
+                   ((aEvents & Poller::WRITABLE) != 0 ? POLLWRNORM : 0));
+}
+
+Poller :: Poller()
+    : mNext(0)
+{
+
+}
+
+Poller :: ~Poller()
+{
+
+}
+
+bool
+Poller :: add(Socket aSocket, void* aData, int aEvents)
+{
+    WSAPOLLFD fd;
+    fd.fd = aSocket;
+    fd.events = toPollEvents(aEvents);
+    fd.revents = 0;
+
+    mIndex[aSocket] = mFds.size();
+    mFds.push_back(fd);
+    mData.push_back(aData);
+    return true;
+}
+
+bool
+Poller :: modify(Socket aSocket, void* aData, int aEvents)
+{
+    std::map<Socket, size_t>::iterator it = mIndex.find(aSocket);
+    if (it == mIndex.end())
+        return false;
+
+    mFds[it->second].events = toPollEvents(aEvents);
+    mData[it->second] = aData;
+    return true;
+}
+
+void
+Poller :: remove(Socket aSocket)
+{
+    std::map<Socket, size_t>::iterator it = mIndex.find(aSocket);
+    if (it == mIndex.end())
+        return;
+
+    // move the last socket in the hole
+    size_t index = it->second;
+    mIndex.erase(it);
+    if (index != mFds.size() - 1)
+    {
+        mFds[index] = mFds.back();
+        mData[index] = mData.back();
+        mIndex[mFds[index].fd] = index;
+    }
+    mFds.pop_back();
+    mData.pop_back();
+}
+
+int
+Poller :: wait(Event* aEvents, int aMax, int aTimeoutMs)
+{
+    if (mFds.empty())
+    {
+        Sleep(aTimeoutMs);
+        return 0;
+    }
+
+    if (WSAPoll(mFds.data(), (ULONG)mFds.size(), aTimeoutMs) <= 0)
+        return 0;
+
+    int count = 0;
+    size_t size = mFds.size();
+    for (size_t n = 0; n < size && count < aMax; ++n)
+    {
+        size_t i = (mNext + n) % size;
+        short revents = mFds[i].revents;
+        if (revents == 0)
+            continue;
+
+        aEvents[count].data = mData[i];
+        aEvents[count].events =
+            ((revents & POLLRDNORM) != 0 ? READABLE : 0) |
+            ((revents & POLLWRNORM) != 0 ? WRITABLE : 0) |
+            ((revents & (POLLERR | POLLHUP | POLLNVAL)) != 0 ? FAILED : 0);
+        ++count;
+    }
+    mNext = (mNext + 1) % size;
+    return count;
+}
+
+#else
+
+static uint32_t
+toEpollEvents(int aEvents)
+{
+    return ((aEvents & Poller::READABLE) != 0 ? (uint32_t)EPOLLIN : (uint32_t)0) |
+           ((aEvents & Poller::WRITABLE) != 0 ? (uint32_t)EPOLLOUT : (uint32_t)0);
+}
+
+Poller :: Poller()
+    : mEpoll(epoll_create1(0))
+{
+
+}
+
+Poller :: ~Poller()
+{
+    close(mEpoll);
+}
+
+bool
+Poller :: add(Socket aSocket, void* aData, int aEvents)
+{
+    struct epoll_event event;
+    event.events = toEpollEvents(aEvents);
+    event.data.ptr = aData;
+    return epoll_ctl(mEpoll, EPOLL_CTL_ADD, aSocket, &event) == 0;
+}
+
+bool
+Poller :: modify(Socket aSocket, void* aData, int aEvents)
+{
+    struct epoll_event event;
+    event.events = toEpollEvents(aEvents);
+    event.data.ptr = aData;
+    return epoll_ctl(mEpoll, EPOLL_CTL_MOD, aSocket, &event) == 0;
+}
+
+void
+Poller :: remove(Socket aSocket)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    epoll_ctl(mEpoll, EPOLL_CTL_DEL, aSocket, &event);
+}
+
+int
+Poller :: wait(Event* aEvents, int aMax, int aTimeoutMs)
+{
+    struct epoll_event events[256];
+    int count = epoll_wait(mEpoll, events, aMax < 256 ? aMax : 256, aTimeoutMs);
+    for (int i = 0; i < count; ++i)
+    {
+        aEvents[i].data = events[i].data.ptr;
+        aEvents[i].events =
+            ((events[i].events & EPOLLIN) != 0 ? READABLE : 0) |
+            ((events[i].events & EPOLLOUT) != 0 ? WRITABLE : 0) |
+            ((events[i].events & (EPOLLERR | EPOLLHUP)) != 0 ? FAILED : 0);
+    }
+    return count > 0 ? count : 0;
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _NET_IO_H_
+#define _NET_IO_H_
+
+// must be included before <windows.h> (and so before benchmark.h)
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <map>
+#include <vector>
+typedef SOCKET Socket;
+#else
+typedef int Socket;
+#define INVALID_SOCKET (-1)
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Initialize the socket library (Winsock), or raise the limit of the
+ * descriptors of the process to its maximum (POSIX).
+ */
+bool netStartup();
+
+/** Release the socket library (Winsock). */
+void netCleanup();
+
+/**
+ * Create a non-blocking listener on the loopback interface.
+ *
+ * @param[in]  aPort       the port, or zero for an ephemeral port
+ * @param[out] aBoundPort  the port the listener is bound to
+ *
+ * @returns the listener, or INVALID_SOCKET on failure
+ */
+Socket netListen(uint16_t aPort, uint16_t* aBoundPort);
+
+/**
+ * Accept a pending connection, as a non-blocking socket.
+ *
+ * @returns the connection, or INVALID_SOCKET if there is none
+ */
+Socket netAccept(Socket aListener);
+
+/**
+ * Start a non-blocking connection to a host of the loopback network.
+ *
+ * @returns the connection, or INVALID_SOCKET on failure
+ */
+Socket netConnect(const char* aHost, uint16_t aPort);
+
+/**
+ * Send octets without blocking.
+ *
+ * @returns the number of octets sent (zero if the socket would block), or
+ *          -1 if the connection is lost
+ */
+int netSend(Socket aSocket, const uint8_t* aBuf, size_t aLen);
+
+/**
+ * Receive octets without blocking.
+ *
+ * @returns the number of octets received (zero if the socket would block),
+ *          or -1 if the connection is closed or lost
+ */
+int netRecv(Socket aSocket, uint8_t* aBuf, size_t aLen);
+
+/** Close a socket. */
+void netClose(Socket aSocket);
+
+/**
+ * Level-triggered readiness poller.
+ *
+ * On Linux, it is based on epoll. On Windows, it is based on WSAPoll, which
+ * has the same readiness model but scans all its sockets on each wait; the
+ * sockets are therefore sharded over many pollers (one per thread).
+ */
+class Poller
+{
+public:
+    /** The readiness events. */
+    enum
+    {
+        READABLE = 1, //!< Octets (or a connection) can be received
+        WRITABLE = 2, //!< Octets can be sent (or the connection is established)
+        FAILED = 4    //!< The connection is closed or lost
+    };
+
+    /** A ready socket. */
+    struct Event
+    {
+        void* data; //!< Data registered with the socket
+        int events; //!< Combination of the readiness events
+    };
+
+public:
+    /* constructor */
+    Poller();
+
+    /* destructor */
+    ~Poller();
+
+    /** Register a socket for some events (READABLE, WRITABLE). */
+    bool add(Socket aSocket, void* aData, int aEvents);
+
+    /** Change the events of a registered socket. */
+    bool modify(Socket aSocket, void* aData, int aEvents);
+
+    /** Unregister a socket (before closing it). */
+    void remove(Socket aSocket);
+
+    /**
+     * Wait until some sockets are ready.
+     *
+     * @param[out] aEvents     the ready sockets
+     * @param[in]  aMax        the capacity of aEvents
+     * @param[in]  aTimeoutMs  the timeout in milliseconds
+     *
+     * @returns the number of ready sockets
+     */
+    int wait(Event* aEvents, int aMax, int aTimeoutMs);
+
+private:
+    // not copyable
+    Poller(const Poller&);
+    Poller& operator=(const Poller&);
+
+private:
+#if defined(_WIN32)
+    std::vector<WSAPOLLFD> mFds; //!< Registered sockets
+    std::vector<void*> mData; //!< Data of the registered sockets
+    std::map<Socket, size_t> mIndex; //!< Index of the sockets in mFds
+    size_t mNext; //!< First socket to report on the next wait (fairness)
+#else
+    int mEpoll; //!< Descriptor of the epoll instance
+#endif
+};
+
+#endif // _NET_IO_H_
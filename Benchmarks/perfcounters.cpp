@@ -0,0 +1,197 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "perfcounters.h"
+#include "instructionset.h"
+#include <string.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+const char*
+PerfCounters :: getName(Event aEvent)
+{
+    static const char* NAMES[EVENT_COUNT] =
+    {
+        "cycles", "ref_cycles", "instructions", "l1d_misses", "l2_misses", "branch_misses"
+    };
+    return NAMES[aEvent];
+}
+
+#if defined(__linux__)
+
+static int
+openEvent(uint32_t aType, uint64_t aConfig)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = aType;
+    attr.config = aConfig;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the events are opened separately, so they may be multiplexed
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Get the reason why perf_event_open failed.
+ */
+static const char*
+getOpenError(int aError)
+{
+    switch (aError)
+    {
+    case ENOENT:
+    case ENODEV:
+    case EOPNOTSUPP:
+        return "no PMU exposed to this system";
+    case EACCES:
+    case EPERM:
+        return "not permitted by kernel.perf_event_paranoid";
+    default:
+        return "perf_event_open failed";
+    }
+}
+
+PerfCounters :: PerfCounters()
+{
+    static const uint64_t L1D_READ_MISS =
+        PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    // L2_RQSTS.MISS (event 0x24, umask 0x3F) on Haswell and later
+    static const uint64_t INTEL_L2_MISS = 0x3F24;
+
+    static const uint32_t TYPES[EVENT_COUNT] =
+    {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_RAW, PERF_TYPE_HARDWARE
+    };
+    static const uint64_t CONFIGS[EVENT_COUNT] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_REF_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        L1D_READ_MISS, INTEL_L2_MISS, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for (int i = 0; i < EVENT_COUNT; ++i)
+    {
+        mValues[i] = 0;
+        mReasons[i] = nullptr;
+
+        if (i == L2_MISSES && InstructionSet::getVendor() != "GenuineIntel")
+        {
+            mFds[i] = -1;
+            mReasons[i] = "Intel only";
+        }
+        else if ((mFds[i] = openEvent(TYPES[i], CONFIGS[i])) < 0)
+        {
+            mReasons[i] = getOpenError(errno);
+        }
+        mAvailable[i] = mFds[i] >= 0;
+    }
+}
+
+PerfCounters :: ~PerfCounters()
+{
+    for (int i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (mFds[i] >= 0)
+            close(mFds[i]);
+    }
+}
+
+void
+PerfCounters :: start()
+{
+    for (int i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (mFds[i] >= 0)
+        {
+            ioctl(mFds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(mFds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void
+PerfCounters :: stop()
+{
+    for (int i = 0; i < EVENT_COUNT; ++i)
+    {
+        if (mFds[i] >= 0)
+            ioctl(mFds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (int i = 0; i < EVENT_COUNT; ++i)
+    {
+        mValues[i] = 0;
+        if (mFds[i] < 0)
+            continue;
+
+        // value, time enabled, time running
+        uint64_t data[3];
+        if (read(mFds[i], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0)
+            continue;
+
+        // scale the value if the event was multiplexed
+        mValues[i] = data[2] < data[1]
+            ? (uint64_t)((double)data[0] * (double)data[1] / (double)data[2])
+            : data[0];
+    }
+}
+
+#elif defined(_WIN32)
+
+PerfCounters :: PerfCounters()
+    : mStartCycles(0)
+{
+    for (int i = 0; i < EVENT_COUNT; ++i)
+    {
+        mAvailable[i] = false;
+        mValues[i] = 0;
+        mReasons[i] = "not readable from user mode on Windows";
+    }
+
+    // the cycles of the thread are counted at the rate of the TSC
+    mAvailable[REF_CYCLES] = true;
+    mReasons[REF_CYCLES] = nullptr;
+}
+
+PerfCounters :: ~PerfCounters()
+{
+
+}
+
+void
+PerfCounters :: start()
+{
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    mStartCycles = cycles;
+}
+
+void
+PerfCounters :: stop()
+{
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    mValues[REF_CYCLES] = cycles - mStartCycles;
+}
+
+#endif
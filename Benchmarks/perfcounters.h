@@ -0,0 +1,81 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <stdint.h>
+
+/**
+ * Hardware performance counters of the calling thread.
+ *
+ * On Linux, the counters are opened with perf_event_open and only count the
+ * user mode, so a perf_event_paranoid level of 2 is enough; the hardware
+ * events also need a PMU, which most virtual machines don't expose. On
+ * Windows, the PMU can't be programmed from user mode: only the cycles of
+ * the thread are available (QueryThreadCycleTime, counting at the rate of
+ * the TSC). The events which can't be counted are reported as unavailable,
+ * with the reason.
+ */
+class PerfCounters
+{
+public:
+    /** The events counted by the harness. */
+    enum Event
+    {
+        CYCLES,        //!< Core cycles (at the actual frequency)
+        REF_CYCLES,    //!< Reference cycles (at the nominal frequency)
+        INSTRUCTIONS,  //!< Retired instructions
+        L1D_MISSES,    //!< L1 data cache read misses
+        L2_MISSES,     //!< L2 cache misses (Intel only)
+        BRANCH_MISSES, //!< Mispredicted branches
+        EVENT_COUNT
+    };
+
+public:
+    /* constructor */
+    PerfCounters();
+
+    /* destructor */
+    ~PerfCounters();
+
+    /** Reset and start the counters. */
+    void start();
+
+    /** Stop the counters and read their values. */
+    void stop();
+
+    /** Check whether an event can be counted on this system. */
+    bool isAvailable(Event aEvent) const { return mAvailable[aEvent]; }
+
+    /** Get the reason why an event can't be counted (nullptr if it can). */
+    const char* getReason(Event aEvent) const { return mReasons[aEvent]; }
+
+    /** Get the value of an event, as read by the last stop(). */
+    uint64_t getValue(Event aEvent) const { return mValues[aEvent]; }
+
+    /** Get the name of an event, as used in the CSV header. */
+    static const char* getName(Event aEvent);
+
+private:
+    // not copyable
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+
+private:
+#if defined(__linux__)
+    int mFds[EVENT_COUNT]; //!< File descriptors of the events (-1 if unavailable)
+#elif defined(_WIN32)
+    uint64_t mStartCycles; //!< Cycles of the thread when started
+#endif
+    uint64_t mValues[EVENT_COUNT]; //!< Values read by the last stop()
+    bool mAvailable[EVENT_COUNT]; //!< Events which can be counted
+    const char* mReasons[EVENT_COUNT]; //!< Reasons why the events can't be counted
+};
+
+#endif // _PERF_COUNTERS_H_
@@ -0,0 +1,167 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "workload.h"
+#include <stdio.h>
+#include <algorithm>
+
+/**
+ * xorshift32, good enough for traces.
+ */
+class TraceRandom
+{
+public:
+    /* constructor */
+    TraceRandom(uint32_t aSeed) : mState(aSeed != 0 ? aSeed : 0x9E3779B9) { }
+
+    /** Get the next integer. */
+    uint32_t next()
+    {
+        mState ^= mState << 13;
+        mState ^= mState >> 17;
+        mState ^= mState << 5;
+        return mState;
+    }
+
+    /** Get an integer in [aMin, aMax]. */
+    uint32_t range(uint32_t aMin, uint32_t aMax) { return aMin + next() % (aMax - aMin + 1); }
+
+    /** Get a percentage in [0, 100). */
+    uint32_t percent() { return next() % 100; }
+
+private:
+    uint32_t mState; //!< State of the generator
+};
+
+static uint16_t
+sentPacketSize(TraceRandom& aRandom)
+{
+    // actions, movements and chat; item and spawn packets; map synchronizations
+    uint32_t p = aRandom.percent();
+    if (p < 60)
+        return (uint16_t)aRandom.range(8, 64);
+    else if (p < 90)
+        return (uint16_t)aRandom.range(64, 512);
+    else if (p < 99)
+        return (uint16_t)aRandom.range(512, 4096);
+    else
+        return (uint16_t)aRandom.range(4096, 8192);
+}
+
+static uint16_t
+receivedPacketSize(TraceRandom& aRandom)
+{
+    // the clients mostly send actions and movements
+    return aRandom.percent() < 90
+        ? (uint16_t)aRandom.range(8, 64)
+        : (uint16_t)aRandom.range(64, 256);
+}
+
+void
+generateTrace(std::vector<TraceEvent>& aTrace, uint32_t aSessions, size_t aEvents, uint32_t aSeed)
+{
+    TraceRandom random(aSeed);
+
+    // the busy sessions are spread over the whole table
+    std::vector<uint32_t> order(aSessions);
+    for (uint32_t i = 0; i < aSessions; ++i)
+        order[i] = i;
+    for (uint32_t i = aSessions; i > 1; --i)
+        std::swap(order[i - 1], order[random.next() % i]);
+
+    uint32_t busy = aSessions / 5 > 0 ? aSessions / 5 : 1;
+    std::vector<bool> logged(aSessions, false);
+
+    aTrace.clear();
+    aTrace.reserve(aEvents);
+    while (aTrace.size() < aEvents)
+    {
+        TraceEvent event;
+        event.session = random.percent() < 80
+            ? order[random.next() % busy]
+            : order[random.next() % aSessions];
+
+        if (!logged[event.session] || random.next() % 1000 == 0)
+        {
+            // first packet of the session, or a relogin
+            logged[event.session] = true;
+            event.op = TraceEvent::OP_LOGIN;
+            event.size = 0;
+        }
+        else if (random.percent() < 55)
+        {
+            event.op = TraceEvent::OP_ENCRYPT;
+            event.size = sentPacketSize(random);
+        }
+        else
+        {
+            event.op = TraceEvent::OP_DECRYPT;
+            event.size = receivedPacketSize(random);
+        }
+
+        aTrace.push_back(event);
+    }
+}
+
+bool
+loadTrace(std::vector<TraceEvent>& aTrace, const std::string& aPath)
+{
+    FILE* file = fopen(aPath.c_str(), "r");
+    if (file == nullptr)
+        return false;
+
+    aTrace.clear();
+
+    bool ok = true;
+    unsigned session = 0, size = 0;
+    char op = 0;
+    int read;
+    while ((read = fscanf(file, " %u,%c,%u", &session, &op, &size)) == 3)
+    {
+        if ((op != TraceEvent::OP_ENCRYPT && op != TraceEvent::OP_DECRYPT && op != TraceEvent::OP_LOGIN) ||
+            size > 0xFFFF)
+        {
+            ok = false;
+            break;
+        }
+
+        TraceEvent event;
+        event.session = session;
+        event.op = (uint8_t)op;
+        event.size = (uint16_t)(op == TraceEvent::OP_LOGIN ? 0 : size);
+        aTrace.push_back(event);
+    }
+
+    if (read != EOF)
+        ok = false;
+
+    fclose(file);
+    return ok && !aTrace.empty();
+}
+
+bool
+saveTrace(const std::vector<TraceEvent>& aTrace, const std::string& aPath)
+{
+    FILE* file = fopen(aPath.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    for (size_t i = 0; i < aTrace.size(); ++i)
+        fprintf(file, "%u,%c,%u\n", aTrace[i].session, aTrace[i].op, aTrace[i].size);
+
+    return fclose(file) == 0;
+}
+
+uint32_t
+getSessionCount(const std::vector<TraceEvent>& aTrace)
+{
+    uint32_t count = 0;
+    for (size_t i = 0; i < aTrace.size(); ++i)
+        count = std::max(count, aTrace[i].session + 1);
+    return count;
+}
@@ -0,0 +1,72 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _WORKLOAD_H_
+#define _WORKLOAD_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * One packet (or login) of a session in a workload trace.
+ */
+struct TraceEvent
+{
+    /** The kind of event. */
+    enum Op
+    {
+        OP_ENCRYPT = 'e', //!< Packet sent to the client
+        OP_DECRYPT = 'd', //!< Packet received from the client
+        OP_LOGIN = 'l'    //!< Login of the client (alternate key)
+    };
+
+    uint32_t session; //!< Index of the session
+    uint16_t size; //!< Size of the packet (zero for a login)
+    uint8_t op; //!< Kind of event (Op)
+};
+
+/**
+ * Synthesize the trace of a game server: mostly tiny packets with some
+ * larger synchronizations, a login per session and a few relogins. A fifth
+ * of the sessions get most of the traffic.
+ *
+ * @param[out] aTrace     the trace
+ * @param[in]  aSessions  the number of sessions
+ * @param[in]  aEvents    the number of events
+ * @param[in]  aSeed      the seed of the generator
+ */
+void generateTrace(std::vector<TraceEvent>& aTrace, uint32_t aSessions, size_t aEvents, uint32_t aSeed);
+
+/**
+ * Load a trace from a text file, one "session,op,size" event per line
+ * (op being e, d or l).
+ *
+ * @param[out] aTrace  the trace
+ * @param[in]  aPath   the path of the file
+ *
+ * @returns false if the file can't be read or is malformed
+ */
+bool loadTrace(std::vector<TraceEvent>& aTrace, const std::string& aPath);
+
+/**
+ * Save a trace to a text file (see loadTrace).
+ *
+ * @param[in] aTrace  the trace
+ * @param[in] aPath   the path of the file
+ *
+ * @returns false if the file can't be written
+ */
+bool saveTrace(const std::vector<TraceEvent>& aTrace, const std::string& aPath);
+
+/**
+ * Get the number of sessions of a trace (the highest index plus one).
+ */
+uint32_t getSessionCount(const std::vector<TraceEvent>& aTrace);
+
+#endif // _WORKLOAD_H_
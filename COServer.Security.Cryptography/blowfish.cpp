@@ -0,0 +1,185 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "blowfish.h"
+#include "blowfish_cfb64.h"
+
+using namespace COServer::Security::Cryptography;
+using namespace System::Runtime::InteropServices;
+
+Blowfish :: Blowfish()
+    : mCipher(new Blowfish_CFB64())
+{
+
+}
+
+Blowfish :: ~Blowfish()
+{
+    this->!Blowfish();
+}
+
+Blowfish :: !Blowfish()
+{
+    if (mCipher != nullptr)
+    {
+        delete mCipher;
+        mCipher = nullptr;
+    }
+}
+
+void
+Blowfish :: SetKey(array<System::Byte>^ aKey)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("Blowfish");
+    if (aKey == nullptr || aKey->Length == 0)
+        throw gcnew System::ArgumentException("The key can't be empty.", "aKey");
+
+    pin_ptr<uint8_t> key = &aKey[0];
+    mCipher->setKey(key, aKey->Length);
+}
+
+void
+Blowfish :: SetIVs(array<System::Byte>^ aEnIV, array<System::Byte>^ aDeIV)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("Blowfish");
+    if (aEnIV == nullptr || aEnIV->Length != BlockSize)
+        throw gcnew System::ArgumentException("The IV must hold BlockSize bytes.", "aEnIV");
+    if (aDeIV == nullptr || aDeIV->Length != BlockSize)
+        throw gcnew System::ArgumentException("The IV must hold BlockSize bytes.", "aDeIV");
+
+    pin_ptr<uint8_t> enIV = &aEnIV[0];
+    pin_ptr<uint8_t> deIV = &aDeIV[0];
+    mCipher->setIVs(enIV, deIV);
+}
+
+void
+Blowfish :: Encrypt(array<System::Byte>^% aBuf, int aLength)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("Blowfish");
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    mCipher->encrypt(buf, aLength);
+}
+
+void
+Blowfish :: Decrypt(array<System::Byte>^% aBuf, int aLength)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("Blowfish");
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    mCipher->decrypt(buf, aLength);
+}
+
+void
+Blowfish :: SetKeys(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aKeys)
+{
+    if (aCiphers == nullptr)
+        throw gcnew System::ArgumentNullException("aCiphers");
+    if (aKeys == nullptr)
+        throw gcnew System::ArgumentNullException("aKeys");
+    if (aKeys->Length != aCiphers->Length)
+        throw gcnew System::ArgumentException("There must be exactly one key per cipher.", "aKeys");
+
+    int count = aCiphers->Length;
+    array<GCHandle>^ handles = gcnew array<GCHandle>(count);
+    Blowfish_CFB64** ciphers = new Blowfish_CFB64*[count];
+    const uint8_t** keys = new const uint8_t*[count];
+    size_t* lens = new size_t[count];
+
+    try
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (aCiphers[i] == nullptr || aCiphers[i]->mCipher == nullptr)
+                throw gcnew System::ArgumentException("The ciphers can't be null or disposed.", "aCiphers");
+            if (aKeys[i] == nullptr || aKeys[i]->Length == 0)
+                throw gcnew System::ArgumentException("The keys can't be empty.", "aKeys");
+
+            handles[i] = GCHandle::Alloc(aKeys[i], GCHandleType::Pinned);
+            ciphers[i] = aCiphers[i]->mCipher;
+            keys[i] = (const uint8_t*)handles[i].AddrOfPinnedObject().ToPointer();
+            lens[i] = aKeys[i]->Length;
+        }
+
+        Blowfish_CFB64::setKeys(ciphers, keys, lens, count);
+    }
+    finally
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (handles[i].IsAllocated)
+                handles[i].Free();
+        }
+        delete[] lens;
+        delete[] keys;
+        delete[] ciphers;
+    }
+}
+
+void
+Blowfish :: EncryptAll(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aBufs, array<int>^ aLengths)
+{
+    ProcessAll(aCiphers, aBufs, aLengths, true);
+}
+
+void
+Blowfish :: DecryptAll(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aBufs, array<int>^ aLengths)
+{
+    ProcessAll(aCiphers, aBufs, aLengths, false);
+}
+
+void
+Blowfish :: ProcessAll(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aBufs, array<int>^ aLengths, bool aEncrypt)
+{
+    if (aCiphers == nullptr)
+        throw gcnew System::ArgumentNullException("aCiphers");
+    if (aBufs == nullptr)
+        throw gcnew System::ArgumentNullException("aBufs");
+    if (aLengths == nullptr)
+        throw gcnew System::ArgumentNullException("aLengths");
+    if (aBufs->Length != aCiphers->Length || aLengths->Length != aCiphers->Length)
+        throw gcnew System::ArgumentException("There must be exactly one buffer and one length per cipher.", "aBufs");
+
+    int count = aCiphers->Length;
+    array<GCHandle>^ handles = gcnew array<GCHandle>(count);
+    BlowfishJob* jobs = new BlowfishJob[count];
+
+    try
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (aCiphers[i] == nullptr || aCiphers[i]->mCipher == nullptr)
+                throw gcnew System::ArgumentException("The ciphers can't be null or disposed.", "aCiphers");
+            if (aBufs[i] == nullptr || aLengths[i] < 0 || aLengths[i] > aBufs[i]->Length)
+                throw gcnew System::ArgumentException("The buffers must hold their length.", "aBufs");
+
+            handles[i] = GCHandle::Alloc(aBufs[i], GCHandleType::Pinned);
+            jobs[i].cipher = aCiphers[i]->mCipher;
+            jobs[i].buf = (uint8_t*)handles[i].AddrOfPinnedObject().ToPointer();
+            jobs[i].len = aLengths[i];
+        }
+
+        if (aEncrypt)
+            Blowfish_CFB64::encrypt(jobs, count);
+        else
+            Blowfish_CFB64::decrypt(jobs, count);
+    }
+    finally
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (handles[i].IsAllocated)
+                handles[i].Free();
+        }
+        delete[] jobs;
+    }
+}
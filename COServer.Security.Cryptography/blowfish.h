@@ -0,0 +1,115 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _BLOWFISH_H_
+#define _BLOWFISH_H_
+
+class Blowfish_CFB64;
+
+namespace COServer
+{
+	namespace Security
+	{
+		namespace Cryptography
+		{
+			/// <summary>
+			/// Blowfish cipher in CFB64 mode (used on the game servers of the 5018 and later versions, after the key
+			/// exchange).
+			///
+			/// Each direction has its own IV. The static methods process many sessions at once, interleaving their
+			/// blocks, which is faster than processing the sessions one after the other.
+			/// </summary>
+			public ref class Blowfish
+			{
+			public:
+                /// <summary>
+                /// Size in bytes of a block (and of an IV).
+                /// </summary>
+                literal int BlockSize = 8;
+
+            public:
+                /// <summary>
+                /// Create a new cipher instance, with a zero-filled key and IVs.
+                /// </summary>
+                Blowfish();
+
+                /* destructor */
+                ~Blowfish();
+
+                /* finalizer */
+                !Blowfish();
+
+            public:
+                /// <summary>
+                /// Sets the key of the cipher and resets the IVs.
+                /// </summary>
+                /// <param name="aKey">The key (at most 56 bytes are used).</param>
+                void SetKey(array<System::Byte>^ aKey);
+
+                /// <summary>
+                /// Sets the IVs of the encryption and the decryption.
+                /// </summary>
+                /// <param name="aEnIV">The encryption IV, of BlockSize bytes.</param>
+                /// <param name="aDeIV">The decryption IV, of BlockSize bytes.</param>
+                void SetIVs(array<System::Byte>^ aEnIV, array<System::Byte>^ aDeIV);
+
+                /// <summary>
+                /// Encrypts data with the algorithm.
+                /// </summary>
+                /// <param name="aBuf">A reference to the buffer to encrypt using the cipher.</param>
+                /// <param name="aLength">The number of bytes of the buffer to encrypt using the cipher.</param>
+                void Encrypt(array<System::Byte>^% aBuf, int aLength);
+
+                /// <summary>
+                /// Decrypts data with the algorithm.
+                /// </summary>
+                /// <param name="aBuf">A reference to the buffer to decrypt using the cipher.</param>
+                /// <param name="aLength">The number of bytes of the buffer to decrypt using the cipher.</param>
+                void Decrypt(array<System::Byte>^% aBuf, int aLength);
+
+            public:
+                /// <summary>
+                /// Sets the keys of many ciphers (e.g. after the key exchanges of a burst of logins).
+                /// </summary>
+                /// <param name="aCiphers">The ciphers.</param>
+                /// <param name="aKeys">The keys, one per cipher.</param>
+                static void SetKeys(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aKeys);
+
+                /// <summary>
+                /// Encrypts the data of many ciphers. A cipher can only appear once.
+                /// </summary>
+                /// <param name="aCiphers">The ciphers.</param>
+                /// <param name="aBufs">The buffers to encrypt, one per cipher.</param>
+                /// <param name="aLengths">The number of bytes to encrypt, one per cipher.</param>
+                static void EncryptAll(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aBufs, array<int>^ aLengths);
+
+                /// <summary>
+                /// Decrypts the data of many ciphers. A cipher can only appear once.
+                /// </summary>
+                /// <param name="aCiphers">The ciphers.</param>
+                /// <param name="aBufs">The buffers to decrypt, one per cipher.</param>
+                /// <param name="aLengths">The number of bytes to decrypt, one per cipher.</param>
+                static void DecryptAll(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aBufs, array<int>^ aLengths);
+
+            private:
+                /// <summary>
+                /// Encrypts or decrypts the data of many ciphers.
+                /// </summary>
+                static void ProcessAll(array<Blowfish^>^ aCiphers, array<array<System::Byte>^>^ aBufs, array<int>^ aLengths, bool aEncrypt);
+
+            private:
+                /// <summary>
+                /// Native cipher object.
+                /// </summary>
+                Blowfish_CFB64* mCipher;
+			};
+		}
+	}
+}
+
+#endif // _BLOWFISH_H_
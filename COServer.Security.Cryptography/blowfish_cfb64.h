@@ -0,0 +1,161 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _BLOWFISH_CFB64_H_
+#define _BLOWFISH_CFB64_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Blowfish_CFB64;
+
+/**
+ * Octets of a session to process in a batch.
+ */
+struct BlowfishJob
+{
+    Blowfish_CFB64* cipher; //!< Cipher of the session
+    uint8_t* buf; //!< Buffer processed in place
+    size_t len; //!< Number of octets to process
+};
+
+/**
+ * Blowfish cipher in CFB64 mode, used by the game servers of Conquer Online
+ * (5018 and later) once the key exchange is done. Each direction has its own
+ * IV and position in the current block (num), so a block can be split over
+ * many calls, like OpenSSL's BF_cfb64_encrypt.
+ *
+ * CFB is serial within a stream: a block can't be encrypted before the
+ * previous ciphertext block is known. The batched functions interleave the
+ * blocks of independent sessions instead, so the S-box lookups of LANES
+ * sessions are in flight at the same time.
+ */
+class Blowfish_CFB64
+{
+public:
+    /** The number of rounds of the Feistel network. */
+    static const size_t ROUNDS = 16;
+    /** The block size in bytes. */
+    static const size_t BLOCK_SIZE = 8;
+    /** The maximum key size in bytes. */
+    static const size_t MAX_KEY_SIZE = 56;
+    /** The number of sessions interleaved by the batched functions. */
+    static const size_t LANES = 4;
+
+public:
+    /**
+     * Create a new instance of the cipher where the IVs and the key are
+     * zero-filled.
+     */
+    Blowfish_CFB64();
+
+    /* destructor */
+    ~Blowfish_CFB64();
+
+public:
+    /**
+     * Expand the key and reset the IVs.
+     *
+     * @param[in] aKey  the key
+     * @param[in] aLen  the size of the key in bytes (at most MAX_KEY_SIZE are used)
+     */
+    void setKey(const uint8_t* aKey, size_t aLen);
+
+    /**
+     * Set the IVs of both directions and restart them at the beginning of
+     * a block.
+     *
+     * @param[in] aEnIV  the encryption IV (BLOCK_SIZE octets)
+     * @param[in] aDeIV  the decryption IV (BLOCK_SIZE octets)
+     */
+    void setIVs(const uint8_t* aEnIV, const uint8_t* aDeIV);
+
+    /**
+     * Encrypt n octet(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be encrypted
+     * @param[in]     aLen          the number of octets to encrypt
+     */
+    void encrypt(uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Decrypt n octet(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be decrypted
+     * @param[in]     aLen          the number of octets to decrypt
+     */
+    void decrypt(uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Encrypt one block with the key (ECB).
+     *
+     * @param[in,out] aL  the left half (big-endian word of the block)
+     * @param[in,out] aR  the right half
+     */
+    void encryptBlock(uint32_t& aL, uint32_t& aR) const;
+
+public:
+    /**
+     * Expand the keys of many sessions. The 521 block encryptions of a
+     * schedule depend on each other, so the schedules of LANES sessions
+     * are run in lockstep.
+     *
+     * @param[in] aCiphers  the ciphers of the sessions
+     * @param[in] aKeys     the keys, one per session
+     * @param[in] aLens     the sizes of the keys in bytes
+     * @param[in] aCount    the number of sessions
+     */
+    static void setKeys(Blowfish_CFB64* const* aCiphers, const uint8_t* const* aKeys,
+                        const size_t* aLens, size_t aCount);
+
+    /**
+     * Encrypt the octets of many sessions. The result is the same as
+     * calling encrypt for each job, in any order. A session must not
+     * appear twice in a batch.
+     *
+     * @param[in,out] aJobs   the octets of the sessions
+     * @param[in]     aCount  the number of jobs
+     */
+    static void encrypt(BlowfishJob* aJobs, size_t aCount);
+
+    /**
+     * Decrypt the octets of many sessions. The result is the same as
+     * calling decrypt for each job, in any order. A session must not
+     * appear twice in a batch.
+     *
+     * @param[in,out] aJobs   the octets of the sessions
+     * @param[in]     aCount  the number of jobs
+     */
+    static void decrypt(BlowfishJob* aJobs, size_t aCount);
+
+private:
+    /**
+     * Encrypt one block of LANES sessions, interleaving their rounds.
+     *
+     * @param[in]     aCiphers  the ciphers of the sessions
+     * @param[in,out] aL        the left halves
+     * @param[in,out] aR        the right halves
+     */
+    static void encryptBlocks(const Blowfish_CFB64* const* aCiphers, uint32_t* aL, uint32_t* aR);
+
+    /**
+     * Process the octets of many sessions (see encrypt and decrypt).
+     */
+    static void process(BlowfishJob* aJobs, size_t aCount, bool aEncrypt);
+
+private:
+    uint32_t mP[ROUNDS + 2]; //!< Subkeys
+    uint32_t mS[4][256]; //!< S-boxes
+
+    uint8_t mEnIV[BLOCK_SIZE]; //!< Encryption IV (last ciphertext block)
+    uint8_t mDeIV[BLOCK_SIZE]; //!< Decryption IV (last ciphertext block)
+    uint32_t mEnNum; //!< Position of the next octet in the encryption block
+    uint32_t mDeNum; //!< Position of the next octet in the decryption block
+};
+
+#endif // _BLOWFISH_CFB64_H_
@@ -0,0 +1,65 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "hexdump.h"
+#include "tqhexdump_avx2.h"
+#include "instructionset.h"
+
+using namespace COServer::Security::Cryptography;
+
+TqHexDump::Lines
+HexDump :: GetLines()
+{
+    if (InstructionSet::AVX2())
+        return &TqHexDump_AVX2::formatLines;
+    else
+        return &TqHexDump::formatLines;
+}
+
+void
+HexDump :: CheckOutput(int aLength, array<System::Byte>^ aOut, int aOutOffset)
+{
+    if (aOut == nullptr)
+        throw gcnew System::ArgumentNullException("aOut");
+    if (aOutOffset < 0 || aOutOffset > aOut->Length || aOut->Length - aOutOffset < GetSize(aLength))
+        throw gcnew System::ArgumentException("The buffer is too small for the dump.", "aOut");
+}
+
+int
+HexDump :: GetSize(int aLength)
+{
+    if (aLength < 0)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+
+    return (int)TqHexDump::getSize(aLength);
+}
+
+int
+HexDump :: Format(array<System::Byte>^ aBuf, int aOffset, int aLength,
+                  array<System::Byte>^ aOut, int aOutOffset)
+{
+    if (aBuf == nullptr)
+        throw gcnew System::ArgumentNullException("aBuf");
+    if (aOffset < 0 || aLength < 0 || aOffset > aBuf->Length || aLength > aBuf->Length - aOffset)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+    CheckOutput(aLength, aOut, aOutOffset);
+    if (aLength == 0)
+        return 0;
+
+    pin_ptr<uint8_t> buf = &aBuf[aOffset];
+    pin_ptr<uint8_t> out = &aOut[aOutOffset];
+    return (int)TqHexDump::format(GetLines(), buf, aLength, (char*)out, aOut->Length - aOutOffset);
+}
+
+System::String^
+HexDump :: Dump(array<System::Byte>^ aBuf, int aLength)
+{
+    array<System::Byte>^ out = gcnew array<System::Byte>(GetSize(aLength));
+    int size = Format(aBuf, 0, aLength, out, 0);
+    return System::Text::Encoding::ASCII->GetString(out, 0, size);
+}
@@ -0,0 +1,78 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _HEX_DUMP_H_
+#define _HEX_DUMP_H_
+
+#include "tqhexdump.h"
+
+namespace COServer
+{
+	namespace Security
+	{
+		namespace Cryptography
+		{
+			/// <summary>
+			/// Hexadecimal dump of the packets, for the packet logs.
+			///
+			/// Each line shows 16 bytes in hexadecimal, padded to 60 columns, then the printable bytes and a CRLF.
+			/// The dump is written as ASCII bytes in the buffer of the caller (e.g. the buffer of a log stream), so
+			/// nothing is allocated; the lines are formatted with AVX2 when it is supported.
+			/// </summary>
+			public ref class HexDump abstract sealed
+			{
+			public:
+                /// <summary>
+                /// Number of bytes shown on a line.
+                /// </summary>
+                literal int LineBytes = 16;
+
+            public:
+                /// <summary>
+                /// Gets the size of the dump of a buffer.
+                /// </summary>
+                /// <param name="aLength">The number of bytes to dump.</param>
+                /// <returns>The number of characters of the dump.</returns>
+                static int GetSize(int aLength);
+
+                /// <summary>
+                /// Dumps data in a buffer.
+                /// </summary>
+                /// <param name="aBuf">The buffer to dump.</param>
+                /// <param name="aOffset">The offset of the first byte to dump.</param>
+                /// <param name="aLength">The number of bytes to dump.</param>
+                /// <param name="aOut">The buffer receiving the dump (ASCII characters).</param>
+                /// <param name="aOutOffset">The offset of the dump in the buffer.</param>
+                /// <returns>The number of characters written.</returns>
+                static int Format(array<System::Byte>^ aBuf, int aOffset, int aLength,
+                                  array<System::Byte>^ aOut, int aOutOffset);
+
+                /// <summary>
+                /// Dumps data in a string.
+                /// </summary>
+                /// <param name="aBuf">The buffer to dump.</param>
+                /// <param name="aLength">The number of bytes to dump.</param>
+                /// <returns>The dump.</returns>
+                static System::String^ Dump(array<System::Byte>^ aBuf, int aLength);
+
+            internal:
+                /// <summary>
+                /// Gets the formatter of the lines supported by the processor.
+                /// </summary>
+                static TqHexDump::Lines GetLines();
+
+                /// <summary>
+                /// Checks that a dump of n byte(s) fits in a buffer at an offset.
+                /// </summary>
+                static void CheckOutput(int aLength, array<System::Byte>^ aOut, int aOutOffset);
+			};
+		}
+	}
+}
+
+#endif // _HEX_DUMP_H_
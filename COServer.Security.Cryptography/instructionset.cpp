@@ -7,9 +7,23 @@
  */
 
 #include "instructionset.h"
+#include <string.h> // memset
 
 #pragma unmanaged
 
+/**
+ * Query a function of CPUID (__cpuidex of MSVC).
+ */
+static void
+cpuid(int* aInfo, int aFunction, int aSubFunction)
+{
+#ifdef _WIN32
+    __cpuidex(aInfo, aFunction, aSubFunction);
+#else
+    __cpuid_count(aFunction, aSubFunction, aInfo[0], aInfo[1], aInfo[2], aInfo[3]);
+#endif
+}
+
 const InstructionSet::InstructionSet_Internal* InstructionSet::sInstructions = new InstructionSet::InstructionSet_Internal();
 
 InstructionSet::InstructionSet_Internal :: InstructionSet_Internal()
@@ -21,12 +35,12 @@ InstructionSet::InstructionSet_Internal :: InstructionSet_Internal()
 
     // Calling __cpuid with 0x0 as the function_id argument
     // gets the number of the highest valid function ID.
-    __cpuid(cpui.data(), 0);
+    cpuid(cpui.data(), 0, 0);
     int ids = cpui[0];
 
     for (int i = 0; i <= ids; ++i)
     {
-        __cpuidex(cpui.data(), i, 0);
+        cpuid(cpui.data(), i, 0);
         data_.push_back(cpui);
     }
 
@@ -57,12 +71,12 @@ InstructionSet::InstructionSet_Internal :: InstructionSet_Internal()
 
     // Calling __cpuid with 0x80000000 as the function_id argument
     // gets the number of the highest valid extended ID.
-    __cpuid(cpui.data(), 0x80000000);
-    int extIds = cpui[0];
+    cpuid(cpui.data(), 0x80000000, 0);
+    unsigned int extIds = (unsigned int)cpui[0];
 
-    for (int i = 0x80000000; i <= extIds; ++i)
+    for (unsigned int i = 0x80000000; i <= extIds; ++i)
     {
-        __cpuidex(cpui.data(), i, 0);
+        cpuid(cpui.data(), (int)i, 0);
         extdata_.push_back(cpui);
     }
 
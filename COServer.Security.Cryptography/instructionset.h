@@ -13,7 +13,11 @@
 #include <bitset>
 #include <array>
 #include <string>
+#ifdef _WIN32
 #include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
 
 class InstructionSet
 {
@@ -66,8 +70,11 @@ public:
     static bool AVX512ER() { return sInstructions->f_7_EBX_[27]; }
     static bool AVX512CD() { return sInstructions->f_7_EBX_[28]; }
     static bool SHA() { return sInstructions->f_7_EBX_[29]; }
+    static bool AVX512BW() { return sInstructions->f_7_EBX_[30]; }
+    static bool AVX512VL() { return sInstructions->f_7_EBX_[31]; }
 
     static bool PREFETCHWT1() { return sInstructions->f_7_ECX_[0]; }
+    static bool GFNI() { return sInstructions->f_7_ECX_[8]; }
 
     static bool LAHF() { return sInstructions->f_81_ECX_[0]; }
     static bool LZCNT() { return sInstructions->mIsIntel && sInstructions->f_81_ECX_[5]; }
@@ -0,0 +1,134 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "rc5.h"
+#include "rc5_32.h"
+#include "rc5_32_avx2.h"
+#include "instructionset.h"
+#include <string.h> // memset
+
+using namespace COServer::Security::Cryptography;
+using namespace System::Runtime::InteropServices;
+
+/**
+ * Encrypt or decrypt n block(s) with the kernel supported by the processor.
+ */
+static void
+process(const RC5_32& aKey, uint8_t* aBuf, size_t aLen, bool aEncrypt)
+{
+    if (InstructionSet::AVX2())
+    {
+        if (aEncrypt)
+            RC5_32_AVX2::encrypt(aKey, aBuf, aLen);
+        else
+            RC5_32_AVX2::decrypt(aKey, aBuf, aLen);
+    }
+    else
+    {
+        if (aEncrypt)
+            aKey.encrypt(aBuf, aLen);
+        else
+            aKey.decrypt(aBuf, aLen);
+    }
+}
+
+RC5 :: RC5()
+    : mCipher(new RC5_32(RC5_32::getServerKey()))
+{
+
+}
+
+RC5 :: RC5(array<System::Byte>^ aKey)
+    : mCipher(new RC5_32())
+{
+    if (aKey == nullptr || aKey->Length == 0)
+        throw gcnew System::ArgumentException("The key can't be empty.", "aKey");
+
+    pin_ptr<uint8_t> key = &aKey[0];
+    mCipher->setKey(key, aKey->Length);
+}
+
+RC5 :: ~RC5()
+{
+    this->!RC5();
+}
+
+RC5 :: !RC5()
+{
+    if (mCipher != nullptr)
+    {
+        delete mCipher;
+        mCipher = nullptr;
+    }
+}
+
+void
+RC5 :: Encrypt(array<System::Byte>^% aBuf, int aLength)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("RC5");
+    if (aBuf == nullptr || aLength < 0 || aLength > aBuf->Length || aLength % BlockSize != 0)
+        throw gcnew System::ArgumentException("The length must be a multiple of BlockSize.", "aLength");
+    if (aLength == 0)
+        return;
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    process(*mCipher, buf, aLength, true);
+}
+
+void
+RC5 :: Decrypt(array<System::Byte>^% aBuf, int aLength)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("RC5");
+    if (aBuf == nullptr || aLength < 0 || aLength > aBuf->Length || aLength % BlockSize != 0)
+        throw gcnew System::ArgumentException("The length must be a multiple of BlockSize.", "aLength");
+    if (aLength == 0)
+        return;
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    process(*mCipher, buf, aLength, false);
+}
+
+void
+RC5 :: DecryptAll(array<array<System::Byte>^>^ aPasswords)
+{
+    if (mCipher == nullptr)
+        throw gcnew System::ObjectDisposedException("RC5");
+    if (aPasswords == nullptr)
+        throw gcnew System::ArgumentNullException("aPasswords");
+
+    int total = 0;
+    for (int i = 0; i < aPasswords->Length; ++i)
+    {
+        if (aPasswords[i] == nullptr || aPasswords[i]->Length % BlockSize != 0)
+            throw gcnew System::ArgumentException("The passwords must be multiples of BlockSize.", "aPasswords");
+        total += aPasswords[i]->Length;
+    }
+    if (total == 0)
+        return;
+
+    // the passwords are gathered, so the blocks of different logins share the vectors
+    uint8_t* blocks = new uint8_t[total];
+    try
+    {
+        for (int i = 0, pos = 0; i < aPasswords->Length; pos += aPasswords[i]->Length, ++i)
+            Marshal::Copy(aPasswords[i], 0, System::IntPtr(blocks + pos), aPasswords[i]->Length);
+
+        process(*mCipher, blocks, total, false);
+
+        for (int i = 0, pos = 0; i < aPasswords->Length; pos += aPasswords[i]->Length, ++i)
+            Marshal::Copy(System::IntPtr(blocks + pos), aPasswords[i], 0, aPasswords[i]->Length);
+    }
+    finally
+    {
+        // security purpose only...
+        memset(blocks, 0, total);
+        delete[] blocks;
+    }
+}
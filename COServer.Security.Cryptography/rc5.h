@@ -0,0 +1,89 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _RC5_H_
+#define _RC5_H_
+
+class RC5_32;
+
+namespace COServer
+{
+	namespace Security
+	{
+		namespace Cryptography
+		{
+			/// <summary>
+			/// RC5-32/12 cipher (used by the AccServer to encrypt the password field of the login requests).
+			///
+			/// The blocks are independent, so the passwords of many logins are decrypted at once (across the lanes of
+			/// the vectors when AVX2 is supported), which is faster than decrypting them one after the other.
+			/// </summary>
+			public ref class RC5
+			{
+			public:
+                /// <summary>
+                /// Size in bytes of a block.
+                /// </summary>
+                literal int BlockSize = 8;
+
+                /// <summary>
+                /// Size in bytes of the password field of a login request.
+                /// </summary>
+                literal int PasswordSize = 16;
+
+            public:
+                /// <summary>
+                /// Create a new cipher instance keyed with the seed of the AccServer. The key is expanded once,
+                /// and shared by all the instances.
+                /// </summary>
+                RC5();
+
+                /// <summary>
+                /// Create a new cipher instance keyed with the given key.
+                /// </summary>
+                /// <param name="aKey">The key (at most 255 bytes are used).</param>
+                RC5(array<System::Byte>^ aKey);
+
+                /* destructor */
+                ~RC5();
+
+                /* finalizer */
+                !RC5();
+
+            public:
+                /// <summary>
+                /// Encrypts data with the algorithm.
+                /// </summary>
+                /// <param name="aBuf">A reference to the buffer to encrypt using the cipher.</param>
+                /// <param name="aLength">The number of bytes of the buffer to encrypt, a multiple of BlockSize.</param>
+                void Encrypt(array<System::Byte>^% aBuf, int aLength);
+
+                /// <summary>
+                /// Decrypts data with the algorithm.
+                /// </summary>
+                /// <param name="aBuf">A reference to the buffer to decrypt using the cipher.</param>
+                /// <param name="aLength">The number of bytes of the buffer to decrypt, a multiple of BlockSize.</param>
+                void Decrypt(array<System::Byte>^% aBuf, int aLength);
+
+                /// <summary>
+                /// Decrypts the passwords of many logins (e.g. a burst of login requests).
+                /// </summary>
+                /// <param name="aPasswords">The passwords, each one a multiple of BlockSize bytes.</param>
+                void DecryptAll(array<array<System::Byte>^>^ aPasswords);
+
+            private:
+                /// <summary>
+                /// Native cipher object.
+                /// </summary>
+                RC5_32* mCipher;
+			};
+		}
+	}
+}
+
+#endif // _RC5_H_
@@ -0,0 +1,239 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "rc5_32.h"
+#include <string.h> // memcpy, memset
+#include <assert.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Magic constants of the key schedule: Odd((e - 2) * 2^32) and Odd((phi - 1) * 2^32).
+static const uint32_t RC5_P32 = 0xB7E15163;
+static const uint32_t RC5_Q32 = 0x9E3779B9;
+
+const uint8_t RC5_32::SERVER_SEED[RC5_32::KEY_SIZE] = {
+    0x3C, 0xDC, 0xFE, 0xE8, 0xC4, 0x54, 0xD6, 0x7E,
+    0x16, 0xA6, 0xF8, 0x1A, 0xE8, 0xD0, 0x38, 0xBE };
+
+static inline uint32_t
+rotl32(uint32_t aValue, uint32_t aCount)
+{
+    aCount &= 31;
+    return (aValue << aCount) | (aValue >> ((32 - aCount) & 31));
+}
+
+static inline uint32_t
+rotr32(uint32_t aValue, uint32_t aCount)
+{
+    aCount &= 31;
+    return (aValue >> aCount) | (aValue << ((32 - aCount) & 31));
+}
+
+static inline uint32_t
+load32(const uint8_t* aBuf)
+{
+    return (uint32_t)aBuf[0] | ((uint32_t)aBuf[1] << 8) |
+           ((uint32_t)aBuf[2] << 16) | ((uint32_t)aBuf[3] << 24);
+}
+
+static inline void
+store32(uint8_t* aBuf, uint32_t aValue)
+{
+    aBuf[0] = (uint8_t)(aValue);
+    aBuf[1] = (uint8_t)(aValue >> 8);
+    aBuf[2] = (uint8_t)(aValue >> 16);
+    aBuf[3] = (uint8_t)(aValue >> 24);
+}
+
+RC5_32 :: RC5_32()
+{
+    static const uint8_t ZERO[KEY_SIZE] = { 0 };
+    setKey(ZERO, sizeof(ZERO));
+}
+
+RC5_32 :: ~RC5_32()
+{
+    // security purpose only...
+    memset(mS, 0, sizeof(mS));
+}
+
+void
+RC5_32 :: setKey(const uint8_t* aKey, size_t aLen)
+{
+    if (aLen > MAX_KEY_SIZE)
+        aLen = MAX_KEY_SIZE;
+
+    // the key is loaded in little-endian words (at least one)
+    uint32_t l[(MAX_KEY_SIZE + 3) / 4 + 1] = { 0 };
+    size_t c = aLen == 0 ? 1 : (aLen + 3) / 4;
+    for (size_t i = aLen; i-- != 0; )
+        l[i / 4] = (l[i / 4] << 8) | aKey[i];
+
+    mS[0] = RC5_P32;
+    for (size_t i = 1; i < TABLE_SIZE; ++i)
+        mS[i] = mS[i - 1] + RC5_Q32;
+
+    // the key is mixed three times over the largest of the two arrays
+    uint32_t a = 0, b = 0;
+    size_t n = 3 * (TABLE_SIZE > c ? TABLE_SIZE : c);
+    for (size_t k = 0, i = 0, j = 0; k < n; ++k)
+    {
+        a = mS[i] = rotl32(mS[i] + a + b, 3);
+        b = l[j] = rotl32(l[j] + a + b, a + b);
+        i = (i + 1) % TABLE_SIZE;
+        j = (j + 1) % c;
+    }
+
+    // security purpose only...
+    memset(l, 0, sizeof(l));
+}
+
+void
+RC5_32 :: encryptBlock(uint32_t& aA, uint32_t& aB) const
+{
+    uint32_t a = aA + mS[0];
+    uint32_t b = aB + mS[1];
+
+    for (size_t i = 1; i <= ROUNDS; ++i)
+    {
+        a = rotl32(a ^ b, b) + mS[2 * i];
+        b = rotl32(b ^ a, a) + mS[2 * i + 1];
+    }
+
+    aA = a;
+    aB = b;
+}
+
+void
+RC5_32 :: decryptBlock(uint32_t& aA, uint32_t& aB) const
+{
+    uint32_t a = aA;
+    uint32_t b = aB;
+
+    for (size_t i = ROUNDS; i >= 1; --i)
+    {
+        b = rotr32(b - mS[2 * i + 1], a) ^ a;
+        a = rotr32(a - mS[2 * i], b) ^ b;
+    }
+
+    aA = a - mS[0];
+    aB = b - mS[1];
+}
+
+void
+RC5_32 :: encrypt(uint8_t* aBuf, size_t aLen) const
+{
+    static_assert(LANES == 4, "the lanes are unrolled");
+    assert(aLen % BLOCK_SIZE == 0);
+
+    // the four chains are independent: their rotations overlap
+    for (; aLen >= LANES * BLOCK_SIZE; aBuf += LANES * BLOCK_SIZE, aLen -= LANES * BLOCK_SIZE)
+    {
+        uint32_t a0 = load32(aBuf) + mS[0], b0 = load32(aBuf + 4) + mS[1];
+        uint32_t a1 = load32(aBuf + 8) + mS[0], b1 = load32(aBuf + 12) + mS[1];
+        uint32_t a2 = load32(aBuf + 16) + mS[0], b2 = load32(aBuf + 20) + mS[1];
+        uint32_t a3 = load32(aBuf + 24) + mS[0], b3 = load32(aBuf + 28) + mS[1];
+
+        for (size_t i = 1; i <= ROUNDS; ++i)
+        {
+            a0 = rotl32(a0 ^ b0, b0) + mS[2 * i];
+            a1 = rotl32(a1 ^ b1, b1) + mS[2 * i];
+            a2 = rotl32(a2 ^ b2, b2) + mS[2 * i];
+            a3 = rotl32(a3 ^ b3, b3) + mS[2 * i];
+
+            b0 = rotl32(b0 ^ a0, a0) + mS[2 * i + 1];
+            b1 = rotl32(b1 ^ a1, a1) + mS[2 * i + 1];
+            b2 = rotl32(b2 ^ a2, a2) + mS[2 * i + 1];
+            b3 = rotl32(b3 ^ a3, a3) + mS[2 * i + 1];
+        }
+
+        store32(aBuf, a0); store32(aBuf + 4, b0);
+        store32(aBuf + 8, a1); store32(aBuf + 12, b1);
+        store32(aBuf + 16, a2); store32(aBuf + 20, b2);
+        store32(aBuf + 24, a3); store32(aBuf + 28, b3);
+    }
+
+    for (; aLen >= BLOCK_SIZE; aBuf += BLOCK_SIZE, aLen -= BLOCK_SIZE)
+    {
+        uint32_t a = load32(aBuf), b = load32(aBuf + 4);
+        encryptBlock(a, b);
+        store32(aBuf, a);
+        store32(aBuf + 4, b);
+    }
+}
+
+void
+RC5_32 :: decrypt(uint8_t* aBuf, size_t aLen) const
+{
+    static_assert(LANES == 4, "the lanes are unrolled");
+    assert(aLen % BLOCK_SIZE == 0);
+
+    // the four chains are independent: their rotations overlap
+    for (; aLen >= LANES * BLOCK_SIZE; aBuf += LANES * BLOCK_SIZE, aLen -= LANES * BLOCK_SIZE)
+    {
+        uint32_t a0 = load32(aBuf), b0 = load32(aBuf + 4);
+        uint32_t a1 = load32(aBuf + 8), b1 = load32(aBuf + 12);
+        uint32_t a2 = load32(aBuf + 16), b2 = load32(aBuf + 20);
+        uint32_t a3 = load32(aBuf + 24), b3 = load32(aBuf + 28);
+
+        for (size_t i = ROUNDS; i >= 1; --i)
+        {
+            b0 = rotr32(b0 - mS[2 * i + 1], a0) ^ a0;
+            b1 = rotr32(b1 - mS[2 * i + 1], a1) ^ a1;
+            b2 = rotr32(b2 - mS[2 * i + 1], a2) ^ a2;
+            b3 = rotr32(b3 - mS[2 * i + 1], a3) ^ a3;
+
+            a0 = rotr32(a0 - mS[2 * i], b0) ^ b0;
+            a1 = rotr32(a1 - mS[2 * i], b1) ^ b1;
+            a2 = rotr32(a2 - mS[2 * i], b2) ^ b2;
+            a3 = rotr32(a3 - mS[2 * i], b3) ^ b3;
+        }
+
+        store32(aBuf, a0 - mS[0]); store32(aBuf + 4, b0 - mS[1]);
+        store32(aBuf + 8, a1 - mS[0]); store32(aBuf + 12, b1 - mS[1]);
+        store32(aBuf + 16, a2 - mS[0]); store32(aBuf + 20, b2 - mS[1]);
+        store32(aBuf + 24, a3 - mS[0]); store32(aBuf + 28, b3 - mS[1]);
+    }
+
+    for (; aLen >= BLOCK_SIZE; aBuf += BLOCK_SIZE, aLen -= BLOCK_SIZE)
+    {
+        uint32_t a = load32(aBuf), b = load32(aBuf + 4);
+        decryptBlock(a, b);
+        store32(aBuf, a);
+        store32(aBuf + 4, b);
+    }
+}
+
+const RC5_32&
+RC5_32 :: getServerKey()
+{
+    static RC5_32* volatile sServerKey = nullptr;
+
+    RC5_32* key = sServerKey;
+    if (key == nullptr)
+    {
+        key = new RC5_32();
+        key->setKey(SERVER_SEED, sizeof(SERVER_SEED));
+
+        // the first key published wins, the others are dropped
+        #ifdef _WIN32
+        RC5_32* published = (RC5_32*)InterlockedCompareExchangePointer(
+            (PVOID volatile*)&sServerKey, key, nullptr);
+        #else
+        RC5_32* published = __sync_val_compare_and_swap(&sServerKey, (RC5_32*)nullptr, key);
+        #endif
+        if (published != nullptr)
+        {
+            delete key;
+            key = published;
+        }
+    }
+
+    return *key;
+}
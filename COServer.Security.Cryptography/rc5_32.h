@@ -0,0 +1,108 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _RC5_32_H_
+#define _RC5_32_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * RC5-32/12 cipher (32-bit words, 12 rounds), used by the AccServer to
+ * encrypt the password field of the login requests. The blocks are
+ * processed independently (ECB); a password of 16 octets is two blocks.
+ *
+ * The buffer functions process many blocks, e.g. the passwords of a burst
+ * of logins gathered in one buffer: the rounds of LANES blocks are
+ * interleaved, so their chains of rotations overlap (see RC5_32_AVX2 for
+ * the vectorized version).
+ */
+class RC5_32
+{
+public:
+    /** The number of rounds. */
+    static const size_t ROUNDS = 12;
+    /** The block size in bytes. */
+    static const size_t BLOCK_SIZE = 8;
+    /** The size of the key of the AccServer in bytes. */
+    static const size_t KEY_SIZE = 16;
+    /** The maximum key size in bytes. */
+    static const size_t MAX_KEY_SIZE = 255;
+    /** The number of words of the expanded key. */
+    static const size_t TABLE_SIZE = 2 * (ROUNDS + 1);
+    /** The number of blocks interleaved by the buffer functions. */
+    static const size_t LANES = 4;
+
+    /** The key (seed) of the AccServer. */
+    static const uint8_t SERVER_SEED[KEY_SIZE];
+
+public:
+    /**
+     * Create a new instance of the cipher where the key is zero-filled.
+     */
+    RC5_32();
+
+    /* destructor */
+    ~RC5_32();
+
+public:
+    /**
+     * Expand the key.
+     *
+     * @param[in] aKey  the key
+     * @param[in] aLen  the size of the key in bytes (at most MAX_KEY_SIZE are used)
+     */
+    void setKey(const uint8_t* aKey, size_t aLen);
+
+    /**
+     * Encrypt n block(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be encrypted
+     * @param[in]     aLen          the number of octets to encrypt (a multiple of BLOCK_SIZE)
+     */
+    void encrypt(uint8_t* aBuf, size_t aLen) const;
+
+    /**
+     * Decrypt n block(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be decrypted
+     * @param[in]     aLen          the number of octets to decrypt (a multiple of BLOCK_SIZE)
+     */
+    void decrypt(uint8_t* aBuf, size_t aLen) const;
+
+    /**
+     * Encrypt one block with the key.
+     *
+     * @param[in,out] aA  the first word (little-endian word of the block)
+     * @param[in,out] aB  the second word
+     */
+    void encryptBlock(uint32_t& aA, uint32_t& aB) const;
+
+    /**
+     * Decrypt one block with the key.
+     *
+     * @param[in,out] aA  the first word (little-endian word of the block)
+     * @param[in,out] aB  the second word
+     */
+    void decryptBlock(uint32_t& aA, uint32_t& aB) const;
+
+    /** Get the expanded key (TABLE_SIZE words). */
+    const uint32_t* getTable() const { return mS; }
+
+public:
+    /**
+     * Get the cipher keyed with the seed of the AccServer. The key is
+     * expanded once, by the first caller, and shared by all the logins.
+     */
+    static const RC5_32& getServerKey();
+
+private:
+    uint32_t mS[TABLE_SIZE]; //!< Expanded key
+};
+
+#endif // _RC5_32_H_
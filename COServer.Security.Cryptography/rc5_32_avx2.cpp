@@ -0,0 +1,120 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "rc5_32_avx2.h"
+#include <immintrin.h>
+#include <assert.h>
+
+// GCC & Clang spell the forced inlining of MSVC differently.
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
+static __forceinline __m256i
+rotl32(__m256i aValue, __m256i aCount)
+{
+    // a count of 32 shifts everything out, so a rotation by 0 is exact
+    __m256i count = _mm256_and_si256(aCount, _mm256_set1_epi32(31));
+    return _mm256_or_si256(_mm256_sllv_epi32(aValue, count),
+                           _mm256_srlv_epi32(aValue, _mm256_sub_epi32(_mm256_set1_epi32(32), count)));
+}
+
+static __forceinline __m256i
+rotr32(__m256i aValue, __m256i aCount)
+{
+    __m256i count = _mm256_and_si256(aCount, _mm256_set1_epi32(31));
+    return _mm256_or_si256(_mm256_srlv_epi32(aValue, count),
+                           _mm256_sllv_epi32(aValue, _mm256_sub_epi32(_mm256_set1_epi32(32), count)));
+}
+
+/**
+ * Load LANES blocks, the first words in aA and the second ones in aB.
+ */
+static __forceinline void
+loadBlocks(const uint8_t* aBuf, __m256i& aA, __m256i& aB)
+{
+    // a0 b0 a1 b1 a2 b2 a3 b3 -> a0 a1 a2 a3 b0 b1 b2 b3
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i lo = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)aBuf), split);
+    __m256i hi = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(aBuf + 32)), split);
+
+    aA = _mm256_permute2x128_si256(lo, hi, 0x20);
+    aB = _mm256_permute2x128_si256(lo, hi, 0x31);
+}
+
+/**
+ * Store LANES blocks (see loadBlocks).
+ */
+static __forceinline void
+storeBlocks(uint8_t* aBuf, __m256i aA, __m256i aB)
+{
+    const __m256i merge = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256i lo = _mm256_permute2x128_si256(aA, aB, 0x20);
+    __m256i hi = _mm256_permute2x128_si256(aA, aB, 0x31);
+
+    _mm256_storeu_si256((__m256i*)aBuf, _mm256_permutevar8x32_epi32(lo, merge));
+    _mm256_storeu_si256((__m256i*)(aBuf + 32), _mm256_permutevar8x32_epi32(hi, merge));
+}
+
+void
+RC5_32_AVX2 :: encrypt(const RC5_32& aKey, uint8_t* aBuf, size_t aLen)
+{
+    assert(aLen % RC5_32::BLOCK_SIZE == 0);
+
+    const uint32_t* s = aKey.getTable();
+    const size_t stride = LANES * RC5_32::BLOCK_SIZE;
+
+    for (; aLen >= stride; aBuf += stride, aLen -= stride)
+    {
+        __m256i a, b;
+        loadBlocks(aBuf, a, b);
+
+        a = _mm256_add_epi32(a, _mm256_set1_epi32((int)s[0]));
+        b = _mm256_add_epi32(b, _mm256_set1_epi32((int)s[1]));
+
+        for (size_t i = 1; i <= RC5_32::ROUNDS; ++i)
+        {
+            a = _mm256_add_epi32(rotl32(_mm256_xor_si256(a, b), b), _mm256_set1_epi32((int)s[2 * i]));
+            b = _mm256_add_epi32(rotl32(_mm256_xor_si256(b, a), a), _mm256_set1_epi32((int)s[2 * i + 1]));
+        }
+
+        storeBlocks(aBuf, a, b);
+    }
+
+    if (aLen != 0)
+        aKey.encrypt(aBuf, aLen);
+}
+
+void
+RC5_32_AVX2 :: decrypt(const RC5_32& aKey, uint8_t* aBuf, size_t aLen)
+{
+    assert(aLen % RC5_32::BLOCK_SIZE == 0);
+
+    const uint32_t* s = aKey.getTable();
+    const size_t stride = LANES * RC5_32::BLOCK_SIZE;
+
+    for (; aLen >= stride; aBuf += stride, aLen -= stride)
+    {
+        __m256i a, b;
+        loadBlocks(aBuf, a, b);
+
+        for (size_t i = RC5_32::ROUNDS; i >= 1; --i)
+        {
+            b = _mm256_xor_si256(rotr32(_mm256_sub_epi32(b, _mm256_set1_epi32((int)s[2 * i + 1])), a), a);
+            a = _mm256_xor_si256(rotr32(_mm256_sub_epi32(a, _mm256_set1_epi32((int)s[2 * i])), b), b);
+        }
+
+        a = _mm256_sub_epi32(a, _mm256_set1_epi32((int)s[0]));
+        b = _mm256_sub_epi32(b, _mm256_set1_epi32((int)s[1]));
+
+        storeBlocks(aBuf, a, b);
+    }
+
+    if (aLen != 0)
+        aKey.decrypt(aBuf, aLen);
+}
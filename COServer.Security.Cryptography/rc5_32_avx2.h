@@ -0,0 +1,48 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _RC5_32_AVX2_H_
+#define _RC5_32_AVX2_H_
+
+#include "rc5_32.h"
+
+/**
+ * RC5-32/12 cipher using AVX2 (see RC5_32).
+ *
+ * Each lane of the vectors holds a word of a different block, so the
+ * blocks of LANES passwords are processed at once; the rotations by the
+ * data are the variable shifts of AVX2. The blocks past the last group of
+ * LANES are processed by the scalar functions.
+ */
+class RC5_32_AVX2
+{
+public:
+    /** The number of blocks processed at once (eight 32-bit lanes). */
+    static const size_t LANES = 8;
+
+public:
+    /**
+     * Encrypt n block(s) with a key.
+     *
+     * @param[in]     aKey  the expanded key
+     * @param[in,out] aBuf  the buffer that will be encrypted
+     * @param[in]     aLen  the number of octets to encrypt (a multiple of RC5_32::BLOCK_SIZE)
+     */
+    static void encrypt(const RC5_32& aKey, uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Decrypt n block(s) with a key.
+     *
+     * @param[in]     aKey  the expanded key
+     * @param[in,out] aBuf  the buffer that will be decrypted
+     * @param[in]     aLen  the number of octets to decrypt (a multiple of RC5_32::BLOCK_SIZE)
+     */
+    static void decrypt(const RC5_32& aKey, uint8_t* aBuf, size_t aLen);
+};
+
+#endif // _RC5_32_AVX2_H_
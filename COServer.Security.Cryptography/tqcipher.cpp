@@ -7,17 +7,46 @@
  */
 
 #include "tqcipher.h"
+#include "tqcipher_avx512.h"
+#include "tqcipher_gfni.h"
 #include "tqcipher_avx2.h"
 #include "tqcipher_sse2.h"
 #include "tqcipher_std.h"
+#include "tqcipher_state.h"
+#include "tqcipher_stream.h"
+#include "tqresync.h"
+#include "tqtap.h"
 #include "instructionset.h"
+#include "tqnuma.h"
 
 using namespace COServer::Security::Cryptography;
 
+/**
+ * Check if the AVX2 and GFNI kernels are built and supported by the processor.
+ */
+static bool
+isGfniSupported()
+{
+    return TQ_CIPHER_GFNI && InstructionSet::AVX2() && InstructionSet::GFNI();
+}
+
+/**
+ * Check if the AVX-512 and GFNI kernels are built and supported by the processor.
+ */
+static bool
+isAvx512Supported()
+{
+    return TQ_CIPHER_GFNI && InstructionSet::AVX512F() && InstructionSet::AVX512BW() && InstructionSet::GFNI();
+}
+
 System::String^
 TqCipher :: GetImplInfo()
 {
-    if (InstructionSet::AVX2())
+    if (isAvx512Supported())
+        return "TqCipher (AVX-512 + GFNI)";
+    else if (isGfniSupported())
+        return "TqCipher (AVX2 + GFNI)";
+    else if (InstructionSet::AVX2())
         return "TqCipher (AVX2)";
     else if (InstructionSet::SSE2())
         return "TqCipher (SSE2)";
@@ -28,7 +57,11 @@ TqCipher :: GetImplInfo()
 TqCipher::ImplType
 TqCipher :: GetImplType()
 {
-	if (InstructionSet::AVX2())
+	if (isAvx512Supported())
+		return ImplType::AVX512;
+	else if (isGfniSupported())
+		return ImplType::GFNI;
+	else if (InstructionSet::AVX2())
 		return ImplType::AVX2;
 	else if (InstructionSet::SSE2())
 		return ImplType::SSE2;
@@ -39,47 +72,87 @@ TqCipher :: GetImplType()
 TqCipher :: TqCipher()
     : mCipher(nullptr)
 {
-	if (InstructionSet::AVX2())
-		mCipher = new TqCipher_AVX2();
-	else if (InstructionSet::SSE2())
-		mCipher = new TqCipher_SSE2();
-	else
-        mCipher = new TqCipher_Std();
-
+    mCipher = CreateCipher(GetImplType());
     mCipher->generateKey(TqCipher::P, TqCipher::G);
 }
 
 TqCipher :: TqCipher(TqCipher::ImplType aType)
 	: mCipher(nullptr)
+{
+    mCipher = CreateCipher(aType);
+	mCipher->generateKey(TqCipher::P, TqCipher::G);
+}
+
+TqCipher :: TqCipher(TqCipherContext^ aContext)
+    : mCipher(nullptr)
+{
+    if (aContext == nullptr)
+        throw gcnew System::ArgumentNullException("aContext");
+    if (aContext->mContext == nullptr)
+        throw gcnew System::ObjectDisposedException("aContext");
+
+    mCipher = CreateCipher(GetImplType());
+    mCipher->setKeyContext(aContext->mContext);
+}
+
+TqCipher :: TqCipher(TqCipherContext^ aContext, TqCipher::ImplType aType)
+    : mCipher(nullptr)
+{
+    if (aContext == nullptr)
+        throw gcnew System::ArgumentNullException("aContext");
+    if (aContext->mContext == nullptr)
+        throw gcnew System::ObjectDisposedException("aContext");
+
+    mCipher = CreateCipher(aType);
+    mCipher->setKeyContext(aContext->mContext);
+}
+
+TqCipher_Base*
+TqCipher :: CreateCipher(TqCipher::ImplType aType)
 {
 	switch (aType)
 	{
+#if TQ_CIPHER_GFNI
+		case ImplType::AVX512:
+		{
+			if (!isAvx512Supported())
+				throw gcnew System::NotSupportedException("AVX-512 (BW) and GFNI instruction sets are not supported on the processor.");
+
+			return new TqCipher_AVX512();
+		}
+		case ImplType::GFNI:
+		{
+			if (!isGfniSupported())
+				throw gcnew System::NotSupportedException("AVX2 and GFNI instruction sets are not supported on the processor.");
+
+			return new TqCipher_GFNI();
+		}
+#else
+		case ImplType::AVX512:
+		case ImplType::GFNI:
+			throw gcnew System::NotSupportedException("GFNI kernels require a newer compiler (Visual Studio 2019 or later).");
+#endif
 	case ImplType::AVX2:
 		{
 			if (!InstructionSet::AVX2())
 				throw gcnew System::NotSupportedException("AVX2 instruction set is not supported on the processor.");
 
-			mCipher = new TqCipher_AVX2();
-			break;
+			return new TqCipher_AVX2();
 		}
 		case ImplType::SSE2:
 		{
 			if (!InstructionSet::SSE2())
 				throw gcnew System::NotSupportedException("SSE2 instruction set is not supported on the processor.");
 
-			mCipher = new TqCipher_SSE2();
-			break;
+			return new TqCipher_SSE2();
 		}
 		case ImplType::Standard:
 		{
-			mCipher = new TqCipher_Std();
-			break;
+			return new TqCipher_Std();
 		}
 		default:
 			throw gcnew System::NotImplementedException("The specified implementation is unknown.");
 	}
-
-	mCipher->generateKey(TqCipher::P, TqCipher::G);
 }
 
 TqCipher :: ~TqCipher()
@@ -108,8 +181,319 @@ TqCipher :: Decrypt(array<System::Byte>^% aBuf, int aLength)
     mCipher->decrypt(buf, aLength);
 }
 
+/**
+ * Get the region of a pinned circular buffer.
+ */
+static TqRingBuffer
+getRing(uint8_t* aBase, int aCapacity, int aHead, int aLength)
+{
+    if (aHead < 0 || aHead >= aCapacity)
+        throw gcnew System::ArgumentOutOfRangeException("aHead");
+    if (aLength < 0 || aLength > aCapacity)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+
+    TqRingBuffer ring = { aBase, (size_t)aCapacity, (size_t)aHead, (size_t)aLength };
+    return ring;
+}
+
+void
+TqCipher :: Encrypt(array<System::Byte>^% aRing, int aHead, int aLength)
+{
+    pin_ptr<uint8_t> base = &aRing[0];
+    TqRingBuffer ring = getRing(base, aRing->Length, aHead, aLength);
+    if (ring.length != 0)
+        mCipher->encrypt(ring);
+}
+
+void
+TqCipher :: Decrypt(array<System::Byte>^% aRing, int aHead, int aLength)
+{
+    pin_ptr<uint8_t> base = &aRing[0];
+    TqRingBuffer ring = getRing(base, aRing->Length, aHead, aLength);
+    if (ring.length != 0)
+        mCipher->decrypt(ring);
+}
+
+void
+TqCipher :: Transcrypt(TqCipher^ aTarget, array<System::Byte>^ aSrc, array<System::Byte>^% aDest, int aLength)
+{
+    if (aTarget == nullptr)
+        throw gcnew System::ArgumentNullException("aTarget");
+    if (aSrc == nullptr)
+        throw gcnew System::ArgumentNullException("aSrc");
+    if (aDest == nullptr)
+        throw gcnew System::ArgumentNullException("aDest");
+    if (aLength < 0 || aLength > aSrc->Length || aLength > aDest->Length)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+    if (aLength == 0)
+        return;
+
+    pin_ptr<uint8_t> src = &aSrc[0];
+    pin_ptr<uint8_t> dest = &aDest[0];
+    mCipher->transcrypt(*aTarget->mCipher, src, dest, aLength);
+}
+
 void
 TqCipher :: ResetCounters()
 {
     mCipher->resetCounters();
-}
\ No newline at end of file
+}
+
+void
+TqCipher :: BindToCurrentNode()
+{
+    mCipher->bindToNode(TqNuma::getCurrentNode());
+}
+
+/**
+ * Check that a value is a 16-bit field of a packet header.
+ */
+static uint16_t
+getField(int aValue, System::String^ aName)
+{
+    if (aValue < 0 || aValue > UINT16_MAX)
+        throw gcnew System::ArgumentOutOfRangeException(aName);
+
+    return (uint16_t)aValue;
+}
+
+array<int>^
+TqCipher :: FindDecryptionCounters(array<System::Byte>^ aWindow, int aLength, int aMinLength, int aMaxLength, int aMinType, int aMaxType)
+{
+    if (aWindow == nullptr)
+        throw gcnew System::ArgumentNullException("aWindow");
+    if (aLength < (int)TqResync::HEADER_SIZE || aLength > aWindow->Length)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+
+    TqResyncFilter filter =
+    {
+        getField(aMinLength, "aMinLength"), getField(aMaxLength, "aMaxLength"),
+        getField(aMinType, "aMinType"), getField(aMaxType, "aMaxType")
+    };
+
+    TqCipherStream* decryptor = mCipher->createDecryptor();
+    TqResyncCandidate* candidates = new TqResyncCandidate[MaxCandidates];
+    size_t found = 0;
+    {
+        pin_ptr<uint8_t> window = &aWindow[0];
+        found = decryptor->findCounters(window, aLength, filter, nullptr, nullptr, candidates, MaxCandidates, 0);
+    }
+    delete decryptor;
+
+    if (found > MaxCandidates)
+        found = MaxCandidates;
+
+    array<int>^ result = gcnew array<int>((int)found);
+    for (size_t i = 0; i < found; ++i)
+        result[(int)i] = candidates[i].counter | (candidates[i].key != 0 ? AltKeyCandidate : 0);
+    delete[] candidates;
+
+    return result;
+}
+
+void
+TqCipher :: Resync(int aCandidate)
+{
+    if ((aCandidate & ~(AltKeyCandidate | UINT16_MAX)) != 0)
+        throw gcnew System::ArgumentOutOfRangeException("aCandidate");
+
+    TqCipherState state;
+    mCipher->saveState(state);
+
+    // a candidate of the base key switches back from the alternate key
+    bool altKey = (aCandidate & AltKeyCandidate) != 0;
+    if (altKey && (state.flags & TqCipherState::FLAG_ALT_KEY) == 0)
+        throw gcnew System::ArgumentException("The cipher doesn't use an alternate key.", "aCandidate");
+    if (!altKey)
+        state.flags = (uint8_t)(state.flags & ~TqCipherState::FLAG_ALT_KEY);
+
+    state.deCounter = (uint16_t)aCandidate;
+    mCipher->restoreState(state);
+}
+
+void
+TqCipher :: SetTap(TqCipherTap^ aTap, System::UInt32 aSession)
+{
+    if (aTap != nullptr && aTap->mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    // the managed tap is referenced until it is detached, so it outlives the session
+    mCipher->setTap(aTap != nullptr ? aTap->mTap : nullptr, aSession);
+    mTap = aTap;
+}
+
+TqCipherDirection^
+TqCipher :: CreateEncryptor()
+{
+    return gcnew TqCipherDirection(mCipher->createEncryptor());
+}
+
+TqCipherDirection^
+TqCipher :: CreateDecryptor()
+{
+    return gcnew TqCipherDirection(mCipher->createDecryptor());
+}
+
+array<System::Byte>^
+TqCipher :: ExportState()
+{
+    TqCipherState state;
+    mCipher->saveState(state);
+
+    array<System::Byte>^ data = gcnew array<System::Byte>(StateSize);
+    pin_ptr<uint8_t> buf = &data[0];
+    state.write(buf);
+
+    return data;
+}
+
+void
+TqCipher :: ImportState(array<System::Byte>^ aState)
+{
+    if (aState == nullptr)
+        throw gcnew System::ArgumentNullException("aState");
+    if (aState->Length != StateSize)
+        throw gcnew System::ArgumentException("The state must be exactly StateSize bytes.", "aState");
+
+    TqCipherState state;
+    pin_ptr<uint8_t> buf = &aState[0];
+    if (!state.read(buf))
+        throw gcnew System::ArgumentException("The state has an unknown format.", "aState");
+    if (!mCipher->restoreState(state))
+        throw gcnew System::ArgumentException("The state was exported with another base key.", "aState");
+}
+
+array<System::Byte>^
+TqCipher :: ExportStates(array<TqCipher^>^ aCiphers)
+{
+    if (aCiphers == nullptr)
+        throw gcnew System::ArgumentNullException("aCiphers");
+
+    array<System::Byte>^ data = gcnew array<System::Byte>(aCiphers->Length * StateSize);
+    if (aCiphers->Length == 0)
+        return data;
+
+    pin_ptr<uint8_t> buf = &data[0];
+    TqCipherState state;
+    for (int i = 0; i < aCiphers->Length; ++i)
+    {
+        aCiphers[i]->mCipher->saveState(state);
+        state.write(buf + i * StateSize);
+    }
+
+    return data;
+}
+
+void
+TqCipher :: ImportStates(array<TqCipher^>^ aCiphers, array<System::Byte>^ aStates)
+{
+    if (aCiphers == nullptr)
+        throw gcnew System::ArgumentNullException("aCiphers");
+    if (aStates == nullptr)
+        throw gcnew System::ArgumentNullException("aStates");
+    if (aStates->Length != aCiphers->Length * StateSize)
+        throw gcnew System::ArgumentException("There must be exactly StateSize bytes per cipher.", "aStates");
+    if (aCiphers->Length == 0)
+        return;
+
+    pin_ptr<uint8_t> buf = &aStates[0];
+    TqCipherState state;
+    for (int i = 0; i < aCiphers->Length; ++i)
+    {
+        if (!state.read(buf + i * StateSize))
+            throw gcnew System::ArgumentException("The state has an unknown format.", "aStates");
+        if (!aCiphers[i]->mCipher->restoreState(state))
+            throw gcnew System::ArgumentException("The state was exported with another base key.", "aStates");
+    }
+}
+
+void
+TqCipher :: Broadcast(array<System::Byte>^ aBuf, int aLength, array<TqCipher^>^ aCiphers, array<array<System::Byte>^>^ aOuts)
+{
+    if (aBuf == nullptr)
+        throw gcnew System::ArgumentNullException("aBuf");
+    if (aCiphers == nullptr)
+        throw gcnew System::ArgumentNullException("aCiphers");
+    if (aOuts == nullptr)
+        throw gcnew System::ArgumentNullException("aOuts");
+    if (aOuts->Length != aCiphers->Length)
+        throw gcnew System::ArgumentException("There must be exactly one output buffer per cipher.", "aOuts");
+    if (aLength < 0 || aLength > aBuf->Length)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+    if (aLength == 0 || aCiphers->Length == 0)
+        return;
+
+    int count = aCiphers->Length;
+    array<System::Runtime::InteropServices::GCHandle>^ handles =
+        gcnew array<System::Runtime::InteropServices::GCHandle>(count);
+    TqBroadcastTarget* targets = new TqBroadcastTarget[count];
+
+    try
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (aCiphers[i] == nullptr)
+                throw gcnew System::ArgumentException("The ciphers can't be null.", "aCiphers");
+            if (aOuts[i] == nullptr || aOuts[i]->Length < aLength)
+                throw gcnew System::ArgumentException("The output buffers must hold aLength bytes.", "aOuts");
+
+            handles[i] = System::Runtime::InteropServices::GCHandle::Alloc(
+                aOuts[i], System::Runtime::InteropServices::GCHandleType::Pinned);
+            targets[i].cipher = aCiphers[i]->mCipher;
+            targets[i].out = (uint8_t*)handles[i].AddrOfPinnedObject().ToPointer();
+        }
+
+        pin_ptr<uint8_t> buf = &aBuf[0];
+        switch (GetImplType())
+        {
+#if TQ_CIPHER_GFNI
+            case ImplType::AVX512:
+                TqCipher_AVX512::broadcast(buf, aLength, targets, count);
+                break;
+            case ImplType::GFNI:
+                TqCipher_GFNI::broadcast(buf, aLength, targets, count);
+                break;
+#endif
+            case ImplType::AVX2:
+                TqCipher_AVX2::broadcast(buf, aLength, targets, count);
+                break;
+            case ImplType::SSE2:
+                TqCipher_SSE2::broadcast(buf, aLength, targets, count);
+                break;
+            default:
+                TqCipher_Std::broadcast(buf, aLength, targets, count);
+                break;
+        }
+    }
+    finally
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (handles[i].IsAllocated)
+                handles[i].Free();
+        }
+        delete[] targets;
+    }
+}
+
+void
+TqCipher :: Patch(array<System::Byte>^ aBuf, int aOffset, array<System::Byte>^ aOld, array<System::Byte>^ aNew, int aLength)
+{
+    if (aBuf == nullptr)
+        throw gcnew System::ArgumentNullException("aBuf");
+    if (aOld == nullptr)
+        throw gcnew System::ArgumentNullException("aOld");
+    if (aNew == nullptr)
+        throw gcnew System::ArgumentNullException("aNew");
+    if (aLength < 0 || aLength > aOld->Length || aLength > aNew->Length)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+    if (aOffset < 0 || aOffset > aBuf->Length - aLength)
+        throw gcnew System::ArgumentOutOfRangeException("aOffset");
+    if (aLength == 0)
+        return;
+
+    pin_ptr<uint8_t> buf = &aBuf[aOffset];
+    pin_ptr<uint8_t> oldValues = &aOld[0];
+    pin_ptr<uint8_t> newValues = &aNew[0];
+    TqCipher_Std::patch(buf, oldValues, newValues, aLength);
+}
@@ -9,6 +9,10 @@
 #ifndef _TQ_CIPHER_H_
 #define _TQ_CIPHER_H_
 
+#include "tqciphercontext.h"
+#include "tqcipherdirection.h"
+#include "tqciphertap.h"
+
 class TqCipher_Base;
 
 namespace COServer
@@ -27,15 +31,32 @@ namespace COServer
 				/// Integer constant used to generate the initial key.
                 ///
                 /// This constant can be changed if the server does not use the original keys.
+                /// When the process hosts realms with different keys, use a TqCipherContext instead.
 				/// </summary>
 				static System::UInt32 P = 0x13FA0F9D;
 				/// <summary>
 				/// Integer constant used to generate the initial key.
                 ///
                 /// This constant can be changed if the server does not use the original keys.
+                /// When the process hosts realms with different keys, use a TqCipherContext instead.
 				/// </summary>
 				static System::UInt32 G = 0x6D5C7962;
 
+                /// <summary>
+                /// Size in bytes of a serialized cipher state.
+                /// </summary>
+                literal int StateSize = 16;
+
+                /// <summary>
+                /// Flag of the candidates of FindDecryptionCounters found with the alternate key.
+                /// </summary>
+                literal int AltKeyCandidate = 0x10000;
+
+                /// <summary>
+                /// Maximum number of candidates returned by FindDecryptionCounters.
+                /// </summary>
+                literal int MaxCandidates = 4096;
+
 			public:
                 /// <summary>
                 /// Type of the implementation of the cipher.
@@ -53,7 +74,15 @@ namespace COServer
                     /// <summary>
                     /// Implementation based on vectorized arithmetic, using the AVX and AVX2 instruction sets.
                     /// </summary>
-					AVX2
+					AVX2,
+                    /// <summary>
+                    /// Implementation based on vectorized arithmetic, using the AVX2 and GFNI instruction sets.
+                    /// </summary>
+					GFNI,
+                    /// <summary>
+                    /// Implementation based on vectorized arithmetic, using the AVX-512 (BW) and GFNI instruction sets.
+                    /// </summary>
+					AVX512
 				};
 
             public:
@@ -83,6 +112,21 @@ namespace COServer
                 /// <param name="aType">The type of the implementation to use for this instance.</param>
 				TqCipher(ImplType aType);
 
+                /// <summary>
+                /// Create a new cipher instance using the key of a shared context.
+                /// </summary>
+                /// <param name="aContext">The context of the key.</param>
+                TqCipher(TqCipherContext^ aContext);
+
+                /// <summary>
+                /// Create a new cipher instance using the key of a shared context.
+                ///
+                /// It will try to use the specified implementation.
+                /// </summary>
+                /// <param name="aContext">The context of the key.</param>
+                /// <param name="aType">The type of the implementation to use for this instance.</param>
+                TqCipher(TqCipherContext^ aContext, ImplType aType);
+
                 /* destructor */
                 ~TqCipher();
 
@@ -109,16 +153,162 @@ namespace COServer
                 /// <param name="aLength">The number of bytes of the buffer to decrypt using the cipher.</param>
                 void Decrypt(array<System::Byte>^% aBuf, int aLength);
 
+                /// <summary>
+                /// Encrypts data stored in a circular buffer (e.g. the receive buffer of a socket), starting at the head and
+                /// wrapping past the end of the buffer. The data is processed as one stream, without being linearized.
+                /// </summary>
+                /// <param name="aRing">A reference to the circular buffer.</param>
+                /// <param name="aHead">The index of the first byte to encrypt.</param>
+                /// <param name="aLength">The number of bytes to encrypt (at most the length of the buffer).</param>
+                void Encrypt(array<System::Byte>^% aRing, int aHead, int aLength);
+
+                /// <summary>
+                /// Decrypts data stored in a circular buffer (e.g. the receive buffer of a socket), starting at the head and
+                /// wrapping past the end of the buffer. The data is processed as one stream, without being linearized.
+                /// </summary>
+                /// <param name="aRing">A reference to the circular buffer.</param>
+                /// <param name="aHead">The index of the first byte to decrypt.</param>
+                /// <param name="aLength">The number of bytes to decrypt (at most the length of the buffer).</param>
+                void Decrypt(array<System::Byte>^% aRing, int aHead, int aLength);
+
+                /// <summary>
+                /// Decrypts data with the algorithm and encrypts it with the target cipher in a single pass (e.g. for a
+                /// proxy forwarding the packets of a client to another server).
+                /// </summary>
+                /// <param name="aTarget">The cipher encrypting the data.</param>
+                /// <param name="aSrc">The buffer to decrypt using the cipher.</param>
+                /// <param name="aDest">A reference to the buffer receiving the encrypted data. It can be the source buffer.</param>
+                /// <param name="aLength">The number of bytes to process (at most the length of both buffers).</param>
+                void Transcrypt(TqCipher^ aTarget, array<System::Byte>^ aSrc, array<System::Byte>^% aDest, int aLength);
+
                 /// <summary>
                 /// Resets the decryption and encryption counters.
                 /// </summary>
                 void ResetCounters();
 
+                /// <summary>
+                /// Binds the cipher to the NUMA node of the current thread, so the key is read from its local replica.
+                ///
+                /// A cipher is bound to the node of the thread creating it. Call this method when the session is moved to a
+                /// thread (or a worker) running on another node.
+                /// </summary>
+                void BindToCurrentNode();
+
+                /// <summary>
+                /// Searches the decryption counters at which a window of received bytes decrypts to a plausible packet
+                /// header (a length and a type in the given ranges), e.g. after the client and the server lost their
+                /// synchronization. All the 65,536 counters are tried with the base key and, if the cipher uses it, the
+                /// alternate key; the search is split between the processors and takes a few milliseconds.
+                /// </summary>
+                /// <param name="aWindow">The received bytes, starting at a packet.</param>
+                /// <param name="aLength">The number of bytes of the window (at least 4).</param>
+                /// <param name="aMinLength">The smallest length of a packet.</param>
+                /// <param name="aMaxLength">The largest length of a packet.</param>
+                /// <param name="aMinType">The smallest type of a packet.</param>
+                /// <param name="aMaxType">The largest type of a packet.</param>
+                /// <returns>The candidates (the counter, ORed with AltKeyCandidate if found with the alternate key), at most MaxCandidates.</returns>
+                array<int>^ FindDecryptionCounters(array<System::Byte>^ aWindow, int aLength, int aMinLength, int aMaxLength, int aMinType, int aMaxType);
+
+                /// <summary>
+                /// Resynchronizes the decryption on a candidate returned by FindDecryptionCounters: the next byte is
+                /// decrypted at its counter, with its key.
+                /// </summary>
+                /// <param name="aCandidate">The candidate.</param>
+                void Resync(int aCandidate);
+
+                /// <summary>
+                /// Attaches a tap to the cipher, or detaches it: the plaintext of the packets sampled by the tap is
+                /// mirrored in its ring. While no tap is attached, the cost is a test per packet.
+                /// </summary>
+                /// <param name="aTap">The tap, or null to detach it.</param>
+                /// <param name="aSession">The identifier of the session in the records of the tap.</param>
+                void SetTap(TqCipherTap^ aTap, System::UInt32 aSession);
+
+                /// <summary>
+                /// Creates the encryptor of the session, starting at the current encryption counter.
+                ///
+                /// The encryptor is independent of the cipher: it can be used from another thread, or shared by many
+                /// writers reserving the positions of their packets.
+                /// </summary>
+                /// <returns>The encryptor.</returns>
+                TqCipherDirection^ CreateEncryptor();
+
+                /// <summary>
+                /// Creates the decryptor of the session, starting at the current decryption counter with the current key.
+                /// </summary>
+                /// <returns>The decryptor.</returns>
+                TqCipherDirection^ CreateDecryptor();
+
+                /// <summary>
+                /// Exports the state of the cipher (counters and key seeds) in a compact versioned format.
+                ///
+                /// The keys are not exported. The state can only be imported by a cipher using the same P and G constants.
+                /// </summary>
+                /// <returns>The serialized state, of StateSize bytes.</returns>
+                array<System::Byte>^ ExportState();
+
+                /// <summary>
+                /// Imports a state previously exported by any instance (or implementation) of the cipher.
+                /// </summary>
+                /// <param name="aState">The serialized state, of StateSize bytes.</param>
+                void ImportState(array<System::Byte>^ aState);
+
+                /// <summary>
+                /// Exports the states of many ciphers in a single buffer.
+                /// </summary>
+                /// <param name="aCiphers">The ciphers to export.</param>
+                /// <returns>The serialized states, StateSize bytes per cipher.</returns>
+                static array<System::Byte>^ ExportStates(array<TqCipher^>^ aCiphers);
+
+                /// <summary>
+                /// Imports the states of many ciphers from a single buffer.
+                /// </summary>
+                /// <param name="aCiphers">The ciphers receiving the states.</param>
+                /// <param name="aStates">The serialized states, StateSize bytes per cipher.</param>
+                static void ImportStates(array<TqCipher^>^ aCiphers, array<System::Byte>^ aStates);
+
+                /// <summary>
+                /// Encrypts the same data for many ciphers (e.g. a packet broadcasted to all the players of a map).
+                ///
+                /// The result is the same as encrypting a copy of the data with each cipher, but the data is only masked
+                /// once. The default implementation is used.
+                /// </summary>
+                /// <param name="aBuf">The buffer to encrypt.</param>
+                /// <param name="aLength">The number of bytes of the buffer to encrypt.</param>
+                /// <param name="aCiphers">The ciphers of the recipients.</param>
+                /// <param name="aOuts">The buffers receiving the encrypted data, one per cipher.</param>
+                static void Broadcast(array<System::Byte>^ aBuf, int aLength, array<TqCipher^>^ aCiphers, array<array<System::Byte>^>^ aOuts);
+
+                /// <summary>
+                /// Patches bytes of an encrypted buffer (e.g. a field of a packet waiting in a send queue), given their
+                /// old and new plain values. The buffer stays encrypted: the ciphertext is XOR'ed with the difference of
+                /// the plain values, so neither the cipher nor the counters are needed.
+                /// </summary>
+                /// <param name="aBuf">The encrypted buffer.</param>
+                /// <param name="aOffset">The offset of the bytes to patch in the buffer.</param>
+                /// <param name="aOld">The old plain values of the bytes.</param>
+                /// <param name="aNew">The new plain values of the bytes.</param>
+                /// <param name="aLength">The number of bytes to patch.</param>
+                static void Patch(array<System::Byte>^ aBuf, int aOffset, array<System::Byte>^ aOld, array<System::Byte>^ aNew, int aLength);
+
+            private:
+                /// <summary>
+                /// Creates the native cipher object of the specified implementation.
+                /// </summary>
+                /// <param name="aType">The type of the implementation.</param>
+                /// <returns>The native cipher object, with a zero-filled key.</returns>
+                static TqCipher_Base* CreateCipher(ImplType aType);
+
             private:
                 /// <summary>
                 /// Native cipher object.
                 /// </summary>
                 TqCipher_Base* mCipher;
+
+                /// <summary>
+                /// Tap attached to the cipher (if any).
+                /// </summary>
+                TqCipherTap^ mTap;
 			};
 		}
 	}
@@ -0,0 +1,63 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqcipher_avx512.h"
+#include "tqcipher_simd_impl.h"
+#include <immintrin.h>
+
+#if TQ_CIPHER_GFNI
+
+/**
+ * Vector traits of AVX-512BW and GFNI (see tqcipher_simd_impl.h). The mask
+ * and the nibble swap of 64 octets are a single affine transformation, the
+ * second value of key2 is blended in with a mask, and the tail of a buffer
+ * is processed with masked loads and stores.
+ */
+struct TqSimd_AVX512
+{
+    typedef __m512i Vector;
+    static const size_t SIZE = sizeof(__m512i);
+    static const bool MASKED_TAIL = true;
+
+    static __forceinline Vector load(const void* aPtr) { return _mm512_loadu_si512(aPtr); }
+    static __forceinline void store(void* aPtr, Vector aX) { _mm512_storeu_si512(aPtr, aX); }
+    static __forceinline Vector bxor(Vector aX, Vector aY) { return _mm512_xor_si512(aX, aY); }
+    static __forceinline Vector set1(uint8_t aX) { return _mm512_set1_epi8((char)aX); }
+
+    static __forceinline Vector
+    split(uint8_t aFirst, uint8_t aSecond, size_t aCount)
+    {
+        return _mm512_mask_set1_epi8(set1(aFirst), ~(__mmask64)0 << aCount, (char)aSecond);
+    }
+
+    template <uint8_t C>
+    static __forceinline Vector
+    swapXor(Vector aX)
+    {
+        return _mm512_gf2p8affine_epi64_epi8(aX, _mm512_set1_epi64(TQ_GFNI_SWAP_MATRIX), C);
+    }
+
+    /** Get the mask of the first n octets of a vector (n < 64). */
+    static __forceinline __mmask64 tailMask(size_t aLen) { return ((__mmask64)1 << aLen) - 1; }
+
+    static __forceinline Vector
+    loadPartial(const void* aPtr, size_t aLen)
+    {
+        return _mm512_maskz_loadu_epi8(tailMask(aLen), aPtr);
+    }
+
+    static __forceinline void
+    storePartial(void* aPtr, Vector aX, size_t aLen)
+    {
+        _mm512_mask_storeu_epi8(aPtr, tailMask(aLen), aX);
+    }
+};
+
+template class TqCipher_Simd<TqSimd_AVX512>;
+
+#endif // TQ_CIPHER_GFNI
@@ -0,0 +1,28 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_AVX512_H_
+#define _TQ_CIPHER_AVX512_H_
+
+#include "tqcipher_simd.h"
+#include "tqcipher_gfni.h" // TQ_CIPHER_GFNI
+
+/** Vector traits of AVX-512BW and GFNI (64 octets), see tqcipher_avx512.cpp. */
+struct TqSimd_AVX512;
+
+/**
+ * TQ Digital's cipher using AVX-512BW and GFNI (see TqCipher_Simd): the mask
+ * and the nibble swap of each octet are a single affine transformation over
+ * GF(2), and the tail of a buffer is processed with masked loads and stores.
+ */
+typedef TqCipher_Simd<TqSimd_AVX512> TqCipher_AVX512;
+#if TQ_CIPHER_GFNI
+extern template class TqCipher_Simd<TqSimd_AVX512>;
+#endif
+
+#endif // _TQ_CIPHER_AVX512_H_
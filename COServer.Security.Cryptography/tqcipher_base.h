@@ -9,14 +9,57 @@
 #ifndef _TQ_CIPHER_BASE_H_
 #define _TQ_CIPHER_BASE_H_
 
+#include "tqcipher_state.h"
+#include "tqnuma.h"
+#include "tqtap.h"
 #include <stdint.h>
+#include <new>
+
+// GCC & Clang spell the forced inlining of MSVC differently.
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
+class TqKeyContext;
+class TqCipherStream;
+class TqCipher_Base;
+
+/**
+ * Recipient of a broadcast: the cipher of the session and the buffer
+ * receiving its copy of the encrypted octets.
+ */
+struct TqBroadcastTarget
+{
+    TqCipher_Base* cipher; //!< Cipher of the session
+    uint8_t* out; //!< Buffer receiving the encrypted octets
+    uint16_t counter; //!< Encryption counter of the first octet (set by the broadcast)
+};
+
+/**
+ * Region of a circular buffer (e.g. the receive buffer of a socket). The
+ * region starts at the head and wraps past the end of the buffer.
+ */
+struct TqRingBuffer
+{
+    uint8_t* base; //!< Start of the buffer
+    size_t capacity; //!< Size of the buffer
+    size_t head; //!< Offset of the first octet of the region (less than the capacity)
+    size_t length; //!< Number of octets of the region (at most the capacity)
+};
 
 /**
  * TQ Digital's cipher used by the AccServer of the game Conquer Online.
  * It uses a 4096-bit key, based from two 32-bit integer, with two 16-bit
  * incremental counter. The cipher is barely a XOR cipher.
  *
- * The following implementation has a memory footprint of 1 KiO.
+ * The implementations share the base key of a realm (see TqKeyContext).
+ *
+ * The sessions are allocated on the NUMA node of the thread creating them
+ * (or on a given node), and read the replica of the base key of their node.
+ *
+ * A tap can be attached to a session to mirror its plaintext (see TqTap);
+ * the implementations hand over their packets to tap(), which only tests
+ * a pointer while no tap is attached.
  */
 class TqCipher_Base
 {
@@ -29,11 +72,37 @@ public:
      * Create a new instance of the cipher where the IV and the key is
      * zero-filled.
      */
-    TqCipher_Base() { }
+    TqCipher_Base()
+        : mTap(nullptr), mTapSession(0)
+    {
+        mTapPackets[TqTap::DIRECTION_ENCRYPT] = 0;
+        mTapPackets[TqTap::DIRECTION_DECRYPT] = 0;
+    }
 
     /* destructor */
     virtual ~TqCipher_Base() {  }
 
+    /** Allocate a session on the NUMA node of the current thread. */
+    static void* operator new(size_t aSize)
+    {
+        return operator new(aSize, TqNumaNode(TqNuma::getCurrentNode()));
+    }
+
+    /** Allocate a session on a NUMA node. */
+    static void* operator new(size_t aSize, const TqNumaNode& aNode)
+    {
+        void* ptr = TqNuma::allocate(aSize, aNode.node);
+        if (ptr == nullptr)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    /** Release a session. */
+    static void operator delete(void* aPtr) { TqNuma::release(aPtr); }
+
+    /** Release a session whose constructor failed. */
+    static void operator delete(void* aPtr, const TqNumaNode&) { TqNuma::release(aPtr); }
+
 public:
     /**
      * Generate the base key based on the P & G integers which
@@ -44,6 +113,24 @@ public:
      */
     virtual void generateKey(uint32_t aP, uint32_t aG) = 0;
 
+    /**
+     * Use the base key of a shared context instead of generating it.
+     * The cipher holds a reference to the context until another key is set.
+     *
+     * @param[in] aContext  the context of the base key
+     */
+    virtual void setKeyContext(const TqKeyContext* aContext) = 0;
+
+    /**
+     * Bind the session to a NUMA node: the base key is read from its
+     * replica on the node. The session is bound to the node of the thread
+     * creating it, and should be rebound when it migrates to a thread
+     * of another node.
+     *
+     * @param[in] aNode  the node (see TqNuma)
+     */
+    virtual void bindToNode(uint32_t aNode) { (void)aNode; }
+
     /**
      * Generate an alternate key to use for the algorithm and reset
      * the encryption counter.
@@ -69,10 +156,180 @@ public:
      */
     virtual void decrypt(uint8_t* aBuf, size_t aLen) = 0;
 
+    /**
+     * Encrypt the octets of a region of a circular buffer, as one stream:
+     * the counters and the vectorized loop continue across the end of the
+     * buffer, without linearizing the region.
+     *
+     * @param[in,out] aRing         the region that will be encrypted
+     */
+    virtual void encrypt(const TqRingBuffer& aRing) = 0;
+
+    /**
+     * Decrypt the octets of a region of a circular buffer, as one stream
+     * (see encrypt(const TqRingBuffer&)).
+     *
+     * @param[in,out] aRing         the region that will be decrypted
+     */
+    virtual void decrypt(const TqRingBuffer& aRing) = 0;
+
     /**
      * Reset the decrypt and the encrypt counters.
      */
     virtual void resetCounters() = 0;
+
+    /**
+     * Save the state of the cipher (counters and key seeds).
+     *
+     * @param[out] aState  the state of the cipher
+     */
+    virtual void saveState(TqCipherState& aState) const = 0;
+
+    /**
+     * Restore a state previously saved by any implementation of the cipher.
+     * The base key must already be set and the alternate key is rebuilt
+     * from its seed.
+     *
+     * @param[in] aState  the state to restore
+     *
+     * @returns false if the state was saved with another base key
+     */
+    virtual bool restoreState(const TqCipherState& aState) = 0;
+
+    /**
+     * Create the encryptor of the session, starting at the encryption
+     * counter. The caller owns the stream.
+     *
+     * @returns the encryptor
+     */
+    virtual TqCipherStream* createEncryptor() const = 0;
+
+    /**
+     * Create the decryptor of the session, starting at the decryption
+     * counter and using the current key. The caller owns the stream.
+     *
+     * @returns the decryptor
+     */
+    virtual TqCipherStream* createDecryptor() const = 0;
+
+    /**
+     * Get the context of the base key, used for the encryption.
+     *
+     * @returns the context of the base key
+     */
+    virtual const TqKeyContext* getKeyContext() const = 0;
+
+    /**
+     * Reserve the encryption counters of n octet(s), so another cipher can
+     * encrypt the octets on behalf of the session (see transcrypt).
+     *
+     * @param[in] aLen  the number of octets
+     *
+     * @returns the encryption counter of the first octet
+     */
+    virtual uint16_t reserveEncryption(size_t aLen) = 0;
+
+    /**
+     * Decrypt n octet(s) with the cipher and encrypt them with the target
+     * cipher in a single pass. The masks and the nibble swaps of the two
+     * steps cancel out, so the octets are only XOR'ed with the keystreams.
+     *
+     * @param[in,out] aTarget       the cipher encrypting the octets
+     * @param[in]     aIn           the octets to decrypt
+     * @param[out]    aOut          the encrypted octets (can be aIn)
+     * @param[in]     aLen          the number of octets to process
+     */
+    virtual void transcrypt(TqCipher_Base& aTarget, const uint8_t* aIn, uint8_t* aOut, size_t aLen) = 0;
+
+public:
+    /**
+     * Encrypt a packet of N octet(s) with the cipher. The kernel is
+     * specialized for the size and inlined in the caller (see
+     * tqcipher_fixed.h, defining the template), so only the reservation of
+     * the counters is a virtual call.
+     *
+     * @param[in,out] aBuf          the buffer that will be encrypted
+     */
+    template <size_t N>
+    void encrypt(uint8_t* aBuf);
+
+    /**
+     * Decrypt a packet of N octet(s) with the cipher (see encrypt<N>).
+     *
+     * @param[in,out] aBuf          the buffer that will be decrypted
+     */
+    template <size_t N>
+    void decrypt(uint8_t* aBuf);
+
+public:
+    /**
+     * Attach a tap to the session, or detach it. The plaintext of the
+     * packets is handed over to the tap before the encryption and after the
+     * decryption (the fused kernels of transcrypt never write the plaintext,
+     * so it isn't handed over).
+     *
+     * @param[in] aTap      the tap, or nullptr
+     * @param[in] aSession  the identifier of the session in the records
+     */
+    void setTap(TqTap* aTap, uint32_t aSession)
+    {
+        mTapSession = aSession;
+        mTap = aTap;
+    }
+
+    /** Get the tap attached to the session (or nullptr). */
+    TqTap* getTap() const { return mTap; }
+
+protected:
+    /**
+     * Reserve the counters of n octet(s) in a direction and get the key of
+     * the direction, for the kernels running outside of the implementation
+     * (see encrypt<N>).
+     *
+     * @param[in]  aDirection  the direction (TqTap::DIRECTION_*)
+     * @param[in]  aLen        the number of octets
+     * @param[out] aCounter    the counter of the first octet
+     *
+     * @returns the padded key of the direction (see TqKeyContext)
+     */
+    virtual const uint8_t* reserve(uint8_t aDirection, size_t aLen, uint16_t& aCounter) = 0;
+
+protected:
+    /**
+     * Hand over a packet to the tap attached to the session, if any.
+     *
+     * @param[in] aDirection  the direction of the packet (TqTap::DIRECTION_*)
+     * @param[in] aCounter    the counter of the first octet
+     * @param[in] aBuf        the plaintext of the packet
+     * @param[in] aLen        the length of the packet
+     */
+    void tap(uint8_t aDirection, uint16_t aCounter, const uint8_t* aBuf, size_t aLen)
+    {
+        TqTap* tap = mTap;
+        if (tap != nullptr && tap->sample(mTapSession, mTapPackets[aDirection]++))
+            tap->record(mTapSession, aDirection, aCounter, aBuf, aLen);
+    }
+
+    /**
+     * Hand over a region of a circular buffer to the tap attached to the
+     * session, if any (see tap()).
+     */
+    void tap(uint8_t aDirection, uint16_t aCounter, const TqRingBuffer& aRing)
+    {
+        TqTap* tap = mTap;
+        if (tap != nullptr && tap->sample(mTapSession, mTapPackets[aDirection]++))
+        {
+            size_t before = aRing.capacity - aRing.head;
+            size_t first = aRing.length < before ? aRing.length : before;
+            tap->record(mTapSession, aDirection, aCounter,
+                        aRing.base + aRing.head, first, aRing.base, aRing.length - first);
+        }
+    }
+
+private:
+    TqTap* volatile mTap; //!< Tap attached to the session (if any)
+    uint32_t mTapSession; //!< Identifier of the session in the records of the tap
+    uint32_t mTapPackets[2]; //!< Packets handed over to the tap per direction (for the sampling), each written only by the thread of its direction
 };
 
 #endif // _TQ_CIPHER_BASE_H_
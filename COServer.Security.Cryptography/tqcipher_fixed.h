@@ -0,0 +1,184 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_FIXED_H_
+#define _TQ_CIPHER_FIXED_H_
+
+// Kernels of the packets whose size is known at compile time (movements,
+// actions, heartbeats, ...), and the definitions of TqCipher_Base::encrypt<N>
+// and TqCipher_Base::decrypt<N>. Include this file to use them.
+
+#include "tqcipher_base.h"
+#include "tqkeycontext.h"
+#include <stdint.h>
+#include <string.h> // memcpy
+
+/**
+ * Integer word of n octet(s) processed at once by the fixed-size kernels.
+ */
+template <size_t WIDTH>
+struct TqFixedWord;
+
+template <> struct TqFixedWord<8> { typedef uint64_t Type; };
+template <> struct TqFixedWord<4> { typedef uint32_t Type; };
+template <> struct TqFixedWord<2> { typedef uint16_t Type; };
+template <> struct TqFixedWord<1> { typedef uint8_t Type; };
+
+/**
+ * Process the octets of a fixed-size packet from OFFSET, by the widest words
+ * fitting the octets left (e.g. 28 octets are three 64-bit words and one
+ * 32-bit word). The words are unrolled at compile time, so the packet has no
+ * loop and no scalar tail.
+ */
+template <size_t N, size_t OFFSET = 0, size_t LEFT = N - OFFSET>
+struct TqFixedRun
+{
+    static const size_t WIDTH = LEFT >= 8 ? 8 : LEFT >= 4 ? 4 : LEFT >= 2 ? 2 : 1;
+    typedef typename TqFixedWord<WIDTH>::Type Word;
+
+    /** Broadcast an octet to all the octets of a word. */
+    static __forceinline Word
+    set1(uint8_t aValue)
+    {
+        return (Word)(UINT64_C(0x0101010101010101) * aValue);
+    }
+
+    /** Swap the nibbles of the octets of a word, then XOR with 0xBA. */
+    static __forceinline Word
+    swapMask(Word aX)
+    {
+        const Word LOW = (Word)UINT64_C(0x0F0F0F0F0F0F0F0F);
+        return (Word)((Word)((aX & LOW) << 4) | (Word)((aX >> 4) & LOW)) ^ set1(0xBA);
+    }
+
+    /**
+     * Process the packet, all its counters sharing the same key2 octet.
+     *
+     * @param[in,out] aBuf   the packet
+     * @param[in]     aKey1  the key1 octet of the first counter
+     * @param[in]     aKey2  the key2 octet broadcast to a word
+     */
+    static __forceinline void
+    process(uint8_t* aBuf, const uint8_t* aKey1, uint64_t aKey2)
+    {
+        Word x, k;
+        memcpy(&x, aBuf + OFFSET, WIDTH);
+        memcpy(&k, aKey1 + OFFSET, WIDTH);
+        x = (Word)(swapMask(x) ^ k ^ (Word)aKey2);
+        memcpy(aBuf + OFFSET, &x, WIDTH);
+
+        TqFixedRun<N, OFFSET + WIDTH>::process(aBuf, aKey1, aKey2);
+    }
+
+    /**
+     * Process the packet, the counters crossing into the next key2 octet.
+     *
+     * @param[in,out] aBuf    the packet
+     * @param[in]     aKey1   the key1 octet of the first counter
+     * @param[in]     aKey2   the key2 octet of the first counters, broadcast to a word
+     * @param[in]     aNext   the key2 octet of the last counters, broadcast to a word
+     * @param[in]     aSplit  the number of octets using aKey2 (less than N)
+     */
+    static __forceinline void
+    processSplit(uint8_t* aBuf, const uint8_t* aKey1, uint64_t aKey2, uint64_t aNext, size_t aSplit)
+    {
+        // the octets of the word from aSplit take the next key2 octet
+        size_t first = aSplit > OFFSET ? aSplit - OFFSET : 0;
+        Word mask = first >= WIDTH ? (Word)0 : (Word)(~UINT64_C(0) << (8 * first));
+
+        Word x, k;
+        memcpy(&x, aBuf + OFFSET, WIDTH);
+        memcpy(&k, aKey1 + OFFSET, WIDTH);
+        x = (Word)(swapMask(x) ^ k ^ (Word)aKey2 ^ ((Word)(aKey2 ^ aNext) & mask));
+        memcpy(aBuf + OFFSET, &x, WIDTH);
+
+        TqFixedRun<N, OFFSET + WIDTH>::processSplit(aBuf, aKey1, aKey2, aNext, aSplit);
+    }
+};
+
+template <size_t N, size_t OFFSET>
+struct TqFixedRun<N, OFFSET, 0>
+{
+    static __forceinline void
+    process(uint8_t*, const uint8_t*, uint64_t) { }
+
+    static __forceinline void
+    processSplit(uint8_t*, const uint8_t*, uint64_t, uint64_t, size_t) { }
+};
+
+/**
+ * Kernels of the TQ cipher specialized for the packets of a fixed size.
+ *
+ * The kernels are portable (SWAR on the general-purpose registers) and
+ * defined in this header, so they are inlined in the callers whatever their
+ * instruction set. Up to 64 octets, the words of a packet are fewer than
+ * the vectors and the scalar tail of the runtime-length kernels.
+ */
+class TqCipher_Fixed
+{
+public:
+    /** The maximum size of a packet (a key1 load never crosses the padding). */
+    static const size_t MAX_SIZE = TqKeyContext::PADDING;
+
+public:
+    /**
+     * Process (encrypt or decrypt) N octet(s) starting at a counter. It is
+     * bit-exact with the kernels of the implementations.
+     *
+     * @param[in]     aKey          the padded key (see TqKeyContext)
+     * @param[in]     aCounter      the counter of the first octet
+     * @param[in,out] aBuf          the buffer that will be processed
+     *
+     * @returns the counter following the last octet
+     */
+    template <size_t N>
+    static __forceinline uint16_t
+    transform(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf)
+    {
+        static_assert(N > 0 && N <= MAX_SIZE, "The fixed-size kernels process 1 to 64 octets.");
+
+        const uint8_t* key1 = aKey + (uint8_t)aCounter;
+        const uint8_t* key2 = aKey + TqKeyContext::HALF_SIZE;
+        uint8_t page = (uint8_t)(aCounter >> 8);
+
+        // the only branch: whether the packet crosses into the next key2 octet
+        // (the padding of key2 repeats its first octet after the last page)
+        size_t split = 0x100 - (uint8_t)aCounter;
+        uint64_t y = UINT64_C(0x0101010101010101) * key2[page];
+        if (split >= N)
+            TqFixedRun<N>::process(aBuf, key1, y);
+        else
+            TqFixedRun<N>::processSplit(aBuf, key1, y, UINT64_C(0x0101010101010101) * key2[page + 1], split);
+
+        return (uint16_t)(aCounter + N);
+    }
+};
+
+template <size_t N>
+void
+TqCipher_Base :: encrypt(uint8_t* aBuf)
+{
+    uint16_t counter;
+    const uint8_t* key = reserve(TqTap::DIRECTION_ENCRYPT, N, counter);
+
+    tap(TqTap::DIRECTION_ENCRYPT, counter, aBuf, N);
+    TqCipher_Fixed::transform<N>(key, counter, aBuf);
+}
+
+template <size_t N>
+void
+TqCipher_Base :: decrypt(uint8_t* aBuf)
+{
+    uint16_t counter;
+    const uint8_t* key = reserve(TqTap::DIRECTION_DECRYPT, N, counter);
+
+    TqCipher_Fixed::transform<N>(key, counter, aBuf);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aBuf, N);
+}
+
+#endif // _TQ_CIPHER_FIXED_H_
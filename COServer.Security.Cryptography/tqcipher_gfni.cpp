@@ -0,0 +1,48 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqcipher_gfni.h"
+#include "tqcipher_simd_impl.h"
+#include <immintrin.h>
+
+#if TQ_CIPHER_GFNI
+
+/**
+ * Vector traits of AVX2 and GFNI (see tqcipher_simd_impl.h). The mask and the
+ * nibble swap of 32 octets are a single affine transformation.
+ */
+struct TqSimd_GFNI : public TqSimdGeneric<TqSimd_GFNI>
+{
+    typedef __m256i Vector;
+    static const size_t SIZE = sizeof(__m256i);
+
+    static __forceinline Vector load(const void* aPtr) { return _mm256_loadu_si256((const __m256i*)aPtr); }
+    static __forceinline void store(void* aPtr, Vector aX) { _mm256_storeu_si256((__m256i*)aPtr, aX); }
+    static __forceinline Vector bxor(Vector aX, Vector aY) { return _mm256_xor_si256(aX, aY); }
+    static __forceinline Vector set1(uint8_t aX) { return _mm256_set1_epi8((char)aX); }
+
+    static __forceinline Vector
+    split(uint8_t aFirst, uint8_t aSecond, size_t aCount)
+    {
+        const __m256i ramp = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                              16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+        __m256i mask = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)aCount), ramp);
+        return _mm256_blendv_epi8(set1(aSecond), set1(aFirst), mask);
+    }
+
+    template <uint8_t C>
+    static __forceinline Vector
+    swapXor(Vector aX)
+    {
+        return _mm256_gf2p8affine_epi64_epi8(aX, _mm256_set1_epi64x(TQ_GFNI_SWAP_MATRIX), C);
+    }
+};
+
+template class TqCipher_Simd<TqSimd_GFNI>;
+
+#endif // TQ_CIPHER_GFNI
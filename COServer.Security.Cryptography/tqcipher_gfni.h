@@ -0,0 +1,36 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_GFNI_H_
+#define _TQ_CIPHER_GFNI_H_
+
+#include "tqcipher_simd.h"
+
+// The GFNI and AVX-512BW intrinsics ship with Visual Studio 2019 and later.
+#if !defined(_MSC_VER) || _MSC_VER >= 1920
+#define TQ_CIPHER_GFNI 1
+#else
+#define TQ_CIPHER_GFNI 0
+#endif
+
+/** Matrix of the nibble swap, for gf2p8affineqb. */
+#define TQ_GFNI_SWAP_MATRIX 0x1020408001020408LL
+
+/** Vector traits of AVX2 and GFNI (32 octets), see tqcipher_gfni.cpp. */
+struct TqSimd_GFNI;
+
+/**
+ * TQ Digital's cipher using AVX2 and GFNI (see TqCipher_Simd): the mask and
+ * the nibble swap of each octet are a single affine transformation over GF(2).
+ */
+typedef TqCipher_Simd<TqSimd_GFNI> TqCipher_GFNI;
+#if TQ_CIPHER_GFNI
+extern template class TqCipher_Simd<TqSimd_GFNI>;
+#endif
+
+#endif // _TQ_CIPHER_GFNI_H_
@@ -0,0 +1,49 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqcipher_neon.h"
+
+#if TQ_CIPHER_NEON
+
+#include "tqcipher_simd_impl.h"
+#include <arm_neon.h>
+
+/**
+ * Vector traits of NEON (see tqcipher_simd_impl.h). The nibbles are swapped
+ * with a shift left and a shift right and insert.
+ */
+struct TqSimd_NEON : public TqSimdGeneric<TqSimd_NEON>
+{
+    typedef uint8x16_t Vector;
+    static const size_t SIZE = sizeof(uint8x16_t);
+
+    static __forceinline Vector load(const void* aPtr) { return vld1q_u8((const uint8_t*)aPtr); }
+    static __forceinline void store(void* aPtr, Vector aX) { vst1q_u8((uint8_t*)aPtr, aX); }
+    static __forceinline Vector bxor(Vector aX, Vector aY) { return veorq_u8(aX, aY); }
+    static __forceinline Vector set1(uint8_t aX) { return vdupq_n_u8(aX); }
+
+    static __forceinline Vector
+    split(uint8_t aFirst, uint8_t aSecond, size_t aCount)
+    {
+        static const uint8_t RAMP[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+        uint8x16_t mask = vcltq_u8(vld1q_u8(RAMP), vdupq_n_u8((uint8_t)aCount));
+        return vbslq_u8(mask, set1(aFirst), set1(aSecond));
+    }
+
+    template <uint8_t C>
+    static __forceinline Vector
+    swapXor(Vector aX)
+    {
+        Vector w = vsriq_n_u8(vshlq_n_u8(aX, 4), aX, 4);
+        return veorq_u8(w, vdupq_n_u8(C));
+    }
+};
+
+template class TqCipher_Simd<TqSimd_NEON>;
+
+#endif // TQ_CIPHER_NEON
@@ -0,0 +1,32 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_NEON_H_
+#define _TQ_CIPHER_NEON_H_
+
+#include "tqcipher_simd.h"
+
+// NEON is part of the baseline of the ARM targets (ARMv7 with VFPv3-D32 and ARM64).
+#if defined(_M_ARM) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define TQ_CIPHER_NEON 1
+#else
+#define TQ_CIPHER_NEON 0
+#endif
+
+/** Vector traits of NEON (16 octets), see tqcipher_neon.cpp. */
+struct TqSimd_NEON;
+
+/**
+ * TQ Digital's cipher using NEON (see TqCipher_Simd).
+ */
+typedef TqCipher_Simd<TqSimd_NEON> TqCipher_NEON;
+#if TQ_CIPHER_NEON
+extern template class TqCipher_Simd<TqSimd_NEON>;
+#endif
+
+#endif // _TQ_CIPHER_NEON_H_
@@ -0,0 +1,263 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqcipher_offload.h"
+#include <string.h> // memcpy
+#include <assert.h>
+
+typedef TqOffloadRegion Region;
+
+TqCipher_Offload :: TqCipher_Offload(TqOffloadClient* aClient, TqCipherStream::Kernel aKernel)
+    : mClient(aClient), mKernel(aKernel), mSession(UINT32_MAX),
+      mEnCounter(0), mDeCounter(0),
+      mContext(TqKeyContext::acquire(0, 0)), // zero-filled key
+      mUsingAltKey(false), mAltSeed(0),
+      mAltKey(nullptr), mAltKeyReady(false), mFailed(false)
+{
+    assert(aClient != nullptr && aKernel != nullptr);
+    mSession = mClient->call(Region::OP_OPEN, 0);
+}
+
+TqCipher_Offload :: ~TqCipher_Offload()
+{
+    if (mSession != UINT32_MAX)
+        mClient->call(Region::OP_CLOSE, mSession);
+
+    if (mAltKey != nullptr)
+    {
+        // security purpose only...
+        memset(mAltKey, 0, TqKeyContext::SIZE);
+        delete[] mAltKey;
+    }
+
+    mContext->release();
+    mContext = nullptr;
+}
+
+void
+TqCipher_Offload :: generateKey(uint32_t aP, uint32_t aG)
+{
+    const TqKeyContext* context = TqKeyContext::acquire(aP, aG);
+    setKeyContext(context);
+    context->release();
+}
+
+void
+TqCipher_Offload :: setKeyContext(const TqKeyContext* aContext)
+{
+    aContext->addRef();
+    mContext->release();
+    mContext = aContext;
+
+    // the service shares the base keys of its sessions the same way
+    if (mSession != UINT32_MAX &&
+        mClient->call(Region::OP_SET_KEY, mSession, 0, mContext->getP(), mContext->getG()) == UINT32_MAX)
+        detach();
+    mAltKeyReady = false;
+}
+
+void
+TqCipher_Offload :: generateAltKey(int32_t aA, int32_t aB)
+{
+    mAltSeed = (uint32_t)(((aA + aB) ^ 0x4321) ^ aA);
+    if (mSession != UINT32_MAX && mClient->call(Region::OP_ALT_KEY, mSession, 0, mAltSeed) == UINT32_MAX)
+        detach();
+    mAltKeyReady = false;
+
+    mUsingAltKey = true;
+    mEnCounter = 0;
+}
+
+void
+TqCipher_Offload :: saveState(TqCipherState& aState) const
+{
+    aState.flags = mUsingAltKey ? TqCipherState::FLAG_ALT_KEY : 0;
+    aState.enCounter = mEnCounter;
+    aState.deCounter = mDeCounter;
+    aState.altSeed = mUsingAltKey ? mAltSeed : 0;
+    aState.keyId = mContext->getKeyId();
+}
+
+bool
+TqCipher_Offload :: restoreState(const TqCipherState& aState)
+{
+    if (aState.keyId != mContext->getKeyId())
+        return false;
+
+    mUsingAltKey = (aState.flags & TqCipherState::FLAG_ALT_KEY) != 0;
+    if (mUsingAltKey)
+    {
+        mAltSeed = aState.altSeed;
+        if (mSession != UINT32_MAX && mClient->call(Region::OP_ALT_KEY, mSession, 0, mAltSeed) == UINT32_MAX)
+            detach();
+        mAltKeyReady = false;
+    }
+    else if (mSession != UINT32_MAX && mClient->call(Region::OP_CLEAR_ALT_KEY, mSession) == UINT32_MAX)
+        detach();
+
+    mEnCounter = aState.enCounter;
+    mDeCounter = aState.deCounter;
+    return true;
+}
+
+TqCipherStream*
+TqCipher_Offload :: createEncryptor() const
+{
+    return new TqCipherStream(mKernel, mContext, nullptr, mEnCounter);
+}
+
+TqCipherStream*
+TqCipher_Offload :: createDecryptor() const
+{
+    return new TqCipherStream(mKernel, mContext, mUsingAltKey ? getAltKey() : nullptr, mDeCounter);
+}
+
+void
+TqCipher_Offload :: encrypt(uint8_t* aBuf, size_t aLen)
+{
+    tap(TqTap::DIRECTION_ENCRYPT, mEnCounter, aBuf, aLen);
+    mEnCounter = process(Region::OP_ENCRYPT, mEnCounter, aBuf, aLen);
+}
+
+void
+TqCipher_Offload :: decrypt(uint8_t* aBuf, size_t aLen)
+{
+    uint16_t counter = mDeCounter;
+    mDeCounter = process(Region::OP_DECRYPT, counter, aBuf, aLen);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aBuf, aLen);
+}
+
+void
+TqCipher_Offload :: encrypt(const TqRingBuffer& aRing)
+{
+    // the octets are copied in the arena anyway, the two parts are sent as they are
+    size_t before = aRing.capacity - aRing.head;
+    size_t first = aRing.length < before ? aRing.length : before;
+    tap(TqTap::DIRECTION_ENCRYPT, mEnCounter, aRing);
+    mEnCounter = process(Region::OP_ENCRYPT, mEnCounter, aRing.base + aRing.head, first);
+    mEnCounter = process(Region::OP_ENCRYPT, mEnCounter, aRing.base, aRing.length - first);
+}
+
+void
+TqCipher_Offload :: decrypt(const TqRingBuffer& aRing)
+{
+    size_t before = aRing.capacity - aRing.head;
+    size_t first = aRing.length < before ? aRing.length : before;
+    uint16_t counter = mDeCounter;
+    mDeCounter = process(Region::OP_DECRYPT, counter, aRing.base + aRing.head, first);
+    mDeCounter = process(Region::OP_DECRYPT, mDeCounter, aRing.base, aRing.length - first);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aRing);
+}
+
+void
+TqCipher_Offload :: transcrypt(TqCipher_Base& aTarget, const uint8_t* aIn, uint8_t* aOut, size_t aLen)
+{
+    if (aOut != aIn)
+        memcpy(aOut, aIn, aLen);
+
+    decrypt(aOut, aLen);
+    aTarget.encrypt(aOut, aLen);
+}
+
+const uint8_t*
+TqCipher_Offload :: reserve(uint8_t aDirection, size_t aLen, uint16_t& aCounter)
+{
+    if (aDirection == TqTap::DIRECTION_ENCRYPT)
+    {
+        aCounter = mEnCounter;
+        mEnCounter = (uint16_t)(mEnCounter + aLen);
+        return mContext->getKey();
+    }
+
+    aCounter = mDeCounter;
+    mDeCounter = (uint16_t)(mDeCounter + aLen);
+    return mUsingAltKey ? getAltKey() : mContext->getKey();
+}
+
+uint16_t
+TqCipher_Offload :: process(uint8_t aOp, uint16_t aCounter, uint8_t* aBuf, size_t aLen)
+{
+    assert(aBuf != nullptr);
+
+    uint16_t counter = aCounter;
+    if (aLen == 0)
+        return counter;
+
+    // zero-copy: the packet was written in the arena
+    if (mSession != UINT32_MAX && mClient->contains(aBuf, aLen))
+    {
+        uint8_t status = Region::STATUS_OK;
+        mClient->wait(mClient->submit(aOp, mSession, counter, 0, 0, aBuf, aLen), &status);
+        if (status == Region::STATUS_OK)
+            return (uint16_t)(counter + aLen);
+
+        detach();
+        if (status == Region::STATUS_LOST)
+        {
+            // the service may have processed part of the octets: the stream can't be recovered
+            mFailed = true;
+            return counter;
+        }
+        // on error, the octets are untouched: they are processed locally below
+    }
+
+    // the octets of a block are only copied back once the service processed them
+    size_t offset = 0;
+    uint8_t* block = mSession != UINT32_MAX ? mClient->allocate() : nullptr;
+    if (block != nullptr)
+    {
+        while (offset < aLen)
+        {
+            size_t len = aLen - offset < Region::BLOCK_SIZE ? aLen - offset : Region::BLOCK_SIZE;
+
+            memcpy(block, aBuf + offset, len);
+            uint8_t status = Region::STATUS_OK;
+            mClient->wait(mClient->submit(aOp, mSession, counter, 0, 0, block, len), &status);
+            if (status != Region::STATUS_OK)
+            {
+                detach();
+                break;
+            }
+            memcpy(aBuf + offset, block, len);
+            counter = (uint16_t)(counter + len);
+            offset += len;
+        }
+        mClient->release(block);
+    }
+
+    if (offset < aLen)
+    {
+        // no session, all the blocks are in flight or the service failed: the octets are processed locally
+        const uint8_t* key = aOp == Region::OP_DECRYPT && mUsingAltKey ? getAltKey() : mContext->getKey();
+        counter = mKernel(key, counter, aBuf + offset, aLen - offset);
+    }
+
+    return counter;
+}
+
+void
+TqCipher_Offload :: detach()
+{
+    if (mSession != UINT32_MAX && !mClient->isLost())
+        mClient->call(Region::OP_CLOSE, mSession);
+    mSession = UINT32_MAX;
+}
+
+const uint8_t*
+TqCipher_Offload :: getAltKey() const
+{
+    if (!mAltKeyReady)
+    {
+        if (mAltKey == nullptr)
+            mAltKey = new uint8_t[TqKeyContext::SIZE];
+
+        mContext->expandAltKey(mAltKey, mAltSeed);
+        mAltKeyReady = true;
+    }
+    return mAltKey;
+}
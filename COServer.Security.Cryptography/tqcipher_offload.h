@@ -0,0 +1,238 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_OFFLOAD_H_
+#define _TQ_CIPHER_OFFLOAD_H_
+
+#include "tqcipher_base.h"
+#include "tqcipher_stream.h"
+#include "tqkeycontext.h"
+#include "tqoffload.h"
+#include <stdint.h>
+
+/**
+ * TQ Digital's cipher used by the AccServer of the game Conquer Online.
+ * It uses a 4096-bit key, based from two 32-bit integer, with two 16-bit
+ * incremental counter. The cipher is barely a XOR cipher.
+ *
+ * The following implementation hands the octets over to the offload service
+ * (see TqOffloadService), which holds the keys of the session. The octets
+ * already in the arena of the client are processed in place; the others are
+ * copied in and out of a block. The counters stay in the process, so the
+ * streams and the transcryption are done locally with the given kernel.
+ *
+ * When the service rejects a job or is lost (see TqOffloadClient), the
+ * session is detached from it and the octets are processed locally from
+ * then on. Only the octets written in the arena can't be recovered if the
+ * service is lost while processing them: the cipher is then failed (see
+ * isFailed) and the counter doesn't advance over them.
+ */
+class TqCipher_Offload : public TqCipher_Base
+{
+public:
+    /**
+     * Create a new instance of the cipher where the IV and the key is
+     * zero-filled, and open its session.
+     *
+     * @param[in] aClient  the client of the service (must outlive the cipher)
+     * @param[in] aKernel  the kernel of the local streams
+     */
+    TqCipher_Offload(TqOffloadClient* aClient, TqCipherStream::Kernel aKernel);
+
+    /* destructor (closes the session) */
+    virtual ~TqCipher_Offload();
+
+public:
+    /**
+     * Generate the base key based on the P & G integers which
+     * are respectively two 32-bit integers.
+     *
+     * @param[in] aP  the P value of the cipher
+     * @param[in] aG  the G value of the cipher
+     */
+    virtual void generateKey(uint32_t aP, uint32_t aG);
+
+    /**
+     * Use the base key of a shared context instead of generating it.
+     * The cipher holds a reference to the context until another key is set.
+     *
+     * @param[in] aContext  the context of the base key
+     */
+    virtual void setKeyContext(const TqKeyContext* aContext);
+
+    /**
+     * Generate an alternate key to use for the algorithm and reset
+     * the encryption counter.
+     *
+     * @param[in] aA  the A value of the cipher (Token)
+     * @param[in] aB  the B value of the cipher (AccountUID)
+     */
+    virtual void generateAltKey(int32_t aA, int32_t aB);
+
+    /**
+     * Encrypt n octet(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be encrypted
+     * @param[in]     aLen          the number of octets to encrypt
+     */
+    virtual void encrypt(uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Decrypt n octet(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be decrypted
+     * @param[in]     aLen          the number of octets to decrypt
+     */
+    virtual void decrypt(uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Encrypt the octets of a region of a circular buffer, as one stream.
+     *
+     * @param[in,out] aRing         the region that will be encrypted
+     */
+    virtual void encrypt(const TqRingBuffer& aRing);
+
+    /**
+     * Decrypt the octets of a region of a circular buffer, as one stream.
+     *
+     * @param[in,out] aRing         the region that will be decrypted
+     */
+    virtual void decrypt(const TqRingBuffer& aRing);
+
+    /* the packets of a fixed size (see tqcipher_fixed.h) */
+    using TqCipher_Base::encrypt;
+    using TqCipher_Base::decrypt;
+
+    /**
+     * Reset the decrypt and the encrypt counters.
+     */
+    virtual void resetCounters() { mEnCounter = 0; mDeCounter = 0; }
+
+    /**
+     * Save the state of the cipher (counters and key seeds).
+     *
+     * @param[out] aState  the state of the cipher
+     */
+    virtual void saveState(TqCipherState& aState) const;
+
+    /**
+     * Restore a state previously saved by any implementation of the cipher.
+     * The base key must already be set and the alternate key is rebuilt
+     * from its seed.
+     *
+     * @param[in] aState  the state to restore
+     *
+     * @returns false if the state was saved with another base key
+     */
+    virtual bool restoreState(const TqCipherState& aState);
+
+    /**
+     * Create the encryptor of the session, starting at the encryption
+     * counter. The caller owns the stream.
+     *
+     * @returns the encryptor
+     */
+    virtual TqCipherStream* createEncryptor() const;
+
+    /**
+     * Create the decryptor of the session, starting at the decryption
+     * counter and using the current key. The caller owns the stream.
+     *
+     * @returns the decryptor
+     */
+    virtual TqCipherStream* createDecryptor() const;
+
+    /**
+     * Get the context of the base key, used for the encryption.
+     *
+     * @returns the context of the base key
+     */
+    virtual const TqKeyContext* getKeyContext() const { return mContext; }
+
+    /**
+     * Reserve the encryption counters of n octet(s), so another cipher can
+     * encrypt the octets on behalf of the session (see transcrypt).
+     *
+     * @param[in] aLen  the number of octets
+     *
+     * @returns the encryption counter of the first octet
+     */
+    virtual uint16_t reserveEncryption(size_t aLen)
+    {
+        uint16_t counter = mEnCounter;
+        mEnCounter = (uint16_t)(mEnCounter + aLen);
+        return counter;
+    }
+
+    /**
+     * Decrypt n octet(s) with the cipher and encrypt them with the target
+     * cipher. The octets are decrypted by the service, then encrypted by
+     * the target.
+     *
+     * @param[in,out] aTarget       the cipher encrypting the octets
+     * @param[in]     aIn           the octets to decrypt
+     * @param[out]    aOut          the encrypted octets (can be aIn)
+     * @param[in]     aLen          the number of octets to process
+     */
+    virtual void transcrypt(TqCipher_Base& aTarget, const uint8_t* aIn, uint8_t* aOut, size_t aLen);
+
+    /**
+     * Check if the service was lost while processing octets of the arena.
+     * The octets may be partly processed: the connection must be closed.
+     *
+     * @returns whether or not the session failed
+     */
+    bool isFailed() const { return mFailed; }
+
+protected:
+    /**
+     * Reserve the counters of n octet(s) in a direction and get the key of
+     * the direction (see TqCipher_Base::reserve). The packets of a fixed
+     * size are too small to be worth a round trip to the service, they are
+     * processed by the caller.
+     */
+    virtual const uint8_t* reserve(uint8_t aDirection, size_t aLen, uint16_t& aCounter);
+
+private:
+    /**
+     * Process n octet(s) with the service.
+     *
+     * @param[in]     aOp           the operation (OP_ENCRYPT or OP_DECRYPT)
+     * @param[in]     aCounter      the counter of the first octet
+     * @param[in,out] aBuf          the buffer that will be processed
+     * @param[in]     aLen          the number of octets to process
+     *
+     * @returns the counter following the last octet processed
+     */
+    uint16_t process(uint8_t aOp, uint16_t aCounter, uint8_t* aBuf, size_t aLen);
+
+    /** Stop using the service: close the session if possible, the octets are processed locally. */
+    void detach();
+
+    /** Get the alternate key, expanding it on the first use. */
+    const uint8_t* getAltKey() const;
+
+private:
+    TqOffloadClient* mClient; //!< Client of the service
+    TqCipherStream::Kernel mKernel; //!< Kernel of the local streams
+    uint32_t mSession; //!< Session of the cipher in the service
+
+    uint16_t mEnCounter; //!< Internal encryption counter.
+    uint16_t mDeCounter; //!< Internal decryption counter.
+
+    const TqKeyContext* mContext; //!< Shared base key
+    bool mUsingAltKey; //!< Whether or not the alternate key must be used
+    uint32_t mAltSeed; //!< Seed of the alternate key (see TqCipherState)
+
+    mutable uint8_t* mAltKey; //!< Local copy of the alternate key (expanded on demand)
+    mutable bool mAltKeyReady; //!< Whether the local copy matches the seed
+
+    bool mFailed; //!< Whether octets of the arena were lost with the service
+};
+
+#endif // _TQ_CIPHER_OFFLOAD_H_
@@ -0,0 +1,273 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2014 - 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_SIMD_H_
+#define _TQ_CIPHER_SIMD_H_
+
+#include "tqcipher_base.h"
+#include "tqkeycontext.h"
+#include <stdint.h>
+
+/**
+ * TQ Digital's cipher used by the AccServer of the game Conquer Online.
+ * It uses a 4096-bit key, based from two 32-bit integer, with two 16-bit
+ * incremental counter. The cipher is barely a XOR cipher.
+ *
+ * The base key is shared by the sessions of a realm (see TqKeyContext), so
+ * the following implementation has a memory footprint of about 640 octets.
+ *
+ * The following implementation is generic over the width of the vectors:
+ * the kernels are written once (see tqcipher_simd_impl.h) against a traits
+ * type providing the load, the store, the XOR, the broadcast of an octet and
+ * the nibble swap of an instruction set. Each instruction set instantiates
+ * the template in its own translation unit, compiled with its own flags.
+ */
+template <class Traits>
+class TqCipher_Simd : public TqCipher_Base
+{
+public:
+    /**
+     * Create a new instance of the cipher where the IV and the key is
+     * zero-filled.
+     */
+    TqCipher_Simd();
+
+    /* destructor */
+    virtual ~TqCipher_Simd();
+
+public:
+    /**
+     * Generate the base key based on the P & G integers which
+     * are respectively two 32-bit integers.
+     *
+     * @param[in] aP  the P value of the cipher
+     * @param[in] aG  the G value of the cipher
+     */
+    virtual void generateKey(uint32_t aP, uint32_t aG);
+
+    /**
+     * Use the base key of a shared context instead of generating it.
+     * The cipher holds a reference to the context until another key is set.
+     *
+     * @param[in] aContext  the context of the base key
+     */
+    virtual void setKeyContext(const TqKeyContext* aContext);
+
+    /**
+     * Bind the session to a NUMA node: the base key is read from its
+     * replica on the node.
+     *
+     * @param[in] aNode  the node (see TqNuma)
+     */
+    virtual void bindToNode(uint32_t aNode);
+
+    /**
+     * Generate an alternate key to use for the algorithm and reset
+     * the encryption counter.
+     *
+     * @param[in] aA  the A value of the cipher (Token)
+     * @param[in] aB  the B value of the cipher (AccountUID)
+     */
+    virtual void generateAltKey(int32_t aA, int32_t aB);
+
+    /**
+     * Encrypt n octet(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be encrypted
+     * @param[in]     aLen          the number of octets to encrypt
+     */
+    virtual void encrypt(uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Decrypt n octet(s) with the cipher.
+     *
+     * @param[in,out] aBuf          the buffer that will be decrypted
+     * @param[in]     aLen          the number of octets to decrypt
+     */
+    virtual void decrypt(uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Encrypt the octets of a region of a circular buffer, as one stream.
+     *
+     * @param[in,out] aRing         the region that will be encrypted
+     */
+    virtual void encrypt(const TqRingBuffer& aRing);
+
+    /**
+     * Decrypt the octets of a region of a circular buffer, as one stream.
+     *
+     * @param[in,out] aRing         the region that will be decrypted
+     */
+    virtual void decrypt(const TqRingBuffer& aRing);
+
+    /* the packets of a fixed size (see tqcipher_fixed.h) */
+    using TqCipher_Base::encrypt;
+    using TqCipher_Base::decrypt;
+
+    /**
+     * Reset the decrypt and the encrypt counters.
+     */
+    virtual void resetCounters() { mEnCounter = 0; mDeCounter = 0; }
+
+    /**
+     * Save the state of the cipher (counters and key seeds).
+     *
+     * @param[out] aState  the state of the cipher
+     */
+    virtual void saveState(TqCipherState& aState) const;
+
+    /**
+     * Restore a state previously saved by any implementation of the cipher.
+     * The base key must already be set and the alternate key is rebuilt
+     * from its seed.
+     *
+     * @param[in] aState  the state to restore
+     *
+     * @returns false if the state was saved with another base key
+     */
+    virtual bool restoreState(const TqCipherState& aState);
+
+    /**
+     * Create the encryptor of the session, starting at the encryption
+     * counter. The caller owns the stream.
+     *
+     * @returns the encryptor
+     */
+    virtual TqCipherStream* createEncryptor() const;
+
+    /**
+     * Create the decryptor of the session, starting at the decryption
+     * counter and using the current key. The caller owns the stream.
+     *
+     * @returns the decryptor
+     */
+    virtual TqCipherStream* createDecryptor() const;
+
+    /**
+     * Get the context of the base key, used for the encryption.
+     *
+     * @returns the context of the base key
+     */
+    virtual const TqKeyContext* getKeyContext() const { return mContext; }
+
+    /**
+     * Reserve the encryption counters of n octet(s), so another cipher can
+     * encrypt the octets on behalf of the session (see transcrypt).
+     *
+     * @param[in] aLen  the number of octets
+     *
+     * @returns the encryption counter of the first octet
+     */
+    virtual uint16_t reserveEncryption(size_t aLen)
+    {
+        uint16_t counter = mEnCounter;
+        mEnCounter = (uint16_t)(mEnCounter + aLen);
+        return counter;
+    }
+
+    /**
+     * Decrypt n octet(s) with the cipher and encrypt them with the target
+     * cipher in a single pass.
+     *
+     * @param[in,out] aTarget       the cipher encrypting the octets
+     * @param[in]     aIn           the octets to decrypt
+     * @param[out]    aOut          the encrypted octets (can be aIn)
+     * @param[in]     aLen          the number of octets to process
+     */
+    virtual void transcrypt(TqCipher_Base& aTarget, const uint8_t* aIn, uint8_t* aOut, size_t aLen);
+
+public:
+    /**
+     * Process (encrypt or decrypt) n octet(s) starting at a counter.
+     *
+     * @param[in]     aKey          the padded key (see TqKeyContext)
+     * @param[in]     aCounter      the counter of the first octet
+     * @param[in,out] aBuf          the buffer that will be processed
+     * @param[in]     aLen          the number of octets to process
+     *
+     * @returns the counter following the last octet
+     */
+    static uint16_t transform(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Process (encrypt or decrypt) the octets of a region of a circular
+     * buffer starting at a counter. Without masked tails, the octets left
+     * before the end of the buffer and the first octets after it are
+     * gathered in one vector, so only the tail of the region is scalar.
+     *
+     * @param[in]     aKey          the padded key (see TqKeyContext)
+     * @param[in]     aCounter      the counter of the first octet
+     * @param[in,out] aRing         the region that will be processed
+     *
+     * @returns the counter following the last octet
+     */
+    static uint16_t transformRing(const uint8_t* aKey, uint16_t aCounter, const TqRingBuffer& aRing);
+
+    /**
+     * Decrypt n octet(s) with a key and encrypt them with another one. As
+     * swap(swap(c ^ 0xAB) ^ k1 ^ 0xAB) ^ k2 = c ^ 0x11 ^ swap(k1) ^ k2, the
+     * octets are never swapped, only the first keystream.
+     *
+     * @param[in]  aSrcKey       the padded key of the decryption
+     * @param[in]  aSrcCounter   the decryption counter of the first octet
+     * @param[in]  aDstKey       the padded key of the encryption
+     * @param[in]  aDstCounter   the encryption counter of the first octet
+     * @param[in]  aIn           the octets to decrypt
+     * @param[out] aOut          the encrypted octets (can be aIn)
+     * @param[in]  aLen          the number of octets to process
+     */
+    static void transcrypt(const uint8_t* aSrcKey, uint16_t aSrcCounter,
+                           const uint8_t* aDstKey, uint16_t aDstCounter,
+                           const uint8_t* aIn, uint8_t* aOut, size_t aLen);
+
+    /**
+     * Encrypt the same n octet(s) for many sessions. The plaintext is masked
+     * and swapped once, then each copy is only XOR'ed with the keystream of
+     * its session. The octets are processed by tiles, so a masked tile stays
+     * in the cache while it is streamed to all the sessions.
+     *
+     * @param[in]     aBuf          the octets to encrypt
+     * @param[in]     aLen          the number of octets to encrypt
+     * @param[in,out] aTargets      the sessions and their buffers
+     * @param[in]     aCount        the number of sessions
+     */
+    static void broadcast(const uint8_t* aBuf, size_t aLen, TqBroadcastTarget* aTargets, size_t aCount);
+
+protected:
+    /**
+     * Reserve the counters of n octet(s) in a direction and get the key of
+     * the direction (see TqCipher_Base::reserve).
+     */
+    virtual const uint8_t* reserve(uint8_t aDirection, size_t aLen, uint16_t& aCounter)
+    {
+        if (aDirection == TqTap::DIRECTION_ENCRYPT)
+        {
+            aCounter = mEnCounter;
+            mEnCounter = (uint16_t)(mEnCounter + aLen);
+            return mKey;
+        }
+
+        aCounter = mDeCounter;
+        mDeCounter = (uint16_t)(mDeCounter + aLen);
+        return mUsingAltKey ? mAltKey : mKey;
+    }
+
+private:
+    uint16_t mEnCounter; //!< Internal encryption counter.
+    uint16_t mDeCounter; //!< Internal decryption counter.
+
+    const TqKeyContext* mContext; //!< Shared base key
+    const uint8_t* mKey; //!< Replica of the base key on the node of the session
+    uint32_t mNode; //!< NUMA node of the session
+    uint8_t mAltKey[TqKeyContext::SIZE]; //!< Alternative key
+    bool mUsingAltKey; //!< Whether or not the alternate key must be used
+
+    uint32_t mAltSeed; //!< Seed of the alternative key
+};
+
+#endif // _TQ_CIPHER_SIMD_H_
@@ -0,0 +1,528 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2014 - 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_SIMD_IMPL_H_
+#define _TQ_CIPHER_SIMD_IMPL_H_
+
+// Definitions of TqCipher_Simd. Only the translation unit of an instruction
+// set includes this file, then defines its traits and explicitly
+// instantiates the template with them, e.g.
+//
+//   struct TqSimd_SSE2 : public TqSimdGeneric<TqSimd_SSE2> { ... };
+//   template class TqCipher_Simd<TqSimd_SSE2>;
+//
+// A traits type provides:
+//
+//   Vector                     the vector type
+//   SIZE                       the number of octets of a vector
+//   MASKED_TAIL                whether the tail of a buffer is processed with
+//                              loadPartial / storePartial (else octet by octet)
+//   load(p), store(p, v)       unaligned load and store of a vector
+//   bxor(a, b)                 the XOR of two vectors
+//   set1(b)                    a vector filled with an octet
+//   split(a, b, n)             the first n octets are a, the others b (0 < n < SIZE)
+//   swapXor<C>(v)              swap the nibbles of each octet, then XOR with C
+//   loadPartial(p, n)          load the first n octets, the others are zero
+//   storePartial(p, v, n)      store the first n octets
+
+#include "tqcipher_simd.h"
+#include "tqcipher_stream.h"
+#include <string.h> // memset, memcpy
+#include <assert.h>
+
+/**
+ * Generic operations of the traits, for the instruction sets without masked
+ * loads and stores. Derived is the traits type (CRTP), providing Vector, SIZE,
+ * load and store. It is still incomplete when the base is instantiated, so the
+ * operations only look it up when they are called (T defaults to Derived).
+ */
+template <class Derived>
+struct TqSimdGeneric
+{
+    static const bool MASKED_TAIL = false;
+
+    template <class T = Derived>
+    static __forceinline typename T::Vector
+    loadPartial(const void* aPtr, size_t aLen)
+    {
+        uint8_t tmp[T::SIZE];
+        memset(tmp, 0, sizeof(tmp));
+        memcpy(tmp, aPtr, aLen);
+        return T::load(tmp);
+    }
+
+    template <class T = Derived>
+    static __forceinline void
+    storePartial(void* aPtr, typename T::Vector aX, size_t aLen)
+    {
+        uint8_t tmp[T::SIZE];
+        T::store(tmp, aX);
+        memcpy(aPtr, tmp, aLen);
+    }
+};
+
+/**
+ * Load the keystream (key1 ^ key2) of a vector at a counter.
+ */
+template <class Traits>
+static __forceinline typename Traits::Vector
+loadKeystream(const uint8_t* aKey, uint16_t aCounter)
+{
+    const uint8_t* key1 = aKey;
+    const uint8_t* key2 = key1 + TqKeyContext::HALF_SIZE;
+
+    typename Traits::Vector x = Traits::load(&key1[(uint8_t)aCounter]);
+    typename Traits::Vector y;
+
+    size_t n = 0x100 - aCounter % 0x100;
+    if (n >= Traits::SIZE)
+        y = Traits::set1(key2[(uint8_t)(aCounter >> 8)]);
+    else
+        y = Traits::split(key2[(uint8_t)(aCounter >> 8)], key2[(uint8_t)(aCounter >> 8) + 1], n);
+
+    return Traits::bxor(x, y);
+}
+
+/** The number of counters sharing the same key2 octet. */
+static const size_t TQ_SIMD_PAGE_SIZE = 0x100;
+
+/**
+ * Process the first n vectors of a run of counters sharing the same key2
+ * octet. The vectors are unrolled at compile time, so a whole page has no
+ * branch.
+ */
+template <class Traits, size_t N>
+struct TqSimdRun
+{
+    static __forceinline void
+    process(uint8_t* aBuf, const uint8_t* aKey1, typename Traits::Vector aKey2)
+    {
+        TqSimdRun<Traits, N - 1>::process(aBuf, aKey1, aKey2);
+
+        uint8_t* buf = aBuf + (N - 1) * Traits::SIZE;
+        typename Traits::Vector w = Traits::template swapXor<0xBA>(Traits::load(buf));
+        typename Traits::Vector k = Traits::bxor(Traits::load(aKey1 + (N - 1) * Traits::SIZE), aKey2);
+        Traits::store(buf, Traits::bxor(w, k));
+    }
+};
+
+template <class Traits>
+struct TqSimdRun<Traits, 0>
+{
+    static __forceinline void
+    process(uint8_t*, const uint8_t*, typename Traits::Vector) { }
+};
+
+template <class Traits>
+TqCipher_Simd<Traits> :: TqCipher_Simd()
+    : mEnCounter(0), mDeCounter(0),
+      mContext(TqKeyContext::acquire(0, 0)), // zero-filled key
+      mKey(nullptr), mNode(TqNuma::getCurrentNode()),
+      mUsingAltKey(false), mAltSeed(0)
+{
+    mKey = mContext->getKey(mNode);
+
+    // security purpose only...
+    memset(mAltKey, 0, sizeof(mAltKey));
+}
+
+template <class Traits>
+TqCipher_Simd<Traits> :: ~TqCipher_Simd()
+{
+    mContext->release();
+    mContext = nullptr;
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: generateKey(uint32_t aP, uint32_t aG)
+{
+    const TqKeyContext* context = TqKeyContext::acquire(aP, aG);
+    setKeyContext(context);
+    context->release();
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: setKeyContext(const TqKeyContext* aContext)
+{
+    aContext->addRef();
+    mContext->release();
+    mContext = aContext;
+    mKey = mContext->getKey(mNode);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: bindToNode(uint32_t aNode)
+{
+    mNode = aNode;
+    mKey = mContext->getKey(mNode);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: generateAltKey(int32_t aA, int32_t aB)
+{
+    mAltSeed = (uint32_t)(((aA + aB) ^ 0x4321) ^ aA);
+    mContext->expandAltKey(mAltKey, mAltSeed);
+
+    mUsingAltKey = true;
+    mEnCounter = 0;
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: saveState(TqCipherState& aState) const
+{
+    aState.flags = mUsingAltKey ? TqCipherState::FLAG_ALT_KEY : 0;
+    aState.enCounter = mEnCounter;
+    aState.deCounter = mDeCounter;
+    aState.altSeed = mUsingAltKey ? mAltSeed : 0;
+    aState.keyId = mContext->getKeyId();
+}
+
+template <class Traits>
+bool
+TqCipher_Simd<Traits> :: restoreState(const TqCipherState& aState)
+{
+    if (aState.keyId != mContext->getKeyId())
+        return false;
+
+    mUsingAltKey = (aState.flags & TqCipherState::FLAG_ALT_KEY) != 0;
+    if (mUsingAltKey)
+    {
+        mAltSeed = aState.altSeed;
+        mContext->expandAltKey(mAltKey, mAltSeed);
+    }
+
+    mEnCounter = aState.enCounter;
+    mDeCounter = aState.deCounter;
+    return true;
+}
+
+template <class Traits>
+TqCipherStream*
+TqCipher_Simd<Traits> :: createEncryptor() const
+{
+    return new TqCipherStream(&TqCipher_Simd::transform, mContext, nullptr, mEnCounter);
+}
+
+template <class Traits>
+TqCipherStream*
+TqCipher_Simd<Traits> :: createDecryptor() const
+{
+    return new TqCipherStream(&TqCipher_Simd::transform, mContext, mUsingAltKey ? mAltKey : nullptr, mDeCounter);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: encrypt(uint8_t* aBuf, size_t aLen)
+{
+    tap(TqTap::DIRECTION_ENCRYPT, mEnCounter, aBuf, aLen);
+    mEnCounter = transform(mKey, mEnCounter, aBuf, aLen);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: decrypt(uint8_t* aBuf, size_t aLen)
+{
+    uint16_t counter = mDeCounter;
+    mDeCounter = transform(mUsingAltKey ? mAltKey : mKey, counter, aBuf, aLen);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aBuf, aLen);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: encrypt(const TqRingBuffer& aRing)
+{
+    tap(TqTap::DIRECTION_ENCRYPT, mEnCounter, aRing);
+    mEnCounter = transformRing(mKey, mEnCounter, aRing);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: decrypt(const TqRingBuffer& aRing)
+{
+    uint16_t counter = mDeCounter;
+    mDeCounter = transformRing(mUsingAltKey ? mAltKey : mKey, counter, aRing);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aRing);
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: transcrypt(TqCipher_Base& aTarget, const uint8_t* aIn, uint8_t* aOut, size_t aLen)
+{
+    uint16_t counter = aTarget.reserveEncryption(aLen);
+    transcrypt(mUsingAltKey ? mAltKey : mKey, mDeCounter,
+               aTarget.getKeyContext()->getKey(mNode), counter,
+               aIn, aOut, aLen);
+    mDeCounter = (uint16_t)(mDeCounter + aLen);
+}
+
+template <class Traits>
+uint16_t
+TqCipher_Simd<Traits> :: transform(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf, size_t aLen)
+{
+    typedef typename Traits::Vector Vector;
+
+    assert(aBuf != nullptr);
+    assert(aLen > 0);
+
+    uint16_t counter = aCounter;
+    uint8_t* buf = aBuf;
+    size_t len = aLen;
+
+    const uint8_t* key1 = aKey;
+    const uint8_t* key2 = key1 + TqKeyContext::HALF_SIZE;
+
+    // the encryption and the decryption are the same: as swap(x ^ 0xAB) =
+    // swap(x) ^ 0xBA, each octet is swapped then XOR'ed with the keystream
+    //
+    // the buffer is processed by pages of 256 counters, sharing the same key2
+    // octet: it is broadcast once per page, a whole page is unrolled, and only
+    // the vector crossing into the next page (if any) blends two key2 octets
+    while (len >= Traits::SIZE)
+    {
+        size_t pos = (uint8_t)counter;
+        uint8_t page = (uint8_t)(counter >> 8);
+        Vector y = Traits::set1(key2[page]);
+
+        if (pos == 0 && len >= TQ_SIMD_PAGE_SIZE)
+        {
+            TqSimdRun<Traits, TQ_SIMD_PAGE_SIZE / Traits::SIZE>::process(buf, key1, y);
+
+            buf += TQ_SIMD_PAGE_SIZE;
+            len -= TQ_SIMD_PAGE_SIZE;
+            counter = (uint16_t)(counter + TQ_SIMD_PAGE_SIZE);
+            continue;
+        }
+
+        size_t count = (TQ_SIMD_PAGE_SIZE - pos) / Traits::SIZE;
+        if (count > len / Traits::SIZE)
+            count = len / Traits::SIZE;
+
+        for (size_t i = 0; i < count; ++i)
+            TqSimdRun<Traits, 1>::process(buf + i * Traits::SIZE, key1 + pos + i * Traits::SIZE, y);
+
+        buf += count * Traits::SIZE;
+        len -= count * Traits::SIZE;
+        pos += count * Traits::SIZE;
+
+        // the padding of key1 covers a whole vector past the end of the page
+        size_t n = TQ_SIMD_PAGE_SIZE - pos;
+        if (n != 0 && n < Traits::SIZE && len >= Traits::SIZE)
+        {
+            y = Traits::split(key2[page], key2[page + 1], n);
+            TqSimdRun<Traits, 1>::process(buf, key1 + pos, y);
+
+            buf += Traits::SIZE;
+            len -= Traits::SIZE;
+            pos += Traits::SIZE;
+        }
+
+        counter = (uint16_t)((page << 8) + pos);
+    }
+
+    if (len != 0 && Traits::MASKED_TAIL)
+    {
+        Vector w = Traits::template swapXor<0xBA>(Traits::loadPartial(buf, len));
+        Traits::storePartial(buf, Traits::bxor(w, loadKeystream<Traits>(aKey, counter)), len);
+
+        counter = (uint16_t)(counter + len);
+    }
+    else
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            buf[i] ^= UINT8_C(0xAB);
+            buf[i] = (uint8_t)(buf[i] << 4 | buf[i] >> 4);
+            buf[i] ^= key1[(uint8_t)counter];
+            buf[i] ^= key2[(uint8_t)(counter >> 8)];
+            ++counter;
+        }
+    }
+
+    return counter;
+}
+
+template <class Traits>
+uint16_t
+TqCipher_Simd<Traits> :: transformRing(const uint8_t* aKey, uint16_t aCounter, const TqRingBuffer& aRing)
+{
+    typedef typename Traits::Vector Vector;
+
+    assert(aRing.base != nullptr);
+    assert(aRing.head < aRing.capacity && aRing.length <= aRing.capacity);
+    assert(aRing.length > 0);
+
+    uint8_t* head = aRing.base + aRing.head;
+    size_t before = aRing.capacity - aRing.head; // octets before the end of the buffer
+    if (aRing.length <= before)
+        return transform(aKey, aCounter, head, aRing.length);
+
+    size_t after = aRing.length - before;
+    uint16_t counter = aCounter;
+
+    // the octets of the vector straddling the end of the buffer (none when
+    // the tails are masked, the two parts are processed as they are)
+    size_t first = Traits::MASKED_TAIL ? 0 : before % Traits::SIZE;
+    size_t second = first == 0 ? 0 : (after < Traits::SIZE - first ? after : Traits::SIZE - first);
+
+    if (before != first)
+        counter = transform(aKey, counter, head, before - first);
+
+    if (first != 0)
+    {
+        uint8_t window[Traits::SIZE];
+        memcpy(window, head + before - first, first);
+        memcpy(window + first, aRing.base, second);
+
+        if (first + second == Traits::SIZE)
+        {
+            Vector w = Traits::template swapXor<0xBA>(Traits::load(window));
+            Traits::store(window, Traits::bxor(w, loadKeystream<Traits>(aKey, counter)));
+            counter = (uint16_t)(counter + Traits::SIZE);
+        }
+        else
+            counter = transform(aKey, counter, window, first + second);
+
+        memcpy(head + before - first, window, first);
+        memcpy(aRing.base, window + first, second);
+    }
+
+    if (after != second)
+        counter = transform(aKey, counter, aRing.base + second, after - second);
+
+    return counter;
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: transcrypt(const uint8_t* aSrcKey, uint16_t aSrcCounter,
+                                    const uint8_t* aDstKey, uint16_t aDstCounter,
+                                    const uint8_t* aIn, uint8_t* aOut, size_t aLen)
+{
+    typedef typename Traits::Vector Vector;
+
+    assert(aIn != nullptr && aOut != nullptr);
+    assert(aLen > 0);
+
+    uint16_t srcCounter = aSrcCounter;
+    uint16_t dstCounter = aDstCounter;
+    Vector k;
+
+    size_t count = aLen / Traits::SIZE;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // the constant 0x11 is folded in the swap of the first keystream
+        k = Traits::template swapXor<0x11>(loadKeystream<Traits>(aSrcKey, srcCounter));
+        k = Traits::bxor(k, loadKeystream<Traits>(aDstKey, dstCounter));
+
+        Traits::store(aOut + i * Traits::SIZE, Traits::bxor(Traits::load(aIn + i * Traits::SIZE), k));
+
+        srcCounter = (uint16_t)(srcCounter + Traits::SIZE);
+        dstCounter = (uint16_t)(dstCounter + Traits::SIZE);
+    }
+
+    size_t tail = aLen % Traits::SIZE;
+    if (tail != 0 && Traits::MASKED_TAIL)
+    {
+        k = Traits::template swapXor<0x11>(loadKeystream<Traits>(aSrcKey, srcCounter));
+        k = Traits::bxor(k, loadKeystream<Traits>(aDstKey, dstCounter));
+
+        size_t offset = aLen - tail;
+        Traits::storePartial(aOut + offset, Traits::bxor(Traits::loadPartial(aIn + offset, tail), k), tail);
+    }
+    else if (tail != 0)
+    {
+        const uint8_t* srcKey1 = aSrcKey;
+        const uint8_t* srcKey2 = srcKey1 + TqKeyContext::HALF_SIZE;
+        const uint8_t* dstKey1 = aDstKey;
+        const uint8_t* dstKey2 = dstKey1 + TqKeyContext::HALF_SIZE;
+
+        for (size_t i = aLen - tail; i < aLen; ++i)
+        {
+            uint8_t b = (uint8_t)(srcKey1[(uint8_t)srcCounter] ^ srcKey2[(uint8_t)(srcCounter >> 8)]);
+            b = (uint8_t)(b << 4 | b >> 4);
+            b ^= dstKey1[(uint8_t)dstCounter];
+            b ^= dstKey2[(uint8_t)(dstCounter >> 8)];
+            aOut[i] = (uint8_t)(aIn[i] ^ UINT8_C(0x11) ^ b);
+            ++srcCounter;
+            ++dstCounter;
+        }
+    }
+}
+
+template <class Traits>
+void
+TqCipher_Simd<Traits> :: broadcast(const uint8_t* aBuf, size_t aLen, TqBroadcastTarget* aTargets, size_t aCount)
+{
+    typedef typename Traits::Vector Vector;
+
+    assert(aBuf != nullptr);
+    assert(aTargets != nullptr || aCount == 0);
+
+    static const size_t TILE_SIZE = 2048;
+    Vector tile[TILE_SIZE / sizeof(Vector)];
+    uint8_t* bytes = (uint8_t*)tile;
+
+    // the keys are read from their replicas on the node of the caller
+    uint32_t node = TqNuma::getCurrentNode();
+
+    for (size_t i = 0; i < aCount; ++i)
+        aTargets[i].counter = aTargets[i].cipher->reserveEncryption(aLen);
+
+    for (size_t offset = 0; offset < aLen; offset += TILE_SIZE)
+    {
+        size_t len = aLen - offset < TILE_SIZE ? aLen - offset : TILE_SIZE;
+        size_t count = len / Traits::SIZE;
+        size_t tail = len % Traits::SIZE;
+        const uint8_t* in = aBuf + offset;
+
+        for (size_t i = 0; i < count; ++i)
+            tile[i] = Traits::template swapXor<0xBA>(Traits::load(in + i * Traits::SIZE));
+        if (tail != 0 && Traits::MASKED_TAIL)
+            tile[count] = Traits::template swapXor<0xBA>(Traits::loadPartial(in + count * Traits::SIZE, tail));
+        else
+        {
+            for (size_t i = count * Traits::SIZE; i < len; ++i)
+            {
+                uint8_t b = (uint8_t)(in[i] ^ UINT8_C(0xAB));
+                bytes[i] = (uint8_t)(b << 4 | b >> 4);
+            }
+        }
+
+        for (size_t t = 0; t < aCount; ++t)
+        {
+            const uint8_t* key1 = aTargets[t].cipher->getKeyContext()->getKey(node);
+            const uint8_t* key2 = key1 + TqKeyContext::HALF_SIZE;
+            uint16_t counter = (uint16_t)(aTargets[t].counter + offset);
+            uint8_t* out = aTargets[t].out + offset;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                Traits::store(out + i * Traits::SIZE, Traits::bxor(tile[i], loadKeystream<Traits>(key1, counter)));
+                counter = (uint16_t)(counter + Traits::SIZE);
+            }
+            if (tail != 0 && Traits::MASKED_TAIL)
+                Traits::storePartial(out + count * Traits::SIZE,
+                                     Traits::bxor(tile[count], loadKeystream<Traits>(key1, counter)), tail);
+            else
+            {
+                for (size_t i = count * Traits::SIZE; i < len; ++i)
+                {
+                    out[i] = (uint8_t)(bytes[i] ^ key1[(uint8_t)counter] ^ key2[(uint8_t)(counter >> 8)]);
+                    ++counter;
+                }
+            }
+        }
+    }
+}
+
+#endif // _TQ_CIPHER_SIMD_IMPL_H_
@@ -0,0 +1,115 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_STATE_H_
+#define _TQ_CIPHER_STATE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Snapshot of the state of a TQ cipher session.
+ *
+ * The keys are not part of the snapshot. Only the seeds needed to rebuild
+ * them are kept, so a session can be restored by any process knowing the
+ * base key (P & G) the session was created with.
+ *
+ * Serialized layout (16 octets, little-endian):
+ *   [0]      version
+ *   [1]      flags (FLAG_ALT_KEY)
+ *   [2..3]   encryption counter
+ *   [4..5]   decryption counter
+ *   [6..7]   reserved (zero)
+ *   [8..11]  seed of the alternate key
+ *   [12..15] identifier of the base key
+ */
+struct TqCipherState
+{
+    /** The version of the serialized layout. */
+    static const uint8_t VERSION = 1;
+    /** The size of a serialized state in bytes. */
+    static const size_t SIZE = 16;
+
+    /** The alternate key is used for decryption. */
+    static const uint8_t FLAG_ALT_KEY = 0x01;
+
+    uint8_t flags; //!< Combination of FLAG_* values.
+    uint16_t enCounter; //!< Encryption counter.
+    uint16_t deCounter; //!< Decryption counter.
+    uint32_t altSeed; //!< Seed of the alternate key (if any).
+    uint32_t keyId; //!< Identifier of the base key.
+
+    /**
+     * Compute the identifier of the base key generated from the P & G
+     * integers. It is only used to refuse snapshots of another realm.
+     *
+     * @param[in] aP  the P value of the cipher
+     * @param[in] aG  the G value of the cipher
+     *
+     * @returns the identifier of the key
+     */
+    static uint32_t computeKeyId(uint32_t aP, uint32_t aG)
+    {
+        uint32_t h = UINT32_C(0x811C9DC5);
+        h = (h ^ aP) * UINT32_C(0x01000193);
+        h = (h ^ aG) * UINT32_C(0x01000193);
+        return h ^ (h >> 15);
+    }
+
+    /**
+     * Serialize the state.
+     *
+     * @param[out] aOut  the buffer receiving SIZE octets
+     */
+    void write(uint8_t* aOut) const
+    {
+        aOut[0] = VERSION;
+        aOut[1] = flags;
+        aOut[2] = (uint8_t)(enCounter);
+        aOut[3] = (uint8_t)(enCounter >> 8);
+        aOut[4] = (uint8_t)(deCounter);
+        aOut[5] = (uint8_t)(deCounter >> 8);
+        aOut[6] = 0;
+        aOut[7] = 0;
+        for (size_t i = 0; i < sizeof(uint32_t); ++i)
+        {
+            aOut[8 + i] = (uint8_t)(altSeed >> (8 * i));
+            aOut[12 + i] = (uint8_t)(keyId >> (8 * i));
+        }
+    }
+
+    /**
+     * Deserialize a state.
+     *
+     * @param[in] aIn  the buffer holding SIZE octets
+     *
+     * @returns false if the version or the flags are unknown, or if the
+     *          reserved octets are used
+     */
+    bool read(const uint8_t* aIn)
+    {
+        if (aIn[0] != VERSION || (aIn[1] & ~FLAG_ALT_KEY) != 0)
+            return false;
+        if (aIn[6] != 0 || aIn[7] != 0)
+            return false;
+
+        flags = aIn[1];
+        enCounter = (uint16_t)(aIn[2] | aIn[3] << 8);
+        deCounter = (uint16_t)(aIn[4] | aIn[5] << 8);
+        altSeed = 0;
+        keyId = 0;
+        for (size_t i = 0; i < sizeof(uint32_t); ++i)
+        {
+            altSeed |= (uint32_t)aIn[8 + i] << (8 * i);
+            keyId |= (uint32_t)aIn[12 + i] << (8 * i);
+        }
+        return true;
+    }
+};
+
+#endif // _TQ_CIPHER_STATE_H_
@@ -7,99 +7,294 @@
  */
 
 #include "tqcipher_std.h"
-#include <string.h> // memset
+#include "tqcipher_stream.h"
+#include <string.h> // memset, memcpy
 #include <assert.h>
 
 TqCipher_Std :: TqCipher_Std()
     : mEnCounter(0), mDeCounter(0),
-      mUsingAltKey(false)
+      mContext(TqKeyContext::acquire(0, 0)), // zero-filled key
+      mKey(nullptr), mNode(TqNuma::getCurrentNode()),
+      mUsingAltKey(false), mAltSeed(0)
 {
+    mKey = mContext->getKey(mNode);
+
     // security purpose only...
-    memset(mKey, 0, sizeof(mKey));
     memset(mAltKey, 0, sizeof(mAltKey));
 }
 
-// there is a bug with VS2013 optimization algorithm, making the second key generation fails
-#pragma optimize( "", off )
+TqCipher_Std :: ~TqCipher_Std()
+{
+    mContext->release();
+    mContext = nullptr;
+}
+
 void
 TqCipher_Std :: generateKey(uint32_t aP, uint32_t aG)
 {
-    uint8_t* p = (uint8_t*)&aP;
-    uint8_t* g = (uint8_t*)&aG;
+    const TqKeyContext* context = TqKeyContext::acquire(aP, aG);
+    setKeyContext(context);
+    context->release();
+}
 
-    uint8_t* key1 = mKey;
-    uint8_t* key2 = key1 + (KEY_SIZE  / 2);
+void
+TqCipher_Std :: setKeyContext(const TqKeyContext* aContext)
+{
+    aContext->addRef();
+    mContext->release();
+    mContext = aContext;
+    mKey = mContext->getKey(mNode);
+}
 
-    for (size_t i = 0, len = (KEY_SIZE  / 2); i < len; ++i)
-    {
-        key1[i] = p[0];
-        key2[i] = g[0];
-        p[0] = (uint8_t)((p[1] + (uint8_t)(p[0] * p[2])) * p[0] + p[3]);
-        g[0] = (uint8_t)((g[1] - (uint8_t)(g[0] * g[2])) * g[0] + g[3]);
-    }
+void
+TqCipher_Std :: bindToNode(uint32_t aNode)
+{
+    mNode = aNode;
+    mKey = mContext->getKey(mNode);
 }
-#pragma optimize( "", on ) 
 
 void
 TqCipher_Std :: generateAltKey(int32_t aA, int32_t aB)
 {
-    uint32_t x = (uint32_t)(((aA + aB) ^ 0x4321) ^ aA);
-    uint32_t y = x * x;
+    mAltSeed = (uint32_t)(((aA + aB) ^ 0x4321) ^ aA);
+    mContext->expandAltKey(mAltKey, mAltSeed);
 
-    uint8_t* tmpKey1 = (uint8_t*)&x;
-    uint8_t* tmpKey2 = (uint8_t*)&y;
+    mUsingAltKey = true;
+    mEnCounter = 0;
+}
+
+void
+TqCipher_Std :: saveState(TqCipherState& aState) const
+{
+    aState.flags = mUsingAltKey ? TqCipherState::FLAG_ALT_KEY : 0;
+    aState.enCounter = mEnCounter;
+    aState.deCounter = mDeCounter;
+    aState.altSeed = mUsingAltKey ? mAltSeed : 0;
+    aState.keyId = mContext->getKeyId();
+}
 
-    uint8_t* key1 = mKey;
-    uint8_t* key2 = key1 + (KEY_SIZE  / 2);
-    uint8_t* altKey1 = mAltKey;
-    uint8_t* altKey2 = altKey1 + (KEY_SIZE  / 2);
+bool
+TqCipher_Std :: restoreState(const TqCipherState& aState)
+{
+    if (aState.keyId != mContext->getKeyId())
+        return false;
 
-    for (size_t i = 0, len = (KEY_SIZE / 2); i < len; ++i)
+    mUsingAltKey = (aState.flags & TqCipherState::FLAG_ALT_KEY) != 0;
+    if (mUsingAltKey)
     {
-        altKey1[i] = (uint8_t)(key1[i] ^ tmpKey1[(i % sizeof(x))]);
-        altKey2[i] = (uint8_t)(key2[i] ^ tmpKey2[(i % sizeof(y))]);
+        mAltSeed = aState.altSeed;
+        mContext->expandAltKey(mAltKey, mAltSeed);
     }
 
-    mUsingAltKey = true;
-    mEnCounter = 0;
+    mEnCounter = aState.enCounter;
+    mDeCounter = aState.deCounter;
+    return true;
+}
+
+TqCipherStream*
+TqCipher_Std :: createEncryptor() const
+{
+    return new TqCipherStream(&TqCipher_Std::transform, mContext, nullptr, mEnCounter);
+}
+
+TqCipherStream*
+TqCipher_Std :: createDecryptor() const
+{
+    return new TqCipherStream(&TqCipher_Std::transform, mContext, mUsingAltKey ? mAltKey : nullptr, mDeCounter);
 }
 
 void
 TqCipher_Std :: encrypt(uint8_t* aBuf, size_t aLen)
+{
+    tap(TqTap::DIRECTION_ENCRYPT, mEnCounter, aBuf, aLen);
+    mEnCounter = transform(mKey, mEnCounter, aBuf, aLen);
+}
+
+void
+TqCipher_Std :: decrypt(uint8_t* aBuf, size_t aLen)
+{
+    uint16_t counter = mDeCounter;
+    mDeCounter = transform(mUsingAltKey ? mAltKey : mKey, counter, aBuf, aLen);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aBuf, aLen);
+}
+
+void
+TqCipher_Std :: encrypt(const TqRingBuffer& aRing)
+{
+    tap(TqTap::DIRECTION_ENCRYPT, mEnCounter, aRing);
+    mEnCounter = transformRing(mKey, mEnCounter, aRing);
+}
+
+void
+TqCipher_Std :: decrypt(const TqRingBuffer& aRing)
+{
+    uint16_t counter = mDeCounter;
+    mDeCounter = transformRing(mUsingAltKey ? mAltKey : mKey, counter, aRing);
+    tap(TqTap::DIRECTION_DECRYPT, counter, aRing);
+}
+
+void
+TqCipher_Std :: transcrypt(TqCipher_Base& aTarget, const uint8_t* aIn, uint8_t* aOut, size_t aLen)
+{
+    uint16_t counter = aTarget.reserveEncryption(aLen);
+    transcrypt(mUsingAltKey ? mAltKey : mKey, mDeCounter,
+               aTarget.getKeyContext()->getKey(mNode), counter,
+               aIn, aOut, aLen);
+    mDeCounter = (uint16_t)(mDeCounter + aLen);
+}
+
+uint16_t
+TqCipher_Std :: transform(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf, size_t aLen)
 {
     assert(aBuf != nullptr);
     assert(aLen > 0);
 
-    uint8_t* key1 = mKey;
-    uint8_t* key2 = key1 + (KEY_SIZE  / 2);
+    uint16_t counter = aCounter;
+
+    const uint8_t* key1 = aKey;
+    const uint8_t* key2 = key1 + TqKeyContext::HALF_SIZE;
 
     for (size_t i = 0; i < aLen; ++i)
     {
         aBuf[i] ^= UINT8_C(0xAB);
         aBuf[i] = (uint8_t)(aBuf[i] << 4 | aBuf[i] >> 4);
-        aBuf[i] ^= key1[(uint8_t)mEnCounter];
-        aBuf[i] ^= key2[(uint8_t)(mEnCounter >> 8)];
-        ++mEnCounter;
+        aBuf[i] ^= key1[(uint8_t)counter];
+        aBuf[i] ^= key2[(uint8_t)(counter >> 8)];
+        ++counter;
     }
+
+    return counter;
 }
 
-#include <stdio.h>
+uint16_t
+TqCipher_Std :: transformRing(const uint8_t* aKey, uint16_t aCounter, const TqRingBuffer& aRing)
+{
+    assert(aRing.base != nullptr);
+    assert(aRing.head < aRing.capacity && aRing.length <= aRing.capacity);
+    assert(aRing.length > 0);
+
+    size_t before = aRing.capacity - aRing.head; // octets before the end of the buffer
+    if (aRing.length <= before)
+        return transform(aKey, aCounter, aRing.base + aRing.head, aRing.length);
+
+    uint16_t counter = transform(aKey, aCounter, aRing.base + aRing.head, before);
+    return transform(aKey, counter, aRing.base, aRing.length - before);
+}
 
 void
-TqCipher_Std :: decrypt(uint8_t* aBuf, size_t aLen)
+TqCipher_Std :: transcrypt(const uint8_t* aSrcKey, uint16_t aSrcCounter,
+                           const uint8_t* aDstKey, uint16_t aDstCounter,
+                           const uint8_t* aIn, uint8_t* aOut, size_t aLen)
 {
-    assert(aBuf != nullptr);
+    assert(aIn != nullptr && aOut != nullptr);
     assert(aLen > 0);
 
-    uint8_t* key1 = mUsingAltKey ? mAltKey : mKey;
-    uint8_t* key2 = key1 + (KEY_SIZE  / 2);
+    uint16_t srcCounter = aSrcCounter;
+    uint16_t dstCounter = aDstCounter;
+
+    const uint8_t* srcKey1 = aSrcKey;
+    const uint8_t* srcKey2 = srcKey1 + TqKeyContext::HALF_SIZE;
+    const uint8_t* dstKey1 = aDstKey;
+    const uint8_t* dstKey2 = dstKey1 + TqKeyContext::HALF_SIZE;
 
     for (size_t i = 0; i < aLen; ++i)
     {
-        aBuf[i] ^= UINT8_C(0xAB);
-        aBuf[i] = (uint8_t)(aBuf[i] << 4 | aBuf[i] >> 4);
-        aBuf[i] ^= key1[(uint8_t)mDeCounter];
-        aBuf[i] ^= key2[(uint8_t)(mDeCounter >> 8)];
-        ++mDeCounter;
+        uint8_t k = (uint8_t)(srcKey1[(uint8_t)srcCounter] ^ srcKey2[(uint8_t)(srcCounter >> 8)]);
+        k = (uint8_t)(k << 4 | k >> 4);
+        k ^= dstKey1[(uint8_t)dstCounter];
+        k ^= dstKey2[(uint8_t)(dstCounter >> 8)];
+        aOut[i] = (uint8_t)(aIn[i] ^ UINT8_C(0x11) ^ k);
+        ++srcCounter;
+        ++dstCounter;
     }
-}
\ No newline at end of file
+}
+
+void
+TqCipher_Std :: broadcast(const uint8_t* aBuf, size_t aLen, TqBroadcastTarget* aTargets, size_t aCount)
+{
+    assert(aBuf != nullptr);
+    assert(aTargets != nullptr || aCount == 0);
+
+    static const size_t TILE_SIZE = 2048;
+    uint8_t tile[TILE_SIZE];
+
+    // the keys are read from their replicas on the node of the caller
+    uint32_t node = TqNuma::getCurrentNode();
+
+    for (size_t i = 0; i < aCount; ++i)
+        aTargets[i].counter = aTargets[i].cipher->reserveEncryption(aLen);
+
+    for (size_t offset = 0; offset < aLen; offset += TILE_SIZE)
+    {
+        size_t len = aLen - offset < TILE_SIZE ? aLen - offset : TILE_SIZE;
+
+        for (size_t i = 0; i < len; ++i)
+        {
+            uint8_t b = (uint8_t)(aBuf[offset + i] ^ UINT8_C(0xAB));
+            tile[i] = (uint8_t)(b << 4 | b >> 4);
+        }
+
+        for (size_t t = 0; t < aCount; ++t)
+        {
+            const uint8_t* key1 = aTargets[t].cipher->getKeyContext()->getKey(node);
+            const uint8_t* key2 = key1 + TqKeyContext::HALF_SIZE;
+            uint16_t counter = (uint16_t)(aTargets[t].counter + offset);
+            uint8_t* out = aTargets[t].out + offset;
+
+            for (size_t i = 0; i < len; ++i)
+            {
+                out[i] = (uint8_t)(tile[i] ^ key1[(uint8_t)counter] ^ key2[(uint8_t)(counter >> 8)]);
+                ++counter;
+            }
+        }
+    }
+}
+
+void
+TqCipher_Std :: patch(uint8_t* aBuf, const uint8_t* aOld, const uint8_t* aNew, size_t aLen)
+{
+    assert(aBuf != nullptr && aOld != nullptr && aNew != nullptr);
+
+    static const uint64_t LOW = UINT64_C(0x0F0F0F0F0F0F0F0F);
+
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= aLen; i += sizeof(uint64_t))
+    {
+        uint64_t x, y, c;
+        memcpy(&x, aOld + i, sizeof(x));
+        memcpy(&y, aNew + i, sizeof(y));
+        memcpy(&c, aBuf + i, sizeof(c));
+
+        uint64_t d = x ^ y;
+        c ^= (d & LOW) << 4 | (d >> 4 & LOW);
+        memcpy(aBuf + i, &c, sizeof(c));
+    }
+
+    for (; i < aLen; ++i)
+    {
+        uint8_t d = (uint8_t)(aOld[i] ^ aNew[i]);
+        aBuf[i] ^= (uint8_t)(d << 4 | d >> 4);
+    }
+}
+
+void
+TqCipher_Std :: patch(const TqRingBuffer& aRing, size_t aOffset, const uint8_t* aOld, const uint8_t* aNew, size_t aLen)
+{
+    assert(aRing.base != nullptr);
+    assert(aRing.head < aRing.capacity && aRing.length <= aRing.capacity);
+    assert(aOffset + aLen <= aRing.length);
+
+    size_t start = aRing.head + aOffset;
+    if (start >= aRing.capacity)
+        start -= aRing.capacity;
+
+    size_t before = aRing.capacity - start; // octets before the end of the buffer
+    if (aLen <= before)
+    {
+        patch(aRing.base + start, aOld, aNew, aLen);
+        return;
+    }
+
+    patch(aRing.base + start, aOld, aNew, before);
+    patch(aRing.base, aOld + before, aNew + before, aLen - before);
+}
@@ -0,0 +1,84 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqcipher_stream.h"
+#include <string.h> // memcpy
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h> // _aligned_malloc
+#endif
+#include <new>
+
+#pragma unmanaged
+
+TqCipherStream :: TqCipherStream(Kernel aKernel, const TqKeyContext* aContext, const uint8_t* aAltKey, uint16_t aCounter)
+    : mKernel(aKernel), mKey(nullptr), mPosition(aCounter), mContext(aContext)
+{
+    mContext->addRef();
+
+    if (aAltKey != nullptr)
+    {
+        memcpy(mAltKey, aAltKey, sizeof(mAltKey));
+        mKey = mAltKey;
+    }
+    else
+    {
+        // security purpose only...
+        memset(mAltKey, 0, sizeof(mAltKey));
+        mKey = mContext->getKey(TqNuma::getCurrentNode());
+    }
+}
+
+TqCipherStream :: ~TqCipherStream()
+{
+    mContext->release();
+    mContext = nullptr;
+}
+
+void*
+TqCipherStream :: operator new(size_t aSize)
+{
+    // round up the size, so the next allocation can't share the last line
+    size_t size = (aSize + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+
+    #ifdef _WIN32
+    void* ptr = _aligned_malloc(size, CACHE_LINE_SIZE);
+    #else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+        ptr = nullptr;
+    #endif
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+void
+TqCipherStream :: operator delete(void* aPtr)
+{
+    #ifdef _WIN32
+    _aligned_free(aPtr);
+    #else
+    free(aPtr);
+    #endif
+}
+
+size_t
+TqCipherStream :: findCounters(const uint8_t* aWindow, size_t aLen, const TqResyncFilter& aFilter,
+                               TqResync::Predicate aPredicate, void* aContext,
+                               TqResyncCandidate* aOut, size_t aMax, size_t aThreads) const
+{
+    const uint8_t* keys[] = { mContext->getKey(), mAltKey };
+    size_t count = mKey == mAltKey ? 2 : 1;
+
+    return TqResync::search(mKernel, keys, count, aWindow, aLen, aFilter,
+                            aPredicate, aContext, aOut, aMax, aThreads);
+}
+
+#pragma managed
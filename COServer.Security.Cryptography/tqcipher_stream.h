@@ -0,0 +1,178 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_STREAM_H_
+#define _TQ_CIPHER_STREAM_H_
+
+#include "tqkeycontext.h"
+#include "tqcipher_fixed.h"
+#include "tqresync.h"
+#include <stdint.h>
+#ifdef _WIN32
+#include <intrin.h>
+#endif
+
+/**
+ * One direction (encryption or decryption) of a TQ cipher session.
+ *
+ * A stream owns the counter of its direction and a view of its key, so the
+ * encryptor and the decryptor of a session can be driven from different
+ * threads without any lock. Each stream is aligned on, and padded to, a
+ * cache line; the counters of the two directions never share a line.
+ *
+ * Several writers can also share one stream: each one atomically reserves
+ * the counters of its packet, then processes it in parallel with the others.
+ * The counter is the lower 16 bits of the position of the octet in the
+ * stream, and the packets must be sent in the order of their position.
+ */
+class TqCipherStream
+{
+public:
+    /** The size of a cache line. */
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * Kernel of an implementation, processing n octet(s) starting at a
+     * counter and returning the counter following the last octet.
+     */
+    typedef uint16_t (*Kernel)(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf, size_t aLen);
+
+public:
+    /**
+     * Create a new stream.
+     *
+     * @param[in] aKernel   the kernel of the implementation
+     * @param[in] aContext  the context of the base key
+     * @param[in] aAltKey   the padded alternate key to copy, or nullptr to use the base key
+     * @param[in] aCounter  the initial counter
+     */
+    TqCipherStream(Kernel aKernel, const TqKeyContext* aContext, const uint8_t* aAltKey, uint16_t aCounter);
+
+    /* destructor */
+    ~TqCipherStream();
+
+    /* aligned allocation */
+    static void* operator new(size_t aSize);
+    static void operator delete(void* aPtr);
+
+public:
+    /**
+     * Process (encrypt or decrypt) n octet(s) with the stream.
+     *
+     * @param[in,out] aBuf          the buffer that will be processed
+     * @param[in]     aLen          the number of octets to process
+     */
+    void process(uint8_t* aBuf, size_t aLen)
+    {
+        uint32_t position = (uint32_t)mPosition;
+        mKernel(mKey, (uint16_t)position, aBuf, aLen);
+        mPosition = (long)(position + (uint32_t)aLen);
+    }
+
+    /**
+     * Reserve the counters of n octet(s). The reservation is atomic, so the
+     * ranges reserved by concurrent writers never overlap.
+     *
+     * @param[in] aLen  the number of octets to reserve
+     *
+     * @returns the position of the first reserved octet
+     */
+    uint32_t reserve(size_t aLen)
+    {
+        #ifdef _WIN32
+        return (uint32_t)_InterlockedExchangeAdd(&mPosition, (long)aLen);
+        #else
+        return (uint32_t)__sync_fetch_and_add(&mPosition, (long)aLen);
+        #endif
+    }
+
+    /**
+     * Process (encrypt or decrypt) n octet(s) at a reserved position. The
+     * stream is not modified, so it can be called from many threads.
+     *
+     * @param[in]     aPosition     the position returned by reserve()
+     * @param[in,out] aBuf          the buffer that will be processed
+     * @param[in]     aLen          the number of octets to process
+     */
+    void processAt(uint32_t aPosition, uint8_t* aBuf, size_t aLen) const
+    {
+        mKernel(mKey, (uint16_t)aPosition, aBuf, aLen);
+    }
+
+    /**
+     * Process (encrypt or decrypt) a packet of N octet(s) with the stream,
+     * with the kernel specialized for the size (see TqCipher_Fixed).
+     *
+     * @param[in,out] aBuf          the buffer that will be processed
+     */
+    template <size_t N>
+    void process(uint8_t* aBuf)
+    {
+        uint32_t position = (uint32_t)mPosition;
+        TqCipher_Fixed::transform<N>(mKey, (uint16_t)position, aBuf);
+        mPosition = (long)(position + (uint32_t)N);
+    }
+
+    /**
+     * Process (encrypt or decrypt) a packet of N octet(s) at a reserved
+     * position (see processAt and TqCipher_Fixed).
+     *
+     * @param[in]     aPosition     the position returned by reserve()
+     * @param[in,out] aBuf          the buffer that will be processed
+     */
+    template <size_t N>
+    void processAt(uint32_t aPosition, uint8_t* aBuf) const
+    {
+        TqCipher_Fixed::transform<N>(mKey, (uint16_t)aPosition, aBuf);
+    }
+
+    /** Get the position of the next octet. */
+    uint32_t getPosition() const { return (uint32_t)mPosition; }
+
+    /** Get the counter of the next octet. */
+    uint16_t getCounter() const { return (uint16_t)mPosition; }
+
+    /** Set the counter of the next octet. */
+    void setCounter(uint16_t aCounter) { mPosition = aCounter; }
+
+    /**
+     * Search the counters at which a window of ciphertext decrypts to a
+     * plausible packet (see TqResync), with the base key (key 0) and, if
+     * the stream uses it, the alternate key (key 1). The stream is not
+     * modified; set the counter of the chosen candidate to resynchronize.
+     *
+     * @param[in]  aWindow     the ciphertext, starting at a packet
+     * @param[in]  aLen        the length of the window (at least TqResync::HEADER_SIZE)
+     * @param[in]  aFilter     the plausible headers
+     * @param[in]  aPredicate  the predicate of the caller, or nullptr
+     * @param[in]  aContext    the context of the predicate
+     * @param[out] aOut        the buffer receiving the candidates
+     * @param[in]  aMax        the size of the buffer
+     * @param[in]  aThreads    the number of threads, or 0 for one per processor
+     *
+     * @returns the number of candidates found (only aMax are written)
+     */
+    size_t findCounters(const uint8_t* aWindow, size_t aLen, const TqResyncFilter& aFilter,
+                        TqResync::Predicate aPredicate, void* aContext,
+                        TqResyncCandidate* aOut, size_t aMax, size_t aThreads) const;
+
+private:
+    // not copyable
+    TqCipherStream(const TqCipherStream&);
+    TqCipherStream& operator=(const TqCipherStream&);
+
+private:
+    Kernel mKernel; //!< Kernel of the implementation
+    const uint8_t* mKey; //!< Key of the direction
+    volatile long mPosition; //!< Position of the next octet (the counter is the lower 16 bits)
+    const TqKeyContext* mContext; //!< Shared base key
+
+    uint8_t mAltKey[TqKeyContext::SIZE]; //!< Copy of the alternative key (if any)
+};
+
+#endif // _TQ_CIPHER_STREAM_H_
@@ -0,0 +1,56 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqciphercontext.h"
+#include "tqkeycontext.h"
+
+using namespace COServer::Security::Cryptography;
+
+TqCipherContext^
+TqCipherContext :: Acquire(System::UInt32 aP, System::UInt32 aG)
+{
+    return gcnew TqCipherContext(TqKeyContext::acquire(aP, aG));
+}
+
+TqCipherContext :: TqCipherContext(const TqKeyContext* aContext)
+    : mContext(aContext)
+{
+
+}
+
+TqCipherContext :: ~TqCipherContext()
+{
+    this->!TqCipherContext();
+}
+
+TqCipherContext :: !TqCipherContext()
+{
+    if (mContext != nullptr)
+    {
+        mContext->release();
+        mContext = nullptr;
+    }
+}
+
+System::UInt32
+TqCipherContext :: P::get()
+{
+    if (mContext == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherContext");
+
+    return mContext->getP();
+}
+
+System::UInt32
+TqCipherContext :: G::get()
+{
+    if (mContext == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherContext");
+
+    return mContext->getG();
+}
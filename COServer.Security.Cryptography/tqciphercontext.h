@@ -0,0 +1,69 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_CONTEXT_H_
+#define _TQ_CIPHER_CONTEXT_H_
+
+class TqKeyContext;
+
+namespace COServer
+{
+	namespace Security
+	{
+		namespace Cryptography
+		{
+			/// <summary>
+			/// Immutable key context of TQ Digital's Asymmetric Cipher, shared by all the ciphers of a realm.
+			///
+			/// The key of a (P, G) pair is generated once per process and reference-counted, so the ciphers
+			/// created against a context don't have to generate it.
+			/// </summary>
+			public ref class TqCipherContext
+			{
+			public:
+                /// <summary>
+                /// Gets the context of the P and G constants. The key is generated if no other context of the
+                /// process uses these constants.
+                /// </summary>
+                /// <param name="aP">The P constant used to generate the key.</param>
+                /// <param name="aG">The G constant used to generate the key.</param>
+                /// <returns>The context of the key.</returns>
+                static TqCipherContext^ Acquire(System::UInt32 aP, System::UInt32 aG);
+
+                /* destructor */
+                ~TqCipherContext();
+
+                /* finalizer */
+                !TqCipherContext();
+
+            public:
+                /// <summary>
+                /// The P constant of the key.
+                /// </summary>
+                property System::UInt32 P { System::UInt32 get(); }
+
+                /// <summary>
+                /// The G constant of the key.
+                /// </summary>
+                property System::UInt32 G { System::UInt32 get(); }
+
+            internal:
+                /// <summary>
+                /// Native context object.
+                /// </summary>
+                const TqKeyContext* mContext;
+
+            private:
+                /* constructor */
+                TqCipherContext(const TqKeyContext* aContext);
+			};
+		}
+	}
+}
+
+#endif // _TQ_CIPHER_CONTEXT_H_
@@ -0,0 +1,108 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqcipherdirection.h"
+#include "tqcipher_stream.h"
+#include "hexdump.h"
+
+using namespace COServer::Security::Cryptography;
+
+TqCipherDirection :: TqCipherDirection(TqCipherStream* aStream)
+    : mStream(aStream)
+{
+
+}
+
+TqCipherDirection :: ~TqCipherDirection()
+{
+    this->!TqCipherDirection();
+}
+
+TqCipherDirection :: !TqCipherDirection()
+{
+    if (mStream != nullptr)
+    {
+        delete mStream;
+        mStream = nullptr;
+    }
+}
+
+void
+TqCipherDirection :: Process(array<System::Byte>^% aBuf, int aLength)
+{
+    if (mStream == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherDirection");
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    mStream->process(buf, aLength);
+}
+
+System::UInt32
+TqCipherDirection :: Reserve(int aLength)
+{
+    if (mStream == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherDirection");
+
+    return mStream->reserve(aLength);
+}
+
+void
+TqCipherDirection :: ProcessAt(System::UInt32 aPosition, array<System::Byte>^% aBuf, int aLength)
+{
+    if (mStream == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherDirection");
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    mStream->processAt(aPosition, buf, aLength);
+}
+
+int
+TqCipherDirection :: ProcessAndDump(array<System::Byte>^% aBuf, int aLength, array<System::Byte>^ aOut, int aOutOffset)
+{
+    if (mStream == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherDirection");
+    if (aBuf == nullptr || aLength < 0 || aLength > aBuf->Length)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+    HexDump::CheckOutput(aLength, aOut, aOutOffset);
+    if (aLength == 0)
+        return 0;
+
+    // the buffer is processed in place, block by block, while its dump is written
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    pin_ptr<uint8_t> out = &aOut[aOutOffset];
+    uint32_t position = mStream->reserve(aLength);
+    return (int)TqHexDump::formatDecrypted(HexDump::GetLines(), *mStream, position, buf, aLength, buf,
+                                           (char*)out, aOut->Length - aOutOffset);
+}
+
+int
+TqCipherDirection :: DumpAt(System::UInt32 aPosition, array<System::Byte>^ aBuf, int aLength,
+                            array<System::Byte>^ aOut, int aOutOffset)
+{
+    if (mStream == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherDirection");
+    if (aBuf == nullptr || aLength < 0 || aLength > aBuf->Length)
+        throw gcnew System::ArgumentOutOfRangeException("aLength");
+    HexDump::CheckOutput(aLength, aOut, aOutOffset);
+    if (aLength == 0)
+        return 0;
+
+    pin_ptr<uint8_t> buf = &aBuf[0];
+    pin_ptr<uint8_t> out = &aOut[aOutOffset];
+    return (int)TqHexDump::formatDecrypted(HexDump::GetLines(), *mStream, aPosition, buf, aLength, nullptr,
+                                           (char*)out, aOut->Length - aOutOffset);
+}
+
+System::UInt32
+TqCipherDirection :: Position::get()
+{
+    if (mStream == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherDirection");
+
+    return mStream->getPosition();
+}
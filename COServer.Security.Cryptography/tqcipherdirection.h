@@ -0,0 +1,103 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_DIRECTION_H_
+#define _TQ_CIPHER_DIRECTION_H_
+
+class TqCipherStream;
+
+namespace COServer
+{
+	namespace Security
+	{
+		namespace Cryptography
+		{
+			/// <summary>
+			/// One direction (encryption or decryption) of a TqCipher session.
+			///
+			/// The direction owns its counter, so the encryptor and the decryptor of a session can be used from
+			/// different threads without lock. Many writers can also share one direction by reserving the
+			/// positions of their packets, then processing them in parallel.
+			/// </summary>
+			public ref class TqCipherDirection
+			{
+			public:
+                /* destructor */
+                ~TqCipherDirection();
+
+                /* finalizer */
+                !TqCipherDirection();
+
+            public:
+                /// <summary>
+                /// Processes (encrypts or decrypts) data at the current position.
+                /// </summary>
+                /// <param name="aBuf">A reference to the buffer to process.</param>
+                /// <param name="aLength">The number of bytes of the buffer to process.</param>
+                void Process(array<System::Byte>^% aBuf, int aLength);
+
+                /// <summary>
+                /// Atomically reserves the positions of a packet. The ranges reserved by concurrent writers never
+                /// overlap, and the packets must be sent in the order of their position.
+                /// </summary>
+                /// <param name="aLength">The number of bytes of the packet.</param>
+                /// <returns>The position of the first byte of the packet.</returns>
+                System::UInt32 Reserve(int aLength);
+
+                /// <summary>
+                /// Processes (encrypts or decrypts) data at a reserved position. It can be called from many threads.
+                /// </summary>
+                /// <param name="aPosition">The position returned by Reserve.</param>
+                /// <param name="aBuf">A reference to the buffer to process.</param>
+                /// <param name="aLength">The number of bytes of the buffer to process.</param>
+                void ProcessAt(System::UInt32 aPosition, array<System::Byte>^% aBuf, int aLength);
+
+                /// <summary>
+                /// Processes data at the current position and dumps the processed bytes (the plaintext of a
+                /// decryptor) in the same pass, for the packet logs (see HexDump).
+                /// </summary>
+                /// <param name="aBuf">A reference to the buffer to process.</param>
+                /// <param name="aLength">The number of bytes of the buffer to process.</param>
+                /// <param name="aOut">The buffer receiving the dump (ASCII characters).</param>
+                /// <param name="aOutOffset">The offset of the dump in the buffer.</param>
+                /// <returns>The number of characters written.</returns>
+                int ProcessAndDump(array<System::Byte>^% aBuf, int aLength, array<System::Byte>^ aOut, int aOutOffset);
+
+                /// <summary>
+                /// Dumps the bytes processed at a position (the plaintext of a decryptor) without modifying the
+                /// buffer, e.g. to log the packets captured from a session. It can be called from many threads.
+                /// </summary>
+                /// <param name="aPosition">The position of the first byte of the buffer.</param>
+                /// <param name="aBuf">The buffer to process and dump.</param>
+                /// <param name="aLength">The number of bytes of the buffer to dump.</param>
+                /// <param name="aOut">The buffer receiving the dump (ASCII characters).</param>
+                /// <param name="aOutOffset">The offset of the dump in the buffer.</param>
+                /// <returns>The number of characters written.</returns>
+                int DumpAt(System::UInt32 aPosition, array<System::Byte>^ aBuf, int aLength,
+                           array<System::Byte>^ aOut, int aOutOffset);
+
+                /// <summary>
+                /// The position of the next byte. The counter of the cipher is the lower 16 bits.
+                /// </summary>
+                property System::UInt32 Position { System::UInt32 get(); }
+
+            internal:
+                /* constructor */
+                TqCipherDirection(TqCipherStream* aStream);
+
+            private:
+                /// <summary>
+                /// Native stream object.
+                /// </summary>
+                TqCipherStream* mStream;
+			};
+		}
+	}
+}
+
+#endif // _TQ_CIPHER_DIRECTION_H_
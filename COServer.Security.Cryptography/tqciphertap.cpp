@@ -0,0 +1,123 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqciphertap.h"
+#include "tqtap.h"
+
+using namespace COServer::Security::Cryptography;
+
+TqCipherTap :: TqCipherTap(int aCapacity, int aSnapLength)
+    : mTap(nullptr)
+{
+    if (aCapacity <= 0 || (aCapacity & (aCapacity - 1)) != 0)
+        throw gcnew System::ArgumentException("The capacity must be a power of two.", "aCapacity");
+    if (aSnapLength <= 0)
+        throw gcnew System::ArgumentOutOfRangeException("aSnapLength");
+
+    mTap = new TqTap(aCapacity, aSnapLength);
+}
+
+TqCipherTap :: ~TqCipherTap()
+{
+    this->!TqCipherTap();
+}
+
+TqCipherTap :: !TqCipherTap()
+{
+    if (mTap != nullptr)
+    {
+        delete mTap;
+        mTap = nullptr;
+    }
+}
+
+bool
+TqCipherTap :: Read(TqCipherTapRecord% aRecord, array<System::Byte>^ aData)
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+    if (aData == nullptr || aData->Length < (int)mTap->getSnapLength())
+        throw gcnew System::ArgumentException("The buffer must hold SnapLength bytes.", "aData");
+
+    TqTapRecord record;
+    pin_ptr<uint8_t> data = &aData[0];
+    if (!mTap->read(record, data))
+    {
+        aRecord = TqCipherTapRecord();
+        return false;
+    }
+
+    aRecord.Session = record.session;
+    aRecord.Length = (int)record.length;
+    aRecord.Counter = record.counter;
+    aRecord.Decrypted = record.direction == TqTap::DIRECTION_DECRYPT;
+    return true;
+}
+
+System::UInt32
+TqCipherTap :: Sampling::get()
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    return mTap->getSampling();
+}
+
+void
+TqCipherTap :: Sampling::set(System::UInt32 aValue)
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    mTap->setSampling(aValue);
+}
+
+System::UInt32
+TqCipherTap :: Session::get()
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    return mTap->getSession();
+}
+
+void
+TqCipherTap :: Session::set(System::UInt32 aValue)
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    mTap->setSession(aValue);
+}
+
+int
+TqCipherTap :: SnapLength::get()
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    return (int)mTap->getSnapLength();
+}
+
+System::UInt32
+TqCipherTap :: Recorded::get()
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    return mTap->getRecorded();
+}
+
+System::UInt32
+TqCipherTap :: Dropped::get()
+{
+    if (mTap == nullptr)
+        throw gcnew System::ObjectDisposedException("TqCipherTap");
+
+    return mTap->getDropped();
+}
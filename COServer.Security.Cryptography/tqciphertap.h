@@ -0,0 +1,119 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_CIPHER_TAP_H_
+#define _TQ_CIPHER_TAP_H_
+
+class TqTap;
+
+namespace COServer
+{
+	namespace Security
+	{
+		namespace Cryptography
+		{
+			/// <summary>
+			/// Header of a packet copied by a TqCipherTap.
+			/// </summary>
+			public value struct TqCipherTapRecord
+			{
+                /// <summary>
+                /// The identifier of the session (see TqCipher.SetTap).
+                /// </summary>
+                System::UInt32 Session;
+
+                /// <summary>
+                /// The length of the packet (at most SnapLength bytes are copied).
+                /// </summary>
+                int Length;
+
+                /// <summary>
+                /// The counter of the first byte of the packet.
+                /// </summary>
+                System::UInt16 Counter;
+
+                /// <summary>
+                /// Whether the packet was decrypted (or is about to be encrypted).
+                /// </summary>
+                bool Decrypted;
+			};
+
+			/// <summary>
+			/// Tap mirroring the plaintext of sampled packets of the attached ciphers, for live debugging.
+			///
+			/// The ciphers copy one packet in Sampling (of the Session, if set) in a lock-free ring, read by a
+			/// background thread. A cipher never waits for the reader: when the ring is full, the packet is
+			/// dropped and counted. The ciphers must be detached before the tap is disposed.
+			/// </summary>
+			public ref class TqCipherTap
+			{
+			public:
+                /// <summary>
+                /// Session filter keeping the packets of every session.
+                /// </summary>
+                literal System::UInt32 AnySession = 0xFFFFFFFF;
+
+            public:
+                /// <summary>
+                /// Create a new tap.
+                /// </summary>
+                /// <param name="aCapacity">The number of packets of the ring (a power of two).</param>
+                /// <param name="aSnapLength">The maximum number of bytes copied per packet.</param>
+                TqCipherTap(int aCapacity, int aSnapLength);
+
+                /* destructor */
+                ~TqCipherTap();
+
+                /* finalizer */
+                !TqCipherTap();
+
+            public:
+                /// <summary>
+                /// Reads the oldest packet of the ring. It must only be called by one thread.
+                /// </summary>
+                /// <param name="aRecord">The header of the packet.</param>
+                /// <param name="aData">The buffer receiving the bytes of the packet (at least SnapLength bytes).</param>
+                /// <returns>False if the ring is empty.</returns>
+                bool Read([System::Runtime::InteropServices::Out] TqCipherTapRecord% aRecord, array<System::Byte>^ aData);
+
+                /// <summary>
+                /// One packet in Sampling of each session is kept (1 keeps every packet, 0 pauses the tap).
+                /// </summary>
+                property System::UInt32 Sampling { System::UInt32 get(); void set(System::UInt32 aValue); }
+
+                /// <summary>
+                /// The only session kept by the tap, or AnySession.
+                /// </summary>
+                property System::UInt32 Session { System::UInt32 get(); void set(System::UInt32 aValue); }
+
+                /// <summary>
+                /// The maximum number of bytes copied per packet.
+                /// </summary>
+                property int SnapLength { int get(); }
+
+                /// <summary>
+                /// The number of packets written in the ring.
+                /// </summary>
+                property System::UInt32 Recorded { System::UInt32 get(); }
+
+                /// <summary>
+                /// The number of sampled packets dropped because the ring was full.
+                /// </summary>
+                property System::UInt32 Dropped { System::UInt32 get(); }
+
+            internal:
+                /// <summary>
+                /// Native tap object.
+                /// </summary>
+                TqTap* mTap;
+			};
+		}
+	}
+}
+
+#endif // _TQ_CIPHER_TAP_H_
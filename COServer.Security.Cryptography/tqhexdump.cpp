@@ -0,0 +1,97 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqhexdump.h"
+#include "tqcipher_stream.h"
+#include <string.h> // memcpy, memset
+#include <assert.h>
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+/**
+ * Format a line of n octet(s) (at most LINE_OCTETS).
+ */
+static char*
+formatLine(const uint8_t* aBuf, size_t aLen, char* aOut)
+{
+    for (size_t i = 0; i < aLen; ++i)
+    {
+        aOut[3 * i] = HEX_DIGITS[aBuf[i] >> 4];
+        aOut[3 * i + 1] = HEX_DIGITS[aBuf[i] & 0x0F];
+        aOut[3 * i + 2] = ' ';
+    }
+    memset(aOut + 3 * aLen, ' ', TqHexDump::HEX_WIDTH - 3 * aLen);
+    aOut += TqHexDump::HEX_WIDTH;
+
+    for (size_t i = 0; i < aLen; ++i)
+        *aOut++ = aBuf[i] >= 32 && aBuf[i] <= 126 ? (char)aBuf[i] : '.';
+
+    *aOut++ = '\r';
+    *aOut++ = '\n';
+    return aOut;
+}
+
+void
+TqHexDump :: formatLines(const uint8_t* aBuf, size_t aLines, char* aOut)
+{
+    for (size_t i = 0; i < aLines; ++i)
+        formatLine(aBuf + i * LINE_OCTETS, LINE_OCTETS, aOut + i * LINE_SIZE);
+}
+
+size_t
+TqHexDump :: format(Lines aLines, const uint8_t* aBuf, size_t aLen, char* aOut, size_t aCapacity)
+{
+    assert(aLines != nullptr);
+    assert(aBuf != nullptr || aLen == 0);
+
+    size_t size = getSize(aLen);
+    if (size > aCapacity)
+        return 0;
+
+    size_t lines = aLen / LINE_OCTETS;
+    if (lines != 0)
+        aLines(aBuf, lines, aOut);
+    if (aLen % LINE_OCTETS != 0)
+        formatLine(aBuf + lines * LINE_OCTETS, aLen % LINE_OCTETS, aOut + lines * LINE_SIZE);
+
+    return size;
+}
+
+size_t
+TqHexDump :: formatDecrypted(Lines aLines, const TqCipherStream& aDecryptor, uint32_t aPosition,
+                             const uint8_t* aCipher, size_t aLen, uint8_t* aPlain,
+                             char* aOut, size_t aCapacity)
+{
+    static_assert(BLOCK_SIZE % LINE_OCTETS == 0, "the blocks are whole lines");
+    assert(aLines != nullptr);
+    assert(aCipher != nullptr || aLen == 0);
+
+    size_t size = getSize(aLen);
+    if (size > aCapacity)
+        return 0;
+
+    uint8_t block[BLOCK_SIZE];
+    for (size_t offset = 0; offset < aLen; offset += BLOCK_SIZE)
+    {
+        size_t len = aLen - offset < BLOCK_SIZE ? aLen - offset : BLOCK_SIZE;
+
+        // decrypted in the plaintext (if any) or in the stack, then dumped while in the L1 cache
+        uint8_t* plain = aPlain != nullptr ? aPlain + offset : block;
+        if (plain != aCipher + offset)
+            memcpy(plain, aCipher + offset, len);
+        aDecryptor.processAt(aPosition + (uint32_t)offset, plain, len);
+
+        size_t done = offset / LINE_OCTETS * LINE_SIZE;
+        format(aLines, plain, len, aOut + done, size - done);
+    }
+
+    // security purpose only...
+    memset(block, 0, sizeof(block));
+
+    return size;
+}
@@ -0,0 +1,104 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_HEX_DUMP_H_
+#define _TQ_HEX_DUMP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+class TqCipherStream;
+
+/**
+ * Hexadecimal dump of a packet, for the packet logs.
+ *
+ * Each line shows LINE_OCTETS octets: "XX " per octet, padded with spaces
+ * to HEX_WIDTH columns, then the printable octets (the others are dots) and
+ * a CRLF. The last line only shows the remaining octets. It is the format of
+ * the dumps of the test vectors, without their quadratic concatenations.
+ *
+ * The dump is written in the buffer of the caller (see getSize) and nothing
+ * is allocated, so a gateway can log every packet. The whole lines are
+ * formatted by a Lines function: the portable one below, or the vectorized
+ * one of TqHexDump_AVX2.
+ */
+class TqHexDump
+{
+public:
+    /** The number of octets of a line. */
+    static const size_t LINE_OCTETS = 16;
+    /** The width of the hexadecimal column, padding included. */
+    static const size_t HEX_WIDTH = 60;
+    /** The size of a whole line, CRLF included. */
+    static const size_t LINE_SIZE = HEX_WIDTH + LINE_OCTETS + 2;
+    /** The number of octets decrypted at once by formatDecrypted (a multiple of LINE_OCTETS). */
+    static const size_t BLOCK_SIZE = 256;
+
+    /**
+     * Formatter of n whole line(s).
+     *
+     * @param[in]  aBuf    the octets to dump (aLines * LINE_OCTETS)
+     * @param[in]  aLines  the number of lines
+     * @param[out] aOut    the buffer receiving the lines (aLines * LINE_SIZE)
+     */
+    typedef void (*Lines)(const uint8_t* aBuf, size_t aLines, char* aOut);
+
+public:
+    /**
+     * Get the size of the dump of n octet(s).
+     *
+     * @param[in] aLen  the number of octets
+     *
+     * @returns the number of characters of the dump
+     */
+    static size_t getSize(size_t aLen)
+    {
+        size_t rest = aLen % LINE_OCTETS;
+        return aLen / LINE_OCTETS * LINE_SIZE + (rest != 0 ? HEX_WIDTH + rest + 2 : 0);
+    }
+
+    /**
+     * Format n whole line(s), one octet at a time (see Lines).
+     */
+    static void formatLines(const uint8_t* aBuf, size_t aLines, char* aOut);
+
+    /**
+     * Dump n octet(s).
+     *
+     * @param[in]  aLines     the formatter of the whole lines
+     * @param[in]  aBuf       the octets to dump
+     * @param[in]  aLen       the number of octets
+     * @param[out] aOut       the buffer receiving the dump
+     * @param[in]  aCapacity  the size of the buffer
+     *
+     * @returns the number of characters written, or 0 if the buffer is too small (nothing is written)
+     */
+    static size_t format(Lines aLines, const uint8_t* aBuf, size_t aLen, char* aOut, size_t aCapacity);
+
+    /**
+     * Decrypt and dump n octet(s) in one pass: each block is decrypted,
+     * then dumped while it is still in the L1 cache. The stream is not
+     * modified, so it can be called from many threads.
+     *
+     * @param[in]  aLines      the formatter of the whole lines
+     * @param[in]  aDecryptor  the stream decrypting the octets
+     * @param[in]  aPosition   the position of the first octet in the stream
+     * @param[in]  aCipher     the ciphertext
+     * @param[in]  aLen        the number of octets
+     * @param[out] aPlain      the buffer receiving the plaintext (can be aCipher), or nullptr
+     * @param[out] aOut        the buffer receiving the dump
+     * @param[in]  aCapacity   the size of the buffer
+     *
+     * @returns the number of characters written, or 0 if the buffer is too small (nothing is processed)
+     */
+    static size_t formatDecrypted(Lines aLines, const TqCipherStream& aDecryptor, uint32_t aPosition,
+                                  const uint8_t* aCipher, size_t aLen, uint8_t* aPlain,
+                                  char* aOut, size_t aCapacity);
+};
+
+#endif // _TQ_HEX_DUMP_H_
@@ -0,0 +1,105 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqhexdump_avx2.h"
+#include <immintrin.h>
+#include <string.h> // memcpy
+
+// GCC & Clang spell the forced inlining of MSVC differently.
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
+/**
+ * Format the line of each lane: the three parts of the hexadecimal column
+ * and the printable octets.
+ */
+static __forceinline void
+formatLanes(__m256i aLine, __m256i& aHex0, __m256i& aHex1, __m256i& aHex2, __m256i& aText)
+{
+    const __m256i digits = _mm256_setr_epi8(
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(aLine, 4), nibble));
+    __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(aLine, nibble));
+
+    // the digits of the octets 0-7 and 8-15 of each line
+    __m256i first = _mm256_unpacklo_epi8(hi, lo);
+    __m256i second = _mm256_unpackhi_epi8(hi, lo);
+
+    // "XX " per octet: the zeroed gaps of the shuffles are the spaces
+    const __m256i part0 = _mm256_setr_epi8(
+        0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10,
+        0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10);
+    const __m256i part1a = _mm256_setr_epi8(
+        11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i part1b = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, 2, 3, -1, 4, 5,
+        -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, 2, 3, -1, 4, 5);
+    const __m256i part2 = _mm256_setr_epi8(
+        -1, 6, 7, -1, 8, 9, -1, 10, 11, -1, 12, 13, -1, 14, 15, -1,
+        -1, 6, 7, -1, 8, 9, -1, 10, 11, -1, 12, 13, -1, 14, 15, -1);
+    const __m256i space = _mm256_set1_epi8(' ');
+
+    // the digits are above the space, so the maximum only fills the gaps
+    aHex0 = _mm256_max_epu8(_mm256_shuffle_epi8(first, part0), space);
+    aHex1 = _mm256_max_epu8(_mm256_or_si256(_mm256_shuffle_epi8(first, part1a),
+                                            _mm256_shuffle_epi8(second, part1b)), space);
+    aHex2 = _mm256_max_epu8(_mm256_shuffle_epi8(second, part2), space);
+
+    // 32 to 126 are the only octets above 31 and below 127 as signed integers
+    __m256i printable = _mm256_and_si256(_mm256_cmpgt_epi8(aLine, _mm256_set1_epi8(31)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8(127), aLine));
+    aText = _mm256_blendv_epi8(_mm256_set1_epi8('.'), aLine, printable);
+}
+
+/**
+ * Store a formatted line.
+ */
+static __forceinline void
+storeLine(char* aOut, __m128i aHex0, __m128i aHex1, __m128i aHex2, __m128i aText)
+{
+    static const char CRLF[2] = { '\r', '\n' };
+
+    // the padding is overwritten by the text where they overlap
+    _mm_storeu_si128((__m128i*)aOut, aHex0);
+    _mm_storeu_si128((__m128i*)(aOut + 16), aHex1);
+    _mm_storeu_si128((__m128i*)(aOut + 32), aHex2);
+    _mm_storeu_si128((__m128i*)(aOut + 48), _mm_set1_epi8(' '));
+    _mm_storeu_si128((__m128i*)(aOut + TqHexDump::HEX_WIDTH), aText);
+    memcpy(aOut + TqHexDump::HEX_WIDTH + TqHexDump::LINE_OCTETS, CRLF, sizeof(CRLF));
+}
+
+void
+TqHexDump_AVX2 :: formatLines(const uint8_t* aBuf, size_t aLines, char* aOut)
+{
+    static_assert(TqHexDump::LINE_OCTETS == 16 && TqHexDump::HEX_WIDTH == 60, "the stores are unrolled");
+
+    __m256i hex0, hex1, hex2, text;
+    for (; aLines >= 2; aBuf += 2 * TqHexDump::LINE_OCTETS, aOut += 2 * TqHexDump::LINE_SIZE, aLines -= 2)
+    {
+        formatLanes(_mm256_loadu_si256((const __m256i*)aBuf), hex0, hex1, hex2, text);
+
+        storeLine(aOut, _mm256_castsi256_si128(hex0), _mm256_castsi256_si128(hex1),
+                  _mm256_castsi256_si128(hex2), _mm256_castsi256_si128(text));
+        storeLine(aOut + TqHexDump::LINE_SIZE,
+                  _mm256_extracti128_si256(hex0, 1), _mm256_extracti128_si256(hex1, 1),
+                  _mm256_extracti128_si256(hex2, 1), _mm256_extracti128_si256(text, 1));
+    }
+
+    if (aLines != 0)
+    {
+        formatLanes(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)aBuf)), hex0, hex1, hex2, text);
+
+        storeLine(aOut, _mm256_castsi256_si128(hex0), _mm256_castsi256_si128(hex1),
+                  _mm256_castsi256_si128(hex2), _mm256_castsi256_si128(text));
+    }
+}
@@ -0,0 +1,32 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_HEX_DUMP_AVX2_H_
+#define _TQ_HEX_DUMP_AVX2_H_
+
+#include "tqhexdump.h"
+
+/**
+ * Hexadecimal dump using AVX2 (see TqHexDump).
+ *
+ * Each 128-bit lane of the vectors holds a line: the nibbles are converted
+ * to digits by a shuffle of the table of digits, interleaved, then spread
+ * over the three parts of the column by other shuffles (the gaps being the
+ * spaces), while the unprintable octets are blended with dots. Two lines
+ * are formatted at once.
+ */
+class TqHexDump_AVX2
+{
+public:
+    /**
+     * Format n whole line(s) (see TqHexDump::Lines).
+     */
+    static void formatLines(const uint8_t* aBuf, size_t aLines, char* aOut);
+};
+
+#endif // _TQ_HEX_DUMP_AVX2_H_
@@ -0,0 +1,267 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqkeycontext.h"
+#include <string.h> // memcpy
+#include <map>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#pragma unmanaged
+
+typedef std::map<uint64_t, TqKeyContext*> TqKeyRegistry;
+
+static TqKeyRegistry sRegistry; //!< Contexts by (P << 32 | G)
+#ifdef _WIN32
+static SRWLOCK sRegistryLock = SRWLOCK_INIT; //!< Lock of the registry
+#else
+static pthread_rwlock_t sRegistryLock = PTHREAD_RWLOCK_INITIALIZER; //!< Lock of the registry
+#endif
+
+static void
+lockShared()
+{
+    #ifdef _WIN32
+    AcquireSRWLockShared(&sRegistryLock);
+    #else
+    pthread_rwlock_rdlock(&sRegistryLock);
+    #endif
+}
+
+static void
+unlockShared()
+{
+    #ifdef _WIN32
+    ReleaseSRWLockShared(&sRegistryLock);
+    #else
+    pthread_rwlock_unlock(&sRegistryLock);
+    #endif
+}
+
+static void
+lockExclusive()
+{
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&sRegistryLock);
+    #else
+    pthread_rwlock_wrlock(&sRegistryLock);
+    #endif
+}
+
+static void
+unlockExclusive()
+{
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&sRegistryLock);
+    #else
+    pthread_rwlock_unlock(&sRegistryLock);
+    #endif
+}
+
+static long
+increment(volatile long* aPtr)
+{
+    #ifdef _WIN32
+    return InterlockedIncrement(aPtr);
+    #else
+    return __sync_add_and_fetch(aPtr, 1);
+    #endif
+}
+
+static long
+decrement(volatile long* aPtr)
+{
+    #ifdef _WIN32
+    return InterlockedDecrement(aPtr);
+    #else
+    return __sync_sub_and_fetch(aPtr, 1);
+    #endif
+}
+
+static long
+compareExchange(volatile long* aPtr, long aValue, long aComparand)
+{
+    #ifdef _WIN32
+    return InterlockedCompareExchange(aPtr, aValue, aComparand);
+    #else
+    return __sync_val_compare_and_swap(aPtr, aComparand, aValue);
+    #endif
+}
+
+TqKeyContext :: TqKeyContext(uint32_t aP, uint32_t aG)
+    : mP(aP), mG(aG), mKeyId(TqCipherState::computeKeyId(aP, aG)),
+      mRefCount(1), mKey(nullptr)
+{
+    uint32_t node = TqNuma::getCurrentNode();
+
+    mKey = (uint8_t*)TqNuma::allocate(SIZE, node);
+    if (mKey == nullptr)
+        throw std::bad_alloc();
+
+    memset((void*)mReplicas, 0, sizeof(mReplicas));
+    mReplicas[node] = mKey;
+
+    generateKey();
+}
+
+TqKeyContext :: ~TqKeyContext()
+{
+    for (uint32_t i = 0; i < TqNuma::MAX_NODES; ++i)
+    {
+        if (mReplicas[i] != mKey)
+            TqNuma::release(mReplicas[i]);
+    }
+    TqNuma::release(mKey);
+}
+
+const uint8_t*
+TqKeyContext :: replicate(uint32_t aNode) const
+{
+    uint8_t* replica = (uint8_t*)TqNuma::allocate(SIZE, aNode);
+    if (replica == nullptr)
+        return mKey;
+
+    memcpy(replica, mKey, SIZE);
+
+    // the first replica published wins, the others are dropped
+    #ifdef _WIN32
+    uint8_t* published = (uint8_t*)InterlockedCompareExchangePointer(
+        (PVOID volatile*)&mReplicas[aNode], replica, nullptr);
+    #else
+    uint8_t* published = __sync_val_compare_and_swap(&mReplicas[aNode], (uint8_t*)nullptr, replica);
+    #endif
+    if (published != nullptr)
+    {
+        TqNuma::release(replica);
+        return published;
+    }
+
+    return replica;
+}
+
+TqKeyContext*
+TqKeyContext :: acquire(uint32_t aP, uint32_t aG)
+{
+    const uint64_t id = (uint64_t)aP << 32 | aG;
+    TqKeyContext* context = nullptr;
+
+    // most of the lookups find an existing context
+    lockShared();
+    TqKeyRegistry::const_iterator it = sRegistry.find(id);
+    if (it != sRegistry.end())
+    {
+        context = it->second;
+        increment(&context->mRefCount);
+    }
+    unlockShared();
+
+    if (context == nullptr)
+    {
+        lockExclusive();
+        it = sRegistry.find(id);
+        if (it != sRegistry.end())
+        {
+            context = it->second;
+            increment(&context->mRefCount);
+        }
+        else
+        {
+            context = new TqKeyContext(aP, aG);
+            sRegistry[id] = context;
+        }
+        unlockExclusive();
+    }
+
+    return context;
+}
+
+void
+TqKeyContext :: addRef() const
+{
+    increment(&mRefCount);
+}
+
+void
+TqKeyContext :: release() const
+{
+    // most of the references aren't the last one: they are released without the lock
+    long count = mRefCount;
+    while (count > 1)
+    {
+        long previous = compareExchange(&mRefCount, count - 1, count);
+        if (previous == count)
+            return;
+        count = previous;
+    }
+
+    // the last reference is released under the lock, and a lookup may have
+    // revived the context in the meantime: the count is checked again
+    lockExclusive();
+    if (decrement(&mRefCount) == 0)
+    {
+        sRegistry.erase((uint64_t)mP << 32 | mG);
+        delete this;
+    }
+    unlockExclusive();
+}
+
+// there is a bug with VS2013 optimization algorithm, making the second key generation fails
+#pragma optimize( "", off )
+void
+TqKeyContext :: generateKey()
+{
+    uint32_t aP = mP;
+    uint32_t aG = mG;
+
+    uint8_t* p = (uint8_t*)&aP;
+    uint8_t* g = (uint8_t*)&aG;
+
+    uint8_t* key1 = mKey;
+    uint8_t* key2 = key1 + HALF_SIZE;
+
+    for (size_t i = 0, len = (TqCipher_Base::KEY_SIZE / 2); i < len; ++i)
+    {
+        key1[i] = p[0];
+        key2[i] = g[0];
+        p[0] = (uint8_t)((p[1] + (uint8_t)(p[0] * p[2])) * p[0] + p[3]);
+        g[0] = (uint8_t)((g[1] - (uint8_t)(g[0] * g[2])) * g[0] + g[3]);
+    }
+
+    memcpy(key1 + TqCipher_Base::KEY_SIZE / 2, key1, PADDING);
+    memcpy(key2 + TqCipher_Base::KEY_SIZE / 2, key2, PADDING);
+}
+#pragma optimize( "", on )
+
+void
+TqKeyContext :: expandAltKey(uint8_t* aAltKey, uint32_t aSeed) const
+{
+    uint32_t x = aSeed;
+    uint32_t y = x * x;
+
+    uint8_t* tmpKey1 = (uint8_t*)&x;
+    uint8_t* tmpKey2 = (uint8_t*)&y;
+
+    const uint8_t* key1 = mKey;
+    const uint8_t* key2 = key1 + HALF_SIZE;
+    uint8_t* altKey1 = aAltKey;
+    uint8_t* altKey2 = altKey1 + HALF_SIZE;
+
+    // the padding is also covered, as the half of the key is a multiple of the seed size
+    for (size_t i = 0; i < HALF_SIZE; ++i)
+    {
+        altKey1[i] = (uint8_t)(key1[i] ^ tmpKey1[(i % sizeof(x))]);
+        altKey2[i] = (uint8_t)(key2[i] ^ tmpKey2[(i % sizeof(y))]);
+    }
+}
+
+#pragma managed
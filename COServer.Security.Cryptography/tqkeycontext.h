@@ -0,0 +1,112 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_KEY_CONTEXT_H_
+#define _TQ_KEY_CONTEXT_H_
+
+#include "tqcipher_base.h"
+#include "tqnuma.h"
+#include <stdint.h>
+
+/**
+ * Immutable base key of the TQ cipher, generated once per (P, G) pair and
+ * shared by all the sessions of a realm.
+ *
+ * The contexts are kept in a process-wide registry and are reference-counted.
+ * The key is expanded in a padded layout usable by all the implementations:
+ * each half of the key is followed by a copy of its first PADDING octets, so
+ * a vector can be loaded at any counter without wrapping.
+ *
+ * The key is allocated on the NUMA node of the thread creating the context,
+ * and replicated on the other nodes when a session served there asks for it
+ * (see getKey(uint32_t)), so the sessions never read the key across nodes.
+ */
+class TqKeyContext
+{
+public:
+    /** The number of octets replicated after each half of the key. */
+    static const size_t PADDING = 64;
+    /** The size of one padded half of the key. */
+    static const size_t HALF_SIZE = TqCipher_Base::KEY_SIZE / 2 + PADDING;
+    /** The size of the padded key. */
+    static const size_t SIZE = 2 * HALF_SIZE;
+
+public:
+    /**
+     * Get the context of the P & G integers, generating its key if there is
+     * no such context in the registry. The caller owns one reference.
+     *
+     * @param[in] aP  the P value of the cipher
+     * @param[in] aG  the G value of the cipher
+     *
+     * @returns the context of the key
+     */
+    static TqKeyContext* acquire(uint32_t aP, uint32_t aG);
+
+    /**
+     * Expand the alternate key of a session from the base key of a context.
+     *
+     * @param[out] aAltKey  the padded alternate key (SIZE octets)
+     * @param[in]  aSeed    the seed derived from the A & B values
+     */
+    void expandAltKey(uint8_t* aAltKey, uint32_t aSeed) const;
+
+    /** Add a reference to the context. */
+    void addRef() const;
+
+    /** Release a reference to the context, destroying it with the last one. */
+    void release() const;
+
+public:
+    /** Get the P value of the key. */
+    uint32_t getP() const { return mP; }
+    /** Get the G value of the key. */
+    uint32_t getG() const { return mG; }
+    /** Get the identifier of the key (see TqCipherState::computeKeyId). */
+    uint32_t getKeyId() const { return mKeyId; }
+    /** Get the padded key (SIZE octets, the second half at HALF_SIZE). */
+    const uint8_t* getKey() const { return mKey; }
+
+    /**
+     * Get the replica of the padded key on a NUMA node, replicating the key
+     * on the node on the first call.
+     *
+     * @param[in] aNode  the node (see TqNuma)
+     *
+     * @returns the replica, or the key if it can't be replicated
+     */
+    const uint8_t* getKey(uint32_t aNode) const
+    {
+        const uint8_t* replica = aNode < TqNuma::MAX_NODES ? mReplicas[aNode] : mKey;
+        return replica != nullptr ? replica : replicate(aNode);
+    }
+
+private:
+    /* constructor */
+    TqKeyContext(uint32_t aP, uint32_t aG);
+
+    /* destructor */
+    ~TqKeyContext();
+
+    /** Generate the padded key. */
+    void generateKey();
+
+    /** Create the replica of the key on a node. */
+    const uint8_t* replicate(uint32_t aNode) const;
+
+private:
+    const uint32_t mP; //!< P value of the key
+    const uint32_t mG; //!< G value of the key
+    const uint32_t mKeyId; //!< Identifier of the key
+    mutable volatile long mRefCount; //!< Number of references to the context
+
+    uint8_t* mKey; //!< Padded key (aligned on a cache line, on the node of the creator)
+    mutable uint8_t* volatile mReplicas[TqNuma::MAX_NODES]; //!< Replicas of the key by node
+};
+
+#endif // _TQ_KEY_CONTEXT_H_
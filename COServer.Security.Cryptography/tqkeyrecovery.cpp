@@ -0,0 +1,346 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqkeyrecovery.h"
+#include <assert.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// The number of values of c1 & c2 searched by a call to the kernel.
+static const size_t BLOCK_OUTER = 256;
+
+/**
+ * Order of the relations: by highest index, the relations with the zero
+ * octet (absolute values) first.
+ */
+static bool
+isBefore(const TqKeyConstraint& aLeft, const TqKeyConstraint& aRight)
+{
+    if (aLeft.b != aRight.b)
+        return aLeft.b < aRight.b;
+    if (aLeft.a != aRight.a)
+        return aLeft.a > aRight.a;
+    return aLeft.value < aRight.value;
+}
+
+/**
+ * Order of the known octets: by counter.
+ */
+static bool
+isEarlier(const TqKnownOctet& aLeft, const TqKnownOctet& aRight)
+{
+    return aLeft.counter < aRight.counter;
+}
+
+/**
+ * Sort the relations, dropping the duplicates, and find the anchor, its
+ * octet and its relation with the next octet.
+ */
+static void
+prepare(std::vector<TqKeyConstraint>& aConstraints, TqKeySearch& aSearch)
+{
+    std::sort(aConstraints.begin(), aConstraints.end(), &isBefore);
+
+    size_t count = 0;
+    for (size_t i = 0; i < aConstraints.size(); ++i)
+    {
+        const TqKeyConstraint& c = aConstraints[i];
+        if (count != 0 && aConstraints[count - 1].a == c.a && aConstraints[count - 1].b == c.b &&
+            aConstraints[count - 1].value == c.value)
+            continue;
+        aConstraints[count++] = c;
+    }
+    aConstraints.resize(count);
+
+    uint16_t anchor = TqKeyRecovery::ZERO;
+    for (size_t i = 0; i < aConstraints.size(); ++i)
+    {
+        const TqKeyConstraint& c = aConstraints[i];
+        anchor = std::min(anchor, std::min(c.a, c.b));
+    }
+
+    aSearch.constraints = aConstraints.data();
+    aSearch.count = aConstraints.size();
+    aSearch.anchor = anchor;
+    aSearch.fixed = -1;
+    aSearch.delta = -1;
+
+    int next = -1;
+    for (size_t i = 0; i < aConstraints.size(); ++i)
+    {
+        const TqKeyConstraint& c = aConstraints[i];
+        if (c.a == TqKeyRecovery::ZERO && c.b == anchor)
+            aSearch.fixed = c.value;
+        else if (c.a == TqKeyRecovery::ZERO && c.b == anchor + 1)
+            next = c.value;
+        else if (c.a == anchor && c.b == anchor + 1)
+            aSearch.delta = c.value;
+    }
+
+    if (aSearch.fixed >= 0 && next >= 0)
+        aSearch.delta = aSearch.fixed ^ next;
+}
+
+/**
+ * Search the constants of a range of c1 & c2 (see TqKeyRecovery::search).
+ */
+static void
+searchThread(TqKeyRecovery::Kernel aKernel, const TqKeySearch* aSearch,
+             uint32_t aFirst, uint32_t aLast, std::vector<uint32_t>* aConstants)
+{
+    uint32_t found[64];
+    for (uint32_t block = aFirst; block < aLast; block += BLOCK_OUTER)
+    {
+        // most of the blocks have no constant, the others are searched again if needed
+        size_t count = aKernel(*aSearch, block, block + BLOCK_OUTER, found, sizeof(found) / sizeof(found[0]));
+        if (count <= sizeof(found) / sizeof(found[0]))
+        {
+            aConstants->insert(aConstants->end(), found, found + count);
+            continue;
+        }
+
+        size_t size = aConstants->size();
+        aConstants->resize(size + count);
+        aKernel(*aSearch, block, block + BLOCK_OUTER, aConstants->data() + size, count);
+    }
+}
+
+void
+TqKeyRecovery :: generate(uint32_t aConstant, uint8_t* aHalf)
+{
+    uint8_t x = (uint8_t)aConstant;
+    uint8_t c1 = (uint8_t)(aConstant >> 8);
+    uint8_t c2 = (uint8_t)(aConstant >> 16);
+    uint8_t c3 = (uint8_t)(aConstant >> 24);
+
+    for (size_t i = 0; i < HALF; ++i)
+    {
+        aHalf[i] = x;
+        x = (uint8_t)((c1 + (uint8_t)(x * c2)) * x + c3);
+    }
+}
+
+void
+TqKeyRecovery :: appendConstants(uint32_t aConstant, uint16_t aAnchor, uint8_t aValue,
+                                 uint32_t* aOut, size_t aMax, size_t& aFound)
+{
+    uint8_t c1 = (uint8_t)(aConstant >> 8);
+    uint8_t c2 = (uint8_t)(aConstant >> 16);
+    uint8_t c3 = (uint8_t)(aConstant >> 24);
+
+    for (uint32_t c0 = 0; c0 < 256; ++c0)
+    {
+        uint8_t x = (uint8_t)c0;
+        for (size_t i = 0; i < aAnchor; ++i)
+            x = (uint8_t)((c1 + (uint8_t)(x * c2)) * x + c3);
+
+        if (x == aValue)
+        {
+            if (aFound < aMax)
+                aOut[aFound] = (aConstant & 0xFFFFFF00) | c0;
+            ++aFound;
+        }
+    }
+}
+
+size_t
+TqKeyRecovery :: searchRange(const TqKeySearch& aSearch, uint32_t aFirst, uint32_t aLast,
+                             uint32_t* aOut, size_t aMax)
+{
+    uint8_t x[HALF + 1];
+    x[ZERO] = 0;
+
+    const size_t anchor = aSearch.anchor;
+    uint32_t firstY = aSearch.fixed >= 0 ? (uint32_t)aSearch.fixed : 0;
+    uint32_t lastY = aSearch.fixed >= 0 ? (uint32_t)aSearch.fixed : 255;
+
+    size_t found = 0;
+    for (uint32_t outer = aFirst; outer < aLast; ++outer)
+    {
+        uint8_t c1 = (uint8_t)outer;
+        uint8_t c2 = (uint8_t)(outer >> 8);
+
+        // y is the octet at the anchor
+        for (uint32_t y = firstY; y <= lastY; ++y)
+        {
+            // the next octet (c1 + y * c2) * y + c3 is known, so is c3
+            uint32_t first3 = 0, last3 = 255;
+            if (aSearch.delta >= 0)
+            {
+                first3 = (uint8_t)((y ^ aSearch.delta) - (uint8_t)(c1 + (uint8_t)(y * c2)) * y);
+                last3 = first3;
+            }
+
+            for (uint32_t c3 = first3; c3 <= last3; ++c3)
+            {
+                x[anchor] = (uint8_t)y;
+                size_t generated = anchor;
+
+                bool match = true;
+                for (size_t i = 0; i < aSearch.count && match; ++i)
+                {
+                    const TqKeyConstraint& c = aSearch.constraints[i];
+                    for (; generated < c.b; ++generated)
+                        x[generated + 1] = (uint8_t)((c1 + (uint8_t)(x[generated] * c2)) * x[generated] + c3);
+                    match = (uint8_t)(x[c.a] ^ x[c.b]) == c.value;
+                }
+
+                if (match)
+                {
+                    appendConstants((uint32_t)c1 << 8 | (uint32_t)c2 << 16 | c3 << 24, (uint16_t)anchor, (uint8_t)y,
+                                    aOut, aMax, found);
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+size_t
+TqKeyRecovery :: search(Kernel aKernel, const TqKeySearch& aSearch,
+                        uint32_t* aOut, size_t aMax, size_t aThreads)
+{
+    assert(aKernel != nullptr);
+    assert(aSearch.constraints != nullptr || aSearch.count == 0);
+    assert(aOut != nullptr || aMax == 0);
+
+    if (aThreads == 0)
+        aThreads = std::thread::hardware_concurrency();
+    if (aThreads == 0)
+        aThreads = 1;
+    if (aThreads > OUTER / BLOCK_OUTER)
+        aThreads = OUTER / BLOCK_OUTER;
+
+    // each thread searches whole blocks of c1 & c2, the last one the remainder
+    size_t blocks = OUTER / BLOCK_OUTER;
+    std::vector<std::vector<uint32_t> > constants(aThreads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < aThreads; ++t)
+    {
+        uint32_t first = (uint32_t)(blocks * t / aThreads * BLOCK_OUTER);
+        uint32_t last = (uint32_t)(blocks * (t + 1) / aThreads * BLOCK_OUTER);
+
+        if (t + 1 == aThreads)
+            searchThread(aKernel, &aSearch, first, last, &constants[t]);
+        else
+            threads.push_back(std::thread(&searchThread, aKernel, &aSearch, first, last, &constants[t]));
+    }
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    // the ranges are in order
+    size_t found = 0;
+    for (size_t t = 0; t < aThreads; ++t)
+    {
+        for (size_t i = 0; i < constants[t].size(); ++i, ++found)
+        {
+            if (found < aMax)
+                aOut[found] = constants[t][i];
+        }
+    }
+
+    return found;
+}
+
+size_t
+TqKeyRecovery :: findP(Kernel aKernel, const TqKnownOctet* aKnown, size_t aCount,
+                       uint32_t* aOut, size_t aMax, size_t aThreads)
+{
+    assert(aKnown != nullptr || aCount == 0);
+
+    // within a page, key2 cancels out: chain the known octets by index
+    std::vector<TqKnownOctet> known(aKnown, aKnown + aCount);
+    std::sort(known.begin(), known.end(), &isEarlier);
+
+    std::vector<TqKeyConstraint> constraints;
+    for (size_t i = 1; i < known.size(); ++i)
+    {
+        const TqKnownOctet& prev = known[i - 1];
+        const TqKnownOctet& cur = known[i];
+        if ((prev.counter >> 8) != (cur.counter >> 8) || prev.counter == cur.counter)
+            continue;
+
+        TqKeyConstraint c;
+        c.a = (uint16_t)(prev.counter & 0xFF);
+        c.b = (uint16_t)(cur.counter & 0xFF);
+        c.value = (uint8_t)(prev.keystream ^ cur.keystream);
+        constraints.push_back(c);
+    }
+
+    if (constraints.empty())
+        return 0;
+
+    TqKeySearch search;
+    prepare(constraints, search);
+    return TqKeyRecovery::search(aKernel, search, aOut, aMax, aThreads);
+}
+
+size_t
+TqKeyRecovery :: findG(Kernel aKernel, uint32_t aP, const TqKnownOctet* aKnown, size_t aCount,
+                       uint32_t* aOut, size_t aMax, size_t aThreads)
+{
+    assert(aKnown != nullptr || aCount == 0);
+
+    uint8_t key1[HALF];
+    generate(aP, key1);
+
+    // with key1, each known octet gives the key2 octet of its page
+    int pages[HALF];
+    for (size_t i = 0; i < HALF; ++i)
+        pages[i] = -1;
+
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        size_t page = aKnown[i].counter >> 8;
+        int value = aKnown[i].keystream ^ key1[aKnown[i].counter & 0xFF];
+        if (pages[page] >= 0 && pages[page] != value)
+            return 0;
+        pages[page] = value;
+    }
+
+    std::vector<TqKeyConstraint> constraints;
+    for (size_t i = 0; i < HALF; ++i)
+    {
+        if (pages[i] < 0)
+            continue;
+
+        TqKeyConstraint c;
+        c.a = ZERO;
+        c.b = (uint16_t)i;
+        c.value = (uint8_t)pages[i];
+        constraints.push_back(c);
+    }
+
+    if (constraints.empty())
+        return 0;
+
+    TqKeySearch search;
+    prepare(constraints, search);
+    size_t found = TqKeyRecovery::search(aKernel, search, aOut, aMax, aThreads);
+
+    for (size_t i = 0; i < found && i < aMax; ++i)
+        aOut[i] = negateC2(aOut[i]);
+    return found;
+}
+
+bool
+TqKeyRecovery :: verify(uint32_t aP, uint32_t aG, const TqKnownOctet* aKnown, size_t aCount)
+{
+    uint8_t key1[HALF], key2[HALF];
+    generate(aP, key1);
+    generate(negateC2(aG), key2);
+
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        if ((key1[aKnown[i].counter & 0xFF] ^ key2[aKnown[i].counter >> 8]) != aKnown[i].keystream)
+            return false;
+    }
+    return true;
+}
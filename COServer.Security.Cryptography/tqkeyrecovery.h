@@ -0,0 +1,214 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_KEY_RECOVERY_H_
+#define _TQ_KEY_RECOVERY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Octet of keystream known at a counter (the key1 octet of the low octet of
+ * the counter XOR the key2 octet of the high octet).
+ */
+struct TqKnownOctet
+{
+    uint16_t counter; //!< Counter of the octet
+    uint8_t keystream; //!< Keystream of the counter
+};
+
+/**
+ * Relation between two octets of a generated half: x[a] ^ x[b] == value.
+ */
+struct TqKeyConstraint
+{
+    uint16_t a; //!< Index of the first octet, or TqKeyRecovery::ZERO
+    uint16_t b; //!< Index of the second octet (the highest one)
+    uint8_t value; //!< XOR of the octets
+};
+
+/**
+ * Search of the constants generating a half of the key.
+ *
+ * Both halves are generated by the same recurrence over the octets c0..c3 of
+ * a constant: x[0] = c0, x[n + 1] = ((c1 + x[n] * c2) * x[n] + c3) & 0xFF.
+ * For key1, the constant is P; for key2, it is G with c2 = -g2 (the
+ * recurrence of key2 subtracts the product).
+ *
+ * The octet at the anchor (the lowest index of the relations) is searched
+ * instead of c0: the sequence is generated from there.
+ */
+struct TqKeySearch
+{
+    const TqKeyConstraint* constraints; //!< Relations, sorted by their highest index
+    size_t count; //!< Number of relations
+    uint16_t anchor; //!< Lowest index of the relations
+    int fixed; //!< Known octet at the anchor, or -1
+    int delta; //!< Known XOR of the octets at the anchor and the next one, or -1 (c3 is then solved)
+};
+
+/**
+ * Recovery of the P & G constants of a key from known keystream.
+ *
+ * The octet of keystream of counter c is key1[c & 0xFF] ^ key2[c >> 8], and
+ * each half only depends on its own constant, so the halves are searched
+ * independently (2 x 2^32 constants instead of 2^64):
+ *  - within a page (same key2 octet), the XOR of two octets of keystream is
+ *    the XOR of two octets of key1, so P is searched first;
+ *  - each P found gives the key2 octets of the known pages, so G is searched
+ *    next.
+ *
+ * The candidates are (c1, c2, c3) and the octet at the lowest related index
+ * (the anchor), rather than c0: the sequence is generated from the anchor,
+ * only as far as the relations sorted by their highest index need it, and
+ * most of the candidates are rejected by the first relation wherever the
+ * known octets are. When the anchor and the next octet are related, c3 is
+ * solved instead of being searched (2^24 candidates); when the anchor is
+ * known too (key2), only 2^16 candidates remain. The values of c0 reaching
+ * the anchor are only searched for the candidates matching all the
+ * relations. The candidates are split between threads.
+ *
+ * Different constants can generate the same half (or the same known octets
+ * of it): they are all kept, and any of them decrypts the traffic.
+ */
+class TqKeyRecovery
+{
+public:
+    /** The index of an octet always zero (see TqKeyConstraint::a). */
+    static const uint16_t ZERO = 256;
+    /** The number of octets of a half of the key. */
+    static const size_t HALF = 256;
+    /** The number of values of the octets c1 & c2, split between threads. */
+    static const size_t OUTER = 65536;
+
+    /**
+     * Kernel of an implementation, testing the constants whose octets c1 & c2
+     * (c1 | c2 << 8) are in a range.
+     *
+     * @param[in]  aSearch  the search
+     * @param[in]  aFirst   the first value of c1 & c2 (a multiple of 16)
+     * @param[in]  aLast    the value past the last one (a multiple of 16)
+     * @param[out] aOut     the buffer receiving the constants
+     * @param[in]  aMax     the size of the buffer
+     *
+     * @returns the number of constants found (only aMax are written)
+     */
+    typedef size_t (*Kernel)(const TqKeySearch& aSearch, uint32_t aFirst, uint32_t aLast,
+                             uint32_t* aOut, size_t aMax);
+
+public:
+    /**
+     * Derive the octet of keystream of a counter from a known octet of
+     * plaintext and its ciphertext.
+     *
+     * @param[in] aPlain   the plaintext
+     * @param[in] aCipher  the ciphertext
+     */
+    static uint8_t keystream(uint8_t aPlain, uint8_t aCipher)
+    {
+        uint8_t masked = (uint8_t)(aPlain ^ 0xAB);
+        return (uint8_t)(aCipher ^ (uint8_t)(masked << 4 | masked >> 4));
+    }
+
+    /**
+     * Convert a G constant to the constant of its recurrence (c2 = -g2),
+     * and back.
+     */
+    static uint32_t negateC2(uint32_t aConstant)
+    {
+        uint8_t c2 = (uint8_t)(0 - (uint8_t)(aConstant >> 16));
+        return (aConstant & 0xFF00FFFF) | (uint32_t)c2 << 16;
+    }
+
+    /**
+     * Generate a half of the key (see TqKeySearch).
+     *
+     * @param[in]  aConstant  the constant (c0 in the low octet)
+     * @param[out] aHalf      the half (HALF octets)
+     */
+    static void generate(uint32_t aConstant, uint8_t* aHalf);
+
+    /**
+     * Append the constants of a candidate matching all the relations: the
+     * values of c0 whose sequence reaches the octet at the anchor.
+     *
+     * @param[in]     aConstant  the octets c1..c3 of the constant (c0 is ignored)
+     * @param[in]     aAnchor    the index of the anchor
+     * @param[in]     aValue     the octet at the anchor
+     * @param[out]    aOut       the buffer receiving the constants
+     * @param[in]     aMax       the size of the buffer
+     * @param[in,out] aFound     the number of constants found
+     */
+    static void appendConstants(uint32_t aConstant, uint16_t aAnchor, uint8_t aValue,
+                                uint32_t* aOut, size_t aMax, size_t& aFound);
+
+    /**
+     * Search the constants of a range with the standard kernel.
+     * See Kernel.
+     */
+    static size_t searchRange(const TqKeySearch& aSearch, uint32_t aFirst, uint32_t aLast,
+                              uint32_t* aOut, size_t aMax);
+
+    /**
+     * Search all the constants satisfying the relations. The constants are
+     * sorted by c1 & c2.
+     *
+     * @param[in]  aKernel   the kernel of the implementation
+     * @param[in]  aSearch   the search
+     * @param[out] aOut      the buffer receiving the constants
+     * @param[in]  aMax      the size of the buffer
+     * @param[in]  aThreads  the number of threads, or 0 for one per processor
+     *
+     * @returns the number of constants found (only aMax are written)
+     */
+    static size_t search(Kernel aKernel, const TqKeySearch& aSearch,
+                         uint32_t* aOut, size_t aMax, size_t aThreads);
+
+    /**
+     * Search the P constants matching the known keystream.
+     *
+     * @param[in]  aKernel   the kernel of the implementation
+     * @param[in]  aKnown    the known octets
+     * @param[in]  aCount    the number of known octets
+     * @param[out] aOut      the buffer receiving the constants
+     * @param[in]  aMax      the size of the buffer
+     * @param[in]  aThreads  the number of threads, or 0 for one per processor
+     *
+     * @returns the number of constants found (only aMax are written), or 0
+     *          if no page has two known octets
+     */
+    static size_t findP(Kernel aKernel, const TqKnownOctet* aKnown, size_t aCount,
+                        uint32_t* aOut, size_t aMax, size_t aThreads);
+
+    /**
+     * Search the G constants matching the known keystream, given a P
+     * constant.
+     *
+     * @param[in]  aKernel   the kernel of the implementation
+     * @param[in]  aP        the P constant
+     * @param[in]  aKnown    the known octets
+     * @param[in]  aCount    the number of known octets
+     * @param[out] aOut      the buffer receiving the constants
+     * @param[in]  aMax      the size of the buffer
+     * @param[in]  aThreads  the number of threads, or 0 for one per processor
+     *
+     * @returns the number of constants found (only aMax are written), or 0
+     *          if the known octets contradict P
+     */
+    static size_t findG(Kernel aKernel, uint32_t aP, const TqKnownOctet* aKnown, size_t aCount,
+                        uint32_t* aOut, size_t aMax, size_t aThreads);
+
+    /**
+     * Check a (P, G) pair against all the known octets.
+     *
+     * @returns whether or not the key generated by the pair matches them
+     */
+    static bool verify(uint32_t aP, uint32_t aG, const TqKnownOctet* aKnown, size_t aCount);
+};
+
+#endif // _TQ_KEY_RECOVERY_H_
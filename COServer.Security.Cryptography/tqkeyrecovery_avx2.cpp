@@ -0,0 +1,123 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqkeyrecovery_avx2.h"
+#include <immintrin.h>
+
+// GCC & Clang spell the forced inlining of MSVC differently.
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
+/**
+ * Test the candidates of the lanes against the relations.
+ *
+ * @returns the mask of the lanes matching all the relations (two bits per lane)
+ */
+static __forceinline uint32_t
+testLanes(const TqKeySearch& aSearch, __m256i* aSeq, __m256i aC1, __m256i aC2, __m256i aC3)
+{
+    const __m256i octet = _mm256_set1_epi16(0xFF);
+
+    __m256i match = _mm256_set1_epi16(-1);
+    size_t generated = aSearch.anchor;
+    for (size_t i = 0; i < aSearch.count; ++i)
+    {
+        const TqKeyConstraint& c = aSearch.constraints[i];
+        for (; generated < c.b; ++generated)
+        {
+            // (c1 + x * c2) * x + c3, the high octets of the lanes being ignored
+            __m256i x = aSeq[generated];
+            __m256i t = _mm256_add_epi16(aC1, _mm256_mullo_epi16(x, aC2));
+            t = _mm256_add_epi16(_mm256_mullo_epi16(t, x), aC3);
+            aSeq[generated + 1] = _mm256_and_si256(t, octet);
+        }
+
+        __m256i diff = _mm256_xor_si256(aSeq[c.a], aSeq[c.b]);
+        match = _mm256_and_si256(match, _mm256_cmpeq_epi16(diff, _mm256_set1_epi16(c.value)));
+        if (_mm256_testz_si256(match, match))
+            return 0;
+    }
+
+    return (uint32_t)_mm256_movemask_epi8(match);
+}
+
+/**
+ * Append the constants of the matching lanes.
+ */
+static void
+appendLanes(uint32_t aMatch, uint32_t aOuter, __m256i aC3, uint16_t aAnchor, uint8_t aValue,
+            uint32_t* aOut, size_t aMax, size_t& aFound)
+{
+    uint16_t c3[16];
+    _mm256_storeu_si256((__m256i*)c3, aC3);
+
+    for (uint32_t lane = 0; lane < 16; ++lane)
+    {
+        if ((aMatch >> (2 * lane) & 1) == 0)
+            continue;
+
+        uint32_t constant = (aOuter + lane) << 8 | (uint32_t)(c3[lane] & 0xFF) << 24;
+        TqKeyRecovery::appendConstants(constant, aAnchor, aValue, aOut, aMax, aFound);
+    }
+}
+
+size_t
+TqKeyRecovery_AVX2 :: searchRange(const TqKeySearch& aSearch, uint32_t aFirst, uint32_t aLast,
+                                  uint32_t* aOut, size_t aMax)
+{
+    __m256i seq[TqKeyRecovery::HALF + 1];
+    seq[TqKeyRecovery::ZERO] = _mm256_setzero_si256();
+
+    const __m256i lanes = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    const uint16_t anchor = aSearch.anchor;
+    uint32_t firstY = aSearch.fixed >= 0 ? (uint32_t)aSearch.fixed : 0;
+    uint32_t lastY = aSearch.fixed >= 0 ? (uint32_t)aSearch.fixed : 255;
+
+    size_t found = 0;
+    for (uint32_t outer = aFirst; outer < aLast; outer += 16)
+    {
+        // the lanes hold 16 values of c1, with the same c2
+        __m256i c1 = _mm256_add_epi16(_mm256_set1_epi16((short)(outer & 0xFF)), lanes);
+        __m256i c2 = _mm256_set1_epi16((short)(outer >> 8));
+
+        // y is the octet at the anchor
+        for (uint32_t y = firstY; y <= lastY; ++y)
+        {
+            __m256i value = _mm256_set1_epi16((short)y);
+
+            if (aSearch.delta >= 0)
+            {
+                // c3 = x[anchor + 1] - (c1 + y * c2) * y, with x[anchor + 1] = y ^ delta
+                __m256i next = _mm256_set1_epi16((short)(y ^ aSearch.delta));
+                __m256i t = _mm256_mullo_epi16(_mm256_add_epi16(c1, _mm256_mullo_epi16(value, c2)), value);
+                __m256i c3 = _mm256_sub_epi16(next, t);
+
+                seq[anchor] = value;
+                uint32_t match = testLanes(aSearch, seq, c1, c2, c3);
+                if (match != 0)
+                    appendLanes(match, outer, c3, anchor, (uint8_t)y, aOut, aMax, found);
+            }
+            else
+            {
+                for (uint32_t c = 0; c < 256; ++c)
+                {
+                    __m256i c3 = _mm256_set1_epi16((short)c);
+
+                    seq[anchor] = value;
+                    uint32_t match = testLanes(aSearch, seq, c1, c2, c3);
+                    if (match != 0)
+                        appendLanes(match, outer, c3, anchor, (uint8_t)y, aOut, aMax, found);
+                }
+            }
+        }
+    }
+
+    return found;
+}
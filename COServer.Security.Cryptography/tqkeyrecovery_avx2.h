@@ -0,0 +1,34 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_KEY_RECOVERY_AVX2_H_
+#define _TQ_KEY_RECOVERY_AVX2_H_
+
+#include "tqkeyrecovery.h"
+
+/**
+ * Search of the constants of a half of the key using AVX2 (see
+ * TqKeyRecovery).
+ *
+ * The octets of the sequences are held in 16-bit lanes, as the products of
+ * the recurrence are only kept modulo 256: the 16 lanes of a vector hold 16
+ * consecutive values of c1, so the lanes stay full whether or not c0 and c3
+ * are known. A block of candidates is dropped as soon as all its lanes fail
+ * a relation.
+ */
+class TqKeyRecovery_AVX2
+{
+public:
+    /**
+     * Search the constants of a range (see TqKeyRecovery::Kernel).
+     */
+    static size_t searchRange(const TqKeySearch& aSearch, uint32_t aFirst, uint32_t aLast,
+                              uint32_t* aOut, size_t aMax);
+};
+
+#endif // _TQ_KEY_RECOVERY_AVX2_H_
@@ -0,0 +1,315 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqnuma.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <sched.h>
+#endif
+
+#pragma unmanaged
+
+/** The size of the chunks of the pools. */
+static const size_t CHUNK_SIZE = 64 * 1024;
+/** The number of size classes of the pools (128 to 8192 bytes, header included). */
+static const uint32_t CLASSES = 7;
+/** The size class of the blocks allocated directly from the system. */
+static const uint32_t LARGE_CLASS = CLASSES;
+
+/**
+ * Header of a block, followed by its payload.
+ */
+struct TqNumaBlock
+{
+    uint32_t node; //!< Node of the block
+    uint32_t sizeClass; //!< Size class of the block (or LARGE_CLASS)
+    size_t size; //!< Size of the block, header included
+    TqNumaBlock* next; //!< Next free block of the same class
+    uint8_t padding[TqNuma::ALIGNMENT - 2 * sizeof(uint32_t) - sizeof(size_t) - sizeof(void*)];
+};
+
+/**
+ * Pool of the blocks of a node.
+ */
+struct TqNumaPool
+{
+    volatile long lock; //!< Spin lock of the pool
+    TqNumaBlock* free[CLASSES]; //!< Free blocks by size class
+    uint8_t* chunk; //!< Current chunk
+    size_t used; //!< Octets of the current chunk already carved
+};
+
+#ifndef _WIN32
+// subset of libnuma, loaded at run time
+typedef int (*numa_available_t)(void);
+typedef int (*numa_max_node_t)(void);
+typedef int (*numa_node_of_cpu_t)(int);
+typedef int (*numa_run_on_node_t)(int);
+typedef void* (*numa_alloc_onnode_t)(size_t, int);
+typedef void (*numa_free_t)(void*, size_t);
+#endif
+
+/**
+ * State of the NUMA placement, initialized when the module is loaded. Until
+ * then (e.g. a cipher constructed by another static initializer), the state
+ * is zero-filled: no node and no function of libnuma, which is handled as a
+ * single node.
+ */
+static struct TqNumaState
+{
+    uint32_t nodeCount; //!< Number of nodes
+    TqNumaPool pools[TqNuma::MAX_NODES]; //!< Pools of the nodes
+
+    #ifndef _WIN32
+    numa_node_of_cpu_t numa_node_of_cpu;
+    numa_run_on_node_t numa_run_on_node;
+    numa_alloc_onnode_t numa_alloc_onnode;
+    numa_free_t numa_free;
+    #endif
+
+    TqNumaState();
+} sState;
+
+TqNumaState :: TqNumaState()
+    : nodeCount(1)
+{
+    // the pools are zero-initialized with the module, before any constructor
+
+    #ifdef _WIN32
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest))
+        nodeCount = highest + 1;
+    #else
+    numa_node_of_cpu = nullptr;
+    numa_run_on_node = nullptr;
+    numa_alloc_onnode = nullptr;
+    numa_free = nullptr;
+
+    void* lib = dlopen("libnuma.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (lib != nullptr)
+    {
+        numa_available_t available = (numa_available_t)dlsym(lib, "numa_available");
+        numa_max_node_t maxNode = (numa_max_node_t)dlsym(lib, "numa_max_node");
+        numa_node_of_cpu = (numa_node_of_cpu_t)dlsym(lib, "numa_node_of_cpu");
+        numa_run_on_node = (numa_run_on_node_t)dlsym(lib, "numa_run_on_node");
+        numa_alloc_onnode = (numa_alloc_onnode_t)dlsym(lib, "numa_alloc_onnode");
+        numa_free = (numa_free_t)dlsym(lib, "numa_free");
+
+        if (available != nullptr && maxNode != nullptr && numa_node_of_cpu != nullptr &&
+            numa_run_on_node != nullptr && numa_alloc_onnode != nullptr && numa_free != nullptr &&
+            available() >= 0)
+            nodeCount = (uint32_t)maxNode() + 1;
+        // the library stays loaded, the functions are used until the exit
+    }
+    #endif
+
+    if (nodeCount > TqNuma::MAX_NODES)
+        nodeCount = TqNuma::MAX_NODES;
+}
+
+static void
+lockPool(TqNumaPool& aPool)
+{
+    #ifdef _WIN32
+    while (InterlockedCompareExchange(&aPool.lock, 1, 0) != 0)
+        YieldProcessor();
+    #else
+    while (__sync_val_compare_and_swap(&aPool.lock, 0, 1) != 0)
+        sched_yield();
+    #endif
+}
+
+static void
+unlockPool(TqNumaPool& aPool)
+{
+    #ifdef _WIN32
+    InterlockedExchange(&aPool.lock, 0);
+    #else
+    __sync_lock_release(&aPool.lock);
+    #endif
+}
+
+/**
+ * Allocate memory from the system on a node (page granularity).
+ */
+static void*
+allocateChunk(size_t aSize, uint32_t aNode)
+{
+    void* ptr = nullptr;
+
+    #ifdef _WIN32
+    if (sState.nodeCount > 1)
+        ptr = VirtualAllocExNuma(GetCurrentProcess(), nullptr, aSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, aNode);
+    if (ptr == nullptr)
+        ptr = VirtualAlloc(nullptr, aSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    #else
+    if (sState.nodeCount > 1)
+        ptr = sState.numa_alloc_onnode(aSize, (int)aNode);
+    else if (posix_memalign(&ptr, 4096, aSize) != 0)
+        ptr = nullptr;
+    #endif
+
+    return ptr;
+}
+
+static void
+releaseChunk(void* aPtr, size_t aSize)
+{
+    #ifdef _WIN32
+    (void)aSize;
+    VirtualFree(aPtr, 0, MEM_RELEASE);
+    #else
+    if (sState.nodeCount > 1)
+        sState.numa_free(aPtr, aSize);
+    else
+        free(aPtr);
+    #endif
+}
+
+uint32_t
+TqNuma :: getNodeCount()
+{
+    return sState.nodeCount;
+}
+
+uint32_t
+TqNuma :: getCurrentNode()
+{
+    // no node yet if the state isn't initialized
+    if (sState.nodeCount <= 1)
+        return 0;
+
+    int node = 0;
+
+    #ifdef _WIN32
+    PROCESSOR_NUMBER processor;
+    USHORT number = 0;
+    GetCurrentProcessorNumberEx(&processor);
+    if (GetNumaProcessorNodeEx(&processor, &number))
+        node = number;
+    #else
+    int cpu = sched_getcpu();
+    if (cpu >= 0 && sState.numa_node_of_cpu != nullptr)
+        node = sState.numa_node_of_cpu(cpu);
+    #endif
+
+    return node >= 0 && (uint32_t)node < sState.nodeCount ? (uint32_t)node : 0;
+}
+
+bool
+TqNuma :: pinThread(uint32_t aNode)
+{
+    if (aNode >= sState.nodeCount)
+        return false;
+    if (sState.nodeCount <= 1)
+        return true;
+
+    #ifdef _WIN32
+    GROUP_AFFINITY affinity;
+    if (!GetNumaNodeProcessorMaskEx((USHORT)aNode, &affinity))
+        return false;
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != FALSE;
+    #else
+    return sState.numa_run_on_node((int)aNode) == 0;
+    #endif
+}
+
+void*
+TqNuma :: allocate(size_t aSize, uint32_t aNode)
+{
+    uint32_t node = aNode < sState.nodeCount ? aNode : 0;
+    size_t size = sizeof(TqNumaBlock) + aSize;
+
+    uint32_t sizeClass = 0;
+    while (sizeClass < CLASSES && ((size_t)128 << sizeClass) < size)
+        ++sizeClass;
+
+    TqNumaBlock* block = nullptr;
+    if (sizeClass == LARGE_CLASS)
+    {
+        size = (size + 4095) & ~(size_t)4095;
+        block = (TqNumaBlock*)allocateChunk(size, node);
+    }
+    else
+    {
+        size = (size_t)128 << sizeClass;
+
+        TqNumaPool& pool = sState.pools[node];
+        lockPool(pool);
+        if (pool.free[sizeClass] != nullptr)
+        {
+            block = pool.free[sizeClass];
+            pool.free[sizeClass] = block->next;
+        }
+        else if (pool.chunk != nullptr && CHUNK_SIZE - pool.used >= size)
+        {
+            block = (TqNumaBlock*)(pool.chunk + pool.used);
+            pool.used += size;
+        }
+        unlockPool(pool);
+
+        if (block == nullptr)
+        {
+            // the system is called outside of the lock, and the chunk of the
+            // thread coming second is dropped if the other one still has room
+            uint8_t* chunk = (uint8_t*)allocateChunk(CHUNK_SIZE, node);
+            if (chunk == nullptr)
+                return nullptr;
+
+            lockPool(pool);
+            if (pool.chunk == nullptr || CHUNK_SIZE - pool.used < size)
+            {
+                // the end of the previous chunk is lost, at most one block of each class
+                pool.chunk = chunk;
+                pool.used = 0;
+                chunk = nullptr;
+            }
+            block = (TqNumaBlock*)(pool.chunk + pool.used);
+            pool.used += size;
+            unlockPool(pool);
+
+            if (chunk != nullptr)
+                releaseChunk(chunk, CHUNK_SIZE);
+        }
+    }
+
+    if (block == nullptr)
+        return nullptr;
+
+    block->node = node;
+    block->sizeClass = sizeClass;
+    block->size = size;
+    block->next = nullptr;
+    return block + 1;
+}
+
+void
+TqNuma :: release(void* aPtr)
+{
+    if (aPtr == nullptr)
+        return;
+
+    TqNumaBlock* block = (TqNumaBlock*)aPtr - 1;
+    if (block->sizeClass == LARGE_CLASS)
+    {
+        releaseChunk(block, block->size);
+        return;
+    }
+
+    TqNumaPool& pool = sState.pools[block->node];
+    lockPool(pool);
+    block->next = pool.free[block->sizeClass];
+    pool.free[block->sizeClass] = block;
+    unlockPool(pool);
+}
+
+#pragma managed
@@ -0,0 +1,92 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_NUMA_H_
+#define _TQ_NUMA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * NUMA node of an allocation (see TqCipher_Base::operator new).
+ */
+struct TqNumaNode
+{
+    explicit TqNumaNode(uint32_t aNode) : node(aNode) { }
+
+    uint32_t node; //!< Index of the node
+};
+
+/**
+ * Placement of the memory on the NUMA nodes of the machine.
+ *
+ * The nodes are queried with the NUMA API of Windows, or with libnuma on the
+ * other systems when the library can be loaded. Without them (or on a single
+ * node machine), everything falls back to one node and the process heap.
+ *
+ * The small blocks (sessions, key replicas) come from a pool per node, carved
+ * out of chunks allocated on the node. The chunks are never returned to the
+ * system, the released blocks are reused by the next allocations of the node:
+ * the memory of a pool is capped by the peak of its blocks of each size
+ * class (e.g. the most sessions the process ever had), not by the current
+ * ones. This is deliberate, the servers keep their sessions for long and open
+ * new ones at about the rate they close the old ones. The pool of a node is
+ * guarded by a spin lock, only held to take or carve a block; the chunks are
+ * allocated from the system outside of it.
+ */
+class TqNuma
+{
+public:
+    /** The maximum number of nodes (the higher nodes are merged into node 0). */
+    static const uint32_t MAX_NODES = 64;
+    /** The alignment of the blocks (a cache line). */
+    static const size_t ALIGNMENT = 64;
+
+public:
+    /**
+     * Get the number of nodes of the machine.
+     *
+     * @returns the number of nodes (1 if NUMA isn't available)
+     */
+    static uint32_t getNodeCount();
+
+    /**
+     * Get the node of the processor running the current thread.
+     *
+     * @returns the node (0 if NUMA isn't available)
+     */
+    static uint32_t getCurrentNode();
+
+    /**
+     * Restrict the current thread to the processors of a node.
+     *
+     * @param[in] aNode  the node
+     *
+     * @returns false if the thread can't be pinned
+     */
+    static bool pinThread(uint32_t aNode);
+
+    /**
+     * Allocate a block on a node.
+     *
+     * @param[in] aSize  the size of the block in bytes
+     * @param[in] aNode  the node
+     *
+     * @returns the block (aligned on ALIGNMENT), or nullptr if the memory is exhausted
+     */
+    static void* allocate(size_t aSize, uint32_t aNode);
+
+    /**
+     * Release a block allocated by allocate().
+     *
+     * @param[in] aPtr  the block (can be nullptr)
+     */
+    static void release(void* aPtr);
+};
+
+#endif // _TQ_NUMA_H_
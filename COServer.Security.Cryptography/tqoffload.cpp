@@ -0,0 +1,531 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqoffload.h"
+#include <stdio.h> // sprintf
+#include <string.h> // memset, strncpy
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <immintrin.h>
+#endif
+
+typedef TqOffloadRegion Region;
+
+static inline long
+atomicCas(volatile long* aPtr, long aValue, long aComparand)
+{
+#ifdef _WIN32
+    return _InterlockedCompareExchange(aPtr, aValue, aComparand);
+#else
+    return __sync_val_compare_and_swap(aPtr, aComparand, aValue);
+#endif
+}
+
+static inline long long
+atomicCas64(volatile long long* aPtr, long long aValue, long long aComparand)
+{
+#ifdef _WIN32
+    return _InterlockedCompareExchange64(aPtr, aValue, aComparand);
+#else
+    return __sync_val_compare_and_swap(aPtr, aComparand, aValue);
+#endif
+}
+
+static inline void
+atomicStore(volatile long* aPtr, long aValue)
+{
+#ifdef _WIN32
+    _InterlockedExchange(aPtr, aValue);
+#else
+    __sync_synchronize();
+    *aPtr = aValue;
+    __sync_synchronize();
+#endif
+}
+
+static inline void
+fullBarrier()
+{
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+/**
+ * Spin a while, then yield the processor.
+ */
+static inline void
+backoff(uint32_t& aSpins)
+{
+    if (++aSpins < 256)
+        _mm_pause();
+    else
+        std::this_thread::yield();
+}
+
+TqOffloadRegion :: TqOffloadRegion()
+    : mHeader(nullptr), mCreated(false)
+{
+    mName[0] = '\0';
+#ifdef _WIN32
+    mMapping = nullptr;
+    for (size_t i = 0; i < MAX_WORKERS; ++i)
+        mEvents[i] = nullptr;
+#endif
+}
+
+TqOffloadRegion :: ~TqOffloadRegion()
+{
+    close();
+}
+
+bool
+TqOffloadRegion :: create(const char* aName, size_t aWorkers)
+{
+    if (aWorkers == 0 || aWorkers > MAX_WORKERS)
+        return false;
+
+    strncpy(mName, aName, sizeof(mName) - 1);
+    mName[sizeof(mName) - 1] = '\0';
+
+#ifdef _WIN32
+    char name[96];
+    sprintf(name, "Local\\%s", mName);
+    mMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  (DWORD)((uint64_t)sizeof(Header) >> 32), (DWORD)sizeof(Header), name);
+    if (mMapping == nullptr)
+        return false;
+
+    mHeader = (Header*)MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Header));
+    if (mHeader == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    // the rings and the arenas stay in physical memory (best effort)
+    VirtualLock(mHeader, sizeof(Header));
+#else
+    char name[96];
+    sprintf(name, "/%s", mName);
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, sizeof(Header)) != 0)
+    {
+        ::close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return false;
+    }
+    mHeader = (Header*)addr;
+
+    // the rings and the arenas stay in physical memory (best effort)
+    mlock(mHeader, sizeof(Header));
+#endif
+
+    mCreated = true;
+    if (!openDoorbells(true))
+    {
+        close();
+        return false;
+    }
+
+    mHeader->magic = 0;
+    fullBarrier();
+
+    memset(mHeader->workers, 0, sizeof(mHeader->workers));
+    for (size_t i = 0; i < CHANNELS; ++i)
+    {
+        Channel& channel = mHeader->channels[i];
+        channel.owner = 0;
+        channel.generation = 0;
+        channel.worker = (uint32_t)(i % aWorkers);
+        channel.head = 0;
+        channel.tail = 0;
+        channel.freeBlocks = ~0LL;
+        for (size_t j = 0; j < RING_SIZE; ++j)
+            channel.ring[j].sequence = (long)j;
+    }
+
+    mHeader->version = VERSION;
+    mHeader->workerCount = (uint32_t)aWorkers;
+    mHeader->running = 1;
+    fullBarrier();
+    mHeader->magic = MAGIC;
+
+    return true;
+}
+
+bool
+TqOffloadRegion :: open(const char* aName)
+{
+    strncpy(mName, aName, sizeof(mName) - 1);
+    mName[sizeof(mName) - 1] = '\0';
+
+#ifdef _WIN32
+    char name[96];
+    sprintf(name, "Local\\%s", mName);
+    mMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (mMapping == nullptr)
+        return false;
+
+    mHeader = (Header*)MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Header));
+#else
+    char name[96];
+    sprintf(name, "/%s", mName);
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    void* addr = mmap(nullptr, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    mHeader = addr != MAP_FAILED ? (Header*)addr : nullptr;
+#endif
+
+    if (mHeader == nullptr || mHeader->magic != MAGIC || mHeader->version != VERSION ||
+        mHeader->running == 0 || !openDoorbells(false))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void
+TqOffloadRegion :: close()
+{
+#ifdef _WIN32
+    for (size_t i = 0; i < MAX_WORKERS; ++i)
+    {
+        if (mEvents[i] != nullptr)
+        {
+            CloseHandle(mEvents[i]);
+            mEvents[i] = nullptr;
+        }
+    }
+    if (mHeader != nullptr)
+        UnmapViewOfFile(mHeader);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+    mMapping = nullptr;
+#else
+    if (mHeader != nullptr)
+        munmap(mHeader, sizeof(Header));
+    if (mCreated)
+    {
+        char name[96];
+        sprintf(name, "/%s", mName);
+        shm_unlink(name);
+    }
+#endif
+
+    mHeader = nullptr;
+    mCreated = false;
+}
+
+bool
+TqOffloadRegion :: openDoorbells(bool aCreate)
+{
+#ifdef _WIN32
+    for (size_t i = 0; i < MAX_WORKERS; ++i)
+    {
+        char name[96];
+        sprintf(name, "Local\\%s-worker-%u", mName, (unsigned)i);
+        mEvents[i] = aCreate ? CreateEventA(nullptr, FALSE, FALSE, name)
+                             : OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, name);
+        if (mEvents[i] == nullptr)
+            return false;
+    }
+#else
+    (void)aCreate; // the futexes are in the region
+#endif
+    return true;
+}
+
+void
+TqOffloadRegion :: ring(size_t aWorker)
+{
+    Worker& worker = mHeader->workers[aWorker];
+    if (worker.sleeping == 0)
+        return;
+
+#ifdef _WIN32
+    SetEvent(mEvents[aWorker]);
+#else
+    __sync_fetch_and_add(&worker.doorbell, 1);
+    syscall(SYS_futex, &worker.doorbell, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+int32_t
+TqOffloadRegion :: prepareWait(size_t aWorker)
+{
+    Worker& worker = mHeader->workers[aWorker];
+    atomicStore(&worker.sleeping, 1);
+    return worker.doorbell;
+}
+
+void
+TqOffloadRegion :: wait(size_t aWorker, int32_t aToken, uint32_t aTimeout)
+{
+    Worker& worker = mHeader->workers[aWorker];
+
+#ifdef _WIN32
+    (void)aToken; // the event stays signaled until the wait
+    WaitForSingleObject(mEvents[aWorker], aTimeout);
+#else
+    struct timespec timeout;
+    timeout.tv_sec = aTimeout / 1000;
+    timeout.tv_nsec = (long)(aTimeout % 1000) * 1000000L;
+    syscall(SYS_futex, &worker.doorbell, FUTEX_WAIT, aToken, &timeout, nullptr, 0);
+#endif
+
+    atomicStore(&worker.sleeping, 0);
+}
+
+long
+TqOffloadRegion :: getProcessId()
+{
+#ifdef _WIN32
+    return (long)GetCurrentProcessId();
+#else
+    return (long)getpid();
+#endif
+}
+
+TqOffloadClient :: TqOffloadClient()
+    : mChannel(nullptr), mWorker(0), mPid(0), mTimeout(DEFAULT_TIMEOUT), mLost(0)
+{
+
+}
+
+TqOffloadClient :: ~TqOffloadClient()
+{
+    // the channel may belong to another process if the service restarted
+    if (mChannel != nullptr && atomicCas(&mChannel->owner, 0, mPid) == mPid)
+        mRegion.ring(mWorker);
+}
+
+TqOffloadClient*
+TqOffloadClient :: connect(const char* aName, uint32_t aTimeout)
+{
+    TqOffloadClient* client = new TqOffloadClient();
+    if (!client->mRegion.open(aName))
+    {
+        delete client;
+        return nullptr;
+    }
+
+    long pid = TqOffloadRegion::getProcessId();
+    Region::Header* header = client->mRegion.getHeader();
+    for (size_t i = 0; i < Region::CHANNELS; ++i)
+    {
+        Region::Channel& channel = header->channels[i];
+        if (atomicCas(&channel.owner, pid, 0) == 0)
+        {
+            // the worker drops the sessions of the previous owner
+            atomicStore(&channel.generation, channel.generation + 1);
+            client->mChannel = &channel;
+            client->mWorker = channel.worker;
+            client->mPid = pid;
+            client->mTimeout = aTimeout;
+            return client;
+        }
+    }
+
+    delete client;
+    return nullptr;
+}
+
+uint64_t
+TqOffloadClient :: getTime()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool
+TqOffloadClient :: checkAlive(uint64_t aDeadline)
+{
+    if (mLost != 0)
+        return false;
+
+    Region::Header* header = mRegion.getHeader();
+    if (header->running != 0 && mChannel->owner == mPid && getTime() < aDeadline)
+        return true;
+
+    // the jobs in flight are abandoned with their slots: the ring isn't used anymore
+    atomicStore(&mLost, 1);
+    return false;
+}
+
+uint8_t*
+TqOffloadClient :: allocate()
+{
+    if (mLost != 0)
+        return nullptr;
+
+    long long mask = mChannel->freeBlocks;
+    while (mask != 0)
+    {
+        // lowest free block
+        long long bit = mask & -mask;
+        long long previous = atomicCas64(&mChannel->freeBlocks, mask & ~bit, mask);
+        if (previous == mask)
+        {
+            size_t index = 0;
+            while (((unsigned long long)bit >> index) != 1)
+                ++index;
+            return mChannel->arena + index * Region::BLOCK_SIZE;
+        }
+        mask = previous;
+    }
+    return nullptr;
+}
+
+void
+TqOffloadClient :: release(uint8_t* aBlock)
+{
+    size_t index = (size_t)(aBlock - mChannel->arena) / Region::BLOCK_SIZE;
+    long long bit = 1LL << index;
+
+    long long mask = mChannel->freeBlocks;
+    for (;;)
+    {
+        long long previous = atomicCas64(&mChannel->freeBlocks, mask | bit, mask);
+        if (previous == mask)
+            break;
+        mask = previous;
+    }
+}
+
+bool
+TqOffloadClient :: contains(const uint8_t* aBuf, size_t aLen) const
+{
+    const uint8_t* begin = mChannel->arena;
+    const uint8_t* end = begin + sizeof(mChannel->arena);
+    return aBuf >= begin && aBuf <= end && aLen <= (size_t)(end - aBuf);
+}
+
+uint32_t
+TqOffloadClient :: submit(uint8_t aOp, uint32_t aSession, uint16_t aCounter,
+                          uint32_t aArg0, uint32_t aArg1, const uint8_t* aBuf, size_t aLen)
+{
+    if (mLost != 0)
+        return INVALID_TICKET;
+
+    // claim the slot of the next position (bounded MPSC queue)
+    TqOffloadJob* job = nullptr;
+    long pos = mChannel->head;
+    uint32_t spins = 0;
+    uint64_t deadline = getTime() + mTimeout;
+    for (;;)
+    {
+        job = &mChannel->ring[(size_t)pos & (Region::RING_SIZE - 1)];
+        long diff = job->sequence - pos;
+        if (diff == 0)
+        {
+            long previous = atomicCas(&mChannel->head, pos + 1, pos);
+            if (previous == pos)
+                break;
+            pos = previous;
+        }
+        else if (diff < 0)
+        {
+            // the ring is full
+            backoff(spins);
+            if (spins % 256 == 0 && !checkAlive(deadline))
+                return INVALID_TICKET;
+            pos = mChannel->head;
+        }
+        else
+            pos = mChannel->head;
+    }
+
+    job->op = aOp;
+    job->status = Region::STATUS_OK;
+    job->counter = aCounter;
+    job->session = aSession;
+    job->arg0 = aArg0;
+    job->arg1 = aArg1;
+    job->offset = aBuf != nullptr ? (uint32_t)(aBuf - mChannel->arena) : 0;
+    job->len = (uint32_t)aLen;
+    job->result = 0;
+    atomicStore(&job->sequence, pos + 1);
+
+    mRegion.ring(mWorker);
+    return (uint32_t)pos;
+}
+
+uint32_t
+TqOffloadClient :: wait(uint32_t aTicket, uint8_t* aStatus)
+{
+    if (aTicket == INVALID_TICKET)
+    {
+        if (aStatus != nullptr)
+            *aStatus = Region::STATUS_LOST;
+        return UINT32_MAX;
+    }
+
+    long pos = (long)aTicket;
+    TqOffloadJob* job = &mChannel->ring[(size_t)pos & (Region::RING_SIZE - 1)];
+
+    // the liveness of the service is checked once the spinning turns to yielding
+    uint32_t spins = 0;
+    uint64_t deadline = getTime() + mTimeout;
+    while (job->sequence != pos + 2)
+    {
+        backoff(spins);
+        if (spins % 256 == 0 && !checkAlive(deadline))
+        {
+            if (aStatus != nullptr)
+                *aStatus = Region::STATUS_LOST;
+            return UINT32_MAX;
+        }
+    }
+    fullBarrier();
+
+    uint32_t result = job->result;
+    if (aStatus != nullptr)
+        *aStatus = job->status;
+
+    // free the slot for the next lap
+    atomicStore(&job->sequence, pos + (long)Region::RING_SIZE);
+    return result;
+}
+
+uint32_t
+TqOffloadClient :: call(uint8_t aOp, uint32_t aSession, uint16_t aCounter,
+                        uint32_t aArg0, uint32_t aArg1, const uint8_t* aBuf, size_t aLen)
+{
+    uint8_t status = Region::STATUS_OK;
+    uint32_t result = wait(submit(aOp, aSession, aCounter, aArg0, aArg1, aBuf, aLen), &status);
+    return status == Region::STATUS_OK ? result : UINT32_MAX;
+}
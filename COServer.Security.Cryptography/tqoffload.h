@@ -0,0 +1,340 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_OFFLOAD_H_
+#define _TQ_OFFLOAD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+ * Job submitted to the offload service. The slot of a job in its ring goes
+ * through four states, tracked by its sequence number:
+ *   pos              free, can be claimed by the producer of the position
+ *   pos + 1          submitted, waiting for the service
+ *   pos + 2          completed, the producer can read the result
+ *   pos + RING_SIZE  released by the producer, free for the next lap
+ */
+struct TqOffloadJob
+{
+    volatile long sequence; //!< State of the slot (see above)
+    uint8_t op; //!< Operation (TqOffloadRegion::OP_*)
+    uint8_t status; //!< Status of the completed job (TqOffloadRegion::STATUS_*)
+    uint16_t counter; //!< Counter of the first octet (encryption and decryption)
+    uint32_t session; //!< Session of the job
+    uint32_t arg0; //!< P (SET_KEY) or seed (ALT_KEY)
+    uint32_t arg1; //!< G (SET_KEY)
+    uint32_t offset; //!< Offset of the octets in the arena of the channel
+    uint32_t len; //!< Number of octets
+    uint32_t result; //!< Session opened by OPEN
+};
+
+/**
+ * Shared memory of the offload service: a named region holding one channel
+ * per client process. Each channel has a bounded MPSC ring of jobs (the
+ * threads of the client produce, a worker of the service consumes) and an
+ * arena of blocks where the octets are processed in place, so the buffers
+ * are handed over without copy.
+ *
+ * The region is a file mapping and the doorbells are named events on
+ * Windows; on Linux, it is a POSIX shared memory object and the doorbells
+ * are futexes. The channel of a process killed while holding it is only
+ * reclaimed when the service is restarted.
+ */
+class TqOffloadRegion
+{
+public:
+    /** The magic number of a ready region. */
+    static const uint32_t MAGIC = 0x4F465154; // "TQFO"
+    /** The version of the layout. */
+    static const uint32_t VERSION = 1;
+    /** The number of channels (client processes). */
+    static const size_t CHANNELS = 16;
+    /** The number of jobs of a ring (power of two). */
+    static const size_t RING_SIZE = 256;
+    /** The size of a block of an arena. */
+    static const size_t BLOCK_SIZE = 16384;
+    /** The number of blocks of an arena (one bit each in the free mask). */
+    static const size_t BLOCKS = 64;
+    /** The maximum number of workers of the service. */
+    static const size_t MAX_WORKERS = 16;
+    /** The maximum number of sessions of a channel. */
+    static const size_t MAX_SESSIONS = 4096;
+    /** The size of a cache line. */
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    /** Operations of the jobs. */
+    enum
+    {
+        OP_OPEN = 1,         //!< Open a session with the zero-filled key
+        OP_CLOSE = 2,        //!< Close the session
+        OP_SET_KEY = 3,      //!< Use the base key of (P, G)
+        OP_ALT_KEY = 4,      //!< Expand the alternate key of the seed and use it for the decryption
+        OP_CLEAR_ALT_KEY = 5,//!< Use the base key for the decryption
+        OP_ENCRYPT = 6,      //!< Encrypt octets of the arena
+        OP_DECRYPT = 7       //!< Decrypt octets of the arena
+    };
+
+    /** Status of the completed jobs. */
+    enum
+    {
+        STATUS_OK = 0,      //!< The job succeeded
+        STATUS_ERROR = 1,   //!< Invalid session, operation or octets (the octets are untouched)
+        STATUS_LOST = 2     //!< The service stopped or didn't answer in time (set by the client)
+    };
+
+    /** Doorbell of a worker. */
+    struct Worker
+    {
+        volatile long sleeping; //!< Whether the worker waits on its doorbell
+        volatile int32_t doorbell; //!< Futex word (Linux)
+        uint8_t padding[CACHE_LINE_SIZE - sizeof(long) - sizeof(int32_t)];
+    };
+
+    /** Channel of a client process. */
+    struct Channel
+    {
+        volatile long owner; //!< Process owning the channel (0 if free)
+        volatile long generation; //!< Incremented when the channel is claimed
+        uint32_t worker; //!< Worker serving the channel
+        uint8_t padding0[CACHE_LINE_SIZE - 2 * sizeof(long) - sizeof(uint32_t)];
+        volatile long head; //!< Next position to claim by the producers
+        uint8_t padding1[CACHE_LINE_SIZE - sizeof(long)];
+        volatile long tail; //!< Next position to consume by the worker
+        uint8_t padding2[CACHE_LINE_SIZE - sizeof(long)];
+        volatile long long freeBlocks; //!< Mask of the free blocks of the arena
+        uint8_t padding3[CACHE_LINE_SIZE - sizeof(long long)];
+        TqOffloadJob ring[RING_SIZE]; //!< Jobs
+        uint8_t arena[BLOCKS * BLOCK_SIZE]; //!< Octets of the jobs
+    };
+
+    /** Layout of the region. */
+    struct Header
+    {
+        uint32_t magic; //!< MAGIC once the region is initialized
+        uint32_t version; //!< VERSION
+        uint32_t workerCount; //!< Number of workers of the service
+        volatile long running; //!< Whether the service is running
+        uint8_t padding[CACHE_LINE_SIZE - 3 * sizeof(uint32_t) - sizeof(long)];
+        Worker workers[MAX_WORKERS]; //!< Doorbells of the workers
+        Channel channels[CHANNELS]; //!< Channels of the clients
+    };
+
+public:
+    /* constructor */
+    TqOffloadRegion();
+
+    /* destructor */
+    ~TqOffloadRegion();
+
+public:
+    /**
+     * Create the region of the service. An existing region of the same name
+     * is reused (e.g. after a crash of the service).
+     *
+     * @param[in] aName     the name of the region
+     * @param[in] aWorkers  the number of workers
+     *
+     * @returns false if the region can't be created
+     */
+    bool create(const char* aName, size_t aWorkers);
+
+    /**
+     * Open the region of a running service.
+     *
+     * @param[in] aName  the name of the region
+     *
+     * @returns false if no service is running under this name
+     */
+    bool open(const char* aName);
+
+    /** Unmap the region (and remove its name if it was created). */
+    void close();
+
+    /** Get the layout of the region. */
+    Header* getHeader() const { return mHeader; }
+
+    /**
+     * Wake up a worker if it is waiting on its doorbell.
+     *
+     * @param[in] aWorker  the index of the worker
+     */
+    void ring(size_t aWorker);
+
+    /**
+     * Announce that a worker is about to wait on its doorbell. The worker
+     * must check its rings after this call, and only wait if they are empty.
+     *
+     * @param[in] aWorker  the index of the worker
+     *
+     * @returns the token to pass to wait()
+     */
+    int32_t prepareWait(size_t aWorker);
+
+    /**
+     * Wait on the doorbell of a worker, unless it was rung since
+     * prepareWait().
+     *
+     * @param[in] aWorker   the index of the worker
+     * @param[in] aToken    the token returned by prepareWait()
+     * @param[in] aTimeout  the maximum time to wait in milliseconds
+     */
+    void wait(size_t aWorker, int32_t aToken, uint32_t aTimeout);
+
+    /** Get the identifier of the current process. */
+    static long getProcessId();
+
+private:
+    /** Open (or create) the doorbells of the workers. */
+    bool openDoorbells(bool aCreate);
+
+private:
+    // not copyable
+    TqOffloadRegion(const TqOffloadRegion&);
+    TqOffloadRegion& operator=(const TqOffloadRegion&);
+
+private:
+    Header* mHeader; //!< Mapped region
+    bool mCreated; //!< Whether the region was created by this object
+    char mName[64]; //!< Name of the region
+
+#ifdef _WIN32
+    HANDLE mMapping; //!< File mapping of the region
+    HANDLE mEvents[MAX_WORKERS]; //!< Doorbells of the workers
+#endif
+};
+
+/**
+ * Client of the offload service: the channel of a process. The methods can
+ * be called from many threads.
+ *
+ * The waits are bounded: when the service stops, gives the channel to
+ * another process (e.g. after a restart) or doesn't answer within the
+ * timeout, the client is lost. The pending and the next jobs then fail with
+ * STATUS_LOST, and the blocks of the arena can't be allocated anymore, so
+ * the sessions process their octets locally.
+ */
+class TqOffloadClient
+{
+public:
+    /** The default time to wait for a job, in milliseconds. */
+    static const uint32_t DEFAULT_TIMEOUT = 1000;
+    /** The ticket of a job that couldn't be submitted. */
+    static const uint32_t INVALID_TICKET = UINT32_MAX;
+
+public:
+    /**
+     * Connect to a running service and claim a channel.
+     *
+     * @param[in] aName     the name of the region
+     * @param[in] aTimeout  the maximum time to wait for a job, in milliseconds
+     *
+     * @returns the client, or nullptr if no service is running or all the
+     *          channels are used
+     */
+    static TqOffloadClient* connect(const char* aName, uint32_t aTimeout = DEFAULT_TIMEOUT);
+
+    /* destructor (releases the channel) */
+    ~TqOffloadClient();
+
+public:
+    /**
+     * Allocate a block of the arena, so a packet can be written directly in
+     * the shared memory and processed without copy.
+     *
+     * @returns the block (BLOCK_SIZE octets), or nullptr if all the blocks are used
+     */
+    uint8_t* allocate();
+
+    /**
+     * Release a block of the arena.
+     *
+     * @param[in] aBlock  the block returned by allocate()
+     */
+    void release(uint8_t* aBlock);
+
+    /**
+     * Check if octets are in a block of the arena.
+     *
+     * @param[in] aBuf  the octets
+     * @param[in] aLen  the number of octets
+     *
+     * @returns true if the octets can be processed in place
+     */
+    bool contains(const uint8_t* aBuf, size_t aLen) const;
+
+    /** Check if the service was lost (see above). */
+    bool isLost() const { return mLost != 0; }
+
+    /**
+     * Submit a job. The call blocks while the ring is full, up to the
+     * timeout.
+     *
+     * @param[in] aOp       the operation
+     * @param[in] aSession  the session
+     * @param[in] aCounter  the counter of the first octet
+     * @param[in] aArg0     the first argument
+     * @param[in] aArg1     the second argument
+     * @param[in] aBuf      the octets (in the arena), or nullptr
+     * @param[in] aLen      the number of octets
+     *
+     * @returns the ticket of the job, or INVALID_TICKET if the service is lost
+     */
+    uint32_t submit(uint8_t aOp, uint32_t aSession, uint16_t aCounter,
+                    uint32_t aArg0, uint32_t aArg1, const uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Wait for the completion of a job and release its slot, up to the
+     * timeout.
+     *
+     * @param[in]  aTicket  the ticket returned by submit()
+     * @param[out] aStatus  the status of the job (STATUS_LOST if the service is lost)
+     *
+     * @returns the result of the job, or UINT32_MAX if the service is lost
+     */
+    uint32_t wait(uint32_t aTicket, uint8_t* aStatus);
+
+    /**
+     * Submit a job and wait for its completion.
+     *
+     * @returns the result of the job, or UINT32_MAX if it failed
+     */
+    uint32_t call(uint8_t aOp, uint32_t aSession, uint16_t aCounter = 0,
+                  uint32_t aArg0 = 0, uint32_t aArg1 = 0, const uint8_t* aBuf = nullptr, size_t aLen = 0);
+
+private:
+    /* constructor */
+    TqOffloadClient();
+
+    /**
+     * Check that the service is still running, still gives the channel to
+     * the process and answers before a deadline, or mark the client as lost.
+     *
+     * @param[in] aDeadline  the deadline (see getTime)
+     *
+     * @returns false if the client is lost
+     */
+    bool checkAlive(uint64_t aDeadline);
+
+    /** Get the time of a monotonic clock, in milliseconds. */
+    static uint64_t getTime();
+
+private:
+    TqOffloadRegion mRegion; //!< Region of the service
+    TqOffloadRegion::Channel* mChannel; //!< Channel of the process
+    size_t mWorker; //!< Worker serving the channel
+    long mPid; //!< Process owning the channel
+    uint32_t mTimeout; //!< Maximum time to wait for a job, in milliseconds
+    volatile long mLost; //!< Whether the service was lost
+};
+
+#endif // _TQ_OFFLOAD_H_
@@ -0,0 +1,281 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqoffload_service.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <immintrin.h>
+#endif
+
+typedef TqOffloadRegion Region;
+
+const char* const TqOffloadService::DEFAULT_NAME = "tqcipher-offload";
+
+/** The number of empty polls before a worker sleeps. */
+static const size_t SPIN_POLLS = 4096;
+/** The number of empty polls between two yields of a spinning worker. */
+static const size_t YIELD_POLLS = 64;
+/** The maximum time a worker sleeps before polling again, in milliseconds. */
+static const uint32_t SLEEP_TIMEOUT = 100;
+
+/**
+ * Pin the current thread on a processor.
+ */
+static void
+pinThread(int aCpu)
+{
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << aCpu);
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(aCpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+static inline void
+publish(volatile long* aPtr, long aValue)
+{
+#ifdef _WIN32
+    _InterlockedExchange(aPtr, aValue);
+#else
+    __sync_synchronize();
+    *aPtr = aValue;
+#endif
+}
+
+TqOffloadService :: TqOffloadService()
+    : mKernel(nullptr), mRunning(false), mWorkerCount(0), mJobs(0), mBytes(0)
+{
+    for (size_t i = 0; i < Region::CHANNELS; ++i)
+        mChannels[i].generation = 0;
+}
+
+TqOffloadService :: ~TqOffloadService()
+{
+    stop();
+}
+
+bool
+TqOffloadService :: start(const char* aName, TqCipherStream::Kernel aKernel, size_t aWorkers, int aFirstCpu)
+{
+    if (mRunning || !mRegion.create(aName, aWorkers))
+        return false;
+
+    mKernel = aKernel;
+    mWorkerCount = aWorkers;
+    mRunning = true;
+    for (size_t i = 0; i < aWorkers; ++i)
+        mWorkers.push_back(std::thread(&TqOffloadService::workerLoop, this, i, aFirstCpu >= 0 ? aFirstCpu + (int)i : -1));
+
+    return true;
+}
+
+void
+TqOffloadService :: stop()
+{
+    if (!mRunning)
+        return;
+
+    // the clients can't connect anymore, but the connected ones keep their channel
+    mRegion.getHeader()->running = 0;
+    mRunning = false;
+    for (size_t i = 0; i < mWorkers.size(); ++i)
+    {
+        mRegion.ring(i);
+        mWorkers[i].join();
+    }
+    mWorkers.clear();
+
+    for (size_t i = 0; i < Region::CHANNELS; ++i)
+        reset(mChannels[i]);
+    mRegion.close();
+}
+
+void
+TqOffloadService :: workerLoop(size_t aIndex, int aCpu)
+{
+    if (aCpu >= 0)
+        pinThread(aCpu);
+
+    size_t idle = 0;
+    while (mRunning)
+    {
+        bool busy = false;
+        for (size_t c = aIndex; c < Region::CHANNELS; c += mWorkerCount)
+            busy = serve(c) || busy;
+
+        if (busy)
+        {
+            idle = 0;
+            continue;
+        }
+        if (++idle < SPIN_POLLS)
+        {
+            // let the clients run if the processors are oversubscribed
+            if (idle % YIELD_POLLS == 0)
+                std::this_thread::yield();
+            else
+                _mm_pause();
+            continue;
+        }
+
+        // announce the sleep, then check the rings once more: a job
+        // submitted after the check rings the doorbell
+        int32_t token = mRegion.prepareWait(aIndex);
+        for (size_t c = aIndex; c < Region::CHANNELS && !busy; c += mWorkerCount)
+            busy = hasWork(c);
+        mRegion.wait(aIndex, token, busy || !mRunning ? 0 : SLEEP_TIMEOUT);
+        idle = 0;
+    }
+}
+
+bool
+TqOffloadService :: hasWork(size_t aChannel) const
+{
+    const Region::Channel& channel = mRegion.getHeader()->channels[aChannel];
+    long pos = channel.tail;
+    return channel.ring[(size_t)pos & (Region::RING_SIZE - 1)].sequence == pos + 1 ||
+           channel.generation != mChannels[aChannel].generation;
+}
+
+bool
+TqOffloadService :: serve(size_t aChannel)
+{
+    Region::Channel& channel = mRegion.getHeader()->channels[aChannel];
+    ChannelState& state = mChannels[aChannel];
+
+    // a new owner, or the owner left: drop the sessions of the previous one
+    if (channel.generation != state.generation || (channel.owner == 0 && !state.sessions.empty()))
+    {
+        reset(state);
+        state.generation = channel.generation;
+    }
+
+    long pos = channel.tail;
+    long first = pos;
+    for (;;)
+    {
+        TqOffloadJob& job = channel.ring[(size_t)pos & (Region::RING_SIZE - 1)];
+        if (job.sequence != pos + 1)
+            break;
+
+        execute(channel, state, job);
+        publish(&job.sequence, pos + 2);
+        ++pos;
+    }
+    channel.tail = pos;
+
+    mJobs += (uint64_t)(pos - first);
+    return pos != first;
+}
+
+void
+TqOffloadService :: execute(Region::Channel& aChannel, ChannelState& aState, TqOffloadJob& aJob)
+{
+    aJob.status = Region::STATUS_OK;
+
+    if (aJob.op == Region::OP_OPEN)
+    {
+        uint32_t id;
+        if (!aState.unused.empty())
+        {
+            id = aState.unused.back();
+            aState.unused.pop_back();
+        }
+        else if (aState.sessions.size() < Region::MAX_SESSIONS)
+        {
+            id = (uint32_t)aState.sessions.size();
+            aState.sessions.push_back(nullptr);
+        }
+        else
+        {
+            aJob.status = Region::STATUS_ERROR;
+            return;
+        }
+
+        Session* session = new Session();
+        session->context = TqKeyContext::acquire(0, 0); // zero-filled key
+        session->usingAltKey = false;
+        aState.sessions[id] = session;
+        aJob.result = id;
+        return;
+    }
+
+    Session* session = aJob.session < aState.sessions.size() ? aState.sessions[aJob.session] : nullptr;
+    if (session == nullptr)
+    {
+        aJob.status = Region::STATUS_ERROR;
+        return;
+    }
+
+    switch (aJob.op)
+    {
+        case Region::OP_CLOSE:
+            session->context->release();
+            delete session;
+            aState.sessions[aJob.session] = nullptr;
+            aState.unused.push_back(aJob.session);
+            break;
+        case Region::OP_SET_KEY:
+        {
+            const TqKeyContext* context = TqKeyContext::acquire(aJob.arg0, aJob.arg1);
+            session->context->release();
+            session->context = context;
+            break;
+        }
+        case Region::OP_ALT_KEY:
+            session->context->expandAltKey(session->altKey, aJob.arg0);
+            session->usingAltKey = true;
+            break;
+        case Region::OP_CLEAR_ALT_KEY:
+            session->usingAltKey = false;
+            break;
+        case Region::OP_ENCRYPT:
+        case Region::OP_DECRYPT:
+        {
+            if (aJob.offset > sizeof(aChannel.arena) || aJob.len > sizeof(aChannel.arena) - aJob.offset)
+            {
+                aJob.status = Region::STATUS_ERROR;
+                break;
+            }
+            if (aJob.len == 0)
+                break;
+
+            const uint8_t* key = aJob.op == Region::OP_DECRYPT && session->usingAltKey
+                ? session->altKey : session->context->getKey();
+            mKernel(key, aJob.counter, aChannel.arena + aJob.offset, aJob.len);
+            mBytes += aJob.len;
+            break;
+        }
+        default:
+            aJob.status = Region::STATUS_ERROR;
+            break;
+    }
+}
+
+void
+TqOffloadService :: reset(ChannelState& aState)
+{
+    for (size_t i = 0; i < aState.sessions.size(); ++i)
+    {
+        if (aState.sessions[i] != nullptr)
+        {
+            aState.sessions[i]->context->release();
+            delete aState.sessions[i];
+        }
+    }
+    aState.sessions.clear();
+    aState.unused.clear();
+}
@@ -0,0 +1,113 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_OFFLOAD_SERVICE_H_
+#define _TQ_OFFLOAD_SERVICE_H_
+
+#include "tqoffload.h"
+#include "tqcipher_stream.h"
+#include "tqkeycontext.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * Offload service of the TQ cipher: it owns the key contexts and the
+ * alternate keys of the sessions of all the client processes of a host,
+ * and processes their jobs with a pool of workers.
+ *
+ * Each worker serves a fixed subset of the channels, so a channel has a
+ * single consumer and its sessions are only touched by one thread. An idle
+ * worker spins a while, then sleeps on its doorbell.
+ */
+class TqOffloadService
+{
+public:
+    /** The default name of the region. */
+    static const char* const DEFAULT_NAME;
+
+public:
+    /* constructor */
+    TqOffloadService();
+
+    /* destructor */
+    ~TqOffloadService();
+
+public:
+    /**
+     * Create the region and start the workers.
+     *
+     * @param[in] aName      the name of the region
+     * @param[in] aKernel    the kernel processing the octets
+     * @param[in] aWorkers   the number of workers
+     * @param[in] aFirstCpu  the processor of the first worker (the others
+     *                       follow), or -1 to let the system schedule them
+     *
+     * @returns false if the region can't be created
+     */
+    bool start(const char* aName, TqCipherStream::Kernel aKernel, size_t aWorkers, int aFirstCpu);
+
+    /** Stop the workers and remove the region. */
+    void stop();
+
+    /** Get the number of processed jobs. */
+    uint64_t getJobs() const { return mJobs; }
+
+    /** Get the number of processed octets. */
+    uint64_t getBytes() const { return mBytes; }
+
+private:
+    /** Session of a client (private to the worker of its channel). */
+    struct Session
+    {
+        const TqKeyContext* context; //!< Base key
+        bool usingAltKey; //!< Whether the alternate key is used for the decryption
+        uint8_t altKey[TqKeyContext::SIZE]; //!< Alternate key
+    };
+
+    /** State of a channel (private to its worker). */
+    struct ChannelState
+    {
+        long generation; //!< Generation of the sessions
+        std::vector<Session*> sessions; //!< Sessions by identifier (nullptr if closed)
+        std::vector<uint32_t> unused; //!< Identifiers of the closed sessions
+    };
+
+private:
+    /** Main loop of a worker. */
+    void workerLoop(size_t aIndex, int aCpu);
+
+    /**
+     * Process the submitted jobs of a channel.
+     *
+     * @returns false if there was no job
+     */
+    bool serve(size_t aChannel);
+
+    /** Check if a channel has a job (or a new owner). */
+    bool hasWork(size_t aChannel) const;
+
+    /** Process one job. */
+    void execute(TqOffloadRegion::Channel& aChannel, ChannelState& aState, TqOffloadJob& aJob);
+
+    /** Close all the sessions of a channel. */
+    void reset(ChannelState& aState);
+
+private:
+    TqOffloadRegion mRegion; //!< Shared memory
+    TqCipherStream::Kernel mKernel; //!< Kernel processing the octets
+    std::atomic<bool> mRunning; //!< Whether the workers run
+    std::vector<std::thread> mWorkers; //!< Workers
+    size_t mWorkerCount; //!< Number of workers
+    ChannelState mChannels[TqOffloadRegion::CHANNELS]; //!< States of the channels
+
+    std::atomic<uint64_t> mJobs; //!< Processed jobs
+    std::atomic<uint64_t> mBytes; //!< Processed octets
+};
+
+#endif // _TQ_OFFLOAD_SERVICE_H_
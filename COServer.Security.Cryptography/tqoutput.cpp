@@ -0,0 +1,111 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqoutput.h"
+#include <string.h> // memmove, memset
+#include <assert.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#pragma unmanaged
+
+/**
+ * Get the time of a monotonic clock, in ms.
+ */
+static uint64_t
+getTickCount()
+{
+    #ifdef _WIN32
+    return GetTickCount64();
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+    #endif
+}
+
+TqOutputBuffer :: TqOutputBuffer(TqCipher_Base& aCipher, size_t aCapacity, size_t aFlushSize, uint32_t aFlushDelay,
+                                 Sink aSink, void* aContext)
+    : mCipher(aCipher), mBuf(nullptr), mCapacity(aCapacity),
+      mLength(0), mEncrypted(0),
+      mFlushSize(aFlushSize < aCapacity ? aFlushSize : aCapacity), mFlushDelay(aFlushDelay), mStartTick(0),
+      mSink(aSink), mContext(aContext)
+{
+    assert(aCapacity != 0);
+    assert(aSink != nullptr);
+
+    mBuf = new uint8_t[mCapacity];
+}
+
+TqOutputBuffer :: ~TqOutputBuffer()
+{
+    // security purpose only...
+    memset(mBuf, 0, mCapacity);
+    delete[] mBuf;
+}
+
+bool
+TqOutputBuffer :: poll()
+{
+    if (mLength == 0)
+        return true;
+
+    if (mEncrypted != 0 || mLength - mEncrypted >= mFlushSize || getTickCount() - mStartTick >= mFlushDelay)
+        return flush();
+
+    return true;
+}
+
+bool
+TqOutputBuffer :: flush()
+{
+    // the packets are encrypted in the order of their appends, as one run
+    if (mLength != mEncrypted)
+    {
+        mCipher.encrypt(mBuf + mEncrypted, mLength - mEncrypted);
+        mEncrypted = mLength;
+    }
+
+    if (mEncrypted == 0)
+        return true;
+
+    size_t sent = mSink(mContext, mBuf, mEncrypted);
+    assert(sent <= mEncrypted);
+
+    // the octets refused by the sink stay first, already encrypted
+    if (sent != 0)
+    {
+        memmove(mBuf, mBuf + sent, mEncrypted - sent);
+        mEncrypted -= sent;
+        mLength = mEncrypted;
+    }
+
+    return mEncrypted == 0;
+}
+
+bool
+TqOutputBuffer :: makeRoom(size_t aLen)
+{
+    if (aLen > mCapacity)
+        return false;
+
+    flush();
+    return aLen <= mCapacity - mLength;
+}
+
+void
+TqOutputBuffer :: start()
+{
+    mStartTick = getTickCount();
+}
+
+#pragma managed
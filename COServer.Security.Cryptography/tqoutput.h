@@ -0,0 +1,161 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_OUTPUT_H_
+#define _TQ_OUTPUT_H_
+
+#include "tqcipher_base.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h> // memcpy
+
+/**
+ * Output buffer of a session, coalescing its packets and encrypting them
+ * when they are flushed.
+ *
+ * The game logic appends the plaintext of many small packets per tick; they
+ * are accumulated, then encrypted by one call to the session (one large run
+ * for the vectorized kernels, instead of a scalar tail per packet) and
+ * handed over to the socket. The buffer is flushed when the pending octets
+ * reach the flush size, when the oldest one has waited for the flush delay
+ * (see poll), or on demand.
+ *
+ * The packets are encrypted in the order of their appends, so the counters
+ * are exactly those of one encryption per packet, as long as the session
+ * isn't used to encrypt anything else: flush the buffer before encrypting
+ * with the session directly. A buffer must only be used by one thread.
+ */
+class TqOutputBuffer
+{
+public:
+    /**
+     * Receiver of the encrypted octets (e.g. the send buffer of a socket).
+     *
+     * @param[in] aContext  the context of the sink
+     * @param[in] aBuf      the encrypted octets
+     * @param[in] aLen      the number of octets
+     *
+     * @returns the number of octets accepted, the others are handed over
+     *          again by the next flush
+     */
+    typedef size_t (*Sink)(void* aContext, const uint8_t* aBuf, size_t aLen);
+
+public:
+    /**
+     * Create an output buffer.
+     *
+     * @param[in,out] aCipher      the session encrypting the packets
+     * @param[in]     aCapacity    the size of the buffer
+     * @param[in]     aFlushSize   the number of pending octets flushing the buffer (e.g. a segment)
+     * @param[in]     aFlushDelay  the delay (in ms) after which a pending octet is flushed
+     * @param[in]     aSink        the receiver of the encrypted octets
+     * @param[in]     aContext     the context of the sink
+     */
+    TqOutputBuffer(TqCipher_Base& aCipher, size_t aCapacity, size_t aFlushSize, uint32_t aFlushDelay,
+                   Sink aSink, void* aContext);
+
+    /* destructor */
+    ~TqOutputBuffer();
+
+public:
+    /**
+     * Append a packet, or a part of a packet.
+     *
+     * @param[in] aData  the plaintext
+     * @param[in] aLen   the number of octets
+     *
+     * @returns false if the buffer is full (nothing is appended)
+     */
+    bool write(const void* aData, size_t aLen)
+    {
+        uint8_t* out = append(aLen);
+        if (out == nullptr)
+            return false;
+
+        memcpy(out, aData, aLen);
+        return true;
+    }
+
+    /**
+     * Append n octet(s) of plaintext written in place by the caller (e.g. a
+     * packet serialized directly in the buffer). The octets must be written
+     * before the next call to the buffer.
+     *
+     * @param[in] aLen  the number of octets
+     *
+     * @returns the octets to write, or nullptr if the buffer is full even
+     *          after a flush
+     */
+    uint8_t* append(size_t aLen)
+    {
+        // the pending octets reached the flush size, or leave no room
+        if (mLength - mEncrypted >= mFlushSize || aLen > mCapacity - mLength)
+        {
+            if (!makeRoom(aLen))
+                return nullptr;
+        }
+
+        if (mLength == mEncrypted)
+            start();
+
+        uint8_t* out = mBuf + mLength;
+        mLength += aLen;
+        return out;
+    }
+
+    /**
+     * Flush the buffer if a threshold is reached: the pending octets reach
+     * the flush size, the oldest one has waited for the flush delay, or
+     * octets are still waiting for the sink. It should be called on each
+     * tick of the server (or by the network thread).
+     *
+     * @returns false if octets are still waiting for the sink
+     */
+    bool poll();
+
+    /**
+     * Encrypt the pending octets in one call and hand over all the
+     * encrypted octets to the sink.
+     *
+     * @returns false if octets are still waiting for the sink
+     */
+    bool flush();
+
+    /** Get the number of octets not encrypted yet. */
+    size_t getPending() const { return mLength - mEncrypted; }
+
+    /** Get the number of octets encrypted, but not accepted by the sink yet. */
+    size_t getWaiting() const { return mEncrypted; }
+
+private:
+    /** Flush the buffer to make room for n octet(s). */
+    bool makeRoom(size_t aLen);
+
+    /** Note the time of the first pending octet. */
+    void start();
+
+    // not copyable
+    TqOutputBuffer(const TqOutputBuffer&);
+    TqOutputBuffer& operator=(const TqOutputBuffer&);
+
+private:
+    TqCipher_Base& mCipher; //!< Session encrypting the packets
+    uint8_t* mBuf; //!< Buffer (the encrypted octets, then the pending ones)
+    size_t mCapacity; //!< Size of the buffer
+    size_t mLength; //!< Number of octets in the buffer
+    size_t mEncrypted; //!< Number of octets encrypted, waiting for the sink
+
+    size_t mFlushSize; //!< Number of pending octets flushing the buffer
+    uint32_t mFlushDelay; //!< Delay (in ms) after which the pending octets are flushed
+    uint64_t mStartTick; //!< Time (in ms) of the first pending octet
+
+    Sink mSink; //!< Receiver of the encrypted octets
+    void* mContext; //!< Context of the sink
+};
+
+#endif // _TQ_OUTPUT_H_
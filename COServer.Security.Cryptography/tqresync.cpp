@@ -0,0 +1,151 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqresync.h"
+#include <string.h> // memset
+#include <assert.h>
+#include <thread>
+#include <vector>
+
+// The number of counters whose headers are tested at once.
+static const size_t BLOCK_COUNTERS = 256;
+
+/**
+ * Search the counters of a range with each key (see TqResync::search).
+ * The candidates of each key are appended to their own list.
+ */
+static void
+searchRange(TqResync::Kernel aKernel, const uint8_t* const* aKeys, size_t aKeyCount,
+            const uint8_t* aMasked, size_t aLen, const TqResyncFilter& aFilter,
+            TqResync::Predicate aPredicate, void* aContext,
+            size_t aFirst, size_t aCount, std::vector<uint16_t>* aCandidates)
+{
+    // the keystream of the range, and of the octets of the window past its end
+    std::vector<uint8_t> keystream(aCount + aLen - 1);
+    std::vector<uint8_t> plain(aLen);
+
+    uint32_t header = (uint32_t)aMasked[0] | (uint32_t)aMasked[1] << 8 |
+                      (uint32_t)aMasked[2] << 16 | (uint32_t)aMasked[3] << 24;
+    uint16_t lengthSpan = (uint16_t)(aFilter.maxLength - aFilter.minLength);
+    uint16_t typeSpan = (uint16_t)(aFilter.maxType - aFilter.minType);
+
+    for (size_t k = 0; k < aKeyCount; ++k)
+    {
+        // the mask of 0xAB is zero, so the kernel outputs the keystream
+        memset(keystream.data(), 0xAB, keystream.size());
+        aKernel(aKeys[k], (uint16_t)aFirst, keystream.data(), keystream.size());
+
+        for (size_t block = 0; block < aCount; block += BLOCK_COUNTERS)
+        {
+            size_t count = aCount - block < BLOCK_COUNTERS ? aCount - block : BLOCK_COUNTERS;
+            const uint8_t* ks = keystream.data() + block;
+
+            // no branch: the compiler vectorizes the test of the block
+            uint8_t plausible[BLOCK_COUNTERS];
+            for (size_t i = 0; i < count; ++i)
+            {
+                uint32_t word = header ^ ((uint32_t)ks[i] | (uint32_t)ks[i + 1] << 8 |
+                                          (uint32_t)ks[i + 2] << 16 | (uint32_t)ks[i + 3] << 24);
+                uint16_t length = (uint16_t)((uint16_t)word - aFilter.minLength);
+                uint16_t type = (uint16_t)((uint16_t)(word >> 16) - aFilter.minType);
+                plausible[i] = (uint8_t)((length <= lengthSpan) & (type <= typeSpan));
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!plausible[i])
+                    continue;
+
+                if (aPredicate != nullptr)
+                {
+                    for (size_t j = 0; j < aLen; ++j)
+                        plain[j] = aMasked[j] ^ ks[i + j];
+                    if (!aPredicate(plain.data(), aLen, aContext))
+                        continue;
+                }
+
+                aCandidates[k].push_back((uint16_t)(aFirst + block + i));
+            }
+        }
+    }
+
+    // security purpose only...
+    memset(keystream.data(), 0, keystream.size());
+    memset(plain.data(), 0, plain.size());
+}
+
+size_t
+TqResync :: search(Kernel aKernel, const uint8_t* const* aKeys, size_t aKeyCount,
+                   const uint8_t* aWindow, size_t aLen, const TqResyncFilter& aFilter,
+                   Predicate aPredicate, void* aContext,
+                   TqResyncCandidate* aOut, size_t aMax, size_t aThreads)
+{
+    assert(aKernel != nullptr);
+    assert(aKeys != nullptr || aKeyCount == 0);
+    assert(aWindow != nullptr);
+    assert(aOut != nullptr || aMax == 0);
+
+    if (aLen < HEADER_SIZE || aKeyCount == 0)
+        return 0;
+
+    if (aThreads == 0)
+        aThreads = std::thread::hardware_concurrency();
+    if (aThreads == 0)
+        aThreads = 1;
+    if (aThreads > COUNTERS / BLOCK_COUNTERS)
+        aThreads = COUNTERS / BLOCK_COUNTERS;
+
+    // the window is masked once: the plaintext is the masked octet XOR the keystream
+    std::vector<uint8_t> masked(aWindow, aWindow + aLen);
+    for (size_t i = 0; i < aLen; ++i)
+        masked[i] = (uint8_t)((masked[i] ^ 0xAB) << 4 | (masked[i] ^ 0xAB) >> 4);
+
+    // each thread searches whole blocks of counters, the last one the remainder
+    size_t blocks = COUNTERS / BLOCK_COUNTERS;
+    std::vector<std::vector<uint16_t> > candidates(aThreads * aKeyCount);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < aThreads; ++t)
+    {
+        size_t first = blocks * t / aThreads * BLOCK_COUNTERS;
+        size_t count = blocks * (t + 1) / aThreads * BLOCK_COUNTERS - first;
+        std::vector<uint16_t>* lists = &candidates[t * aKeyCount];
+
+        if (t + 1 == aThreads)
+        {
+            searchRange(aKernel, aKeys, aKeyCount, masked.data(), aLen, aFilter,
+                        aPredicate, aContext, first, count, lists);
+        }
+        else
+        {
+            threads.push_back(std::thread(&searchRange, aKernel, aKeys, aKeyCount, masked.data(), aLen,
+                                          std::cref(aFilter), aPredicate, aContext, first, count, lists));
+        }
+    }
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    // the ranges are in order, so the lists are merged by key
+    size_t found = 0;
+    for (size_t k = 0; k < aKeyCount; ++k)
+    {
+        for (size_t t = 0; t < aThreads; ++t)
+        {
+            const std::vector<uint16_t>& list = candidates[t * aKeyCount + k];
+            for (size_t i = 0; i < list.size(); ++i, ++found)
+            {
+                if (found < aMax)
+                {
+                    aOut[found].counter = list[i];
+                    aOut[found].key = (uint8_t)k;
+                }
+            }
+        }
+    }
+
+    return found;
+}
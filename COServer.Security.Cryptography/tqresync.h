@@ -0,0 +1,100 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_RESYNC_H_
+#define _TQ_RESYNC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Plausible headers of a packet: a 16-bit length followed by a 16-bit type
+ * (little-endian), each one in an inclusive range.
+ */
+struct TqResyncFilter
+{
+    uint16_t minLength; //!< Smallest length of a packet
+    uint16_t maxLength; //!< Largest length of a packet
+    uint16_t minType; //!< Smallest type of a packet
+    uint16_t maxType; //!< Largest type of a packet
+};
+
+/**
+ * Counter (and key) at which a window decrypts to a plausible packet.
+ */
+struct TqResyncCandidate
+{
+    uint16_t counter; //!< Counter of the first octet of the window
+    uint8_t key; //!< Index of the key in the searched keys
+};
+
+/**
+ * Search of the counter of a desynchronized stream.
+ *
+ * When both ends disagree on the counter (e.g. after a dropped buffer),
+ * every decrypted packet is garbage. Given a window of ciphertext starting
+ * at a packet, the search tries the 65,536 counters with each key and keeps
+ * the ones where the window decrypts to a plausible header (and passes the
+ * predicate of the caller, if any). Some counters decrypt a window the same
+ * way (the halves of the key repeat some octets): they are all kept, the
+ * next packet tells them apart.
+ *
+ * The keystream of the counters is generated with the kernel of the session
+ * (the mask of an octet of 0xAB is the keystream itself), so it is as fast
+ * as decrypting 64 KB per key; the headers are then tested without branch,
+ * a block of counters at a time. The counters are split between threads.
+ */
+class TqResync
+{
+public:
+    /** The size of the header tested by the filter. */
+    static const size_t HEADER_SIZE = 4;
+    /** The number of counters. */
+    static const size_t COUNTERS = 65536;
+
+    /** Kernel of an implementation (see TqCipherStream::Kernel). */
+    typedef uint16_t (*Kernel)(const uint8_t* aKey, uint16_t aCounter, uint8_t* aBuf, size_t aLen);
+
+    /**
+     * Predicate of the caller, testing a decrypted window whose header
+     * passed the filter. It is called from many threads at once.
+     *
+     * @param[in] aPlain    the decrypted window
+     * @param[in] aLen      the length of the window
+     * @param[in] aContext  the context of the caller
+     *
+     * @returns whether or not the window is plausible
+     */
+    typedef bool (*Predicate)(const uint8_t* aPlain, size_t aLen, void* aContext);
+
+public:
+    /**
+     * Search the counters at which a window decrypts to a plausible packet.
+     * The candidates are sorted by key, then by counter.
+     *
+     * @param[in]  aKernel     the kernel of the implementation
+     * @param[in]  aKeys       the padded keys to try (e.g. the base and the alternate keys)
+     * @param[in]  aKeyCount   the number of keys
+     * @param[in]  aWindow     the ciphertext, starting at a packet
+     * @param[in]  aLen        the length of the window (at least HEADER_SIZE)
+     * @param[in]  aFilter     the plausible headers
+     * @param[in]  aPredicate  the predicate of the caller, or nullptr
+     * @param[in]  aContext    the context of the predicate
+     * @param[out] aOut        the buffer receiving the candidates
+     * @param[in]  aMax        the size of the buffer
+     * @param[in]  aThreads    the number of threads, or 0 for one per processor
+     *
+     * @returns the number of candidates found (only aMax are written)
+     */
+    static size_t search(Kernel aKernel, const uint8_t* const* aKeys, size_t aKeyCount,
+                         const uint8_t* aWindow, size_t aLen, const TqResyncFilter& aFilter,
+                         Predicate aPredicate, void* aContext,
+                         TqResyncCandidate* aOut, size_t aMax, size_t aThreads);
+};
+
+#endif // _TQ_RESYNC_H_
@@ -0,0 +1,133 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqtap.h"
+#include <string.h> // memcpy, memset
+#include <stdlib.h>
+#include <assert.h>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h> // _aligned_malloc
+#include <windows.h>
+#endif
+
+#pragma unmanaged
+
+TqTap :: TqTap(size_t aCapacity, size_t aSnapLength)
+    : mSlots(nullptr), mSlotSize(0), mCapacity(aCapacity), mSnapLength(aSnapLength),
+      mSampling(1), mSession(ANY_SESSION), mHead(0), mTail(0), mDropped(0)
+{
+    assert(aCapacity != 0 && (aCapacity & (aCapacity - 1)) == 0);
+
+    // each slot starts on its own cache line, so two sessions never write the same line
+    mSlotSize = (sizeof(Slot) + aSnapLength + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    #ifdef _WIN32
+    mSlots = (uint8_t*)_aligned_malloc(mSlotSize * mCapacity, CACHE_LINE_SIZE);
+    #else
+    void* slots = nullptr;
+    mSlots = posix_memalign(&slots, CACHE_LINE_SIZE, mSlotSize * mCapacity) == 0 ? (uint8_t*)slots : nullptr;
+    #endif
+    if (mSlots == nullptr)
+        throw std::bad_alloc();
+
+    for (size_t i = 0; i < mCapacity; ++i)
+        getSlot((long)i)->sequence = (long)i;
+}
+
+TqTap :: ~TqTap()
+{
+    // security purpose only...
+    memset(mSlots, 0, mSlotSize * mCapacity);
+    #ifdef _WIN32
+    _aligned_free(mSlots);
+    #else
+    free(mSlots);
+    #endif
+}
+
+void
+TqTap :: record(uint32_t aSession, uint8_t aDirection, uint16_t aCounter,
+                const uint8_t* aFirst, size_t aFirstLen,
+                const uint8_t* aSecond, size_t aSecondLen)
+{
+    // claim the slot of the next position (bounded MPSC queue)
+    Slot* slot = nullptr;
+    long pos = mHead;
+    for (;;)
+    {
+        slot = getSlot(pos);
+        long diff = slot->sequence - pos;
+        if (diff == 0)
+        {
+            #ifdef _WIN32
+            long previous = InterlockedCompareExchange(&mHead, pos + 1, pos);
+            #else
+            long previous = __sync_val_compare_and_swap(&mHead, pos, pos + 1);
+            #endif
+            if (previous == pos)
+                break;
+            pos = previous;
+        }
+        else if (diff < 0)
+        {
+            // the ring is full, the session doesn't wait for the reader
+            #ifdef _WIN32
+            InterlockedIncrement(&mDropped);
+            #else
+            __sync_add_and_fetch(&mDropped, 1);
+            #endif
+            return;
+        }
+        else
+            pos = mHead;
+    }
+
+    uint8_t* data = (uint8_t*)(slot + 1);
+    size_t first = aFirstLen < mSnapLength ? aFirstLen : mSnapLength;
+    size_t second = aSecondLen < mSnapLength - first ? aSecondLen : mSnapLength - first;
+    memcpy(data, aFirst, first);
+    if (second != 0)
+        memcpy(data + first, aSecond, second);
+
+    slot->record.session = aSession;
+    slot->record.length = (uint32_t)(aFirstLen + aSecondLen);
+    slot->record.counter = aCounter;
+    slot->record.direction = aDirection;
+    slot->record.reserved = 0;
+    #ifdef _WIN32
+    InterlockedExchange(&slot->sequence, pos + 1);
+    #else
+    __sync_synchronize();
+    slot->sequence = pos + 1;
+    #endif
+}
+
+bool
+TqTap :: read(TqTapRecord& aRecord, uint8_t* aData)
+{
+    long pos = mTail;
+    Slot* slot = getSlot(pos);
+    if (slot->sequence != pos + 1)
+        return false;
+
+    aRecord = slot->record;
+    memcpy(aData, slot + 1, aRecord.length < mSnapLength ? aRecord.length : mSnapLength);
+
+    // free the slot for the next lap
+    #ifdef _WIN32
+    InterlockedExchange(&slot->sequence, pos + (long)mCapacity);
+    #else
+    __sync_synchronize();
+    slot->sequence = pos + (long)mCapacity;
+    #endif
+    mTail = pos + 1;
+    return true;
+}
+
+#pragma managed
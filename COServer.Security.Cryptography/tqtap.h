@@ -0,0 +1,173 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#ifndef _TQ_TAP_H_
+#define _TQ_TAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Header of a packet copied by a tap.
+ */
+struct TqTapRecord
+{
+    uint32_t session; //!< Session of the packet (see TqCipher_Base::setTap)
+    uint32_t length; //!< Length of the packet (at most the snap length is copied)
+    uint16_t counter; //!< Counter of the first octet
+    uint8_t direction; //!< Direction of the packet (TqTap::DIRECTION_*)
+    uint8_t reserved; //!< Unused
+};
+
+/**
+ * Tap mirroring the plaintext of sampled packets, for live debugging.
+ *
+ * The sessions attached to the tap (see TqCipher_Base::setTap) hand over
+ * their packets, before the encryption and after the decryption; the tap
+ * keeps one packet in N of each session (optionally of a single session)
+ * and copies its first octets in a bounded MPSC ring, read by a background
+ * thread. The slots are claimed like the jobs of the offload service: a
+ * slot goes from pos (free) to pos + 1 (written) to pos + CAPACITY (read).
+ *
+ * A session never waits: when the ring is full, the packet is dropped and
+ * counted. The tap must outlive the sessions attached to it.
+ */
+class TqTap
+{
+public:
+    /** The size of a cache line. */
+    static const size_t CACHE_LINE_SIZE = 64;
+    /** Filter keeping the packets of every session. */
+    static const uint32_t ANY_SESSION = 0xFFFFFFFF;
+
+    /** Directions of the packets. */
+    enum
+    {
+        DIRECTION_ENCRYPT = 0, //!< Plaintext about to be encrypted
+        DIRECTION_DECRYPT = 1  //!< Plaintext just decrypted
+    };
+
+public:
+    /**
+     * Create a new tap.
+     *
+     * @param[in] aCapacity    the number of records of the ring (a power of two)
+     * @param[in] aSnapLength  the maximum number of octets copied per packet
+     */
+    TqTap(size_t aCapacity, size_t aSnapLength);
+
+    /* destructor */
+    ~TqTap();
+
+public:
+    /**
+     * Set the sampling rate: one packet in aRate of each session is kept.
+     *
+     * @param[in] aRate  the rate (1 keeps every packet, 0 pauses the tap)
+     */
+    void setSampling(uint32_t aRate) { mSampling = aRate; }
+
+    /** Get the sampling rate. */
+    uint32_t getSampling() const { return mSampling; }
+
+    /**
+     * Only keep the packets of one session.
+     *
+     * @param[in] aSession  the session, or ANY_SESSION
+     */
+    void setSession(uint32_t aSession) { mSession = aSession; }
+
+    /** Get the session kept by the tap (or ANY_SESSION). */
+    uint32_t getSession() const { return mSession; }
+
+    /** Get the maximum number of octets copied per packet. */
+    size_t getSnapLength() const { return mSnapLength; }
+
+    /** Get the number of records written in the ring. */
+    uint32_t getRecorded() const { return (uint32_t)mHead; }
+
+    /** Get the number of sampled packets dropped because the ring was full. */
+    uint32_t getDropped() const { return (uint32_t)mDropped; }
+
+    /**
+     * Whether or not a packet is sampled by the tap.
+     *
+     * @param[in] aSession  the session of the packet
+     * @param[in] aPacket   the number of the packet in the session
+     *
+     * @returns true if the packet must be recorded
+     */
+    bool sample(uint32_t aSession, uint32_t aPacket) const
+    {
+        uint32_t session = mSession;
+        uint32_t rate = mSampling;
+        return (session == ANY_SESSION || session == aSession) && rate != 0 && aPacket % rate == 0;
+    }
+
+    /**
+     * Record a sampled packet, in two parts (e.g. a region of a circular
+     * buffer). It can be called from many threads.
+     *
+     * @param[in] aSession    the session of the packet
+     * @param[in] aDirection  the direction of the packet
+     * @param[in] aCounter    the counter of the first octet
+     * @param[in] aFirst      the first part of the packet
+     * @param[in] aFirstLen   the length of the first part
+     * @param[in] aSecond     the second part of the packet (if any)
+     * @param[in] aSecondLen  the length of the second part
+     */
+    void record(uint32_t aSession, uint8_t aDirection, uint16_t aCounter,
+                const uint8_t* aFirst, size_t aFirstLen,
+                const uint8_t* aSecond = nullptr, size_t aSecondLen = 0);
+
+    /**
+     * Read the oldest record. It must only be called by one thread.
+     *
+     * @param[out] aRecord  the header of the record
+     * @param[out] aData    the buffer receiving the octets (at least the snap length)
+     *
+     * @returns false if the ring is empty
+     */
+    bool read(TqTapRecord& aRecord, uint8_t* aData);
+
+private:
+    /** Slot of the ring, followed by the octets of its packet. */
+    struct Slot
+    {
+        volatile long sequence; //!< State of the slot (see above)
+        TqTapRecord record; //!< Header of the packet
+    };
+
+    /** Get the slot of a position. */
+    Slot* getSlot(long aPos) const
+    {
+        return (Slot*)(mSlots + ((size_t)aPos & (mCapacity - 1)) * mSlotSize);
+    }
+
+private:
+    // not copyable
+    TqTap(const TqTap&);
+    TqTap& operator=(const TqTap&);
+
+private:
+    uint8_t* mSlots; //!< Slots of the ring
+    size_t mSlotSize; //!< Size of a slot (a multiple of the cache lines)
+    size_t mCapacity; //!< Number of slots
+    size_t mSnapLength; //!< Maximum number of octets per packet
+    volatile uint32_t mSampling; //!< One packet in N is kept (0 pauses the tap)
+    volatile uint32_t mSession; //!< Session kept by the tap (or ANY_SESSION)
+    uint8_t mPadding0[CACHE_LINE_SIZE];
+
+    volatile long mHead; //!< Next position to claim by the sessions
+    uint8_t mPadding1[CACHE_LINE_SIZE - sizeof(long)];
+    volatile long mTail; //!< Next position to read
+    uint8_t mPadding2[CACHE_LINE_SIZE - sizeof(long)];
+    volatile long mDropped; //!< Number of dropped packets
+};
+
+#endif // _TQ_TAP_H_
@@ -0,0 +1,263 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqkeyrecovery.h"
+#include "tqkeyrecovery_avx2.h"
+#include "instructionset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <map>
+#include <vector>
+
+// Offline recovery of the P & G constants of a key from our own captured
+// traffic. Each line of the capture is a run of octets encrypted with the
+// base key (the server to client stream, or the client to server stream
+// before the exchange of the alternate key):
+//
+//     <counter of the first octet> <plaintext> <ciphertext>
+//
+// The plaintext and the ciphertext are in hexadecimal ("??" for an unknown
+// octet of plaintext); the lines starting with # are ignored.
+
+// The largest number of constants kept by a search.
+static const size_t MAX_CONSTANTS = 1024 * 1024;
+// The largest number of keys printed.
+static const size_t MAX_KEYS = 16;
+
+static TqKeyRecovery::Kernel
+selectKernel(const char* aImpl)
+{
+    if (strcmp(aImpl, "std") == 0)
+        return &TqKeyRecovery::searchRange;
+    else if (strcmp(aImpl, "avx2") == 0 && InstructionSet::AVX2())
+        return &TqKeyRecovery_AVX2::searchRange;
+    else if (strcmp(aImpl, "auto") == 0)
+    {
+        if (InstructionSet::AVX2())
+            return &TqKeyRecovery_AVX2::searchRange;
+        return &TqKeyRecovery::searchRange;
+    }
+    return nullptr;
+}
+
+/**
+ * Parse an octet in hexadecimal.
+ *
+ * @returns the octet, -1 if unknown ("??") or -2 if invalid
+ */
+static int
+parseOctet(const char* aText)
+{
+    if (aText[0] == '?' && aText[1] == '?')
+        return -1;
+    if (!isxdigit((unsigned char)aText[0]) || !isxdigit((unsigned char)aText[1]))
+        return -2;
+
+    char digits[3] = { aText[0], aText[1], '\0' };
+    return (int)strtoul(digits, nullptr, 16);
+}
+
+/**
+ * Read the known octets of keystream of a capture.
+ *
+ * @returns false if the capture can't be read
+ */
+static bool
+readCapture(const char* aPath, std::vector<TqKnownOctet>& aKnown)
+{
+    FILE* file = fopen(aPath, "r");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Can't open %s\n", aPath);
+        return false;
+    }
+
+    bool ok = true;
+    char line[16384];
+    for (unsigned number = 1; ok && fgets(line, sizeof(line), file) != nullptr; ++number)
+    {
+        char plain[8192], cipher[8192];
+        long counter;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+
+        size_t len = 0;
+        ok = sscanf(line, "%li %8191s %8191s", &counter, plain, cipher) == 3 &&
+             counter >= 0 && counter <= 0xFFFF && (len = strlen(plain)) == strlen(cipher) && len % 2 == 0;
+
+        for (size_t i = 0; ok && i < len; i += 2)
+        {
+            int p = parseOctet(plain + i);
+            int c = parseOctet(cipher + i);
+            ok = p != -2 && c >= 0;
+            if (ok && p >= 0)
+            {
+                TqKnownOctet octet;
+                octet.counter = (uint16_t)(counter + i / 2);
+                octet.keystream = TqKeyRecovery::keystream((uint8_t)p, (uint8_t)c);
+                aKnown.push_back(octet);
+            }
+        }
+
+        if (!ok)
+            fprintf(stderr, "%s:%u: invalid line\n", aPath, number);
+    }
+
+    fclose(file);
+    return ok;
+}
+
+/**
+ * Pair of constants, with the number of pairs generating the same keystream.
+ */
+struct Key
+{
+    uint32_t p; //!< First P constant found
+    uint32_t g; //!< First G constant found
+    size_t count; //!< Number of pairs
+};
+
+/**
+ * Group the constants generating the same half of the key.
+ *
+ * @param[in]  aConstants  the constants (G constants if aG)
+ * @param[in]  aCount      the number of constants
+ * @param[in]  aG          whether or not the constants are G constants
+ * @param[out] aGroups     the first constant of each half, with the number of constants
+ */
+static void
+groupConstants(const uint32_t* aConstants, size_t aCount, bool aG,
+               std::map<std::vector<uint8_t>, std::pair<uint32_t, size_t> >& aGroups)
+{
+    std::vector<uint8_t> half(TqKeyRecovery::HALF);
+    for (size_t i = 0; i < aCount; ++i)
+    {
+        TqKeyRecovery::generate(aG ? TqKeyRecovery::negateC2(aConstants[i]) : aConstants[i], half.data());
+
+        std::pair<uint32_t, size_t>& group = aGroups[half];
+        if (group.second++ == 0)
+            group.first = aConstants[i];
+    }
+}
+
+/**
+ * Add a pair to the keys. XORing both halves with the same octet gives the
+ * same keystream, so the halves are compared once XORed with the first
+ * octet of key1.
+ */
+static void
+addKey(uint32_t aP, uint32_t aG, size_t aCount, std::map<std::vector<uint8_t>, Key>& aKeys)
+{
+    std::vector<uint8_t> halves(2 * TqKeyRecovery::HALF);
+    TqKeyRecovery::generate(aP, halves.data());
+    TqKeyRecovery::generate(TqKeyRecovery::negateC2(aG), halves.data() + TqKeyRecovery::HALF);
+
+    uint8_t first = halves[0];
+    for (size_t i = 0; i < halves.size(); ++i)
+        halves[i] ^= first;
+
+    Key& key = aKeys[halves];
+    if (key.count == 0)
+    {
+        key.p = aP;
+        key.g = aG;
+    }
+    key.count += aCount;
+}
+
+int
+main(int argc, char* argv[])
+{
+    const char* path = argc > 1 ? argv[1] : nullptr;
+    size_t threads = argc > 2 ? (size_t)atoi(argv[2]) : 0;
+    const char* impl = argc > 3 ? argv[3] : "auto";
+
+    TqKeyRecovery::Kernel kernel = selectKernel(impl);
+    if (path == nullptr || kernel == nullptr)
+    {
+        fprintf(stderr, "Usage: %s <capture> [threads (0 = one per processor)] [auto|std|avx2]\n",
+                argc > 0 ? argv[0] : "KeyRecovery");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<TqKnownOctet> known;
+    if (!readCapture(path, known))
+        return EXIT_FAILURE;
+
+    bool pages[TqKeyRecovery::HALF] = { false };
+    size_t pageCount = 0;
+    for (size_t i = 0; i < known.size(); ++i)
+    {
+        if (!pages[known[i].counter >> 8])
+            ++pageCount;
+        pages[known[i].counter >> 8] = true;
+    }
+    printf("%u known octet(s) in %u page(s), searching with %s\n",
+           (unsigned)known.size(), (unsigned)pageCount, impl);
+
+    // the halves are searched one after the other: P, then G for each key1
+    std::vector<uint32_t> constants(MAX_CONSTANTS);
+    clock_t start = clock();
+    size_t found = TqKeyRecovery::findP(kernel, known.data(), known.size(), constants.data(), MAX_CONSTANTS, threads);
+    if (found == 0)
+    {
+        fprintf(stderr, "No P constant found (two known octets are needed in a page)\n");
+        return EXIT_FAILURE;
+    }
+    if (found > MAX_CONSTANTS)
+    {
+        fprintf(stderr, "Too many P constants (%u), more known octets are needed\n", (unsigned)found);
+        return EXIT_FAILURE;
+    }
+
+    std::map<std::vector<uint8_t>, std::pair<uint32_t, size_t> > keys1;
+    groupConstants(constants.data(), found, false, keys1);
+    printf("%u P constant(s), %u key1 candidate(s) (%.1f s)\n",
+           (unsigned)found, (unsigned)keys1.size(), (double)(clock() - start) / CLOCKS_PER_SEC);
+
+    std::map<std::vector<uint8_t>, Key> keys;
+    for (std::map<std::vector<uint8_t>, std::pair<uint32_t, size_t> >::const_iterator it1 = keys1.begin();
+         it1 != keys1.end(); ++it1)
+    {
+        uint32_t p = it1->second.first;
+        found = TqKeyRecovery::findG(kernel, p, known.data(), known.size(), constants.data(), MAX_CONSTANTS, threads);
+        if (found > MAX_CONSTANTS)
+        {
+            fprintf(stderr, "Too many G constants (%u) for P = 0x%08X, more known pages are needed\n",
+                    (unsigned)found, p);
+            continue;
+        }
+
+        std::map<std::vector<uint8_t>, std::pair<uint32_t, size_t> > keys2;
+        groupConstants(constants.data(), found, true, keys2);
+        for (std::map<std::vector<uint8_t>, std::pair<uint32_t, size_t> >::const_iterator it2 = keys2.begin();
+             it2 != keys2.end(); ++it2)
+        {
+            uint32_t g = it2->second.first;
+            if (TqKeyRecovery::verify(p, g, known.data(), known.size()))
+                addKey(p, g, it1->second.second * it2->second.second, keys);
+        }
+    }
+
+    size_t printed = 0;
+    for (std::map<std::vector<uint8_t>, Key>::const_iterator it = keys.begin();
+         it != keys.end() && printed < MAX_KEYS; ++it, ++printed)
+    {
+        printf("P = 0x%08X, G = 0x%08X (%u equivalent pair(s))\n",
+               it->second.p, it->second.g, (unsigned)it->second.count);
+    }
+
+    printf("%u key(s) (%.1f s)\n", (unsigned)keys.size(), (double)(clock() - start) / CLOCKS_PER_SEC);
+    if (keys.size() > 1)
+        printf("Some keys can't be told apart yet, more known octets (or pages) are needed\n");
+
+    return !keys.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,203 @@
+/*
+ * *** COServer.Security.Cryptography - Closed Source ***
+ * Copyright (C) 2015 Jean-Philippe Boivin
+ *
+ * Please read the WARNING, DISCLAIMER and PATENTS
+ * sections in the LICENSE file.
+ */
+
+#include "tqoffload_service.h"
+#include "tqcipher_offload.h"
+#include "instructionset.h"
+#include "tqcipher_std.h"
+#include "tqcipher_sse2.h"
+#include "tqcipher_avx2.h"
+#include "tqcipher_gfni.h"
+#include "tqcipher_avx512.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Offload service of the TQ cipher: the game servers of the host connect
+// to the region and hand their octets over to the workers. It runs until
+// a line is read on the standard input.
+//
+// With --check, the sessions of a client are checked against the standard
+// cipher through a service started in the process, then the service is
+// stopped and the sessions must go on locally.
+
+static const char* const CHECK_NAME = "tqcipher-offload-check";
+static const uint32_t CHECK_P = 0x13FA0F9D;
+static const uint32_t CHECK_G = 0x6D5C7962;
+static const size_t CHECK_SIZES[] = {
+    1, 15, 64, 255, 1000,
+    TqOffloadRegion::BLOCK_SIZE - 1, TqOffloadRegion::BLOCK_SIZE, TqOffloadRegion::BLOCK_SIZE + 1,
+    3 * TqOffloadRegion::BLOCK_SIZE + 7 };
+
+static TqCipherStream::Kernel
+selectKernel(const char* aImpl)
+{
+    if (strcmp(aImpl, "std") == 0)
+        return &TqCipher_Std::transform;
+    else if (strcmp(aImpl, "sse2") == 0 && InstructionSet::SSE2())
+        return &TqCipher_SSE2::transform;
+    else if (strcmp(aImpl, "avx2") == 0 && InstructionSet::AVX2())
+        return &TqCipher_AVX2::transform;
+#if TQ_CIPHER_GFNI
+    else if (strcmp(aImpl, "gfni") == 0 && InstructionSet::AVX2() && InstructionSet::GFNI())
+        return &TqCipher_GFNI::transform;
+    else if (strcmp(aImpl, "avx512") == 0 && InstructionSet::AVX512F() && InstructionSet::AVX512BW() && InstructionSet::GFNI())
+        return &TqCipher_AVX512::transform;
+#endif
+    else if (strcmp(aImpl, "auto") == 0)
+    {
+#if TQ_CIPHER_GFNI
+        if (InstructionSet::AVX512F() && InstructionSet::AVX512BW() && InstructionSet::GFNI())
+            return &TqCipher_AVX512::transform;
+        if (InstructionSet::AVX2() && InstructionSet::GFNI())
+            return &TqCipher_GFNI::transform;
+#endif
+        if (InstructionSet::AVX2())
+            return &TqCipher_AVX2::transform;
+        if (InstructionSet::SSE2())
+            return &TqCipher_SSE2::transform;
+        return &TqCipher_Std::transform;
+    }
+    return nullptr;
+}
+
+/**
+ * Process the same octets with the offloaded session and the reference, in
+ * a buffer of the process or, if allowed, in a block of the arena.
+ */
+static bool
+checkPackets(TqOffloadClient* aClient, TqCipher_Offload& aOffload, TqCipher_Base& aReference,
+             bool aDecrypt, bool aZeroCopy, const char* aWhat)
+{
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(CHECK_SIZES) / sizeof(CHECK_SIZES[0]); ++i)
+    {
+        size_t size = CHECK_SIZES[i];
+        std::vector<uint8_t> expected(size), actual(size);
+        for (size_t j = 0; j < size; ++j)
+            expected[j] = (uint8_t)(j * 31 + i);
+
+        // zero-copy when a block of the arena can hold the packet
+        uint8_t* block = aZeroCopy && size <= TqOffloadRegion::BLOCK_SIZE ? aClient->allocate() : nullptr;
+        uint8_t* buf = block != nullptr ? block : actual.data();
+        memcpy(buf, expected.data(), size);
+
+        if (aDecrypt)
+        {
+            aReference.decrypt(expected.data(), size);
+            aOffload.decrypt(buf, size);
+        }
+        else
+        {
+            aReference.encrypt(expected.data(), size);
+            aOffload.encrypt(buf, size);
+        }
+
+        if (memcmp(buf, expected.data(), size) != 0 || aOffload.isFailed())
+        {
+            fprintf(stderr, "The %s octets differ (%u octets%s)\n", aWhat, (unsigned)size,
+                    block != nullptr ? ", zero-copy" : "");
+            ok = false;
+        }
+        if (block != nullptr)
+            aClient->release(block);
+    }
+    return ok;
+}
+
+/**
+ * Check the round trips of a session against the standard cipher (see above).
+ */
+static bool
+check(TqCipherStream::Kernel aKernel)
+{
+    TqOffloadService service;
+    TqOffloadClient* client = nullptr;
+    if (!service.start(CHECK_NAME, aKernel, 1, -1) || (client = TqOffloadClient::connect(CHECK_NAME)) == nullptr)
+    {
+        fprintf(stderr, "Can't start the offload service\n");
+        return false;
+    }
+
+    bool ok = true;
+    {
+        TqCipher_Offload offload(client, aKernel);
+        TqCipher_Std reference;
+        offload.generateKey(CHECK_P, CHECK_G);
+        reference.generateKey(CHECK_P, CHECK_G);
+
+        ok &= checkPackets(client, offload, reference, false, true, "encrypted");
+        ok &= checkPackets(client, offload, reference, true, true, "decrypted");
+
+        offload.generateAltKey(0x12345678, 1000001);
+        reference.generateAltKey(0x12345678, 1000001);
+        ok &= checkPackets(client, offload, reference, false, true, "encrypted (alternate key)");
+        ok &= checkPackets(client, offload, reference, true, true, "decrypted (alternate key)");
+
+        // the waits must give up, and the session go on with the local kernel (the
+        // octets of the arena would be lost with the service, see isFailed)
+        service.stop();
+        ok &= checkPackets(client, offload, reference, false, false, "encrypted (service stopped)");
+        if (!client->isLost())
+        {
+            fprintf(stderr, "The client didn't notice the service stopped\n");
+            ok = false;
+        }
+    }
+
+    delete client;
+    return ok;
+}
+
+int
+main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--check") == 0)
+    {
+        TqCipherStream::Kernel kernel = selectKernel(argc > 2 ? argv[2] : "auto");
+        if (kernel == nullptr)
+        {
+            fprintf(stderr, "Usage: %s --check [auto|std|sse2|avx2|gfni|avx512]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        bool ok = check(kernel);
+        printf("Offload check %s\n", ok ? "passed" : "failed");
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const char* name = argc > 1 ? argv[1] : TqOffloadService::DEFAULT_NAME;
+    size_t workers = argc > 2 ? (size_t)atoi(argv[2]) : 2;
+    const char* impl = argc > 3 ? argv[3] : "auto";
+    int firstCpu = argc > 4 ? atoi(argv[4]) : -1;
+
+    TqCipherStream::Kernel kernel = selectKernel(impl);
+    if (kernel == nullptr || workers == 0 || workers > TqOffloadRegion::MAX_WORKERS)
+    {
+        fprintf(stderr, "Usage: %s [name] [workers (1-%u)] [auto|std|sse2|avx2|gfni|avx512] [first_cpu]\n",
+                argc > 0 ? argv[0] : "OffloadService", (unsigned)TqOffloadRegion::MAX_WORKERS);
+        return EXIT_FAILURE;
+    }
+
+    TqOffloadService service;
+    if (!service.start(name, kernel, workers, firstCpu))
+    {
+        fprintf(stderr, "Can't create the region %s\n", name);
+        return EXIT_FAILURE;
+    }
+
+    printf("Offload service %s running with %u worker(s) (%s), press Enter to stop.\n",
+           name, (unsigned)workers, impl);
+    getchar();
+
+    service.stop();
+    printf("%llu jobs, %llu octets\n",
+           (unsigned long long)service.getJobs(), (unsigned long long)service.getBytes());
+    return EXIT_SUCCESS;
+}
@@ -302,6 +302,7 @@ namespace COServer.Security.Cryptography
 
             TqCipher.P = P;
             TqCipher.G = G;
+            TqCipherContext context = TqCipherContext.Acquire(P, G);
             Console.WriteLine("Default implementation: " + TqCipher.GetImplInfo());
             Console.WriteLine();
 
@@ -320,6 +321,11 @@ namespace COServer.Security.Cryptography
             cipherIA32.Encrypt(ref block1, block1.Length);
             Console.WriteLine("Encryption test 2 ... {0}", block1.SequenceEqual(ciphertext2) ? "Success" : "Failure");
 
+            Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+            TqCipher sharedIA32 = new TqCipher(context, TqCipher.ImplType.Standard);
+            sharedIA32.Encrypt(ref block1, block1.Length);
+            Console.WriteLine("Encryption test (shared context) ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
             Buffer.BlockCopy(ciphertext3, 0, block1, 0, ciphertext3.Length);
             cipherIA32.ResetCounters();
             cipherIA32.Decrypt(ref block1, block1.Length);
@@ -331,6 +337,55 @@ namespace COServer.Security.Cryptography
             cipherIA32.Decrypt(ref block1, block1.Length);
             Console.WriteLine("Decryption test (alt key) ... {0}", block1.SequenceEqual(plaintext4) ? "Success" : "Failure");
 
+            TqCipher clientIA32 = new TqCipher(TqCipher.ImplType.Standard);
+            TqCipher serverIA32 = new TqCipher(TqCipher.ImplType.Standard);
+            clientIA32.GenerateAltKey(A, B);
+            byte[] forwardedIA32 = new byte[ciphertext4.Length];
+            clientIA32.Transcrypt(serverIA32, ciphertext4, ref forwardedIA32, forwardedIA32.Length);
+            byte[] expectedIA32 = (byte[])plaintext4.Clone();
+            new TqCipher(TqCipher.ImplType.Standard).Encrypt(ref expectedIA32, expectedIA32.Length);
+            Console.WriteLine("Transcrypt test ... {0}", forwardedIA32.SequenceEqual(expectedIA32) ? "Success" : "Failure");
+
+            bool rejected = true;
+            try { clientIA32.Transcrypt(serverIA32, null, ref forwardedIA32, forwardedIA32.Length); rejected = false; }
+            catch (ArgumentNullException) { }
+            try { clientIA32.Transcrypt(serverIA32, ciphertext4, ref forwardedIA32, forwardedIA32.Length + 1); rejected = false; }
+            catch (ArgumentOutOfRangeException) { }
+            byte[] shortIA32 = new byte[forwardedIA32.Length - 1];
+            try { clientIA32.Transcrypt(serverIA32, ciphertext4, ref shortIA32, ciphertext4.Length); rejected = false; }
+            catch (ArgumentOutOfRangeException) { }
+            Console.WriteLine("Transcrypt test (invalid arguments) ... {0}", rejected ? "Success" : "Failure");
+
+            Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+            cipherIA32.ResetCounters();
+            cipherIA32.GenerateAltKey(A, B);
+            cipherIA32.Decrypt(ref block1, 300);
+            TqCipher restoredIA32 = new TqCipher(TqCipher.ImplType.Standard);
+            restoredIA32.ImportState(cipherIA32.ExportState());
+            byte[] tailIA32 = ciphertext4.Skip(300).ToArray();
+            restoredIA32.Decrypt(ref tailIA32, tailIA32.Length);
+            Console.WriteLine("Snapshot test ... {0}", block1.Take(300).Concat(tailIA32).SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+            byte[] futureIA32 = cipherIA32.ExportState();
+            futureIA32[6] = 1;
+            bool refused = false;
+            try { restoredIA32.ImportState(futureIA32); }
+            catch (ArgumentException) { refused = true; }
+            Console.WriteLine("Snapshot test (reserved bytes) ... {0}", refused ? "Success" : "Failure");
+
+            Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+            cipherIA32.ResetCounters();
+            using (TqCipherDirection encryptorIA32 = cipherIA32.CreateEncryptor())
+            {
+                byte[] headIA32 = block1.Take(200).ToArray();
+                byte[] bodyIA32 = block1.Skip(200).ToArray();
+                UInt32 headPosIA32 = encryptorIA32.Reserve(headIA32.Length);
+                UInt32 bodyPosIA32 = encryptorIA32.Reserve(bodyIA32.Length);
+                encryptorIA32.ProcessAt(bodyPosIA32, ref bodyIA32, bodyIA32.Length);
+                encryptorIA32.ProcessAt(headPosIA32, ref headIA32, headIA32.Length);
+                Console.WriteLine("Reservation test ... {0}", headIA32.Concat(bodyIA32).SequenceEqual(ciphertext1) ? "Success" : "Failure");
+            }
+
             Console.WriteLine();
 
             try
@@ -348,6 +403,11 @@ namespace COServer.Security.Cryptography
                 cipherSSE2.Encrypt(ref block1, block1.Length);
                 Console.WriteLine("Encryption test 2 ... {0}", block1.SequenceEqual(ciphertext2) ? "Success" : "Failure");
 
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                TqCipher sharedSSE2 = new TqCipher(context, TqCipher.ImplType.SSE2);
+                sharedSSE2.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test (shared context) ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
                 Buffer.BlockCopy(ciphertext3, 0, block1, 0, ciphertext3.Length);
                 cipherSSE2.ResetCounters();
                 cipherSSE2.Decrypt(ref block1, block1.Length);
@@ -358,6 +418,38 @@ namespace COServer.Security.Cryptography
                 cipherSSE2.GenerateAltKey(A, B);
                 cipherSSE2.Decrypt(ref block1, block1.Length);
                 Console.WriteLine("Decryption test (alt key) ... {0}", block1.SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                TqCipher clientSSE2 = new TqCipher(TqCipher.ImplType.SSE2);
+                TqCipher serverSSE2 = new TqCipher(TqCipher.ImplType.Standard);
+                clientSSE2.GenerateAltKey(A, B);
+                byte[] forwardedSSE2 = new byte[ciphertext4.Length];
+                clientSSE2.Transcrypt(serverSSE2, ciphertext4, ref forwardedSSE2, forwardedSSE2.Length);
+                byte[] expectedSSE2 = (byte[])plaintext4.Clone();
+                new TqCipher(TqCipher.ImplType.Standard).Encrypt(ref expectedSSE2, expectedSSE2.Length);
+                Console.WriteLine("Transcrypt test ... {0}", forwardedSSE2.SequenceEqual(expectedSSE2) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+                cipherSSE2.ResetCounters();
+                cipherSSE2.GenerateAltKey(A, B);
+                cipherSSE2.Decrypt(ref block1, 300);
+                TqCipher restoredSSE2 = new TqCipher(TqCipher.ImplType.Standard);
+                restoredSSE2.ImportState(cipherSSE2.ExportState());
+                byte[] tailSSE2 = ciphertext4.Skip(300).ToArray();
+                restoredSSE2.Decrypt(ref tailSSE2, tailSSE2.Length);
+                Console.WriteLine("Snapshot test ... {0}", block1.Take(300).Concat(tailSSE2).SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                cipherSSE2.ResetCounters();
+                using (TqCipherDirection encryptorSSE2 = cipherSSE2.CreateEncryptor())
+                {
+                    byte[] headSSE2 = block1.Take(200).ToArray();
+                    byte[] bodySSE2 = block1.Skip(200).ToArray();
+                    UInt32 headPosSSE2 = encryptorSSE2.Reserve(headSSE2.Length);
+                    UInt32 bodyPosSSE2 = encryptorSSE2.Reserve(bodySSE2.Length);
+                    encryptorSSE2.ProcessAt(bodyPosSSE2, ref bodySSE2, bodySSE2.Length);
+                    encryptorSSE2.ProcessAt(headPosSSE2, ref headSSE2, headSSE2.Length);
+                    Console.WriteLine("Reservation test ... {0}", headSSE2.Concat(bodySSE2).SequenceEqual(ciphertext1) ? "Success" : "Failure");
+                }
             }
             catch (NotSupportedException exc) { Console.WriteLine(exc); }
 
@@ -378,6 +470,11 @@ namespace COServer.Security.Cryptography
                 cipherAVX2.Encrypt(ref block1, block1.Length);
                 Console.WriteLine("Encryption test 2 ... {0}", block1.SequenceEqual(ciphertext2) ? "Success" : "Failure");
 
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                TqCipher sharedAVX2 = new TqCipher(context, TqCipher.ImplType.AVX2);
+                sharedAVX2.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test (shared context) ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
                 Buffer.BlockCopy(ciphertext3, 0, block1, 0, ciphertext3.Length);
                 cipherAVX2.ResetCounters();
                 cipherAVX2.Decrypt(ref block1, block1.Length);
@@ -388,9 +485,346 @@ namespace COServer.Security.Cryptography
                 cipherAVX2.GenerateAltKey(A, B);
                 cipherAVX2.Decrypt(ref block1, block1.Length);
                 Console.WriteLine("Decryption test (alt key) ... {0}", block1.SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                TqCipher clientAVX2 = new TqCipher(TqCipher.ImplType.AVX2);
+                TqCipher serverAVX2 = new TqCipher(TqCipher.ImplType.Standard);
+                clientAVX2.GenerateAltKey(A, B);
+                byte[] forwardedAVX2 = new byte[ciphertext4.Length];
+                clientAVX2.Transcrypt(serverAVX2, ciphertext4, ref forwardedAVX2, forwardedAVX2.Length);
+                byte[] expectedAVX2 = (byte[])plaintext4.Clone();
+                new TqCipher(TqCipher.ImplType.Standard).Encrypt(ref expectedAVX2, expectedAVX2.Length);
+                Console.WriteLine("Transcrypt test ... {0}", forwardedAVX2.SequenceEqual(expectedAVX2) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+                cipherAVX2.ResetCounters();
+                cipherAVX2.GenerateAltKey(A, B);
+                cipherAVX2.Decrypt(ref block1, 300);
+                TqCipher restoredAVX2 = new TqCipher(TqCipher.ImplType.Standard);
+                restoredAVX2.ImportState(cipherAVX2.ExportState());
+                byte[] tailAVX2 = ciphertext4.Skip(300).ToArray();
+                restoredAVX2.Decrypt(ref tailAVX2, tailAVX2.Length);
+                Console.WriteLine("Snapshot test ... {0}", block1.Take(300).Concat(tailAVX2).SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                cipherAVX2.ResetCounters();
+                using (TqCipherDirection encryptorAVX2 = cipherAVX2.CreateEncryptor())
+                {
+                    byte[] headAVX2 = block1.Take(200).ToArray();
+                    byte[] bodyAVX2 = block1.Skip(200).ToArray();
+                    UInt32 headPosAVX2 = encryptorAVX2.Reserve(headAVX2.Length);
+                    UInt32 bodyPosAVX2 = encryptorAVX2.Reserve(bodyAVX2.Length);
+                    encryptorAVX2.ProcessAt(bodyPosAVX2, ref bodyAVX2, bodyAVX2.Length);
+                    encryptorAVX2.ProcessAt(headPosAVX2, ref headAVX2, headAVX2.Length);
+                    Console.WriteLine("Reservation test ... {0}", headAVX2.Concat(bodyAVX2).SequenceEqual(ciphertext1) ? "Success" : "Failure");
+                }
+            }
+            catch (NotSupportedException exc) { Console.WriteLine(exc); }
+
+            Console.WriteLine();
+
+            try
+            {
+                Console.WriteLine("Testing the GFNI cipher...");
+                TqCipher cipherGFNI = new TqCipher(TqCipher.ImplType.GFNI);
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                cipherGFNI.ResetCounters();
+                cipherGFNI.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test 1 ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext2, 0, block1, 0, plaintext2.Length);
+                cipherGFNI.ResetCounters();
+                cipherGFNI.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test 2 ... {0}", block1.SequenceEqual(ciphertext2) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                TqCipher sharedGFNI = new TqCipher(context, TqCipher.ImplType.GFNI);
+                sharedGFNI.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test (shared context) ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext3, 0, block1, 0, ciphertext3.Length);
+                cipherGFNI.ResetCounters();
+                cipherGFNI.Decrypt(ref block1, block1.Length);
+                Console.WriteLine("Decryption test (default key) ... {0}", block1.SequenceEqual(plaintext3) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+                cipherGFNI.ResetCounters();
+                cipherGFNI.GenerateAltKey(A, B);
+                cipherGFNI.Decrypt(ref block1, block1.Length);
+                Console.WriteLine("Decryption test (alt key) ... {0}", block1.SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                TqCipher clientGFNI = new TqCipher(TqCipher.ImplType.GFNI);
+                TqCipher serverGFNI = new TqCipher(TqCipher.ImplType.Standard);
+                clientGFNI.GenerateAltKey(A, B);
+                byte[] forwardedGFNI = new byte[ciphertext4.Length];
+                clientGFNI.Transcrypt(serverGFNI, ciphertext4, ref forwardedGFNI, forwardedGFNI.Length);
+                byte[] expectedGFNI = (byte[])plaintext4.Clone();
+                new TqCipher(TqCipher.ImplType.Standard).Encrypt(ref expectedGFNI, expectedGFNI.Length);
+                Console.WriteLine("Transcrypt test ... {0}", forwardedGFNI.SequenceEqual(expectedGFNI) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+                cipherGFNI.ResetCounters();
+                cipherGFNI.GenerateAltKey(A, B);
+                cipherGFNI.Decrypt(ref block1, 300);
+                TqCipher restoredGFNI = new TqCipher(TqCipher.ImplType.Standard);
+                restoredGFNI.ImportState(cipherGFNI.ExportState());
+                byte[] tailGFNI = ciphertext4.Skip(300).ToArray();
+                restoredGFNI.Decrypt(ref tailGFNI, tailGFNI.Length);
+                Console.WriteLine("Snapshot test ... {0}", block1.Take(300).Concat(tailGFNI).SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                cipherGFNI.ResetCounters();
+                using (TqCipherDirection encryptorGFNI = cipherGFNI.CreateEncryptor())
+                {
+                    byte[] headGFNI = block1.Take(200).ToArray();
+                    byte[] bodyGFNI = block1.Skip(200).ToArray();
+                    UInt32 headPosGFNI = encryptorGFNI.Reserve(headGFNI.Length);
+                    UInt32 bodyPosGFNI = encryptorGFNI.Reserve(bodyGFNI.Length);
+                    encryptorGFNI.ProcessAt(bodyPosGFNI, ref bodyGFNI, bodyGFNI.Length);
+                    encryptorGFNI.ProcessAt(headPosGFNI, ref headGFNI, headGFNI.Length);
+                    Console.WriteLine("Reservation test ... {0}", headGFNI.Concat(bodyGFNI).SequenceEqual(ciphertext1) ? "Success" : "Failure");
+                }
             }
             catch (NotSupportedException exc) { Console.WriteLine(exc); }
 
+            Console.WriteLine();
+
+            try
+            {
+                Console.WriteLine("Testing the AVX-512 cipher...");
+                TqCipher cipherAVX512 = new TqCipher(TqCipher.ImplType.AVX512);
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                cipherAVX512.ResetCounters();
+                cipherAVX512.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test 1 ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext2, 0, block1, 0, plaintext2.Length);
+                cipherAVX512.ResetCounters();
+                cipherAVX512.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test 2 ... {0}", block1.SequenceEqual(ciphertext2) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                TqCipher sharedAVX512 = new TqCipher(context, TqCipher.ImplType.AVX512);
+                sharedAVX512.Encrypt(ref block1, block1.Length);
+                Console.WriteLine("Encryption test (shared context) ... {0}", block1.SequenceEqual(ciphertext1) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext3, 0, block1, 0, ciphertext3.Length);
+                cipherAVX512.ResetCounters();
+                cipherAVX512.Decrypt(ref block1, block1.Length);
+                Console.WriteLine("Decryption test (default key) ... {0}", block1.SequenceEqual(plaintext3) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+                cipherAVX512.ResetCounters();
+                cipherAVX512.GenerateAltKey(A, B);
+                cipherAVX512.Decrypt(ref block1, block1.Length);
+                Console.WriteLine("Decryption test (alt key) ... {0}", block1.SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                TqCipher clientAVX512 = new TqCipher(TqCipher.ImplType.AVX512);
+                TqCipher serverAVX512 = new TqCipher(TqCipher.ImplType.Standard);
+                clientAVX512.GenerateAltKey(A, B);
+                byte[] forwardedAVX512 = new byte[ciphertext4.Length];
+                clientAVX512.Transcrypt(serverAVX512, ciphertext4, ref forwardedAVX512, forwardedAVX512.Length);
+                byte[] expectedAVX512 = (byte[])plaintext4.Clone();
+                new TqCipher(TqCipher.ImplType.Standard).Encrypt(ref expectedAVX512, expectedAVX512.Length);
+                Console.WriteLine("Transcrypt test ... {0}", forwardedAVX512.SequenceEqual(expectedAVX512) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(ciphertext4, 0, block1, 0, ciphertext4.Length);
+                cipherAVX512.ResetCounters();
+                cipherAVX512.GenerateAltKey(A, B);
+                cipherAVX512.Decrypt(ref block1, 300);
+                TqCipher restoredAVX512 = new TqCipher(TqCipher.ImplType.Standard);
+                restoredAVX512.ImportState(cipherAVX512.ExportState());
+                byte[] tailAVX512 = ciphertext4.Skip(300).ToArray();
+                restoredAVX512.Decrypt(ref tailAVX512, tailAVX512.Length);
+                Console.WriteLine("Snapshot test ... {0}", block1.Take(300).Concat(tailAVX512).SequenceEqual(plaintext4) ? "Success" : "Failure");
+
+                Buffer.BlockCopy(plaintext1, 0, block1, 0, plaintext1.Length);
+                cipherAVX512.ResetCounters();
+                using (TqCipherDirection encryptorAVX512 = cipherAVX512.CreateEncryptor())
+                {
+                    byte[] headAVX512 = block1.Take(200).ToArray();
+                    byte[] bodyAVX512 = block1.Skip(200).ToArray();
+                    UInt32 headPosAVX512 = encryptorAVX512.Reserve(headAVX512.Length);
+                    UInt32 bodyPosAVX512 = encryptorAVX512.Reserve(bodyAVX512.Length);
+                    encryptorAVX512.ProcessAt(bodyPosAVX512, ref bodyAVX512, bodyAVX512.Length);
+                    encryptorAVX512.ProcessAt(headPosAVX512, ref headAVX512, headAVX512.Length);
+                    Console.WriteLine("Reservation test ... {0}", headAVX512.Concat(bodyAVX512).SequenceEqual(ciphertext1) ? "Success" : "Failure");
+                }
+            }
+            catch (NotSupportedException exc) { Console.WriteLine(exc); }
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the broadcast...");
+            TqCipher[] recipients = new TqCipher[3];
+            byte[][] outputs = new byte[3][];
+            for (int i = 0; i < recipients.Length; ++i)
+            {
+                recipients[i] = new TqCipher(context);
+                outputs[i] = new byte[plaintext2.Length];
+            }
+            byte[] skipped = new byte[100];
+            recipients[1].Encrypt(ref skipped, 77);
+
+            TqCipher.Broadcast(plaintext2, plaintext2.Length, recipients, outputs);
+            byte[] expected = (byte[])plaintext2.Clone();
+            TqCipher reference = new TqCipher(context);
+            reference.Encrypt(ref skipped, 77);
+            reference.Encrypt(ref expected, expected.Length);
+            Console.WriteLine("Broadcast test ... {0}", outputs[0].SequenceEqual(ciphertext2) && outputs[2].SequenceEqual(ciphertext2) && outputs[1].SequenceEqual(expected) ? "Success" : "Failure");
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the patching...");
+            byte[] patched = (byte[])ciphertext2.Clone();
+            byte[] newValues = new byte[] { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0, 0x0F, 0xED, 0xCB };
+            TqCipher.Patch(patched, 5, plaintext2.Skip(5).Take(newValues.Length).ToArray(), newValues, newValues.Length);
+            expected = (byte[])plaintext2.Clone();
+            Buffer.BlockCopy(newValues, 0, expected, 5, newValues.Length);
+            reference = new TqCipher(context);
+            reference.Encrypt(ref expected, expected.Length);
+            Console.WriteLine("Patch test ... {0}", patched.SequenceEqual(expected) ? "Success" : "Failure");
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the ring buffers...");
+            byte[] ring = new byte[plaintext1.Length + 100];
+            int head = ring.Length - 211;
+            for (int i = 0; i < plaintext1.Length; ++i)
+                ring[(head + i) % ring.Length] = plaintext1[i];
+            TqCipher ringCipher = new TqCipher(context);
+            ringCipher.Encrypt(ref ring, head, plaintext1.Length);
+            Console.WriteLine("Encryption test (wrapped) ... {0}", Enumerable.Range(0, ciphertext1.Length).All(i => ring[(head + i) % ring.Length] == ciphertext1[i]) ? "Success" : "Failure");
+
+            for (int i = 0; i < ciphertext4.Length; ++i)
+                ring[(head + i) % ring.Length] = ciphertext4[i];
+            ringCipher.GenerateAltKey(A, B);
+            ringCipher.Decrypt(ref ring, head, ciphertext4.Length);
+            Console.WriteLine("Decryption test (wrapped) ... {0}", Enumerable.Range(0, plaintext4.Length).All(i => ring[(head + i) % ring.Length] == plaintext4[i]) ? "Success" : "Failure");
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the resynchronization...");
+            TqCipher desynced = new TqCipher(context);
+            desynced.GenerateAltKey(A, B);
+            block1 = new byte[37];
+            desynced.Decrypt(ref block1, block1.Length); // the client never sent these bytes
+            int[] candidates = desynced.FindDecryptionCounters(ciphertext4, 16, 0x3F8D, 0x3F8D, 0x188C, 0x188C);
+            bool resynced = false;
+            foreach (int candidate in candidates.Where(c => (c & TqCipher.AltKeyCandidate) != 0))
+            {
+                desynced.Resync(candidate);
+                block1 = (byte[])ciphertext4.Clone();
+                desynced.Decrypt(ref block1, block1.Length);
+                resynced |= block1.SequenceEqual(plaintext4);
+            }
+            Console.WriteLine("Search test ... {0}", resynced ? "Success" : "Failure");
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the packet dumps...");
+            Console.WriteLine("Dump test ... {0}", HexDump.Dump(plaintext4, plaintext4.Length) == (String)Dump(plaintext4) ? "Success" : "Failure");
+
+            TqCipher logged = new TqCipher(context);
+            logged.GenerateAltKey(A, B);
+            using (TqCipherDirection decryptor = logged.CreateDecryptor())
+            {
+                byte[] log = new byte[HexDump.GetSize(ciphertext4.Length)];
+                block1 = (byte[])ciphertext4.Clone();
+                int logSize = decryptor.ProcessAndDump(ref block1, block1.Length, log, 0);
+                Console.WriteLine("Decryption and dump test ... {0}", block1.SequenceEqual(plaintext4) && System.Text.Encoding.ASCII.GetString(log, 0, logSize) == (String)Dump(plaintext4) ? "Success" : "Failure");
+            }
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the packet tap...");
+            using (TqCipherTap tap = new TqCipherTap(16, 64))
+            {
+                TqCipher tapped = new TqCipher(context);
+                tapped.GenerateAltKey(A, B);
+                tapped.SetTap(tap, 7);
+                block1 = (byte[])ciphertext4.Clone();
+                tapped.Decrypt(ref block1, block1.Length);
+                tapped.SetTap(null, 0);
+
+                TqCipherTapRecord record;
+                byte[] snap = new byte[tap.SnapLength];
+                bool read = tap.Read(out record, snap);
+                Console.WriteLine("Tap test ... {0}", read && record.Session == 7 && record.Decrypted && record.Length == ciphertext4.Length && snap.SequenceEqual(plaintext4.Take(snap.Length)) && !tap.Read(out record, snap) ? "Success" : "Failure");
+            }
+
+            Console.WriteLine();
+
+            Console.WriteLine("Testing the Blowfish cipher...");
+            byte[] bfKey = new byte[] { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0xF0, 0xE1, 0xD2, 0xC3, 0xB4, 0xA5, 0x96, 0x87 };
+            byte[] bfIV = new byte[] { 0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10 };
+            byte[] bfPlaintext = System.Text.Encoding.ASCII.GetBytes("7654321 Now is the time for \0");
+            byte[] bfCiphertext = new byte[] {
+                0xE7, 0x32, 0x14, 0xA2, 0x82, 0x21, 0x39, 0xCA, 0xF2, 0x6E, 0xCF, 0x6D, 0x2E, 0xB9, 0xE7, 0x6E,
+                0x3D, 0xA3, 0xDE, 0x04, 0xD1, 0x51, 0x72, 0x00, 0x51, 0x9D, 0x57, 0xA6, 0xC3 };
+
+            Blowfish blowfish = new Blowfish();
+            blowfish.SetKey(new byte[8]);
+            block1 = new byte[8];
+            blowfish.Encrypt(ref block1, block1.Length);
+            Console.WriteLine("Encryption test (zero key) ... {0}", block1.SequenceEqual(new byte[] { 0x4E, 0xF9, 0x97, 0x45, 0x61, 0x98, 0xDD, 0x78 }) ? "Success" : "Failure");
+
+            blowfish.SetKey(bfKey);
+            blowfish.SetIVs(bfIV, bfIV);
+            byte[] bfHead = bfPlaintext.Take(3).ToArray();
+            byte[] bfTail = bfPlaintext.Skip(3).ToArray();
+            blowfish.Encrypt(ref bfHead, bfHead.Length);
+            blowfish.Encrypt(ref bfTail, bfTail.Length);
+            Console.WriteLine("Encryption test (CFB64) ... {0}", bfHead.Concat(bfTail).SequenceEqual(bfCiphertext) ? "Success" : "Failure");
+
+            block1 = (byte[])bfCiphertext.Clone();
+            blowfish.Decrypt(ref block1, block1.Length);
+            Console.WriteLine("Decryption test (CFB64) ... {0}", block1.SequenceEqual(bfPlaintext) ? "Success" : "Failure");
+
+            Blowfish[] bfSessions = new Blowfish[5];
+            byte[][] bfBufs = new byte[5][];
+            int[] bfLengths = new int[5];
+            for (int i = 0; i < bfSessions.Length; ++i)
+            {
+                bfSessions[i] = new Blowfish();
+                bfBufs[i] = (byte[])bfPlaintext.Clone();
+                bfLengths[i] = bfPlaintext.Length;
+            }
+            Blowfish.SetKeys(bfSessions, Enumerable.Repeat(bfKey, bfSessions.Length).ToArray());
+            foreach (Blowfish session in bfSessions)
+                session.SetIVs(bfIV, bfIV);
+            Blowfish.EncryptAll(bfSessions, bfBufs, bfLengths);
+            Console.WriteLine("Batch test ... {0}", bfBufs.All(buf => buf.SequenceEqual(bfCiphertext)) ? "Success" : "Failure");
+
+            Console.WriteLine("Testing the RC5 cipher...");
+            byte[] rc5Key = new byte[] { 0x91, 0x5F, 0x46, 0x19, 0xBE, 0x41, 0xB2, 0x51, 0x63, 0x55, 0xA5, 0x01, 0x10, 0xA9, 0xCE, 0x91 };
+            byte[] rc5Block1 = new byte[] { 0x21, 0xA5, 0xDB, 0xEE, 0x15, 0x4B, 0x8F, 0x6D };
+            byte[] rc5Block2 = new byte[] { 0xF7, 0xC0, 0x13, 0xAC, 0x5B, 0x2B, 0x89, 0x52 };
+
+            RC5 rc5 = new RC5(new byte[16]);
+            block1 = new byte[8];
+            rc5.Encrypt(ref block1, block1.Length);
+            Console.WriteLine("Encryption test (zero key) ... {0}", block1.SequenceEqual(rc5Block1) ? "Success" : "Failure");
+
+            rc5 = new RC5(rc5Key);
+            rc5.Encrypt(ref block1, block1.Length);
+            Console.WriteLine("Encryption test ... {0}", block1.SequenceEqual(rc5Block2) ? "Success" : "Failure");
+            rc5.Decrypt(ref block1, block1.Length);
+            Console.WriteLine("Decryption test ... {0}", block1.SequenceEqual(rc5Block1) ? "Success" : "Failure");
+
+            RC5 rc5Server = new RC5();
+            byte[][] rc5Passwords = new byte[37][];
+            byte[][] rc5Plaintexts = new byte[37][];
+            for (int i = 0; i < rc5Passwords.Length; ++i)
+            {
+                rc5Plaintexts[i] = System.Text.Encoding.ASCII.GetBytes(String.Format("password{0:D8}", i));
+                rc5Passwords[i] = (byte[])rc5Plaintexts[i].Clone();
+                rc5Server.Encrypt(ref rc5Passwords[i], RC5.PasswordSize);
+            }
+            rc5Server.DecryptAll(rc5Passwords);
+            Console.WriteLine("Batch test ... {0}", Enumerable.Range(0, rc5Passwords.Length).All(i => rc5Passwords[i].SequenceEqual(rc5Plaintexts[i])) ? "Success" : "Failure");
+
             Console.WriteLine();
             Console.WriteLine("Done...");
             Console.ReadLine();